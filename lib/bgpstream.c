@@ -204,6 +204,54 @@ void bgpstream_set_live_mode(bgpstream_t *bs)
   bgpstream_di_mgr_set_blocking(bs->di_mgr);
 }
 
+void bgpstream_set_decode_ahead(bgpstream_t *bs, int queue_len)
+{
+  assert(!bs->started);
+  bgpstream_di_mgr_set_decode_ahead(bs->di_mgr, queue_len);
+}
+
+void bgpstream_set_opener_threads(bgpstream_t *bs, int threads)
+{
+  assert(!bs->started);
+  bgpstream_di_mgr_set_opener_threads(bs->di_mgr, threads);
+}
+
+void bgpstream_set_buffer_budget(bgpstream_t *bs, size_t budget)
+{
+  assert(!bs->started);
+  bgpstream_di_mgr_set_buffer_budget(bs->di_mgr, budget);
+}
+
+void bgpstream_set_decompress_threads(bgpstream_t *bs, int threads)
+{
+  assert(!bs->started);
+  bgpstream_di_mgr_set_decompress_threads(bs->di_mgr, threads);
+}
+
+void bgpstream_set_lazy_elem_attrs(bgpstream_t *bs)
+{
+  assert(!bs->started);
+  bgpstream_di_mgr_set_lazy_elem_attrs(bs->di_mgr);
+}
+
+void bgpstream_set_unordered(bgpstream_t *bs)
+{
+  assert(!bs->started);
+  bgpstream_di_mgr_set_unordered(bs->di_mgr);
+}
+
+void bgpstream_get_opener_stats(bgpstream_t *bs,
+                                bgpstream_opener_stats_t *stats)
+{
+  bgpstream_di_mgr_get_opener_stats(bs->di_mgr, stats);
+}
+
+void bgpstream_get_response_cache_stats(bgpstream_t *bs,
+                                        bgpstream_response_cache_stats_t *stats)
+{
+  bgpstream_di_mgr_get_response_cache_stats(bs->di_mgr, stats);
+}
+
 /* turn on the bgpstream interface, i.e.:
  * it makes the interface ready
  * for a new get next call
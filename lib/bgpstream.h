@@ -188,6 +188,59 @@ typedef struct struct_bgpstream_data_interface_option {
 
 } bgpstream_data_interface_option_t;
 
+/** Structure that contains statistics about resources opened by the opener
+ * thread pool (see bgpstream_set_opener_threads). All times are in
+ * milliseconds. */
+typedef struct bgpstream_opener_stats {
+
+  /** The number of resources that have finished opening (successfully or
+      not) */
+  uint64_t open_cnt;
+
+  /** The total time that resources spent queued, waiting for an opener
+      thread */
+  uint64_t queue_wait_total;
+
+  /** The longest time that a resource spent queued */
+  uint64_t queue_wait_max;
+
+  /** The total time spent opening resources (including retries) */
+  uint64_t open_time_total;
+
+  /** The longest time spent opening a single resource */
+  uint64_t open_time_max;
+
+  /** The number of resources currently waiting to be opened */
+  int queued_cnt;
+
+  /** The number of resources currently being opened */
+  int active_cnt;
+
+  /** The largest number of resources that were opened concurrently */
+  int active_max;
+
+} bgpstream_opener_stats_t;
+
+/** Structure that contains statistics about the on-disk cache of broker
+ * responses (see the "response-cache-dir" option of the broker data
+ * interface). */
+typedef struct bgpstream_response_cache_stats {
+
+  /** The number of queries answered from the cache */
+  uint64_t hit_cnt;
+
+  /** The number of cacheable queries that had to be sent to the broker */
+  uint64_t miss_cnt;
+
+  /** The number of responses written to the cache */
+  uint64_t store_cnt;
+
+  /** The number of queries that could not be cached because their time
+      intervals were not closed */
+  uint64_t uncacheable_cnt;
+
+} bgpstream_response_cache_stats_t;
+
 /** @} */
 
 /**
@@ -363,6 +416,133 @@ void bgpstream_set_data_interface(bgpstream_t *bs,
  */
 void bgpstream_set_live_mode(bgpstream_t *bs);
 
+/** Configure BGP Stream to decode records in the background
+ *
+ * @param bs            pointer to a BGP Stream instance to configure
+ * @param queue_len     maximum number of decoded records to buffer for each
+ *                      open resource (0 disables background decoding)
+ *
+ * By default, records are decoded on the caller's thread as they are
+ * requested. When background decoding is enabled, each open (non-stream)
+ * resource decodes up to `queue_len` records ahead of the caller on its own
+ * thread, allowing many concurrently open dump files to be decoded in
+ * parallel. If an opener pool is used (see bgpstream_set_opener_threads), the
+ * decoding is done by the pool's threads instead, so the number of threads
+ * stays bounded however many resources are open. Records are returned in
+ * exactly the same order either way.
+ *
+ * Values between 1 and 2 are rounded up to 2.
+ */
+void bgpstream_set_decode_ahead(bgpstream_t *bs, int queue_len);
+
+/** Configure BGP Stream to open resources using a bounded pool of threads
+ *
+ * @param bs            pointer to a BGP Stream instance to configure
+ * @param threads       number of opener threads (0 to use one thread per
+ *                      resource)
+ *
+ * By default, a new thread is started to open each resource, so a query that
+ * covers many dump files may start hundreds of threads at once. When an
+ * opener pool is used, at most `threads` resources are opened concurrently,
+ * and resources with the earliest initial time are opened first. When
+ * background decoding is enabled (see bgpstream_set_decode_ahead), the same
+ * threads also decode the open resources.
+ */
+void bgpstream_set_opener_threads(bgpstream_t *bs, int threads);
+
+/** Configure BGP Stream to share parse buffers between open resources, within
+ * a memory budget
+ *
+ * @param bs            pointer to a BGP Stream instance to configure
+ * @param budget        approximate number of bytes to use for parse buffers
+ *                      (0 to give each open resource a private buffer)
+ *
+ * By default, each open resource holds a private 1 MB parse buffer for as long
+ * as it is open. When a budget is set, resources take buffers from a shared
+ * pool only when they need to read more data, and give them back as soon as
+ * they have been consumed. Once the budget is used up, resources read using
+ * small (64 kB) buffers, so a budget of N MB caps the number of resources
+ * holding full-size buffers at N.
+ *
+ * In either mode, a buffer will grow as needed to fit a single large message
+ * (e.g., a large TABLE_DUMP_V2 record).
+ */
+void bgpstream_set_buffer_budget(bgpstream_t *bs, size_t budget);
+
+/** Configure BGP Stream to decompress bzip2 files using a pool of threads
+ *
+ * @param bs            pointer to a BGP Stream instance to configure
+ * @param threads       number of decompression threads (0 to decompress each
+ *                      file serially, the default)
+ *
+ * bzip2 files (e.g., RouteViews dumps) are split into their independent
+ * blocks, which are decompressed in parallel by the pool and then returned in
+ * order, so reading a single large RIB is no longer limited by the speed of
+ * one core. gzip files can only be split if their members are tagged with
+ * their length (as bgzip does), so other gzip files (e.g., RIS dumps), and
+ * uncompressed files, are read as usual. The pool is shared by all open
+ * resources.
+ */
+void bgpstream_set_decompress_threads(bgpstream_t *bs, int threads);
+
+/** Configure BGP Stream to decode the AS path and communities of elems only
+ * when they are accessed
+ *
+ * @param bs            pointer to a BGP Stream instance to configure
+ *
+ * By default, the AS path (including merging AS_PATH and AS4_PATH) and the
+ * communities of every RIB and announcement elem are decoded as the elem is
+ * extracted. In lazy mode, the elem instead keeps a reference to the decoded
+ * BGP attributes, and these fields are built the first time they are
+ * accessed, so applications that only use the prefix, peer and type of elems
+ * skip this work entirely.
+ *
+ * In lazy mode, the `as_path` and `communities` fields of an elem MUST be
+ * accessed using bgpstream_elem_get_as_path and
+ * bgpstream_elem_get_communities (or by bgpstream_elem_snprintf or
+ * bgpstream_elem_copy, which use them).
+ */
+void bgpstream_set_lazy_elem_attrs(bgpstream_t *bs);
+
+/** Configure BGP Stream to return records without ordering them by time
+ *
+ * @param bs            pointer to a BGP Stream instance to configure
+ *
+ * By default, records from all resources are merged into time order, which
+ * means waiting for every overlapping resource to open and reading from
+ * whichever has the earliest next record, however slow it is. In unordered
+ * mode, many resources are opened at once, each decodes ahead in its own
+ * thread, and records are returned from whichever resource has one ready.
+ * This suits jobs that aggregate over all records and do not care about
+ * their order.
+ *
+ * Records from the same resource are still returned in the order they appear
+ * in it, but records from different resources are interleaved arbitrarily.
+ */
+void bgpstream_set_unordered(bgpstream_t *bs);
+
+/** Get statistics about the resources opened by the opener thread pool
+ *
+ * @param bs            pointer to a BGP Stream instance
+ * @param[out] stats    pointer to a stats structure to fill
+ *
+ * All statistics will be zero if no opener pool is in use (see
+ * bgpstream_set_opener_threads).
+ */
+void bgpstream_get_opener_stats(bgpstream_t *bs,
+                                bgpstream_opener_stats_t *stats);
+
+/** Get statistics about the response cache of the current data interface
+ *
+ * @param bs            pointer to a BGP Stream instance
+ * @param[out] stats    pointer to a stats structure to fill
+ *
+ * All statistics will be zero if the data interface does not cache responses
+ * (currently only the broker can, see its "response-cache-dir" option).
+ */
+void bgpstream_get_response_cache_stats(bgpstream_t *bs,
+                                        bgpstream_response_cache_stats_t *stats);
+
 /** Start the given BGP Stream instance.
  *
  * @param bs            pointer to a BGP Stream instance to start
@@ -0,0 +1,553 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_aspath_matcher.h"
+#include "khash.h"
+#include "utils.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NONE UINT32_MAX
+
+/* automaton state types */
+enum {
+  /* match one segment, then move on to the next state */
+  STATE_ONE = 0,
+
+  /* match any number of segments (staying in this state), or move on to the
+     next state without matching a segment */
+  STATE_STAR = 1,
+
+  /* the whole expression has matched */
+  STATE_FINAL = 2,
+};
+
+typedef struct aspath_state {
+
+  /* ASN of the segment to match (unless any is set) */
+  uint32_t asn;
+
+  /* index of the expression this state belongs to */
+  uint32_t expr;
+
+  /* STATE_ONE, STATE_STAR or STATE_FINAL */
+  uint8_t type;
+
+  /* if set, any segment matches (including AS sets) */
+  uint8_t any;
+
+} aspath_state_t;
+
+typedef struct aspath_expr {
+
+  /* the match must start at the first segment ('^') */
+  uint8_t anchored_start;
+
+  /* the match must end at the last segment ('$') */
+  uint8_t anchored_end;
+
+  uint8_t negate;
+
+} aspath_expr_t;
+
+/* entry in a list of expressions that may start at a given segment */
+typedef struct aspath_start {
+
+  /* state the expression is in once its first item has matched */
+  uint32_t state;
+
+  /* index of the next entry in the list (or NONE) */
+  uint32_t next;
+
+} aspath_start_t;
+
+/* ASN of the first item -> index of the first entry of the start list */
+KHASH_INIT(aspath_start_map, uint32_t, uint32_t, 1, kh_int_hash_func,
+           kh_int_hash_equal);
+
+struct bgpstream_aspath_matcher {
+
+  aspath_expr_t *exprs;
+  uint32_t exprs_cnt;
+  uint32_t negative_cnt;
+
+  /* states of all the expressions (each expression uses a contiguous range,
+     ending with a STATE_FINAL state) */
+  aspath_state_t *states;
+  uint32_t states_cnt;
+  uint32_t states_alloc_cnt;
+
+  aspath_start_t *starts;
+  uint32_t starts_cnt;
+
+  /* start lists of the expressions whose first item is an ASN, indexed by
+     anchored_start, then by ASN */
+  khash_t(aspath_start_map) * asn_starts[2];
+
+  /* start lists of the expressions whose first item is '.*', indexed by
+     anchored_start */
+  uint32_t any_starts[2];
+};
+
+struct bgpstream_aspath_matcher_scratch {
+
+  /* number of states and expressions that there is room for */
+  uint32_t states_cnt;
+  uint32_t exprs_cnt;
+
+  /* states that are active before/after the current segment */
+  uint32_t *active;
+  uint32_t active_cnt;
+  uint32_t *next;
+  uint32_t next_cnt;
+
+  /* generation in which each state was last made active (so that a state is
+     only added once per segment) */
+  uint32_t *state_gens;
+  uint32_t state_gen;
+
+  /* generation in which each expression last matched (so that an expression
+     is only counted once per path) */
+  uint32_t *expr_gens;
+  uint32_t expr_gen;
+
+  /* number of non-negated expressions that matched the current path */
+  int positives;
+};
+
+/* parse an item (an ASN or '.*') into one or two states */
+static int parse_item(const char **pp, aspath_state_t *st, int star)
+{
+  const char *p = *pp;
+  uint64_t asn = 0;
+
+  if (p[0] == '.' && p[1] == '*') {
+    *pp = p + 2;
+    st[0].asn = 0;
+    st[0].any = 1;
+    if (star) {
+      st[0].type = STATE_STAR;
+      return 1;
+    }
+    /* one or more segments */
+    st[0].type = STATE_ONE;
+    st[1] = st[0];
+    st[1].type = STATE_STAR;
+    return 2;
+  }
+
+  /* ASNs are printed without leading zeroes, so e.g. "_01_" never matches */
+  if (*p < '0' || *p > '9' || (p[0] == '0' && p[1] >= '0' && p[1] <= '9')) {
+    return 0;
+  }
+  while (*p >= '0' && *p <= '9') {
+    asn = (asn * 10) + (*p - '0');
+    if (asn > UINT32_MAX) {
+      return 0;
+    }
+    p++;
+  }
+  *pp = p;
+  st[0].asn = (uint32_t)asn;
+  st[0].any = 0;
+  st[0].type = star ? STATE_STAR : STATE_ONE;
+  return 1;
+}
+
+/* parse an expression into states (st must have room for 2*strlen+1 states),
+   returns the number of states, or 0 if the expression is not supported */
+static int parse_expr(const char *p, aspath_state_t *st, aspath_expr_t *expr)
+{
+  int cnt = 0;
+  int n;
+
+  if (*p == '^') {
+    expr->anchored_start = 1;
+  } else if (*p == '_') {
+    expr->anchored_start = 0;
+  } else {
+    return 0;
+  }
+  p++;
+
+  if ((n = parse_item(&p, &st[cnt], 0)) == 0) {
+    return 0;
+  }
+  cnt += n;
+
+  while (1) {
+    if ((p[0] == '_' || p[0] == '$') && p[1] == '\0') {
+      expr->anchored_end = (p[0] == '$');
+      break;
+    }
+
+    if (p[0] == '_') {
+      /* next item */
+      p++;
+      if ((n = parse_item(&p, &st[cnt], 0)) == 0) {
+        return 0;
+      }
+    } else if (strncmp(p, "\\(_", 3) == 0) {
+      /* repeated item */
+      p += 3;
+      if ((n = parse_item(&p, &st[cnt], 1)) == 0 ||
+          strncmp(p, "\\)*", 3) != 0) {
+        return 0;
+      }
+      p += 3;
+    } else {
+      return 0;
+    }
+    cnt += n;
+  }
+
+  st[cnt].asn = 0;
+  st[cnt].any = 0;
+  st[cnt].type = STATE_FINAL;
+  cnt++;
+
+  return cnt;
+}
+
+static int grow_states(bgpstream_aspath_matcher_t *matcher, uint32_t cnt)
+{
+  uint32_t alloc_cnt = matcher->states_cnt + cnt;
+
+  if (alloc_cnt <= matcher->states_alloc_cnt) {
+    return 0;
+  }
+  if ((matcher->states = realloc(matcher->states, sizeof(aspath_state_t) *
+                                                    alloc_cnt)) == NULL) {
+    return -1;
+  }
+  matcher->states_alloc_cnt = alloc_cnt;
+  return 0;
+}
+
+static int add_start(bgpstream_aspath_matcher_t *matcher,
+                     aspath_state_t *first, int anchored_start)
+{
+  uint32_t *head;
+  khiter_t k;
+  int khret;
+
+  if ((matcher->starts =
+         realloc(matcher->starts,
+                 sizeof(aspath_start_t) * (matcher->starts_cnt + 1))) ==
+      NULL) {
+    return -1;
+  }
+
+  if (first->any) {
+    head = &matcher->any_starts[anchored_start];
+  } else {
+    if ((k = kh_get(aspath_start_map, matcher->asn_starts[anchored_start],
+                    first->asn)) ==
+        kh_end(matcher->asn_starts[anchored_start])) {
+      k = kh_put(aspath_start_map, matcher->asn_starts[anchored_start],
+                 first->asn, &khret);
+      if (khret < 0) {
+        return -1;
+      }
+      kh_val(matcher->asn_starts[anchored_start], k) = NONE;
+    }
+    head = &kh_val(matcher->asn_starts[anchored_start], k);
+  }
+
+  /* the state after the first item */
+  matcher->starts[matcher->starts_cnt].state = (first - matcher->states) + 1;
+  matcher->starts[matcher->starts_cnt].next = *head;
+  *head = matcher->starts_cnt;
+  matcher->starts_cnt++;
+  return 0;
+}
+
+bgpstream_aspath_matcher_t *bgpstream_aspath_matcher_create()
+{
+  bgpstream_aspath_matcher_t *matcher;
+
+  if ((matcher = malloc_zero(sizeof(bgpstream_aspath_matcher_t))) == NULL) {
+    return NULL;
+  }
+
+  if ((matcher->asn_starts[0] = kh_init(aspath_start_map)) == NULL ||
+      (matcher->asn_starts[1] = kh_init(aspath_start_map)) == NULL) {
+    bgpstream_aspath_matcher_destroy(matcher);
+    return NULL;
+  }
+  matcher->any_starts[0] = NONE;
+  matcher->any_starts[1] = NONE;
+
+  return matcher;
+}
+
+void bgpstream_aspath_matcher_destroy(bgpstream_aspath_matcher_t *matcher)
+{
+  int i;
+
+  if (matcher == NULL) {
+    return;
+  }
+
+  for (i = 0; i < 2; i++) {
+    if (matcher->asn_starts[i] != NULL) {
+      kh_destroy(aspath_start_map, matcher->asn_starts[i]);
+    }
+  }
+  free(matcher->exprs);
+  free(matcher->states);
+  free(matcher->starts);
+  free(matcher);
+}
+
+int bgpstream_aspath_matcher_add(bgpstream_aspath_matcher_t *matcher,
+                                 const char *expr, int negate)
+{
+  aspath_expr_t pexpr;
+  aspath_state_t *st;
+  size_t len = strlen(expr);
+  int cnt;
+  int i;
+
+  if (len > (UINT32_MAX / 4) || grow_states(matcher, (2 * len) + 1) != 0) {
+    return -1;
+  }
+
+  /* parse into the unused states at the end of the array, so nothing needs to
+     be undone if the expression is not supported */
+  st = &matcher->states[matcher->states_cnt];
+  if ((cnt = parse_expr(expr, st, &pexpr)) == 0) {
+    return 1;
+  }
+  pexpr.negate = negate ? 1 : 0;
+
+  if ((matcher->exprs =
+         realloc(matcher->exprs,
+                 sizeof(aspath_expr_t) * (matcher->exprs_cnt + 1))) == NULL ||
+      add_start(matcher, st, pexpr.anchored_start) != 0) {
+    return -1;
+  }
+
+  for (i = 0; i < cnt; i++) {
+    st[i].expr = matcher->exprs_cnt;
+  }
+  matcher->exprs[matcher->exprs_cnt] = pexpr;
+  matcher->exprs_cnt++;
+  if (pexpr.negate) {
+    matcher->negative_cnt++;
+  }
+  matcher->states_cnt += cnt;
+
+  return 0;
+}
+
+int bgpstream_aspath_matcher_get_cnt(
+  const bgpstream_aspath_matcher_t *matcher)
+{
+  return matcher->exprs_cnt;
+}
+
+bgpstream_aspath_matcher_scratch_t *
+bgpstream_aspath_matcher_scratch_create(
+  const bgpstream_aspath_matcher_t *matcher)
+{
+  bgpstream_aspath_matcher_scratch_t *scratch;
+  uint32_t cnt = matcher->states_cnt;
+
+  if ((scratch = malloc_zero(sizeof(bgpstream_aspath_matcher_scratch_t))) ==
+      NULL) {
+    return NULL;
+  }
+
+  if (cnt > 0 &&
+      ((scratch->active = malloc(sizeof(uint32_t) * cnt)) == NULL ||
+       (scratch->next = malloc(sizeof(uint32_t) * cnt)) == NULL ||
+       (scratch->state_gens = malloc_zero(sizeof(uint32_t) * cnt)) == NULL ||
+       (scratch->expr_gens =
+          malloc_zero(sizeof(uint32_t) * matcher->exprs_cnt)) == NULL)) {
+    bgpstream_aspath_matcher_scratch_destroy(scratch);
+    return NULL;
+  }
+  scratch->states_cnt = cnt;
+  scratch->exprs_cnt = matcher->exprs_cnt;
+
+  return scratch;
+}
+
+void bgpstream_aspath_matcher_scratch_destroy(
+  bgpstream_aspath_matcher_scratch_t *scratch)
+{
+  if (scratch == NULL) {
+    return;
+  }
+  free(scratch->active);
+  free(scratch->next);
+  free(scratch->state_gens);
+  free(scratch->expr_gens);
+  free(scratch);
+}
+
+/* make a state active after the current segment (along with the states that
+   can be reached from it without matching a segment). returns -1 if this
+   completes a match of a negated expression */
+static inline int add_state(const bgpstream_aspath_matcher_t *matcher,
+                            bgpstream_aspath_matcher_scratch_t *scratch,
+                            uint32_t s, int last)
+{
+  const aspath_state_t *st;
+  const aspath_expr_t *expr;
+
+  for (;; s++) {
+    if (scratch->state_gens[s] == scratch->state_gen) {
+      return 0;
+    }
+    scratch->state_gens[s] = scratch->state_gen;
+    st = &matcher->states[s];
+
+    if (st->type == STATE_FINAL) {
+      expr = &matcher->exprs[st->expr];
+      if (expr->anchored_end != last ||
+          scratch->expr_gens[st->expr] == scratch->expr_gen) {
+        return 0;
+      }
+      scratch->expr_gens[st->expr] = scratch->expr_gen;
+      if (expr->negate) {
+        return -1;
+      }
+      scratch->positives++;
+      return 0;
+    }
+
+    scratch->next[scratch->next_cnt++] = s;
+    if (st->type != STATE_STAR) {
+      return 0;
+    }
+  }
+}
+
+static inline int add_starts(const bgpstream_aspath_matcher_t *matcher,
+                             bgpstream_aspath_matcher_scratch_t *scratch,
+                             uint32_t i, int last)
+{
+  for (; i != NONE; i = matcher->starts[i].next) {
+    if (add_state(matcher, scratch, matcher->starts[i].state, last) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int bgpstream_aspath_matcher_match(const bgpstream_aspath_matcher_t *matcher,
+                                   bgpstream_aspath_matcher_scratch_t *scratch,
+                                   bgpstream_as_path_t *path)
+{
+  bgpstream_as_path_iter_t iter;
+  bgpstream_as_path_seg_t *seg;
+  const aspath_state_t *st;
+  uint32_t *tmp;
+  uint32_t asn;
+  uint32_t i;
+  khiter_t k;
+  int seg_cnt = bgpstream_as_path_get_len(path);
+  int seg_idx = 0;
+  int is_asn;
+  int first;
+  int last;
+
+  /* the scratch space must have been created after the last expression was
+     added */
+  assert(scratch->states_cnt >= matcher->states_cnt &&
+         scratch->exprs_cnt >= matcher->exprs_cnt);
+
+  scratch->positives = 0;
+  scratch->active_cnt = 0;
+  if (matcher->exprs_cnt == 0) {
+    return 0;
+  }
+
+  if (++scratch->expr_gen == 0) {
+    memset(scratch->expr_gens, 0, sizeof(uint32_t) * scratch->exprs_cnt);
+    scratch->expr_gen = 1;
+  }
+
+  bgpstream_as_path_iter_reset(&iter);
+  while ((seg = bgpstream_as_path_get_next_seg(path, &iter)) != NULL) {
+    seg_idx++;
+    first = (seg_idx == 1);
+    last = (seg_idx == seg_cnt);
+
+    if (++scratch->state_gen == 0) {
+      memset(scratch->state_gens, 0, sizeof(uint32_t) * scratch->states_cnt);
+      scratch->state_gen = 1;
+    }
+    scratch->next_cnt = 0;
+
+    is_asn = (seg->type == BGPSTREAM_AS_PATH_SEG_ASN);
+    asn = is_asn ? ((bgpstream_as_path_seg_asn_t *)seg)->asn : 0;
+
+    /* advance the expressions that are part-way through a match */
+    for (i = 0; i < scratch->active_cnt; i++) {
+      st = &matcher->states[scratch->active[i]];
+      if (st->any == 0 && (is_asn == 0 || st->asn != asn)) {
+        continue;
+      }
+      if (add_state(matcher, scratch,
+                    st->type == STATE_STAR ? scratch->active[i]
+                                           : scratch->active[i] + 1,
+                    last) != 0) {
+        return -1;
+      }
+    }
+
+    /* start the expressions whose first item matches this segment ('^'
+       expressions may only start at the first segment, '_' expressions at any
+       other segment) */
+    if (is_asn && (k = kh_get(aspath_start_map, matcher->asn_starts[first],
+                              asn)) != kh_end(matcher->asn_starts[first])) {
+      if (add_starts(matcher, scratch, kh_val(matcher->asn_starts[first], k),
+                     last) != 0) {
+        return -1;
+      }
+    }
+    if (add_starts(matcher, scratch, matcher->any_starts[first], last) != 0) {
+      return -1;
+    }
+
+    tmp = scratch->active;
+    scratch->active = scratch->next;
+    scratch->next = tmp;
+    scratch->active_cnt = scratch->next_cnt;
+
+    /* nothing more to learn from the rest of the path */
+    if (matcher->negative_cnt == 0 &&
+        scratch->positives == (int)matcher->exprs_cnt) {
+      break;
+    }
+  }
+
+  return scratch->positives;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_ASPATH_MATCHER_H
+#define __BGPSTREAM_ASPATH_MATCHER_H
+
+#include "bgpstream_utils_as_path.h"
+
+/** @file
+ *
+ * @brief Matcher for AS path filter expressions that works directly on the
+ * segments of an AS path.
+ *
+ * AS path filters are POSIX regular expressions that are applied to the
+ * "filterable" string form of a path (segments separated by '_', see
+ * bgpstream_as_path_get_filterable). Most expressions only use a small part
+ * of the regex syntax, in which every piece lines up with whole segments:
+ *
+ *   expr := ( '^' | '_' ) item { '_' item | '\(_' item '\)*' } ( '$' | '_' )
+ *   item := ASN | '.*'
+ *
+ * e.g. "_3356_", "^174_", "_13335$", "^3356_.*_15169$" or
+ * "^174\(_174\)*_3356_". An ASN matches exactly one simple ASN segment (never
+ * an AS set), '.*' matches one or more segments of any type, and a leading or
+ * trailing '_' means that the match must not start at the first segment (or
+ * end at the last one).
+ *
+ * Such expressions are compiled into a small automaton over path segments,
+ * and all the expressions added to a matcher are run together in a single
+ * pass over the path, without printing it. Expressions are indexed by the
+ * ASN of their first item, so the cost of matching a path depends on its
+ * length and on the number of expressions that actually (partially) match
+ * it, not on the total number of expressions.
+ *
+ * Expressions that use any other syntax are rejected by
+ * bgpstream_aspath_matcher_add, so that the caller can use a regex for them
+ * instead. For accepted expressions, the matcher gives exactly the same
+ * result as the regex.
+ */
+
+/** Opaque structure representing a set of compiled AS path expressions */
+typedef struct bgpstream_aspath_matcher bgpstream_aspath_matcher_t;
+
+/** Opaque structure representing the scratch space used to match paths */
+typedef struct bgpstream_aspath_matcher_scratch
+  bgpstream_aspath_matcher_scratch_t;
+
+/** Create a new (empty) AS path matcher
+ *
+ * @return pointer to the matcher if successful, NULL otherwise
+ */
+bgpstream_aspath_matcher_t *bgpstream_aspath_matcher_create();
+
+/** Destroy the given AS path matcher
+ *
+ * @param matcher       pointer to the matcher to destroy
+ */
+void bgpstream_aspath_matcher_destroy(bgpstream_aspath_matcher_t *matcher);
+
+/** Compile an expression and add it to the matcher
+ *
+ * @param matcher       pointer to the matcher
+ * @param expr          expression to add (without the leading '!')
+ * @param negate        if set, a path that matches this expression is
+ *                      rejected
+ * @return 0 if the expression was added, 1 if it uses syntax that the matcher
+ * does not support (and it was not added), -1 if an error occurred
+ */
+int bgpstream_aspath_matcher_add(bgpstream_aspath_matcher_t *matcher,
+                                 const char *expr, int negate);
+
+/** Get the number of expressions in the matcher
+ *
+ * @param matcher       pointer to the matcher
+ * @return the number of expressions that have been added
+ */
+int bgpstream_aspath_matcher_get_cnt(
+  const bgpstream_aspath_matcher_t *matcher);
+
+/** Create scratch space for matching paths against the given matcher
+ *
+ * @param matcher       pointer to the matcher
+ * @return pointer to the scratch space if successful, NULL otherwise
+ *
+ * The scratch space is sized for the expressions in the matcher, so it must
+ * be created after the last expression has been added.
+ */
+bgpstream_aspath_matcher_scratch_t *
+bgpstream_aspath_matcher_scratch_create(
+  const bgpstream_aspath_matcher_t *matcher);
+
+/** Destroy the given scratch space
+ *
+ * @param scratch       pointer to the scratch space to destroy
+ */
+void bgpstream_aspath_matcher_scratch_destroy(
+  bgpstream_aspath_matcher_scratch_t *scratch);
+
+/** Match an AS path against all the expressions in the matcher
+ *
+ * @param matcher       pointer to the matcher
+ * @param scratch       pointer to scratch space created for the matcher
+ * @param path          pointer to the AS path to match
+ * @return -1 if a negated expression matches the path, otherwise the number
+ * of (non-negated) expressions that match the path
+ *
+ * Matching does not allocate memory or modify the matcher, so several threads
+ * may share a matcher as long as each uses its own scratch space.
+ */
+int bgpstream_aspath_matcher_match(const bgpstream_aspath_matcher_t *matcher,
+                                   bgpstream_aspath_matcher_scratch_t *scratch,
+                                   bgpstream_as_path_t *path);
+
+#endif /* __BGPSTREAM_ASPATH_MATCHER_H */
@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+#include "bgpstream_buffer_pool.h"
+#include "utils.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct bgpstream_buffer_pool {
+
+  /** Maximum number of bytes of buffers (handed out and cached) */
+  size_t budget;
+
+  /** Number of bytes of buffers currently handed out */
+  size_t live_len;
+
+  /** Cached full-size buffers */
+  bgpstream_buffer_t *free_bufs;
+  int free_cnt;
+  int free_alloc_cnt;
+
+  pthread_mutex_t mutex;
+};
+
+/* create an anonymous shared memory object of the given size */
+static int shm_create(size_t len)
+{
+  int fd;
+#ifdef HAVE_MEMFD_CREATE
+  fd = memfd_create("bgpstream-buffer", 0);
+#else
+  static uint32_t seq = 0;
+  char name[64];
+  snprintf(name, sizeof(name), "/bgpstream-%d-%" PRIu32, (int)getpid(),
+           __sync_fetch_and_add(&seq, 1));
+  if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) >= 0) {
+    shm_unlink(name);
+  }
+#endif
+  if (fd < 0) {
+    return -1;
+  }
+  if (ftruncate(fd, len) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* map the same pages twice, back to back */
+static int mirror_alloc(bgpstream_buffer_t *buf, size_t len)
+{
+  long page_size = sysconf(_SC_PAGESIZE);
+  uint8_t *base = MAP_FAILED;
+  int fd = -1;
+
+  if (page_size <= 0 || (len % page_size) != 0 || (fd = shm_create(len)) < 0) {
+    return -1;
+  }
+
+  // reserve enough address space for both copies, then map the object over it
+  if ((base = mmap(NULL, 2 * len, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0)) ==
+        MAP_FAILED ||
+      mmap(base, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) ==
+        MAP_FAILED ||
+      mmap(base + len, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+           0) == MAP_FAILED) {
+    goto err;
+  }
+  // the mappings keep the memory alive
+  close(fd);
+
+  buf->data = base;
+  buf->len = len;
+  buf->mirrored = 1;
+  return 0;
+
+ err:
+  if (base != MAP_FAILED) {
+    munmap(base, 2 * len);
+  }
+  close(fd);
+  return -1;
+}
+
+static int buffer_alloc(bgpstream_buffer_t *buf, size_t len)
+{
+  if (mirror_alloc(buf, len) == 0) {
+    return 0;
+  }
+  // fall back to a plain buffer
+  if ((buf->data = malloc(len)) == NULL) {
+    return -1;
+  }
+  buf->len = len;
+  buf->mirrored = 0;
+  return 0;
+}
+
+static void buffer_free(bgpstream_buffer_t *buf)
+{
+  if (buf->data == NULL) {
+    return;
+  }
+  if (buf->mirrored != 0) {
+    munmap(buf->data, 2 * buf->len);
+  } else {
+    free(buf->data);
+  }
+  memset(buf, 0, sizeof(bgpstream_buffer_t));
+}
+
+/* ========== PUBLIC FUNCTIONS BELOW ========== */
+
+bgpstream_buffer_pool_t *bgpstream_buffer_pool_create(size_t budget)
+{
+  bgpstream_buffer_pool_t *pool;
+
+  if ((pool = malloc_zero(sizeof(bgpstream_buffer_pool_t))) == NULL) {
+    return NULL;
+  }
+
+  pool->budget = budget;
+
+  // we can never cache more full-size buffers than fit in the budget
+  pool->free_alloc_cnt = budget / BGPSTREAM_BUFFER_POOL_CHUNK_LEN;
+  if (pool->free_alloc_cnt > 0 &&
+      (pool->free_bufs = malloc(sizeof(bgpstream_buffer_t) *
+                                pool->free_alloc_cnt)) == NULL) {
+    free(pool);
+    return NULL;
+  }
+
+  pthread_mutex_init(&pool->mutex, NULL);
+
+  return pool;
+}
+
+void bgpstream_buffer_pool_destroy(bgpstream_buffer_pool_t *pool)
+{
+  int i;
+
+  if (pool == NULL) {
+    return;
+  }
+
+  assert(pool->live_len == 0);
+
+  for (i = 0; i < pool->free_cnt; i++) {
+    buffer_free(&pool->free_bufs[i]);
+  }
+  free(pool->free_bufs);
+  pool->free_bufs = NULL;
+
+  pthread_mutex_destroy(&pool->mutex);
+
+  free(pool);
+}
+
+int bgpstream_buffer_pool_get(bgpstream_buffer_pool_t *pool, size_t min_len,
+                              bgpstream_buffer_t *buf)
+{
+  size_t len;
+
+  memset(buf, 0, sizeof(bgpstream_buffer_t));
+
+  if (min_len > BGPSTREAM_BUFFER_POOL_MAX_LEN) {
+    return -1;
+  }
+
+  if (pool == NULL) {
+    len = (min_len > BGPSTREAM_BUFFER_POOL_CHUNK_LEN) ?
+      min_len : BGPSTREAM_BUFFER_POOL_CHUNK_LEN;
+    return buffer_alloc(buf, len);
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  if (min_len <= BGPSTREAM_BUFFER_POOL_CHUNK_LEN &&
+      pool->live_len + BGPSTREAM_BUFFER_POOL_CHUNK_LEN <= pool->budget) {
+    len = BGPSTREAM_BUFFER_POOL_CHUNK_LEN;
+    if (pool->free_cnt > 0) {
+      *buf = pool->free_bufs[--pool->free_cnt];
+    }
+  } else {
+    // over budget (or too big to come from the cache), but we still need to
+    // make progress
+    len = (min_len > BGPSTREAM_BUFFER_POOL_MIN_LEN) ?
+      min_len : BGPSTREAM_BUFFER_POOL_MIN_LEN;
+  }
+  pool->live_len += len;
+  pthread_mutex_unlock(&pool->mutex);
+
+  if (buf->data == NULL && buffer_alloc(buf, len) != 0) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->live_len -= len;
+    pthread_mutex_unlock(&pool->mutex);
+    return -1;
+  }
+
+  return 0;
+}
+
+void bgpstream_buffer_pool_put(bgpstream_buffer_pool_t *pool,
+                               bgpstream_buffer_t *buf)
+{
+  if (buf->data == NULL) {
+    return;
+  }
+
+  if (pool == NULL) {
+    buffer_free(buf);
+    return;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  assert(pool->live_len >= buf->len);
+  pool->live_len -= buf->len;
+  // only cache full-size buffers, and only while the cache fits in the budget
+  if (buf->len == BGPSTREAM_BUFFER_POOL_CHUNK_LEN &&
+      pool->free_cnt < pool->free_alloc_cnt &&
+      pool->live_len +
+          ((size_t)(pool->free_cnt + 1) * BGPSTREAM_BUFFER_POOL_CHUNK_LEN) <=
+        pool->budget) {
+    pool->free_bufs[pool->free_cnt++] = *buf;
+    memset(buf, 0, sizeof(bgpstream_buffer_t));
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  // not cached, so free it
+  buffer_free(buf);
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_BUFFER_POOL_H
+#define __BGPSTREAM_BUFFER_POOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** @file
+ *
+ * @brief Shared pool of parse buffers with a memory budget.
+ *
+ * Formats take a buffer from the pool when they need to read more data, and
+ * give it back once it has been fully consumed. While the total size of the
+ * buffers handed out is within the budget, formats get full-size
+ * (BGPSTREAM_BUFFER_POOL_CHUNK_LEN) buffers, and released full-size buffers
+ * are cached for reuse. Once the budget is used up, formats get small
+ * (BGPSTREAM_BUFFER_POOL_MIN_LEN) buffers instead, so that they can still
+ * make progress.
+ *
+ * Where the OS allows it, buffers are "mirrored" (the pages of the buffer are
+ * mapped a second time directly after it), so that they can be used as ring
+ * buffers without ever having to move data that wraps around the end.
+ */
+
+/** Size of a full-size buffer. This is also the size of the buffer used by
+    each format when no pool is in use */
+#define BGPSTREAM_BUFFER_POOL_CHUNK_LEN (1024 * 1024)
+
+/** Size of the buffers handed out once the budget has been used up */
+#define BGPSTREAM_BUFFER_POOL_MIN_LEN (64 * 1024)
+
+/** Largest buffer that may be requested (to fit a single large message) */
+#define BGPSTREAM_BUFFER_POOL_MAX_LEN (64 * 1024 * 1024)
+
+/** Opaque pointer representing a buffer pool */
+typedef struct bgpstream_buffer_pool bgpstream_buffer_pool_t;
+
+/** A buffer handed out by the pool */
+typedef struct bgpstream_buffer {
+
+  /** Pointer to the buffer memory */
+  uint8_t *data;
+
+  /** Size of the buffer */
+  size_t len;
+
+  /** If set, the `len` bytes following `data` are mapped to the buffer itself,
+      so data that wraps around the end of the buffer can be read and written
+      contiguously */
+  int mirrored;
+
+} bgpstream_buffer_t;
+
+/** Create a new buffer pool
+ *
+ * @param budget        maximum number of bytes of buffers to hand out before
+ *                      falling back to small buffers
+ * @return pointer to the pool if successful, NULL otherwise
+ */
+bgpstream_buffer_pool_t *bgpstream_buffer_pool_create(size_t budget);
+
+/** Destroy the given buffer pool
+ *
+ * @param pool          pointer to the pool to destroy
+ *
+ * All buffers must have been released before the pool is destroyed.
+ */
+void bgpstream_buffer_pool_destroy(bgpstream_buffer_pool_t *pool);
+
+/** Get a buffer from the pool
+ *
+ * @param pool          pointer to the pool, or NULL to allocate a full-size
+ *                      buffer without a pool
+ * @param min_len       minimum size of the buffer (0 for the default size)
+ * @param[out] buf      filled with the details of the buffer
+ * @return 0 if successful, -1 otherwise
+ *
+ * Buffers larger than the default size may be requested (up to
+ * BGPSTREAM_BUFFER_POOL_MAX_LEN) even when the budget has been used up, since
+ * a message must fit in a single buffer.
+ */
+int bgpstream_buffer_pool_get(bgpstream_buffer_pool_t *pool, size_t min_len,
+                              bgpstream_buffer_t *buf);
+
+/** Give a buffer back to the pool
+ *
+ * @param pool          pointer to the pool the buffer came from (or NULL)
+ * @param buf           pointer to the buffer to release (will be cleared)
+ */
+void bgpstream_buffer_pool_put(bgpstream_buffer_pool_t *pool,
+                               bgpstream_buffer_t *buf);
+
+#endif /* __BGPSTREAM_BUFFER_POOL_H */
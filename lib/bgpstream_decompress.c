@@ -0,0 +1,863 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+#include "bgpstream_decompress.h"
+#include "bgpstream_log.h"
+#include "utils.h"
+#include "wandio.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(HAVE_LIBBZ2) && defined(HAVE_BZLIB_H)
+#define WITH_BZIP2
+#include <bzlib.h>
+#endif
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#define WITH_BGZF
+#include <zlib.h>
+#endif
+
+/* amount of compressed data to read at a time */
+#define READ_CHUNK_LEN (1024 * 1024)
+
+/* initial output buffer size for a bzip2 block (a block holds at most 900 kB
+   before run-length encoding) */
+#define BZIP2_OUT_LEN (1024 * 1024)
+
+/* bzip2 stream header ("BZh" + block size) */
+#define BZIP2_HDR_LEN 4
+
+/* 48-bit magic numbers that start a bzip2 block, and end a bzip2 stream */
+#define BZIP2_BLOCK_MAGIC 0x314159265359ULL
+#define BZIP2_EOS_MAGIC 0x177245385090ULL
+#define BZIP2_MAGIC_BITS 48
+#define BZIP2_MAGIC_MASK 0xFFFFFFFFFFFFULL
+
+/* length of a gzip member header up to (and including) the XLEN field */
+#define GZIP_HDR_LEN 12
+
+/* number of blocks that may be queued or decompressed ahead of the reader, per
+   worker thread */
+#define JOBS_PER_THREAD 2
+
+typedef enum {
+  TYPE_BZIP2 = 0,
+  TYPE_BGZF = 1,
+} decomp_type_t;
+
+typedef enum {
+  JOB_QUEUED = 0,
+  JOB_RUNNING = 1,
+  JOB_DONE = 2,
+  JOB_FAILED = 3,
+  JOB_CANCELLED = 4,
+} job_state_t;
+
+typedef struct decomp_job {
+
+  /** Format of the compressed data */
+  decomp_type_t type;
+
+  /** Compressed data (a standalone bzip2 stream, or a gzip member) */
+  uint8_t *in;
+  size_t in_len;
+
+  /** Decompressed data */
+  uint8_t *out;
+  size_t out_len;
+
+  /** Number of decompressed bytes already returned to the reader */
+  size_t out_pos;
+
+  /** State of the job (must use pool mutex) */
+  job_state_t state;
+
+  /** Next job in the pool queue */
+  struct decomp_job *next_queued;
+
+  /** Next job of the same stream (in file order) */
+  struct decomp_job *next;
+
+} decomp_job_t;
+
+struct bgpstream_decompress_pool {
+
+  /** Worker threads */
+  pthread_t *threads;
+  int threads_cnt;
+
+  /** Queued jobs (FIFO) */
+  decomp_job_t *queue_head;
+  decomp_job_t *queue_tail;
+
+  /** Has the pool been asked to shut down? */
+  int shutdown;
+
+  // ALL ABOVE HERE MUST USE MUTEX
+  pthread_mutex_t mutex;
+
+  /** Signalled when a job is queued, or the pool is shut down */
+  pthread_cond_t work_cond;
+
+  /** Signalled when a job completes */
+  pthread_cond_t done_cond;
+};
+
+struct bgpstream_decompress {
+
+  /** Pool to decompress with */
+  bgpstream_decompress_pool_t *pool;
+
+  /** URI of the file (needed to fall back to wandio) */
+  char *uri;
+
+  /** Format of the file */
+  decomp_type_t type;
+
+  /** Reader for the raw (compressed) data */
+  io_t *in;
+  int in_eof;
+
+  /** Compressed data that has not yet been handed to a job. buf[0] is at
+      byte offset buf_base in the file */
+  uint8_t *buf;
+  size_t buf_len;
+  size_t buf_alloc;
+  uint64_t buf_base;
+
+  /** bzip2 scanning state: the next bit to scan, the last bits scanned, the
+      number of valid bits in the window, and the start of the current block
+      (-1 if not in a block) */
+  uint64_t scan_bit;
+  uint64_t window;
+  int window_bits;
+  int64_t block_start;
+
+  /** Jobs in file order */
+  decomp_job_t *jobs_head;
+  decomp_job_t *jobs_tail;
+  int jobs_cnt;
+  int jobs_max;
+
+  /** Serial (wandio) reader, if we had to fall back */
+  io_t *fallback;
+
+  /** Number of decompressed bytes returned so far */
+  uint64_t delivered;
+};
+
+static void job_free(decomp_job_t *job)
+{
+  if (job == NULL) {
+    return;
+  }
+  free(job->in);
+  free(job->out);
+  free(job);
+}
+
+#ifdef WITH_BZIP2
+static int run_bzip2(decomp_job_t *job)
+{
+  bz_stream s;
+  size_t alloc = BZIP2_OUT_LEN;
+  uint8_t *tmp;
+  int rc;
+
+  memset(&s, 0, sizeof(s));
+  if (BZ2_bzDecompressInit(&s, 0, 0) != BZ_OK) {
+    return -1;
+  }
+  if ((job->out = malloc(alloc)) == NULL) {
+    goto err;
+  }
+  s.next_in = (char *)job->in;
+  s.avail_in = job->in_len;
+
+  while (1) {
+    s.next_out = (char *)job->out + job->out_len;
+    s.avail_out = alloc - job->out_len;
+    rc = BZ2_bzDecompress(&s);
+    job->out_len = alloc - s.avail_out;
+    if (rc == BZ_STREAM_END) {
+      break;
+    }
+    if (rc != BZ_OK) {
+      goto err;
+    }
+    if (s.avail_out == 0) {
+      alloc *= 2;
+      if ((tmp = realloc(job->out, alloc)) == NULL) {
+        goto err;
+      }
+      job->out = tmp;
+    } else if (s.avail_in == 0) {
+      // truncated
+      goto err;
+    }
+  }
+
+  BZ2_bzDecompressEnd(&s);
+  return 0;
+
+ err:
+  BZ2_bzDecompressEnd(&s);
+  return -1;
+}
+#endif
+
+#ifdef WITH_BGZF
+static int run_bgzf(decomp_job_t *job)
+{
+  z_stream z;
+  size_t isize;
+
+  // the uncompressed length is in the last four bytes of the member
+  if (job->in_len < GZIP_HDR_LEN + 8) {
+    return -1;
+  }
+  isize = (size_t)job->in[job->in_len - 4] |
+          ((size_t)job->in[job->in_len - 3] << 8) |
+          ((size_t)job->in[job->in_len - 2] << 16) |
+          ((size_t)job->in[job->in_len - 1] << 24);
+  // +1 since malloc(0) may return NULL
+  if ((job->out = malloc(isize + 1)) == NULL) {
+    return -1;
+  }
+
+  memset(&z, 0, sizeof(z));
+  // 16+ to expect a gzip header
+  if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) {
+    return -1;
+  }
+  z.next_in = job->in;
+  z.avail_in = job->in_len;
+  z.next_out = job->out;
+  z.avail_out = isize + 1;
+  if (inflate(&z, Z_FINISH) != Z_STREAM_END || z.total_out != isize) {
+    inflateEnd(&z);
+    return -1;
+  }
+  job->out_len = isize;
+  inflateEnd(&z);
+  return 0;
+}
+#endif
+
+static int run_job(decomp_job_t *job)
+{
+  switch (job->type) {
+#ifdef WITH_BZIP2
+  case TYPE_BZIP2:
+    return run_bzip2(job);
+#endif
+#ifdef WITH_BGZF
+  case TYPE_BGZF:
+    return run_bgzf(job);
+#endif
+  default:
+    return -1;
+  }
+}
+
+static void *worker(void *user)
+{
+  bgpstream_decompress_pool_t *pool = (bgpstream_decompress_pool_t *)user;
+  decomp_job_t *job;
+  int rc;
+
+  pthread_mutex_lock(&pool->mutex);
+  while (1) {
+    while (pool->shutdown == 0 && pool->queue_head == NULL) {
+      pthread_cond_wait(&pool->work_cond, &pool->mutex);
+    }
+    if (pool->shutdown != 0) {
+      break;
+    }
+
+    job = pool->queue_head;
+    if ((pool->queue_head = job->next_queued) == NULL) {
+      pool->queue_tail = NULL;
+    }
+    if (job->state == JOB_CANCELLED) {
+      // nobody is waiting for this job any more
+      job_free(job);
+      continue;
+    }
+    assert(job->state == JOB_QUEUED);
+    job->state = JOB_RUNNING;
+    pthread_mutex_unlock(&pool->mutex);
+
+    rc = run_job(job);
+
+    pthread_mutex_lock(&pool->mutex);
+    job->state = (rc == 0) ? JOB_DONE : JOB_FAILED;
+    pthread_cond_broadcast(&pool->done_cond);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+/* queue a job for the given stream. takes ownership of in */
+static int submit(bgpstream_decompress_t *d, uint8_t *in, size_t in_len)
+{
+  bgpstream_decompress_pool_t *pool = d->pool;
+  decomp_job_t *job;
+
+  if ((job = malloc_zero(sizeof(decomp_job_t))) == NULL) {
+    free(in);
+    return -1;
+  }
+  job->type = d->type;
+  job->in = in;
+  job->in_len = in_len;
+  job->state = JOB_QUEUED;
+
+  if (d->jobs_tail == NULL) {
+    d->jobs_head = job;
+  } else {
+    d->jobs_tail->next = job;
+  }
+  d->jobs_tail = job;
+  d->jobs_cnt++;
+
+  pthread_mutex_lock(&pool->mutex);
+  if (pool->queue_tail == NULL) {
+    pool->queue_head = job;
+  } else {
+    pool->queue_tail->next_queued = job;
+  }
+  pool->queue_tail = job;
+  pthread_cond_signal(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  return 0;
+}
+
+/* release all of the jobs of the given stream */
+static void cancel_jobs(bgpstream_decompress_t *d)
+{
+  bgpstream_decompress_pool_t *pool = d->pool;
+  decomp_job_t *job, *next;
+
+  pthread_mutex_lock(&pool->mutex);
+  for (job = d->jobs_head; job != NULL; job = next) {
+    next = job->next;
+    if (job->state == JOB_QUEUED) {
+      // the worker will free it when it pops it
+      job->state = JOB_CANCELLED;
+      continue;
+    }
+    while (job->state == JOB_RUNNING) {
+      pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    job_free(job);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  d->jobs_head = d->jobs_tail = NULL;
+  d->jobs_cnt = 0;
+}
+
+static uint64_t get_bits(const uint8_t *buf, uint64_t bit, int cnt)
+{
+  uint64_t val = 0;
+  int i;
+
+  for (i = 0; i < cnt; i++, bit++) {
+    val = (val << 1) | ((buf[bit / 8] >> (7 - (bit % 8))) & 1);
+  }
+  return val;
+}
+
+static void put_bits(uint8_t *buf, uint64_t bit, uint64_t val, int cnt)
+{
+  int i;
+
+  for (i = cnt - 1; i >= 0; i--, bit++) {
+    if ((val >> i) & 1) {
+      buf[bit / 8] |= 1 << (7 - (bit % 8));
+    }
+  }
+}
+
+/* wrap the bzip2 block in bits [start, end) of the file as a standalone
+   stream, and queue it */
+static int submit_bzip2_block(bgpstream_decompress_t *d, uint64_t start,
+                              uint64_t end)
+{
+  const uint8_t *src = d->buf + (start / 8 - d->buf_base);
+  uint64_t bits = end - start;
+  int shift = start % 8;
+  uint64_t crc;
+  size_t len, i, src_bytes;
+  uint8_t *out;
+
+  // header + block + end-of-stream magic + combined CRC, rounded up to a byte
+  len = BZIP2_HDR_LEN + (bits + BZIP2_MAGIC_BITS + 32 + 7) / 8;
+  if ((out = calloc(1, len)) == NULL) {
+    return -1;
+  }
+
+  // always claim the largest block size, since it is only used to size the
+  // decoder's buffers
+  memcpy(out, "BZh9", BZIP2_HDR_LEN);
+
+  // copy the block, shifting it to be byte-aligned
+  src_bytes = (bits + 7) / 8;
+  for (i = 0; i < src_bytes; i++) {
+    out[BZIP2_HDR_LEN + i] = src[i] << shift;
+    // the next source byte is needed if any of its bits are in the block
+    if (shift != 0 && (start - shift + (i + 1) * 8) < end) {
+      out[BZIP2_HDR_LEN + i] |= src[i + 1] >> (8 - shift);
+    }
+  }
+  // clear any bits copied from beyond the end of the block
+  if (bits % 8 != 0) {
+    out[BZIP2_HDR_LEN + bits / 8] &= 0xFF << (8 - (bits % 8));
+  }
+
+  // for a single-block stream, the combined CRC is just the block CRC (which
+  // immediately follows the block magic)
+  crc = (bits >= BZIP2_MAGIC_BITS + 32) ?
+    get_bits(src, shift + BZIP2_MAGIC_BITS, 32) : 0;
+  put_bits(out, BZIP2_HDR_LEN * 8 + bits, BZIP2_EOS_MAGIC, BZIP2_MAGIC_BITS);
+  put_bits(out, BZIP2_HDR_LEN * 8 + bits + BZIP2_MAGIC_BITS, crc, 32);
+
+  return submit(d, out, len);
+}
+
+/* scan newly read data for bzip2 block boundaries */
+static int scan_bzip2(bgpstream_decompress_t *d)
+{
+  uint64_t end_bit = (d->buf_base + d->buf_len) * 8;
+  uint64_t magic, pos;
+  uint8_t byte;
+
+  while (d->scan_bit < end_bit) {
+    byte = d->buf[d->scan_bit / 8 - d->buf_base];
+    d->window = (d->window << 1) | ((byte >> (7 - (d->scan_bit % 8))) & 1);
+    d->scan_bit++;
+    if (d->window_bits < BZIP2_MAGIC_BITS) {
+      d->window_bits++;
+      if (d->window_bits < BZIP2_MAGIC_BITS) {
+        continue;
+      }
+    }
+    magic = d->window & BZIP2_MAGIC_MASK;
+    if (magic != BZIP2_BLOCK_MAGIC && magic != BZIP2_EOS_MAGIC) {
+      continue;
+    }
+    // the previous block (if any) ends here
+    pos = d->scan_bit - BZIP2_MAGIC_BITS;
+    if (d->block_start >= 0 &&
+        submit_bzip2_block(d, d->block_start, pos) != 0) {
+      return -1;
+    }
+    d->block_start = (magic == BZIP2_BLOCK_MAGIC) ? (int64_t)pos : -1;
+  }
+
+  // at the end of the file, whatever is left is (a truncated) block, which
+  // will fail to decompress, and make us fall back to wandio
+  if (d->in_eof != 0 && d->block_start >= 0) {
+    if (submit_bzip2_block(d, d->block_start, end_bit) != 0) {
+      return -1;
+    }
+    d->block_start = -1;
+  }
+
+  // drop data we no longer need
+  pos = (d->block_start >= 0) ? (uint64_t)d->block_start / 8 : end_bit / 8;
+  pos -= d->buf_base;
+  memmove(d->buf, d->buf + pos, d->buf_len - pos);
+  d->buf_len -= pos;
+  d->buf_base += pos;
+
+  return 0;
+}
+
+/* length of the BGZF member at the start of buf, 0 if more data is needed,
+   or -1 if it is not a BGZF member */
+static int64_t bgzf_member_len(const uint8_t *buf, size_t len)
+{
+  size_t xlen, off;
+
+  if (len < GZIP_HDR_LEN) {
+    return 0;
+  }
+  // gzip magic, deflate, FEXTRA
+  if (buf[0] != 0x1f || buf[1] != 0x8b || buf[2] != 8 || (buf[3] & 4) == 0) {
+    return -1;
+  }
+  xlen = buf[10] | (buf[11] << 8);
+  if (len < GZIP_HDR_LEN + xlen) {
+    return 0;
+  }
+  // look for the "BC" subfield, which holds the member length - 1
+  for (off = GZIP_HDR_LEN; off + 4 <= GZIP_HDR_LEN + xlen;
+       off += 4 + (buf[off + 2] | (buf[off + 3] << 8))) {
+    if (buf[off] == 'B' && buf[off + 1] == 'C' &&
+        (buf[off + 2] | (buf[off + 3] << 8)) == 2 &&
+        off + 6 <= GZIP_HDR_LEN + xlen) {
+      return (buf[off + 4] | (buf[off + 5] << 8)) + 1;
+    }
+  }
+  return -1;
+}
+
+/* split newly read data into BGZF members */
+static int scan_bgzf(bgpstream_decompress_t *d)
+{
+  int64_t member_len;
+  size_t off = 0;
+  uint8_t *in;
+
+  while ((member_len = bgzf_member_len(d->buf + off, d->buf_len - off)) > 0 &&
+         (size_t)member_len <= d->buf_len - off) {
+    if ((in = malloc(member_len)) == NULL) {
+      return -1;
+    }
+    memcpy(in, d->buf + off, member_len);
+    if (submit(d, in, member_len) != 0) {
+      return -1;
+    }
+    off += member_len;
+  }
+
+  // a non-BGZF member, or trailing junk: hand the rest over as a single job. if
+  // it is not exactly one gzip member, it will fail to decompress, and we will
+  // fall back to wandio
+  if (member_len < 0 || (d->in_eof != 0 && off < d->buf_len)) {
+    if ((in = malloc(d->buf_len - off)) == NULL) {
+      return -1;
+    }
+    memcpy(in, d->buf + off, d->buf_len - off);
+    if (submit(d, in, d->buf_len - off) != 0) {
+      return -1;
+    }
+    off = d->buf_len;
+  }
+
+  memmove(d->buf, d->buf + off, d->buf_len - off);
+  d->buf_len -= off;
+  d->buf_base += off;
+
+  return 0;
+}
+
+/* read more compressed data into the scan buffer. returns the number of bytes
+   read, or -1 on error */
+static int64_t read_more(bgpstream_decompress_t *d)
+{
+  uint8_t *tmp;
+  int64_t rd;
+
+  if (d->buf_len + READ_CHUNK_LEN > d->buf_alloc) {
+    if ((tmp = realloc(d->buf, d->buf_len + READ_CHUNK_LEN)) == NULL) {
+      return -1;
+    }
+    d->buf = tmp;
+    d->buf_alloc = d->buf_len + READ_CHUNK_LEN;
+  }
+  if ((rd = wandio_read(d->in, d->buf + d->buf_len, READ_CHUNK_LEN)) < 0) {
+    return -1;
+  }
+  if (rd == 0) {
+    d->in_eof = 1;
+  }
+  d->buf_len += rd;
+  return rd;
+}
+
+/* keep the pool busy with blocks for this stream */
+static int fill_jobs(bgpstream_decompress_t *d)
+{
+  while (d->jobs_cnt < d->jobs_max && d->in_eof == 0) {
+    if (read_more(d) < 0) {
+      return -1;
+    }
+    if (((d->type == TYPE_BZIP2) ? scan_bzip2(d) : scan_bgzf(d)) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* give up on parallel decompression, and read the rest of the file using
+   wandio instead */
+static int fall_back(bgpstream_decompress_t *d)
+{
+  uint8_t *skip = d->buf;
+  uint64_t remain = d->delivered;
+  int64_t rd;
+
+  bgpstream_log(BGPSTREAM_LOG_WARN,
+                "Could not decompress %s in parallel, "
+                "falling back to serial decompression",
+                d->uri);
+
+  cancel_jobs(d);
+  wandio_destroy(d->in);
+  d->in = NULL;
+
+  if ((d->fallback = wandio_create(d->uri)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open %s for reading", d->uri);
+    return -1;
+  }
+
+  // skip the data we have already returned (reusing the scan buffer)
+  if (d->buf_alloc < READ_CHUNK_LEN &&
+      (skip = realloc(d->buf, READ_CHUNK_LEN)) == NULL) {
+    return -1;
+  }
+  d->buf = skip;
+  d->buf_alloc = READ_CHUNK_LEN;
+  while (remain > 0) {
+    rd = wandio_read(d->fallback, skip,
+                     (remain < READ_CHUNK_LEN) ? remain : READ_CHUNK_LEN);
+    if (rd <= 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not re-read %s", d->uri);
+      return -1;
+    }
+    remain -= rd;
+  }
+
+  return 0;
+}
+
+/* ========== PUBLIC FUNCTIONS BELOW ========== */
+
+bgpstream_decompress_pool_t *bgpstream_decompress_pool_create(int threads)
+{
+  bgpstream_decompress_pool_t *pool;
+  int i;
+
+  assert(threads > 0);
+
+  if ((pool = malloc_zero(sizeof(bgpstream_decompress_pool_t))) == NULL) {
+    return NULL;
+  }
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->work_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+
+  if ((pool->threads = malloc(sizeof(pthread_t) * threads)) == NULL) {
+    goto err;
+  }
+  for (i = 0; i < threads; i++) {
+    if (pthread_create(&pool->threads[i], NULL, worker, pool) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not start decompression thread");
+      goto err;
+    }
+    pool->threads_cnt++;
+  }
+
+  return pool;
+
+ err:
+  bgpstream_decompress_pool_destroy(pool);
+  return NULL;
+}
+
+void bgpstream_decompress_pool_destroy(bgpstream_decompress_pool_t *pool)
+{
+  decomp_job_t *job;
+  int i;
+
+  if (pool == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (i = 0; i < pool->threads_cnt; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  free(pool->threads);
+  pool->threads = NULL;
+
+  // only cancelled jobs can be left
+  while ((job = pool->queue_head) != NULL) {
+    pool->queue_head = job->next_queued;
+    assert(job->state == JOB_CANCELLED);
+    job_free(job);
+  }
+
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_cond_destroy(&pool->done_cond);
+
+  free(pool);
+}
+
+bgpstream_decompress_t *
+bgpstream_decompress_create(bgpstream_decompress_pool_t *pool,
+                            const char *uri)
+{
+  bgpstream_decompress_t *d;
+
+  if ((d = malloc_zero(sizeof(bgpstream_decompress_t))) == NULL) {
+    return NULL;
+  }
+  d->pool = pool;
+  d->block_start = -1;
+  d->jobs_max = pool->threads_cnt * JOBS_PER_THREAD;
+
+  if ((d->uri = strdup(uri)) == NULL ||
+      (d->in = wandio_create_uncompressed(uri)) == NULL) {
+    goto err;
+  }
+
+  // read enough to recognize the format
+  while (d->buf_len < READ_CHUNK_LEN && d->in_eof == 0) {
+    if (read_more(d) < 0) {
+      goto err;
+    }
+  }
+
+#ifdef WITH_BZIP2
+  static const uint8_t bzip2_block[] = {0x31, 0x41, 0x59, 0x26, 0x53, 0x59};
+
+  // "BZh" + block size, followed immediately by a block
+  if (d->buf_len >= BZIP2_HDR_LEN + sizeof(bzip2_block) &&
+      memcmp(d->buf, "BZh", 3) == 0 && d->buf[3] >= '1' && d->buf[3] <= '9' &&
+      memcmp(d->buf + BZIP2_HDR_LEN, bzip2_block, sizeof(bzip2_block)) == 0) {
+    d->type = TYPE_BZIP2;
+    d->scan_bit = BZIP2_HDR_LEN * 8;
+    if (scan_bzip2(d) != 0) {
+      goto err;
+    }
+    return d;
+  }
+#endif
+#ifdef WITH_BGZF
+  if (bgzf_member_len(d->buf, d->buf_len) > 0) {
+    d->type = TYPE_BGZF;
+    if (scan_bgzf(d) != 0) {
+      goto err;
+    }
+    return d;
+  }
+#endif
+
+  // not a format we can split
+ err:
+  bgpstream_decompress_destroy(d);
+  return NULL;
+}
+
+int64_t bgpstream_decompress_read(bgpstream_decompress_t *d, uint8_t *buffer,
+                                  int64_t len)
+{
+  bgpstream_decompress_pool_t *pool = d->pool;
+  decomp_job_t *job;
+  int64_t done = 0;
+  int64_t rd;
+  size_t n;
+
+  while (done < len) {
+    if (d->fallback != NULL) {
+      if ((rd = wandio_read(d->fallback, buffer + done, len - done)) < 0) {
+        return -1;
+      }
+      done += rd;
+      break;
+    }
+
+    if (fill_jobs(d) != 0) {
+      return -1;
+    }
+    if ((job = d->jobs_head) == NULL) {
+      // EOF
+      break;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    while (job->state == JOB_QUEUED || job->state == JOB_RUNNING) {
+      pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (job->state == JOB_FAILED) {
+      if (fall_back(d) != 0) {
+        return -1;
+      }
+      continue;
+    }
+
+    n = job->out_len - job->out_pos;
+    if ((uint64_t)n > (uint64_t)(len - done)) {
+      n = len - done;
+    }
+    memcpy(buffer + done, job->out + job->out_pos, n);
+    job->out_pos += n;
+    done += n;
+    d->delivered += n;
+
+    if (job->out_pos == job->out_len) {
+      if ((d->jobs_head = job->next) == NULL) {
+        d->jobs_tail = NULL;
+      }
+      d->jobs_cnt--;
+      job_free(job);
+    }
+  }
+
+  return done;
+}
+
+void bgpstream_decompress_destroy(bgpstream_decompress_t *d)
+{
+  if (d == NULL) {
+    return;
+  }
+
+  cancel_jobs(d);
+
+  if (d->in != NULL) {
+    wandio_destroy(d->in);
+    d->in = NULL;
+  }
+  if (d->fallback != NULL) {
+    wandio_destroy(d->fallback);
+    d->fallback = NULL;
+  }
+
+  free(d->buf);
+  d->buf = NULL;
+  free(d->uri);
+  d->uri = NULL;
+
+  free(d);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_DECOMPRESS_H
+#define __BGPSTREAM_DECOMPRESS_H
+
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Block-parallel decompression of bzip2 and gzip dumps.
+ *
+ * A bzip2 stream is made up of independent blocks (of up to 900 kB of
+ * uncompressed data) that start with a 48-bit magic number. The blocks are not
+ * byte-aligned, and their lengths are not recorded anywhere, but they can be
+ * found by scanning the compressed bits for the magic number, and each one can
+ * then be rewrapped as a standalone bzip2 stream and decompressed on its own.
+ *
+ * gzip members can be decompressed independently too, but their lengths are
+ * only known in advance when they carry a BGZF-style "BC" extra field
+ * (e.g., files written by bgzip), so only such files are supported.
+ *
+ * Blocks (or members) are decompressed by a shared pool of worker threads, and
+ * the output is returned to the reader in order. If a block fails to
+ * decompress (e.g., if a magic number appeared in the compressed data by
+ * chance), the stream falls back to decompressing the file serially using
+ * wandio, skipping the data that has already been returned.
+ */
+
+/** Opaque pointer representing a pool of decompression threads */
+typedef struct bgpstream_decompress_pool bgpstream_decompress_pool_t;
+
+/** Opaque pointer representing a file being decompressed */
+typedef struct bgpstream_decompress bgpstream_decompress_t;
+
+/** Create a new decompression pool
+ *
+ * @param threads       number of worker threads
+ * @return pointer to the pool if successful, NULL otherwise
+ */
+bgpstream_decompress_pool_t *bgpstream_decompress_pool_create(int threads);
+
+/** Destroy the given decompression pool
+ *
+ * @param pool          pointer to the pool to destroy
+ *
+ * All streams using the pool must have been destroyed first.
+ */
+void bgpstream_decompress_pool_destroy(bgpstream_decompress_pool_t *pool);
+
+/** Open the given file for parallel decompression
+ *
+ * @param pool          pointer to the pool to decompress with
+ * @param uri           path or URL of the file to open
+ * @return pointer to the stream if successful, NULL if the file could not be
+ * opened or is not in a format that can be decompressed in parallel (in which
+ * case the caller should read it using wandio)
+ */
+bgpstream_decompress_t *
+bgpstream_decompress_create(bgpstream_decompress_pool_t *pool,
+                            const char *uri);
+
+/** Read decompressed data from the given stream
+ *
+ * @param d             pointer to the stream to read from
+ * @param buffer        pointer to the buffer to fill
+ * @param len           number of bytes to read
+ * @return the number of bytes read (less than len only at the end of the
+ * file), or -1 if an error occurred
+ */
+int64_t bgpstream_decompress_read(bgpstream_decompress_t *d, uint8_t *buffer,
+                                  int64_t len);
+
+/** Destroy the given stream
+ *
+ * @param d             pointer to the stream to destroy
+ */
+void bgpstream_decompress_destroy(bgpstream_decompress_t *d);
+
+#endif /* __BGPSTREAM_DECOMPRESS_H */
@@ -69,6 +69,14 @@
 
 /** Convenience macros that create a class structure for a data interface */
 #define BSDI_CREATE_CLASS_FULL(classname, classnamestr, id, desc, options)     \
+  BSDI_CREATE_CLASS_FULL_EXT(classname, classnamestr, id, desc, options,       \
+                             NULL, NULL)
+
+/** Create a class structure for a data interface that also implements some of
+ * the optional methods (poll_resources, get_response_cache_stats). Methods
+ * that are not implemented should be given as NULL */
+#define BSDI_CREATE_CLASS_FULL_EXT(classname, classnamestr, id, desc,          \
+                                   options, poll, cache_stats)                 \
   static bsdi_t bsdi_##classname = {                                           \
     {                                                                          \
       (id), classnamestr, desc,                                                \
@@ -80,6 +88,8 @@
     bsdi_##classname##_set_option,                                             \
     bsdi_##classname##_destroy,                                                \
     bsdi_##classname##_update_resources,                                       \
+    (poll),                                                                    \
+    (cache_stats),                                                             \
     NULL,                                                                      \
     NULL,                                                                      \
     NULL,                                                                      \
@@ -162,6 +172,27 @@ struct bsdi {
    */
   int (*update_resources)(bsdi_t *di);
 
+  /** (Optional) Add any resources that are ready without blocking
+   *
+   * @param di          pointer to the data interface
+   * @return 0 if the queue was updated successfully, -1 otherwise
+   *
+   * This method is called before each record is read while the queue is not
+   * empty. It allows interfaces that fetch resource metadata in the background
+   * to hand it over before the queue drains. May be NULL.
+   */
+  int (*poll_resources)(bsdi_t *di);
+
+  /** (Optional) Get statistics about the response cache of this interface
+   *
+   * @param di          pointer to the data interface
+   * @param[out] stats  pointer to a stats structure to fill
+   *
+   * May be NULL if the interface does not cache responses.
+   */
+  void (*get_response_cache_stats)(bsdi_t *di,
+                                   bgpstream_response_cache_stats_t *stats);
+
   /** }@ */
 
   /**
@@ -31,6 +31,7 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -340,6 +341,56 @@ void bgpstream_di_mgr_set_blocking(bgpstream_di_mgr_t *di_mgr)
   di_mgr->blocking = 1;
 }
 
+void bgpstream_di_mgr_set_decode_ahead(bgpstream_di_mgr_t *di_mgr,
+                                       int queue_len)
+{
+  bgpstream_resource_mgr_set_decode_ahead(di_mgr->res_mgr, queue_len);
+}
+
+void bgpstream_di_mgr_set_opener_threads(bgpstream_di_mgr_t *di_mgr,
+                                         int threads)
+{
+  bgpstream_resource_mgr_set_opener_threads(di_mgr->res_mgr, threads);
+}
+
+void bgpstream_di_mgr_set_buffer_budget(bgpstream_di_mgr_t *di_mgr,
+                                        size_t budget)
+{
+  bgpstream_resource_mgr_set_buffer_budget(di_mgr->res_mgr, budget);
+}
+
+void bgpstream_di_mgr_set_decompress_threads(bgpstream_di_mgr_t *di_mgr,
+                                             int threads)
+{
+  bgpstream_resource_mgr_set_decompress_threads(di_mgr->res_mgr, threads);
+}
+
+void bgpstream_di_mgr_set_lazy_elem_attrs(bgpstream_di_mgr_t *di_mgr)
+{
+  bgpstream_resource_mgr_set_lazy_elem_attrs(di_mgr->res_mgr);
+}
+
+void bgpstream_di_mgr_set_unordered(bgpstream_di_mgr_t *di_mgr)
+{
+  bgpstream_resource_mgr_set_unordered(di_mgr->res_mgr);
+}
+
+void bgpstream_di_mgr_get_opener_stats(bgpstream_di_mgr_t *di_mgr,
+                                       bgpstream_opener_stats_t *stats)
+{
+  bgpstream_resource_mgr_get_opener_stats(di_mgr->res_mgr, stats);
+}
+
+void bgpstream_di_mgr_get_response_cache_stats(
+  bgpstream_di_mgr_t *di_mgr, bgpstream_response_cache_stats_t *stats)
+{
+  if (ACTIVE_DI == NULL || ACTIVE_DI->get_response_cache_stats == NULL) {
+    memset(stats, 0, sizeof(bgpstream_response_cache_stats_t));
+    return;
+  }
+  ACTIVE_DI->get_response_cache_stats(ACTIVE_DI, stats);
+}
+
 int
 bgpstream_di_mgr_get_next_record(bgpstream_di_mgr_t *di_mgr,
                                  bgpstream_record_t **record)
@@ -357,6 +408,11 @@ bgpstream_di_mgr_get_next_record(bgpstream_di_mgr_t *di_mgr,
 
     // if the queue is not empty, then grab a record
     if (bgpstream_resource_mgr_empty(di_mgr->res_mgr) == 0) {
+      // but first let the DI add anything it fetched in the background
+      if (ACTIVE_DI->poll_resources != NULL &&
+          ACTIVE_DI->poll_resources(ACTIVE_DI) != 0) {
+        return -1;
+      }
       if ((rc = bgpstream_resource_mgr_get_record(di_mgr->res_mgr,
                                                   record)) < 0) {
         // an error occurred
@@ -134,6 +134,71 @@ int bgpstream_di_mgr_set_data_interface_option(
  */
 void bgpstream_di_mgr_set_blocking(bgpstream_di_mgr_t *di_mgr);
 
+/** Set the number of records that readers should decode in the background
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param queue_len     number of records to decode ahead for each open
+ *                      resource (0 to disable)
+ */
+void bgpstream_di_mgr_set_decode_ahead(bgpstream_di_mgr_t *di_mgr,
+                                       int queue_len);
+
+/** Set the number of threads used to open resources
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param threads       number of opener threads (0 to use one thread per
+ *                      resource)
+ */
+void bgpstream_di_mgr_set_opener_threads(bgpstream_di_mgr_t *di_mgr,
+                                         int threads);
+
+/** Set a memory budget for the parse buffers of open resources
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param budget        maximum number of bytes of full-size parse buffers
+ *                      (0 to give each resource a private buffer)
+ */
+void bgpstream_di_mgr_set_buffer_budget(bgpstream_di_mgr_t *di_mgr,
+                                        size_t budget);
+
+/** Set the number of threads used to decompress files in parallel
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param threads       number of decompression threads (0 to decompress each
+ *                      file serially)
+ */
+void bgpstream_di_mgr_set_decompress_threads(bgpstream_di_mgr_t *di_mgr,
+                                             int threads);
+
+/** Defer decoding elem path attributes until they are accessed
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ */
+void bgpstream_di_mgr_set_lazy_elem_attrs(bgpstream_di_mgr_t *di_mgr);
+
+/** Return records from whichever open resource has one ready, rather than in
+ * time order
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ */
+void bgpstream_di_mgr_set_unordered(bgpstream_di_mgr_t *di_mgr);
+
+/** Get statistics about the resources opened by the opener thread pool
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param[out] stats    pointer to a stats structure to fill
+ */
+void bgpstream_di_mgr_get_opener_stats(bgpstream_di_mgr_t *di_mgr,
+                                       bgpstream_opener_stats_t *stats);
+
+/** Get statistics about the response cache of the active data interface
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param[out] stats    pointer to a stats structure to fill
+ */
+void bgpstream_di_mgr_get_response_cache_stats(
+  bgpstream_di_mgr_t *di_mgr, bgpstream_response_cache_stats_t *stats);
+
 /** Start the data interface
  *
  * @param di_mgr        pointer to a data interface manager instance
@@ -35,8 +35,34 @@
 #include <stdio.h>
 #include <string.h>
 
+/* build the given lazily-decoded field, if it is still pending */
+static int build_lazy_field(bgpstream_elem_t *elem, int which)
+{
+  if ((elem->__lazy_pending & which) == 0) {
+    return 0;
+  }
+  elem->__lazy_pending &= ~which;
+  if (elem->__lazy_cb(elem, elem->__lazy_attrs, which) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not decode %s",
+                  (which == BGPSTREAM_ELEM_LAZY_AS_PATH) ? "AS path"
+                                                         : "communities");
+    return -1;
+  }
+  return 0;
+}
+
 /* ==================== PROTECTED FUNCTIONS ==================== */
 
+void bgpstream_elem_set_lazy_attrs(bgpstream_elem_t *elem,
+                                   bgpstream_elem_lazy_attrs_cb_t *cb,
+                                   void *attrs)
+{
+  elem->__lazy_pending =
+    BGPSTREAM_ELEM_LAZY_AS_PATH | BGPSTREAM_ELEM_LAZY_COMMUNITIES;
+  elem->__lazy_attrs = attrs;
+  elem->__lazy_cb = cb;
+}
+
 /* ==================== PUBLIC FUNCTIONS ==================== */
 
 bgpstream_elem_t *bgpstream_elem_create()
@@ -87,11 +113,20 @@ void bgpstream_elem_clear(bgpstream_elem_t *elem)
 {
   bgpstream_as_path_clear(elem->as_path);
   bgpstream_community_set_clear(elem->communities);
+  elem->__lazy_pending = 0;
+  elem->__lazy_attrs = NULL;
+  elem->__lazy_cb = NULL;
 }
 
 bgpstream_elem_t *bgpstream_elem_copy(bgpstream_elem_t *dst,
                                       bgpstream_elem_t *src)
 {
+  /* the copy does not reference the attributes of the source */
+  if (bgpstream_elem_get_as_path(src) == NULL ||
+      bgpstream_elem_get_communities(src) == NULL) {
+    return NULL;
+  }
+
   /* save all ptrs before memcpy */
   bgpstream_as_path_t *dst_aspath = dst->as_path;
   bgpstream_community_set_t *dst_comms = dst->communities;
@@ -102,6 +137,8 @@ bgpstream_elem_t *bgpstream_elem_copy(bgpstream_elem_t *dst,
   /* restore all ptrs */
   dst->as_path = dst_aspath;
   dst->communities = dst_comms;
+  dst->__lazy_attrs = NULL;
+  dst->__lazy_cb = NULL;
 
   if (bgpstream_as_path_copy(dst->as_path, src->as_path) != 0) {
     return NULL;
@@ -114,6 +151,23 @@ bgpstream_elem_t *bgpstream_elem_copy(bgpstream_elem_t *dst,
   return dst;
 }
 
+bgpstream_as_path_t *bgpstream_elem_get_as_path(bgpstream_elem_t *elem)
+{
+  if (build_lazy_field(elem, BGPSTREAM_ELEM_LAZY_AS_PATH) != 0) {
+    return NULL;
+  }
+  return elem->as_path;
+}
+
+bgpstream_community_set_t *
+bgpstream_elem_get_communities(bgpstream_elem_t *elem)
+{
+  if (build_lazy_field(elem, BGPSTREAM_ELEM_LAZY_COMMUNITIES) != 0) {
+    return NULL;
+  }
+  return elem->communities;
+}
+
 int bgpstream_elem_type_snprintf(char *buf, size_t len,
                                  bgpstream_elem_type_t type)
 {
@@ -242,6 +296,8 @@ char *bgpstream_elem_custom_snprintf(char *buf, size_t len,
   size_t c = 0;       /* < how many chars were written */
   char *buf_p = buf;
   bgpstream_as_path_seg_t *seg;
+  bgpstream_as_path_t *as_path;
+  bgpstream_community_set_t *communities;
 
   /* common fields */
 
@@ -296,8 +352,17 @@ char *bgpstream_elem_custom_snprintf(char *buf, size_t len,
     }
     ADD_PIPE;
 
+    /* building lazily-decoded fields does not change the elem as seen by the
+       user */
+    if ((as_path = bgpstream_elem_get_as_path((bgpstream_elem_t *)elem)) ==
+          NULL ||
+        (communities = bgpstream_elem_get_communities(
+           (bgpstream_elem_t *)elem)) == NULL) {
+      return NULL;
+    }
+
     /* AS PATH */
-    c = bgpstream_as_path_snprintf(buf_p, B_REMAIN, elem->as_path);
+    c = bgpstream_as_path_snprintf(buf_p, B_REMAIN, as_path);
     written += c;
     buf_p += c;
     if (B_FULL)
@@ -305,7 +370,7 @@ char *bgpstream_elem_custom_snprintf(char *buf, size_t len,
     ADD_PIPE;
 
     /* ORIGIN AS */
-    if ((seg = bgpstream_as_path_get_origin_seg(elem->as_path)) != NULL) {
+    if ((seg = bgpstream_as_path_get_origin_seg(as_path)) != NULL) {
       c = bgpstream_as_path_seg_snprintf(buf_p, B_REMAIN, seg);
       written += c;
       buf_p += c;
@@ -313,7 +378,7 @@ char *bgpstream_elem_custom_snprintf(char *buf, size_t len,
     ADD_PIPE;
 
     /* COMMUNITIES */
-    c = bgpstream_community_set_snprintf(buf_p, B_REMAIN, elem->communities);
+    c = bgpstream_community_set_snprintf(buf_p, B_REMAIN, communities);
     written += c;
     buf_p += c;
     if (B_FULL)
@@ -107,6 +107,17 @@ typedef enum {
 
 } bgpstream_elem_type_t;
 
+/** Elem fields that may be decoded lazily (flags) */
+typedef enum {
+
+  /** AS path */
+  BGPSTREAM_ELEM_LAZY_AS_PATH = 0x1,
+
+  /** Communities */
+  BGPSTREAM_ELEM_LAZY_COMMUNITIES = 0x2,
+
+} bgpstream_elem_lazy_field_t;
+
 /** @} */
 
 /**
@@ -114,6 +125,18 @@ typedef enum {
  *
  * @{ */
 
+struct bgpstream_elem;
+
+/** Callback used to build the lazily-decoded path attributes of an elem
+ *
+ * @param elem          pointer to the elem to populate
+ * @param attrs         opaque pointer to the (format-specific) attributes
+ * @param which         BGPSTREAM_ELEM_LAZY_* flag of the field to build
+ * @return 0 if successful, -1 otherwise
+ */
+typedef int(bgpstream_elem_lazy_attrs_cb_t)(struct bgpstream_elem *elem,
+                                            void *attrs, int which);
+
 /** A BGP Stream Elem object */
 typedef struct bgpstream_elem {
 
@@ -166,12 +189,19 @@ typedef struct bgpstream_elem {
   /** AS path
    *
    * Available only for RIB and Announcement elem types
+   *
+   * If lazy path attribute decoding is enabled (see
+   * bgpstream_set_lazy_elem_attrs), use bgpstream_elem_get_as_path instead.
    */
   bgpstream_as_path_t *as_path;
 
   /** Communities
    *
    * Available only for RIB and Announcement elem types
+   *
+   * If lazy path attribute decoding is enabled (see
+   * bgpstream_set_lazy_elem_attrs), use bgpstream_elem_get_communities
+   * instead.
    */
   bgpstream_community_set_t *communities;
 
@@ -187,6 +217,17 @@ typedef struct bgpstream_elem {
    */
   bgpstream_elem_peerstate_t new_state;
 
+  /* ---------- INTERNAL FIELDS: ---------- */
+
+  /** INTERNAL: BGPSTREAM_ELEM_LAZY_* flags of the fields not yet built */
+  int __lazy_pending;
+
+  /** INTERNAL: Attributes to build the pending fields from. Do not use. */
+  void *__lazy_attrs;
+
+  /** INTERNAL: Callback to build the pending fields. Do not use. */
+  bgpstream_elem_lazy_attrs_cb_t *__lazy_cb;
+
 } bgpstream_elem_t;
 
 /** @} */
@@ -227,6 +268,31 @@ void bgpstream_elem_clear(bgpstream_elem_t *elem);
 bgpstream_elem_t *bgpstream_elem_copy(bgpstream_elem_t *dst,
                                       bgpstream_elem_t *src);
 
+/** Get the AS path of the given elem
+ *
+ * @param elem          pointer to a BGP Stream Elem
+ * @return pointer to the AS path of the elem, or NULL if it could not be
+ * decoded
+ *
+ * If lazy path attribute decoding is enabled, the AS path is built the first
+ * time this is called for an elem. Otherwise this simply returns
+ * `elem->as_path`. The returned path belongs to the elem.
+ */
+bgpstream_as_path_t *bgpstream_elem_get_as_path(bgpstream_elem_t *elem);
+
+/** Get the communities of the given elem
+ *
+ * @param elem          pointer to a BGP Stream Elem
+ * @return pointer to the community set of the elem, or NULL if it could not be
+ * decoded
+ *
+ * If lazy path attribute decoding is enabled, the community set is built the
+ * first time this is called for an elem. Otherwise this simply returns
+ * `elem->communities`. The returned set belongs to the elem.
+ */
+bgpstream_community_set_t *
+bgpstream_elem_get_communities(bgpstream_elem_t *elem);
+
 /** Write the string representation of the elem type into the provided buffer
  *
  * @param buf           pointer to a char array
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_elem_columns.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ==================== PUBLIC FUNCTIONS ==================== */
+
+bgpstream_elem_columns_t *
+bgpstream_elem_columns_create(int size, bgpstream_peer_sig_map_t *peer_sig_map,
+                              bgpstream_as_path_store_t *path_store)
+{
+  bgpstream_elem_columns_t *cols;
+
+  if (size <= 0 ||
+      (cols = malloc_zero(sizeof(bgpstream_elem_columns_t))) == NULL) {
+    return NULL;
+  }
+
+  cols->size = size;
+  cols->peer_sig_map = peer_sig_map;
+  cols->path_store = path_store;
+
+  if ((cols->type = malloc(sizeof(uint8_t) * size)) == NULL ||
+      (cols->time_sec = malloc(sizeof(uint32_t) * size)) == NULL ||
+      (cols->ip_version = malloc(sizeof(uint8_t) * size)) == NULL ||
+      (cols->pfx_ipv4 = malloc(sizeof(uint32_t) * size)) == NULL ||
+      (cols->pfx_ipv6 = malloc(sizeof(struct in6_addr) * size)) == NULL ||
+      (cols->mask_len = malloc(sizeof(uint8_t) * size)) == NULL ||
+      (cols->peer_asn = malloc(sizeof(uint32_t) * size)) == NULL ||
+      (cols->peer_id = malloc(sizeof(bgpstream_peer_id_t) * size)) == NULL ||
+      (cols->origin_asn = malloc(sizeof(uint32_t) * size)) == NULL ||
+      (cols->path_id = malloc(sizeof(bgpstream_as_path_store_path_id_t) *
+                              size)) == NULL) {
+    goto err;
+  }
+
+  return cols;
+
+err:
+  bgpstream_elem_columns_destroy(cols);
+  return NULL;
+}
+
+void bgpstream_elem_columns_destroy(bgpstream_elem_columns_t *cols)
+{
+  if (cols == NULL) {
+    return;
+  }
+
+  free(cols->type);
+  free(cols->time_sec);
+  free(cols->ip_version);
+  free(cols->pfx_ipv4);
+  free(cols->pfx_ipv6);
+  free(cols->mask_len);
+  free(cols->peer_asn);
+  free(cols->peer_id);
+  free(cols->origin_asn);
+  free(cols->path_id);
+
+  free(cols);
+}
+
+void bgpstream_elem_columns_clear(bgpstream_elem_columns_t *cols)
+{
+  cols->cnt = 0;
+}
+
+int bgpstream_elem_columns_append(bgpstream_elem_columns_t *cols,
+                                  bgpstream_elem_t *elem, char *collector,
+                                  uint32_t time_sec)
+{
+  int i = cols->cnt;
+  bgpstream_as_path_t *path;
+
+  if (i == cols->size) {
+    return 0;
+  }
+
+  cols->type[i] = elem->type;
+  cols->time_sec[i] = time_sec;
+  cols->peer_asn[i] = elem->peer_asn;
+
+  cols->peer_id[i] = 0;
+  if (cols->peer_sig_map != NULL &&
+      (cols->peer_id[i] = bgpstream_peer_sig_map_get_id(
+         cols->peer_sig_map, collector, (bgpstream_ip_addr_t *)&elem->peer_ip,
+         elem->peer_asn)) == 0) {
+    return -1;
+  }
+
+  // prefix (RIB, announcement and withdrawal elems)
+  cols->ip_version[i] = 0;
+  cols->pfx_ipv4[i] = 0;
+  memset(&cols->pfx_ipv6[i], 0, sizeof(struct in6_addr));
+  cols->mask_len[i] = 0;
+  if (elem->type == BGPSTREAM_ELEM_TYPE_RIB ||
+      elem->type == BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT ||
+      elem->type == BGPSTREAM_ELEM_TYPE_WITHDRAWAL) {
+    cols->ip_version[i] = elem->prefix.address.version;
+    if (elem->prefix.address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
+      cols->pfx_ipv4[i] = elem->prefix.address.ipv4.s_addr;
+    } else {
+      cols->pfx_ipv6[i] = elem->prefix.address.ipv6;
+    }
+    cols->mask_len[i] = elem->prefix.mask_len;
+  }
+
+  // path (RIB and announcement elems)
+  cols->origin_asn[i] = 0;
+  memset(&cols->path_id[i], 0, sizeof(bgpstream_as_path_store_path_id_t));
+  if (elem->type == BGPSTREAM_ELEM_TYPE_RIB ||
+      elem->type == BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT) {
+    if ((path = bgpstream_elem_get_as_path(elem)) == NULL) {
+      return -1;
+    }
+    if (bgpstream_as_path_get_origin_val(path, &cols->origin_asn[i]) != 0) {
+      cols->origin_asn[i] = 0;
+    }
+    if (cols->path_store != NULL &&
+        bgpstream_as_path_store_get_path_id(cols->path_store, path,
+                                            elem->peer_asn,
+                                            &cols->path_id[i]) != 0) {
+      return -1;
+    }
+  }
+
+  cols->cnt++;
+  return 1;
+}
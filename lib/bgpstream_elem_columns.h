@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_ELEM_COLUMNS_H
+#define __BGPSTREAM_ELEM_COLUMNS_H
+
+#include "bgpstream_elem.h"
+#include "bgpstream_utils.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of a columnar
+ * (struct-of-arrays) batch of elems.
+ *
+ */
+
+/**
+ * @name Public Data Structures
+ *
+ * @{ */
+
+/** A batch of elems stored as parallel arrays
+ *
+ * Row i of the batch is described by element i of every column array. Columns
+ * that do not apply to the elem type (e.g., the prefix of a peer state elem,
+ * or the origin of a withdrawal) are zero.
+ */
+typedef struct bgpstream_elem_columns {
+
+  /** Number of rows in the batch */
+  int cnt;
+
+  /** Maximum number of rows in the batch */
+  int size;
+
+  /** Borrowed pointer to a peer signature map used to assign peer IDs (NULL
+   * if the peer_id column is not wanted) */
+  bgpstream_peer_sig_map_t *peer_sig_map;
+
+  /** Borrowed pointer to an AS path store used to assign path IDs (NULL if the
+   * path_id column is not wanted) */
+  bgpstream_as_path_store_t *path_store;
+
+  /** Elem type (bgpstream_elem_type_t) */
+  uint8_t *type;
+
+  /** Record time (seconds) */
+  uint32_t *time_sec;
+
+  /** IP version of the prefix (0 if the elem has no prefix) */
+  uint8_t *ip_version;
+
+  /** IPv4 prefix address in network byte order (if ip_version is 4) */
+  uint32_t *pfx_ipv4;
+
+  /** IPv6 prefix address (if ip_version is 6) */
+  struct in6_addr *pfx_ipv6;
+
+  /** Prefix mask length */
+  uint8_t *mask_len;
+
+  /** Peer ASN */
+  uint32_t *peer_asn;
+
+  /** Peer ID from peer_sig_map (0 if there is no peer sig map) */
+  bgpstream_peer_id_t *peer_id;
+
+  /** Origin ASN (0 if the origin segment is not a simple ASN) */
+  uint32_t *origin_asn;
+
+  /** Path ID from path_store (zero if there is no path store) */
+  bgpstream_as_path_store_path_id_t *path_id;
+
+} bgpstream_elem_columns_t;
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new columnar elem batch
+ *
+ * @param size          maximum number of rows in the batch
+ * @param peer_sig_map  pointer to a peer signature map to assign peer IDs with
+ *                      (NULL to leave the peer_id column empty)
+ * @param path_store    pointer to an AS path store to assign path IDs with
+ *                      (NULL to leave the path_id column empty)
+ * @return pointer to the batch if successful, NULL otherwise
+ *
+ * The peer signature map and path store are borrowed, and may be shared by
+ * many batches.
+ */
+bgpstream_elem_columns_t *
+bgpstream_elem_columns_create(int size, bgpstream_peer_sig_map_t *peer_sig_map,
+                              bgpstream_as_path_store_t *path_store);
+
+/** Destroy the given columnar elem batch
+ *
+ * @param cols          pointer to the batch to destroy
+ */
+void bgpstream_elem_columns_destroy(bgpstream_elem_columns_t *cols);
+
+/** Remove all rows from the given columnar elem batch
+ *
+ * @param cols          pointer to the batch to clear
+ */
+void bgpstream_elem_columns_clear(bgpstream_elem_columns_t *cols);
+
+/** Append the given elem to a columnar elem batch
+ *
+ * @param cols          pointer to the batch to append to
+ * @param elem          pointer to the elem to append
+ * @param collector     name of the collector the elem came from (only used
+ *                      for the peer ID)
+ * @param time_sec      time of the record the elem came from
+ * @return 1 if the elem was appended, 0 if the batch is full, -1 if an error
+ * occurred
+ */
+int bgpstream_elem_columns_append(bgpstream_elem_columns_t *cols,
+                                  bgpstream_elem_t *elem, char *collector,
+                                  uint32_t time_sec);
+
+/** @} */
+
+#endif /* __BGPSTREAM_ELEM_COLUMNS_H */
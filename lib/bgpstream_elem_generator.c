@@ -28,6 +28,9 @@
 #include "bgpstream_elem_generator.h"
 #include <assert.h>
 
+/* Number of elems in the first chunk of elems */
+#define ELEM_CHUNK_MIN_CNT 16
+
 struct bgpstream_elem_generator {
 
   /** Array of elems */
@@ -41,10 +44,55 @@ struct bgpstream_elem_generator {
 
   /* Current iterator position (iter == cnt means end-of-list) */
   int iter;
+
+  /** Chunks that the elems are allocated from (each chunk is as large as all
+   * of the chunks before it, so the elems array doubles in size each time) */
+  bgpstream_elem_t **chunks;
+
+  /** Number of chunks */
+  int chunks_cnt;
 };
 
 /* ==================== PRIVATE FUNCTIONS ==================== */
 
+static int grow_elems(bgpstream_elem_generator_t *self, int cnt)
+{
+  bgpstream_elem_t **elems;
+  bgpstream_elem_t **chunks;
+  bgpstream_elem_t *chunk;
+  int i;
+
+  /* realloc into temporaries so that a failure leaves both arrays (and their
+   * counts) consistent for destroy */
+  if ((elems = realloc(self->elems, sizeof(bgpstream_elem_t *) *
+                                      (self->elems_alloc_cnt + cnt))) == NULL) {
+    return -1;
+  }
+  self->elems = elems;
+  if ((chunks = realloc(self->chunks, sizeof(bgpstream_elem_t *) *
+                                        (self->chunks_cnt + 1))) == NULL) {
+    return -1;
+  }
+  self->chunks = chunks;
+  if ((chunk = malloc_zero(sizeof(bgpstream_elem_t) * cnt)) == NULL) {
+    return -1;
+  }
+  self->chunks[self->chunks_cnt++] = chunk;
+
+  for (i = 0; i < cnt; i++) {
+    if ((chunk[i].as_path = bgpstream_as_path_create()) == NULL ||
+        (chunk[i].communities = bgpstream_community_set_create()) == NULL) {
+      if (chunk[i].as_path != NULL) {
+        bgpstream_as_path_destroy(chunk[i].as_path);
+      }
+      return -1;
+    }
+    self->elems[self->elems_alloc_cnt++] = &chunk[i];
+  }
+
+  return 0;
+}
+
 /* ==================== PROTECTED FUNCTIONS ==================== */
 
 bgpstream_elem_generator_t *bgpstream_elem_generator_create()
@@ -63,19 +111,31 @@ bgpstream_elem_generator_t *bgpstream_elem_generator_create()
 
 void bgpstream_elem_generator_destroy(bgpstream_elem_generator_t *self)
 {
+  bgpstream_elem_t *elem;
   int i;
   if (self == NULL) {
     return;
   }
 
-  /* free all the alloc'd elems */
+  /* free the attributes of all the alloc'd elems (the elems themselves belong
+   * to the chunks) */
   for (i = 0; i < self->elems_alloc_cnt; i++) {
-    bgpstream_elem_destroy(self->elems[i]);
+    elem = self->elems[i];
+    if (elem->as_path != NULL) {
+      bgpstream_as_path_destroy(elem->as_path);
+    }
+    if (elem->communities != NULL) {
+      bgpstream_community_set_destroy(elem->communities);
+    }
     self->elems[i] = NULL;
   }
-
   free(self->elems);
 
+  for (i = 0; i < self->chunks_cnt; i++) {
+    free(self->chunks[i]);
+  }
+  free(self->chunks);
+
   self->elems_cnt = self->elems_alloc_cnt = self->iter = 0;
 
   free(self);
@@ -100,28 +160,40 @@ int bgpstream_elem_generator_is_populated(bgpstream_elem_generator_t *self)
   return self->elems_cnt != -1;
 }
 
+int bgpstream_elem_generator_reserve(bgpstream_elem_generator_t *self, int cnt)
+{
+  int used = (self->elems_cnt == -1) ? 0 : self->elems_cnt;
+  int grow;
+
+  if (used + cnt <= self->elems_alloc_cnt) {
+    return 0;
+  }
+
+  // grow geometrically, unless even more elems are needed
+  grow = self->elems_alloc_cnt;
+  if (grow < ELEM_CHUNK_MIN_CNT) {
+    grow = ELEM_CHUNK_MIN_CNT;
+  }
+  if (self->elems_alloc_cnt + grow < used + cnt) {
+    grow = used + cnt - self->elems_alloc_cnt;
+  }
+
+  return grow_elems(self, grow);
+}
+
 bgpstream_elem_t *
 bgpstream_elem_generator_get_new_elem(bgpstream_elem_generator_t *self)
 {
   bgpstream_elem_t *elem = NULL;
 
-  /* check if we need to alloc more elems */
-  if (self->elems_cnt + 1 >= self->elems_alloc_cnt) {
-
-    /* alloc more memory */
-    if ((self->elems = realloc(self->elems, sizeof(bgpstream_elem_t *) *
-                                              (self->elems_alloc_cnt + 1))) ==
-        NULL) {
-      return NULL;
-    }
-
-    /* create an elem */
-    if ((self->elems[self->elems_alloc_cnt] = bgpstream_elem_create()) ==
-        NULL) {
-      return NULL;
-    }
+  /* getting a new elem populates the generator */
+  if (self->elems_cnt == -1) {
+    self->elems_cnt = 0;
+  }
 
-    self->elems_alloc_cnt++;
+  /* check if we need to alloc more elems */
+  if (bgpstream_elem_generator_reserve(self, 1) != 0) {
+    return NULL;
   }
 
   elem = self->elems[self->elems_cnt];
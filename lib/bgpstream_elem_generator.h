@@ -72,6 +72,10 @@ void bgpstream_elem_generator_destroy(bgpstream_elem_generator_t *generator);
 /** Clear the generator ready for re-use
  *
  * @param generator     pointer to the generator to clear
+ *
+ * The elems (and the memory of their AS paths and communities) are kept for
+ * the next record, so a generator that has warmed up does not allocate any
+ * memory.
  */
 void bgpstream_elem_generator_clear(bgpstream_elem_generator_t *generator);
 
@@ -92,6 +96,19 @@ void bgpstream_elem_generator_empty(bgpstream_elem_generator_t *self);
 int bgpstream_elem_generator_is_populated(
   bgpstream_elem_generator_t *generator);
 
+/** Make sure that the generator has room for the given number of new elems
+ *
+ * @param generator     pointer to the generator
+ * @param cnt           number of elems that are about to be added
+ * @return 0 if successful, -1 otherwise
+ *
+ * Callers that know how many elems a record holds (e.g., from its NLRI or RIB
+ * entry count) can use this to allocate them all at once. Otherwise the
+ * generator grows geometrically as elems are added.
+ */
+int bgpstream_elem_generator_reserve(bgpstream_elem_generator_t *generator,
+                                     int cnt);
+
 /** Get a "new" elem structure from the generator
  *
  * @param generator     pointer to the generator to get the elem from
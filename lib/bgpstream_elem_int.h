@@ -43,6 +43,17 @@
  *
  * @{ */
 
+/** Defer decoding of the AS path and communities of the given elem
+ *
+ * @param elem          pointer to the elem
+ * @param cb            callback to build the fields on first access
+ * @param attrs         opaque pointer to pass to the callback, which must stay
+ *                      valid until the elem is cleared (or re-populated)
+ */
+void bgpstream_elem_set_lazy_attrs(bgpstream_elem_t *elem,
+                                   bgpstream_elem_lazy_attrs_cb_t *cb,
+                                   void *attrs);
+
 /** Write the string representation of the elem into the provided buffer
  *
  * @param buf           pointer to a char array
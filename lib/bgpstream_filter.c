@@ -35,6 +35,7 @@
 #include <assert.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 
 /* allocate memory for a new bgpstream filter */
 bgpstream_filter_mgr_t *bgpstream_filter_mgr_create()
@@ -271,10 +272,105 @@ void bgpstream_filter_mgr_interval_filter_add(
   bgpstream_log(BGPSTREAM_LOG_VFINE, "\tBSF_MGR:: add_filter stop");
 }
 
+static void aspath_res_destroy(bgpstream_filter_mgr_t *filter_mgr)
+{
+  int i;
+
+  bgpstream_aspath_matcher_destroy(filter_mgr->aspath_matcher);
+  filter_mgr->aspath_matcher = NULL;
+  for (i = 0; i < filter_mgr->aspath_res_cnt; i++) {
+    regfree(&filter_mgr->aspath_res[i].re);
+  }
+  free(filter_mgr->aspath_res);
+  filter_mgr->aspath_res = NULL;
+  filter_mgr->aspath_res_cnt = 0;
+  filter_mgr->aspath_positive_cnt = 0;
+}
+
+/* compile the AS path expressions once, rather than for every elem. most
+ * expressions can be matched directly against the path segments, the rest are
+ * compiled as regexes and matched against the filterable path string */
+static int aspath_res_compile(bgpstream_filter_mgr_t *filter_mgr)
+{
+  bgpstream_aspath_expr_t *expr;
+  char *regexstr;
+  char errbuf[256];
+  int negate;
+  int rc;
+
+  aspath_res_destroy(filter_mgr);
+
+  if ((filter_mgr->aspath_matcher = bgpstream_aspath_matcher_create()) ==
+        NULL ||
+      (filter_mgr->aspath_res =
+         malloc(sizeof(bgpstream_aspath_expr_t) *
+                bgpstream_str_set_size(filter_mgr->aspath_exprs))) == NULL) {
+    return -1;
+  }
+
+  bgpstream_str_set_rewind(filter_mgr->aspath_exprs);
+  while ((regexstr = bgpstream_str_set_next(filter_mgr->aspath_exprs)) !=
+         NULL) {
+    if (strlen(regexstr) == 0) {
+      continue;
+    }
+
+    negate = 0;
+    if (*regexstr == '!') {
+      negate = 1;
+      regexstr++;
+    }
+    if (negate == 0) {
+      filter_mgr->aspath_positive_cnt++;
+    }
+
+    if ((rc = bgpstream_aspath_matcher_add(filter_mgr->aspath_matcher,
+                                           regexstr, negate)) < 0) {
+      return -1;
+    }
+    if (rc == 0) {
+      continue;
+    }
+
+    /* not supported by the matcher, use a regex */
+    bgpstream_log(BGPSTREAM_LOG_FINE, "Matching AS path filter '%s' as a regex",
+                  regexstr);
+    expr = &filter_mgr->aspath_res[filter_mgr->aspath_res_cnt];
+    expr->negate = negate;
+    if ((rc = regcomp(&expr->re, regexstr, 0)) != 0) {
+      regerror(rc, &expr->re, errbuf, sizeof(errbuf));
+      bgpstream_log(BGPSTREAM_LOG_ERR,
+                    "Failed to compile AS path regex '%s': %s", regexstr,
+                    errbuf);
+      return -1;
+    }
+    filter_mgr->aspath_res_cnt++;
+  }
+
+  return 0;
+}
+
 int bgpstream_filter_mgr_validate(bgpstream_filter_mgr_t *filter_mgr)
 {
   bgpstream_interval_filter_t *tif;
-  /* currently we only validate the intervals */
+
+  if (filter_mgr->aspath_exprs != NULL &&
+      aspath_res_compile(filter_mgr) != 0) {
+    return -1;
+  }
+
+  /* elem prefixes are matched against a read-only copy of the prefix filters
+   * (rebuilt in case filters were added since the last validation) */
+  if (filter_mgr->prefixes != NULL) {
+    bgpstream_pfx_index_destroy(filter_mgr->prefix_index);
+    if ((filter_mgr->prefix_index = bgpstream_pfx_index_create_from_patricia(
+           filter_mgr->prefixes)) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "\tBSF_MGR: can't index prefix filters");
+      return -1;
+    }
+  }
+
+  /* validate the intervals */
   if (filter_mgr->time_intervals != NULL) {
     tif = filter_mgr->time_intervals;
 
@@ -328,10 +424,12 @@ void bgpstream_filter_mgr_destroy(bgpstream_filter_mgr_t *bs_filter_mgr)
   if (bs_filter_mgr->aspath_exprs != NULL) {
     bgpstream_str_set_destroy(bs_filter_mgr->aspath_exprs);
   }
+  aspath_res_destroy(bs_filter_mgr);
   // prefixes
   if (bs_filter_mgr->prefixes != NULL) {
     bgpstream_patricia_tree_destroy(bs_filter_mgr->prefixes);
   }
+  bgpstream_pfx_index_destroy(bs_filter_mgr->prefix_index);
   // communities
   if (bs_filter_mgr->communities != NULL) {
     kh_destroy(bgpstream_community_filter, bs_filter_mgr->communities);
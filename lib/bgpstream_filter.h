@@ -33,8 +33,10 @@
 #define _BGPSTREAM_FILTER_H
 
 #include "bgpstream.h"
+#include "bgpstream_aspath_matcher.h"
 #include "bgpstream_constants.h"
 #include "khash.h"
+#include <regex.h>
 
 #define BGPSTREAM_FILTER_ELEM_TYPE_RIB 0x1
 #define BGPSTREAM_FILTER_ELEM_TYPE_ANNOUNCEMENT 0x2
@@ -58,14 +60,25 @@ KHASH_INIT(collector_ts, char *, uint32_t, 1, kh_str_hash_func,
 
 typedef khash_t(collector_ts) collector_ts_t;
 
+/* AS path expression that the matcher does not support, compiled as a regex */
+typedef struct struct_bgpstream_aspath_expr_t {
+  regex_t re;
+  int negate;
+} bgpstream_aspath_expr_t;
+
 typedef struct struct_bgpstream_filter_mgr_t {
   bgpstream_str_set_t *projects;
   bgpstream_str_set_t *collectors;
   bgpstream_str_set_t *routers;
   bgpstream_str_set_t *bgp_types;
   bgpstream_str_set_t *aspath_exprs;
+  bgpstream_aspath_matcher_t *aspath_matcher; // compiled by validate
+  bgpstream_aspath_expr_t *aspath_res;        // compiled by validate
+  int aspath_res_cnt;
+  int aspath_positive_cnt; // non-negated expressions (matcher and regex)
   bgpstream_id_set_t *peer_asns;
   bgpstream_patricia_tree_t *prefixes;
+  bgpstream_pfx_index_t *prefix_index; // compiled by validate
   bgpstream_community_filter_t *communities;
   bgpstream_interval_filter_t *time_intervals;
   int64_t time_intervals_min; // lower bound of all intervals
@@ -91,7 +104,7 @@ void bgpstream_filter_mgr_interval_filter_add(
   bgpstream_filter_mgr_t *bs_filter_mgr, uint32_t begin_time,
   uint32_t end_time);
 
-/* validate the current filters */
+/* validate the current filters (and compile the AS path expressions) */
 int bgpstream_filter_mgr_validate(bgpstream_filter_mgr_t *mgr);
 
 /* destroy the memory allocated for bgpstream filter */
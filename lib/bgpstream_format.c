@@ -54,8 +54,12 @@ static const format_create_func_t create_functions[] = {
 
 };
 
-bgpstream_format_t *bgpstream_format_create(bgpstream_resource_t *res,
-                                            bgpstream_filter_mgr_t *filter_mgr)
+bgpstream_format_t *
+bgpstream_format_create(bgpstream_resource_t *res,
+                        bgpstream_filter_mgr_t *filter_mgr,
+                        bgpstream_buffer_pool_t *buf_pool,
+                        bgpstream_decompress_pool_t *decomp_pool,
+                        int lazy_elem_attrs)
 {
   bgpstream_format_t *format = NULL;
 
@@ -83,11 +87,21 @@ bgpstream_format_t *bgpstream_format_create(bgpstream_resource_t *res,
   format->res = res;
 
   // create the transport reader
-  if ((format->transport = bgpstream_transport_create(res)) == NULL) {
+  if ((format->transport = bgpstream_transport_create(res, decomp_pool)) ==
+      NULL) {
     goto err;
   }
 
   format->filter_mgr = filter_mgr;
+  format->buf_pool = buf_pool;
+  format->lazy_elem_attrs = lazy_elem_attrs;
+
+  // the AS path matcher was compiled when the filters were validated
+  if (filter_mgr->aspath_matcher != NULL &&
+      (format->aspath_scratch = bgpstream_aspath_matcher_scratch_create(
+         filter_mgr->aspath_matcher)) == NULL) {
+    goto err;
+  }
 
   if (create_functions[res->format_type](format, res) != 0) {
     goto err;
@@ -96,6 +110,9 @@ bgpstream_format_t *bgpstream_format_create(bgpstream_resource_t *res,
   return format;
 
  err:
+  if (format != NULL) {
+    bgpstream_aspath_matcher_scratch_destroy(format->aspath_scratch);
+  }
   free(format);
   return NULL;
 }
@@ -118,6 +135,23 @@ int bgpstream_format_get_next_elem(bgpstream_format_t *format,
   return format->get_next_elem(format, record, elem);
 }
 
+int bgpstream_format_get_elems(bgpstream_format_t *format,
+                               bgpstream_record_t *record,
+                               bgpstream_format_elem_check_cb_t *check_cb,
+                               bgpstream_elem_t **elems, int max)
+{
+  assert(record->__int->format == format);
+  return format->get_elems(format, record, check_cb, elems, max);
+}
+
+int bgpstream_format_get_elem_columns(
+  bgpstream_format_t *format, bgpstream_record_t *record,
+  bgpstream_format_elem_check_cb_t *check_cb, bgpstream_elem_columns_t *cols)
+{
+  assert(record->__int->format == format);
+  return format->get_elem_columns(format, record, check_cb, cols);
+}
+
 #define DATA(record) ((record)->__int)
 
 int bgpstream_format_init_data(bgpstream_record_t *record)
@@ -159,5 +193,8 @@ void bgpstream_format_destroy(bgpstream_format_t *format)
   bgpstream_transport_destroy(format->transport);
   format->transport = NULL;
 
+  bgpstream_aspath_matcher_scratch_destroy(format->aspath_scratch);
+  format->aspath_scratch = NULL;
+
   free(format);
 }
@@ -27,6 +27,9 @@
 #ifndef __BGPSTREAM_FORMAT_H
 #define __BGPSTREAM_FORMAT_H
 
+#include "bgpstream_buffer_pool.h"
+#include "bgpstream_decompress.h"
+#include "bgpstream_elem_columns.h"
 #include "bgpstream_filter.h"
 #include "bgpstream_resource.h"
 
@@ -47,10 +50,21 @@ typedef enum {
   BGPSTREAM_FORMAT_UNKNOWN_ERROR,
 } bgpstream_format_status_t;
 
+/** Callback used to filter the elems returned by bgpstream_format_get_elems
+ * (returns 1 to keep the elem, 0 to skip it) */
+typedef int(bgpstream_format_elem_check_cb_t)(bgpstream_record_t *record,
+                                              bgpstream_elem_t *elem);
+
 /** Create a format handler for the given resource
  *
  * @param res           pointer to a resource
  * @param filter_mgr    pointer to filter manager to use for filtering records
+ * @param buf_pool      pointer to a shared pool to take parse buffers from
+ *                      (NULL to allocate a private buffer)
+ * @param decomp_pool   pointer to a pool to decompress data with (NULL to
+ *                      decompress serially)
+ * @param lazy_elem_attrs  set to defer decoding elem path attributes until
+ *                         they are accessed
  * @return pointer to a format module instance if successful, NULL otherwise
  *
  * TODO: allow return of fatal and non-fatal errors. This way the reader can
@@ -58,7 +72,10 @@ typedef enum {
  */
 bgpstream_format_t *
 bgpstream_format_create(bgpstream_resource_t *res,
-                        bgpstream_filter_mgr_t *filter_mgr);
+                        bgpstream_filter_mgr_t *filter_mgr,
+                        bgpstream_buffer_pool_t *buf_pool,
+                        bgpstream_decompress_pool_t *decomp_pool,
+                        int lazy_elem_attrs);
 
 /** Populate the given record with the next available record from this resource
  *
@@ -88,6 +105,36 @@ int bgpstream_format_get_next_elem(bgpstream_format_t *format,
                                    bgpstream_record_t *record,
                                    bgpstream_elem_t **elem);
 
+/** Get a batch of elems that pass the given check from the given record
+ *
+ * @param format        pointer to the format object to use
+ * @param record        pointer to the record to use
+ * @param check_cb      callback that returns 1 if an elem should be returned,
+ *                      0 otherwise
+ * @param[out] elems    array to fill with borrowed elem pointers
+ * @param max           size of the elems array
+ * @return the number of elems returned, 0 if there are no more elems, -1 if an
+ * error occurred.
+ */
+int bgpstream_format_get_elems(bgpstream_format_t *format,
+                               bgpstream_record_t *record,
+                               bgpstream_format_elem_check_cb_t *check_cb,
+                               bgpstream_elem_t **elems, int max);
+
+/** Append the elems that pass the given check to a columnar elem batch
+ *
+ * @param format        pointer to the format object to use
+ * @param record        pointer to the record to use
+ * @param check_cb      callback that returns 1 if an elem should be appended,
+ *                      0 otherwise
+ * @param cols          pointer to the batch to append to
+ * @return 1 if the batch filled up before all of the elems were appended, 0 if
+ * there are no more elems, -1 if an error occurred.
+ */
+int bgpstream_format_get_elem_columns(
+  bgpstream_format_t *format, bgpstream_record_t *record,
+  bgpstream_format_elem_check_cb_t *check_cb, bgpstream_elem_columns_t *cols);
+
 /** Initialize/create the format data in a given record
  *
  * @param record        pointer to the record to init data for
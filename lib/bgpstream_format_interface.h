@@ -51,6 +51,14 @@
   int bs_format_##name##_get_next_elem(bgpstream_format_t *format,             \
                                        bgpstream_record_t *record,             \
                                        bgpstream_elem_t **elem);               \
+  int bs_format_##name##_get_elems(                                            \
+    bgpstream_format_t *format, bgpstream_record_t *record,                    \
+    bgpstream_format_elem_check_cb_t *check_cb, bgpstream_elem_t **elems,      \
+    int max);                                                                  \
+  int bs_format_##name##_get_elem_columns(                                     \
+    bgpstream_format_t *format, bgpstream_record_t *record,                    \
+    bgpstream_format_elem_check_cb_t *check_cb,                                \
+    bgpstream_elem_columns_t *cols);                                           \
   int bs_format_##name##_init_data(bgpstream_format_t *format, void **data);   \
   void bs_format_##name##_clear_data(bgpstream_format_t *format, void *data);  \
   void bs_format_##name##_destroy_data(bgpstream_format_t *format,             \
@@ -61,6 +69,8 @@
   do {                                                                         \
     (format)->populate_record = bs_format_##classname##_populate_record;       \
     (format)->get_next_elem = bs_format_##classname##_get_next_elem;           \
+    (format)->get_elems = bs_format_##classname##_get_elems;                   \
+    (format)->get_elem_columns = bs_format_##classname##_get_elem_columns;     \
     (format)->init_data = bs_format_##classname##_init_data;                   \
     (format)->clear_data = bs_format_##classname##_clear_data;                 \
     (format)->destroy_data = bs_format_##classname##_destroy_data;             \
@@ -101,6 +111,40 @@ struct bgpstream_format {
                        bgpstream_record_t *record,
                        bgpstream_elem_t **elem);
 
+  /** Get a batch of elems from the given record
+   *
+   * @param format        pointer to the format object to use
+   * @param record        pointer to the record to use
+   * @param check_cb      callback used to filter the elems
+   * @param[out] elems    array to fill with borrowed elem pointers
+   * @param max           maximum number of elems to return
+   * @return the number of elems returned, 0 if there are no more elems, -1 if
+   * an error occurred.
+   *
+   * The returned elems are distinct structures, and remain valid until the
+   * next call to this function for the same record, or until the record data
+   * is cleared.
+   */
+  int (*get_elems)(bgpstream_format_t *format, bgpstream_record_t *record,
+                   bgpstream_format_elem_check_cb_t *check_cb,
+                   bgpstream_elem_t **elems, int max);
+
+  /** Append the elems of the given record to a columnar elem batch
+   *
+   * @param format        pointer to the format object to use
+   * @param record        pointer to the record to use
+   * @param check_cb      callback used to filter the elems
+   * @param cols          pointer to the batch to append to
+   * @return 1 if the batch filled up, 0 if there are no more elems, -1 if an
+   * error occurred.
+   *
+   * Only the fields that the columns hold should be decoded.
+   */
+  int (*get_elem_columns)(bgpstream_format_t *format,
+                          bgpstream_record_t *record,
+                          bgpstream_format_elem_check_cb_t *check_cb,
+                          bgpstream_elem_columns_t *cols);
+
   /** Initialize/create the given format-specific record data
    *
    * @param format      pointer to the format object to use
@@ -144,6 +188,17 @@ struct bgpstream_format {
   /** Pointer to the filter manager instance to use to filter records */
   bgpstream_filter_mgr_t *filter_mgr;
 
+  /** Pointer to a shared buffer pool (may be NULL) */
+  bgpstream_buffer_pool_t *buf_pool;
+
+  /** Set if elem path attributes should be decoded when they are accessed */
+  int lazy_elem_attrs;
+
+  /** Scratch space for matching AS path filters (NULL if there are none).
+      Each format instance has its own, so that the filter manager can be
+      shared between readers */
+  bgpstream_aspath_matcher_scratch_t *aspath_scratch;
+
   /** An opaque pointer to format-specific state if needed */
   void *state;
 
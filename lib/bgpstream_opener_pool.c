@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_opener_pool.h"
+#include "bgpstream_log.h"
+#include "bgpstream_resource_heap.h"
+#include "utils.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+typedef enum {
+  TASK_QUEUED = 0,
+  TASK_RUNNING = 1,
+  TASK_DONE = 2,
+  TASK_CANCELLED = 3,
+} task_state_t;
+
+struct bgpstream_opener_task {
+
+  /** Lower values are run first */
+  uint32_t priority;
+
+  /** Submission sequence number (run tasks with equal priority in FIFO
+      order) */
+  uint64_t seq;
+
+  /** Function to run, and its argument */
+  bgpstream_opener_func_t *func;
+  void *user;
+
+  /** Is this an open (as opposed to other work), counted in the stats? */
+  int is_open;
+
+  /** State of the task (must use pool mutex) */
+  task_state_t state;
+
+  /** Time the task was submitted (msec) */
+  uint64_t submit_time;
+};
+
+struct bgpstream_opener_pool {
+
+  /** Worker threads */
+  pthread_t *threads;
+  int threads_cnt;
+
+  /** Queued tasks, ordered by priority */
+  bgpstream_resource_heap_t *queue;
+
+  /** Next submission sequence number */
+  uint64_t seq;
+
+  /** Number of opens waiting to be run (not including cancelled tasks) */
+  int queued_cnt;
+
+  /** Number of opens currently running */
+  int active_cnt;
+
+  /** Has the pool been asked to shut down? */
+  int shutdown;
+
+  /** Open latency statistics */
+  bgpstream_opener_stats_t stats;
+
+  // ALL ABOVE HERE MUST USE MUTEX
+  pthread_mutex_t mutex;
+
+  /** Signalled when a task is queued, or the pool is shut down */
+  pthread_cond_t work_cond;
+
+  /** Signalled when a task completes */
+  pthread_cond_t done_cond;
+};
+
+static int task_cmp(const void *a, const void *b)
+{
+  const bgpstream_opener_task_t *ta = a;
+  const bgpstream_opener_task_t *tb = b;
+
+  if (ta->priority != tb->priority) {
+    return (ta->priority < tb->priority) ? -1 : 1;
+  }
+  if (ta->seq != tb->seq) {
+    return (ta->seq < tb->seq) ? -1 : 1;
+  }
+  return 0;
+}
+
+static void *worker(void *user)
+{
+  bgpstream_opener_pool_t *pool = (bgpstream_opener_pool_t *)user;
+  bgpstream_opener_task_t *task;
+  uint64_t start, elapsed;
+
+  pthread_mutex_lock(&pool->mutex);
+  while (1) {
+    while (pool->shutdown == 0 &&
+           bgpstream_resource_heap_size(pool->queue) == 0) {
+      pthread_cond_wait(&pool->work_cond, &pool->mutex);
+    }
+    if (pool->shutdown != 0) {
+      break;
+    }
+
+    task = bgpstream_resource_heap_pop(pool->queue);
+    if (task->state == TASK_CANCELLED) {
+      // nobody is waiting for this task any more
+      free(task);
+      continue;
+    }
+    assert(task->state == TASK_QUEUED);
+    task->state = TASK_RUNNING;
+
+    if (task->is_open == 0) {
+      pthread_mutex_unlock(&pool->mutex);
+      task->func(task->user);
+      pthread_mutex_lock(&pool->mutex);
+      task->state = TASK_DONE;
+      pthread_cond_broadcast(&pool->done_cond);
+      continue;
+    }
+    pool->queued_cnt--;
+
+    start = epoch_msec();
+    elapsed = (start > task->submit_time) ? start - task->submit_time : 0;
+    pool->stats.queue_wait_total += elapsed;
+    if (elapsed > pool->stats.queue_wait_max) {
+      pool->stats.queue_wait_max = elapsed;
+    }
+    pool->active_cnt++;
+    if (pool->active_cnt > pool->stats.active_max) {
+      pool->stats.active_max = pool->active_cnt;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    task->func(task->user);
+
+    pthread_mutex_lock(&pool->mutex);
+    elapsed = epoch_msec();
+    elapsed = (elapsed > start) ? elapsed - start : 0;
+    pool->stats.open_cnt++;
+    pool->stats.open_time_total += elapsed;
+    if (elapsed > pool->stats.open_time_max) {
+      pool->stats.open_time_max = elapsed;
+    }
+    pool->active_cnt--;
+    task->state = TASK_DONE;
+    pthread_cond_broadcast(&pool->done_cond);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+static bgpstream_opener_task_t *submit(bgpstream_opener_pool_t *pool,
+                                       uint32_t priority,
+                                       bgpstream_opener_func_t *func,
+                                       void *user, int is_open)
+{
+  bgpstream_opener_task_t *task;
+
+  if ((task = malloc_zero(sizeof(bgpstream_opener_task_t))) == NULL) {
+    return NULL;
+  }
+  task->priority = priority;
+  task->func = func;
+  task->user = user;
+  task->is_open = is_open;
+  task->state = TASK_QUEUED;
+  task->submit_time = epoch_msec();
+
+  pthread_mutex_lock(&pool->mutex);
+  task->seq = pool->seq++;
+  if (bgpstream_resource_heap_push(pool->queue, task) != 0) {
+    pthread_mutex_unlock(&pool->mutex);
+    free(task);
+    return NULL;
+  }
+  if (is_open != 0) {
+    pool->queued_cnt++;
+  }
+  pthread_cond_signal(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  return task;
+}
+
+/* ========== PUBLIC FUNCTIONS BELOW ========== */
+
+bgpstream_opener_pool_t *bgpstream_opener_pool_create(int threads)
+{
+  bgpstream_opener_pool_t *pool;
+  int i;
+
+  assert(threads > 0);
+
+  if ((pool = malloc_zero(sizeof(bgpstream_opener_pool_t))) == NULL) {
+    return NULL;
+  }
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->work_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+
+  if ((pool->queue = bgpstream_resource_heap_create(task_cmp)) == NULL ||
+      (pool->threads = malloc_zero(sizeof(pthread_t) * threads)) == NULL) {
+    goto err;
+  }
+
+  for (i = 0; i < threads; i++) {
+    if (pthread_create(&pool->threads[i], NULL, worker, pool) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not start opener thread");
+      goto err;
+    }
+    pool->threads_cnt++;
+  }
+
+  return pool;
+
+ err:
+  bgpstream_opener_pool_destroy(pool);
+  return NULL;
+}
+
+void bgpstream_opener_pool_destroy(bgpstream_opener_pool_t *pool)
+{
+  int i;
+
+  if (pool == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (i = 0; i < pool->threads_cnt; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  free(pool->threads);
+  pool->threads = NULL;
+
+  // anything left in the queue has been cancelled
+  if (pool->queue != NULL) {
+    while (bgpstream_resource_heap_size(pool->queue) != 0) {
+      free(bgpstream_resource_heap_pop(pool->queue));
+    }
+    bgpstream_resource_heap_destroy(pool->queue);
+    pool->queue = NULL;
+  }
+
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_cond_destroy(&pool->done_cond);
+
+  free(pool);
+}
+
+
+bgpstream_opener_task_t *
+bgpstream_opener_pool_submit(bgpstream_opener_pool_t *pool, uint32_t priority,
+                             bgpstream_opener_func_t *func, void *user)
+{
+  return submit(pool, priority, func, user, 1);
+}
+
+bgpstream_opener_task_t *
+bgpstream_opener_pool_submit_work(bgpstream_opener_pool_t *pool,
+                                  uint32_t priority,
+                                  bgpstream_opener_func_t *func, void *user)
+{
+  return submit(pool, priority, func, user, 0);
+}
+
+void bgpstream_opener_pool_cancel(bgpstream_opener_pool_t *pool,
+                                  bgpstream_opener_task_t *task)
+{
+  if (task == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  if (task->state == TASK_QUEUED) {
+    // the worker that pops it will free it
+    task->state = TASK_CANCELLED;
+    if (task->is_open != 0) {
+      pool->queued_cnt--;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return;
+  }
+  while (task->state != TASK_DONE) {
+    pthread_cond_wait(&pool->done_cond, &pool->mutex);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  free(task);
+}
+
+void bgpstream_opener_pool_get_stats(bgpstream_opener_pool_t *pool,
+                                     bgpstream_opener_stats_t *stats)
+{
+  pthread_mutex_lock(&pool->mutex);
+  *stats = pool->stats;
+  stats->queued_cnt = pool->queued_cnt;
+  stats->active_cnt = pool->active_cnt;
+  pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_OPENER_POOL_H
+#define __BGPSTREAM_OPENER_POOL_H
+
+#include "bgpstream.h"
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Bounded pool of threads used to open resources.
+ *
+ * Open requests are queued in priority order (lowest priority value first,
+ * e.g. the initial time of the resource) and run by a fixed number of worker
+ * threads, which bounds the number of resources being opened concurrently.
+ *
+ * Other short pieces of work (e.g. decoding the records of a resource once it
+ * is open) may be run by the same workers, so that they also share the bound.
+ */
+
+/** Opaque pointer representing an opener pool */
+typedef struct bgpstream_opener_pool bgpstream_opener_pool_t;
+
+/** Opaque pointer representing a queued open request */
+typedef struct bgpstream_opener_task bgpstream_opener_task_t;
+
+/** Function run by a worker thread to open a resource */
+typedef void (bgpstream_opener_func_t)(void *user);
+
+/** Create a new opener pool
+ *
+ * @param threads       number of worker threads (i.e. the maximum number of
+ *                      concurrent opens)
+ * @return pointer to the pool if successful, NULL otherwise
+ */
+bgpstream_opener_pool_t *bgpstream_opener_pool_create(int threads);
+
+/** Destroy the given opener pool
+ *
+ * @param pool          pointer to the pool to destroy
+ *
+ * All submitted tasks must have been cancelled (using
+ * bgpstream_opener_pool_cancel) before the pool is destroyed.
+ */
+void bgpstream_opener_pool_destroy(bgpstream_opener_pool_t *pool);
+
+/** Queue a function to be run by one of the worker threads
+ *
+ * @param pool          pointer to the pool
+ * @param priority      tasks with lower values are run first
+ * @param func          function to run
+ * @param user          user pointer to pass to the function
+ * @return pointer to the queued task if successful, NULL otherwise
+ *
+ * The returned task must be released using bgpstream_opener_pool_cancel.
+ */
+bgpstream_opener_task_t *
+bgpstream_opener_pool_submit(bgpstream_opener_pool_t *pool, uint32_t priority,
+                             bgpstream_opener_func_t *func, void *user);
+
+/** Queue a function that is not an open to be run by one of the worker
+ *  threads
+ *
+ * @param pool          pointer to the pool
+ * @param priority      tasks with lower values are run first
+ * @param func          function to run
+ * @param user          user pointer to pass to the function
+ * @return pointer to the queued task if successful, NULL otherwise
+ *
+ * This is the same as bgpstream_opener_pool_submit, except that the task is
+ * not included in the open statistics. The function must not block waiting for
+ * other tasks, since it holds one of the worker threads while it runs.
+ */
+bgpstream_opener_task_t *
+bgpstream_opener_pool_submit_work(bgpstream_opener_pool_t *pool,
+                                  uint32_t priority,
+                                  bgpstream_opener_func_t *func, void *user);
+
+/** Cancel and release the given task
+ *
+ * @param pool          pointer to the pool
+ * @param task          pointer to the task to release
+ *
+ * If the task has not yet started, it will never be run. Otherwise this blocks
+ * until the task has completed.
+ */
+void bgpstream_opener_pool_cancel(bgpstream_opener_pool_t *pool,
+                                  bgpstream_opener_task_t *task);
+
+/** Get open latency statistics for the given pool
+ *
+ * @param pool          pointer to the pool
+ * @param[out] stats    pointer to a stats structure to fill
+ */
+void bgpstream_opener_pool_get_stats(bgpstream_opener_pool_t *pool,
+                                     bgpstream_opener_stats_t *stats);
+
+#endif /* __BGPSTREAM_OPENER_POOL_H */
@@ -38,6 +38,14 @@
 #define PREFETCH_IDX (reader->rec_buf_prefetch_idx)
 #define EXPORTED_IDX ((reader->rec_buf_prefetch_idx + 1) % 2)
 
+// the decode-ahead ring needs room for at least two decoded records (so that
+// we can tell if a record is the last in the dump before exporting it)
+#define DECODE_AHEAD_MIN 2
+
+// number of ring slots that the decoder thread is free to fill
+#define RING_FREE(reader)                                                      \
+  ((reader)->ring_size - (reader)->ring_cnt - (reader)->ring_exported)
+
 
 struct bgpstream_reader {
 
@@ -47,6 +55,15 @@ struct bgpstream_reader {
   // borrowed pointer to a filter manager instance
   bgpstream_filter_mgr_t *filter_mgr;
 
+  // borrowed pointer to a shared parse buffer pool (may be NULL)
+  bgpstream_buffer_pool_t *buf_pool;
+
+  // borrowed pointer to a shared decompression pool (may be NULL)
+  bgpstream_decompress_pool_t *decomp_pool;
+
+  // should the format defer decoding elem path attributes
+  int lazy_elem_attrs;
+
   // internal flip-flop buffers for storing records
   bgpstream_record_t *rec_buf[2];
   int rec_buf_filled[2];
@@ -61,6 +78,12 @@ struct bgpstream_reader {
   // handle for the thread that will do the actual opening
   pthread_t opener_thread;
 
+  // borrowed pointer to the opener pool (if NULL, opener_thread is used)
+  bgpstream_opener_pool_t *opener_pool;
+
+  // open request queued in the opener pool
+  bgpstream_opener_task_t *open_task;
+
   // ALL BELOW HERE MUST USE MUTEX
 
   // format instance
@@ -76,6 +99,47 @@ struct bgpstream_reader {
 
   // what is the time of the next record (PREFETCH)
   uint32_t next_time;
+
+  // number of records to decode ahead of the consumer (0 means records are
+  // decoded synchronously using the flip-flop buffers)
+  int decode_ahead;
+
+  // DECODE-AHEAD STATE (all fields must use mutex)
+
+  // ring of records decoded by the opener thread
+  bgpstream_record_t **ring;
+  int ring_size;
+
+  // index of the next record to export
+  int ring_head;
+
+  // number of decoded records waiting to be exported
+  int ring_cnt;
+
+  // is the consumer holding the record before ring_head?
+  int ring_exported;
+
+  // has the decoder stopped producing records (EOD or error)?
+  int decoder_done;
+
+  // has the reader been asked to shut down?
+  int shutdown;
+
+  // when opened by the pool, decode-ahead runs as steps queued in the pool
+  // (each one decoding until the ring is full) rather than in its own thread,
+  // so that the pool also bounds the number of decoders
+
+  // last decode step queued in the opener pool
+  bgpstream_opener_task_t *decode_task;
+
+  // is a decode step queued or running?
+  int decode_queued;
+
+  // time of the newest decoded record (used to prioritize decode steps)
+  uint32_t decode_time;
+
+  pthread_cond_t ring_data_cond;
+  pthread_cond_t ring_space_cond;
 };
 
 static int prefetch_record(bgpstream_reader_t *reader)
@@ -147,6 +211,114 @@ static int prepopulate_record(bgpstream_record_t *record,
   return 0;
 }
 
+// fills the ring with decoded records until EOD, error, or shutdown. runs in
+// the opener thread once the resource has been opened, waiting for the
+// consumer whenever the ring is full, or, if wait is 0, as a step in the opener
+// pool that returns as soon as the ring is full
+static void decode_ahead(bgpstream_reader_t *reader, int wait)
+{
+  bgpstream_record_t *record;
+  bgpstream_record_t *last;
+  bgpstream_format_status_t status;
+
+  pthread_mutex_lock(&reader->mutex);
+  while (reader->shutdown == 0 && reader->decoder_done == 0) {
+    // wait for the consumer to give us somewhere to decode into
+    if (RING_FREE(reader) == 0) {
+      if (wait == 0) {
+        break;
+      }
+      pthread_cond_wait(&reader->ring_space_cond, &reader->mutex);
+      continue;
+    }
+    record = reader->ring[(reader->ring_head + reader->ring_cnt) %
+                          reader->ring_size];
+    pthread_mutex_unlock(&reader->mutex);
+
+    // the consumer cannot touch a free slot, so decode without the lock
+    bgpstream_record_clear(record);
+    status = bgpstream_format_populate_record(reader->format, record);
+
+    pthread_mutex_lock(&reader->mutex);
+    reader->status = status;
+
+    // same end-of-dump handling as prefetch_record. the consumer never exports
+    // the newest decoded record until its successor has been decoded, so it
+    // is still safe to modify here.
+    if (status == BGPSTREAM_FORMAT_END_OF_DUMP &&
+        record->dump_pos == BGPSTREAM_DUMP_END && reader->ring_cnt > 0) {
+      last = reader->ring[(reader->ring_head + reader->ring_cnt - 1) %
+                          reader->ring_size];
+      last->dump_pos = BGPSTREAM_DUMP_END;
+    }
+
+    if (status != BGPSTREAM_FORMAT_END_OF_DUMP) {
+      reader->ring_cnt++;
+      reader->decode_time = record->time_sec;
+    } else {
+      // used as the "next time" once the ring has drained
+      reader->next_time = record->time_sec;
+    }
+    if (status != BGPSTREAM_FORMAT_OK) {
+      reader->decoder_done = 1;
+    }
+    pthread_cond_signal(&reader->ring_data_cond);
+  }
+  reader->decode_queued = 0;
+  pthread_mutex_unlock(&reader->mutex);
+}
+
+static void pooled_decoder(void *user)
+{
+  decode_ahead((bgpstream_reader_t *)user, 0);
+}
+
+// queue a decode step in the opener pool if the ring has been drained to half
+// (so that a step decodes more than a single record) and no step is pending.
+// must be called with the mutex held
+static void schedule_decode(bgpstream_reader_t *reader)
+{
+  if (reader->opener_pool == NULL || reader->ring == NULL ||
+      reader->decode_queued != 0 || reader->decoder_done != 0 ||
+      reader->shutdown != 0 || reader->ring_cnt > reader->ring_size / 2) {
+    return;
+  }
+
+  // the previous step has already given up the mutex for good, so this only
+  // waits for the worker to mark it done
+  bgpstream_opener_pool_cancel(reader->opener_pool, reader->decode_task);
+
+  if ((reader->decode_task = bgpstream_opener_pool_submit_work(
+         reader->opener_pool, reader->decode_time, pooled_decoder, reader)) ==
+      NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not queue decoding of %s",
+                  reader->res->uri);
+    reader->status = BGPSTREAM_FORMAT_READ_ERROR;
+    reader->decoder_done = 1;
+    pthread_cond_signal(&reader->ring_data_cond);
+    return;
+  }
+  reader->decode_queued = 1;
+}
+
+static int create_ring(bgpstream_reader_t *reader)
+{
+  int i;
+
+  reader->ring_size = reader->decode_ahead + 1; // +1 for the exported record
+  if ((reader->ring = malloc_zero(sizeof(bgpstream_record_t *) *
+                                  reader->ring_size)) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < reader->ring_size; i++) {
+    if ((reader->ring[i] = bgpstream_record_create(reader->format)) == NULL ||
+        prepopulate_record(reader->ring[i], reader->res) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
 static void *threaded_opener(void *user)
 {
   bgpstream_reader_t *reader = (bgpstream_reader_t *)user;
@@ -158,7 +330,9 @@ static void *threaded_opener(void *user)
   /* but try a few times in case there is a transient failure */
   while (retries < DUMP_OPEN_MAX_RETRIES && reader->format == NULL) {
     if ((reader->format =
-           bgpstream_format_create(reader->res, reader->filter_mgr)) == NULL) {
+           bgpstream_format_create(reader->res, reader->filter_mgr,
+                                   reader->buf_pool, reader->decomp_pool,
+                                   reader->lazy_elem_attrs)) == NULL) {
       bgpstream_log(BGPSTREAM_LOG_WARN,
                     "Could not open (%s). Attempt %d of %d",
                     reader->res->uri, retries + 1, DUMP_OPEN_MAX_RETRIES);
@@ -176,6 +350,24 @@ static void *threaded_opener(void *user)
       "Could not open dumpfile (%s) after %d attempts. Giving up.",
       reader->res->uri, DUMP_OPEN_MAX_RETRIES);
     reader->status = BGPSTREAM_FORMAT_CANT_OPEN_DUMP;
+  } else if (reader->decode_ahead != 0) {
+    if (create_ring(reader) != 0) {
+      reader->status = BGPSTREAM_FORMAT_CANT_OPEN_DUMP;
+    } else {
+      // decoding is handed over to the pool, rather than done here, so that
+      // the open statistics only cover the open
+      schedule_decode(reader);
+    }
+    reader->dump_ready = 1;
+    pthread_cond_signal(&reader->dump_ready_cond);
+    pthread_mutex_unlock(&reader->mutex);
+    // the first record is decoded along with the rest, and the consumer will
+    // wait for it in get_next_time
+    if (reader->opener_pool == NULL &&
+        reader->status != BGPSTREAM_FORMAT_CANT_OPEN_DUMP) {
+      decode_ahead(reader, 1);
+    }
+    return NULL;
   } else {
     // create the pair of records
     for (i=0; i<2; i++) {
@@ -200,11 +392,55 @@ static void *threaded_opener(void *user)
   return NULL;
 }
 
+static void pooled_opener(void *user)
+{
+  threaded_opener(user);
+}
+
+// decode-ahead version of get_next_record
+static bgpstream_reader_status_t
+get_next_decoded_record(bgpstream_reader_t *reader,
+                        bgpstream_record_t **record)
+{
+  pthread_mutex_lock(&reader->mutex);
+
+  // give the previously exported record back to the decoder
+  if (reader->ring_exported != 0) {
+    reader->ring_exported = 0;
+    pthread_cond_signal(&reader->ring_space_cond);
+  }
+  schedule_decode(reader);
+
+  // we need to know if the head record is the last one in the dump before
+  // we export it, so wait for its successor too
+  while (reader->ring_cnt < 2 && reader->decoder_done == 0) {
+    pthread_cond_wait(&reader->ring_data_cond, &reader->mutex);
+  }
+
+  if (reader->ring_cnt == 0) {
+    pthread_mutex_unlock(&reader->mutex);
+    return BGPSTREAM_READER_STATUS_EOS;
+  }
+
+  *record = reader->ring[reader->ring_head];
+  reader->ring_head = (reader->ring_head + 1) % reader->ring_size;
+  reader->ring_cnt--;
+  reader->ring_exported = 1;
+
+  pthread_mutex_unlock(&reader->mutex);
+  return BGPSTREAM_READER_STATUS_OK;
+}
+
 /* ========== PUBLIC FUNCTIONS BELOW ========== */
 
 bgpstream_reader_t *
 bgpstream_reader_create(bgpstream_resource_t *resource,
-                        bgpstream_filter_mgr_t *filter_mgr)
+                        bgpstream_filter_mgr_t *filter_mgr,
+                        int decode_ahead,
+                        bgpstream_opener_pool_t *opener_pool,
+                        bgpstream_buffer_pool_t *buf_pool,
+                        bgpstream_decompress_pool_t *decomp_pool,
+                        int lazy_elem_attrs)
 {
   bgpstream_reader_t *reader;
 
@@ -214,23 +450,68 @@ bgpstream_reader_create(bgpstream_resource_t *resource,
 
   reader->res = resource;
   reader->filter_mgr = filter_mgr;
+  reader->opener_pool = opener_pool;
+  reader->buf_pool = buf_pool;
+  reader->decomp_pool = decomp_pool;
+  reader->lazy_elem_attrs = lazy_elem_attrs;
   reader->status = BGPSTREAM_FORMAT_OK;
+  reader->decode_time = resource->initial_time;
+
+  // stream resources never reach EOD, so they are always read synchronously
+  if (decode_ahead > 0 && resource->duration != BGPSTREAM_FOREVER) {
+    reader->decode_ahead =
+      (decode_ahead < DECODE_AHEAD_MIN) ? DECODE_AHEAD_MIN : decode_ahead;
+  }
 
   // initialize and start the thread to open the resource
   // this will also pre-fetch the first record
   pthread_mutex_init(&reader->mutex, NULL);
   pthread_cond_init(&reader->dump_ready_cond, NULL);
+  pthread_cond_init(&reader->ring_data_cond, NULL);
+  pthread_cond_init(&reader->ring_space_cond, NULL);
   reader->dump_ready = 0;
   reader->skip_dump_check = 0;
-  pthread_create(&reader->opener_thread, NULL, threaded_opener, reader);
+  if (opener_pool == NULL) {
+    pthread_create(&reader->opener_thread, NULL, threaded_opener, reader);
+  } else if ((reader->open_task = bgpstream_opener_pool_submit(
+                opener_pool, resource->initial_time, pooled_opener, reader)) ==
+             NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not queue open of %s",
+                  resource->uri);
+    pthread_mutex_destroy(&reader->mutex);
+    pthread_cond_destroy(&reader->dump_ready_cond);
+    pthread_cond_destroy(&reader->ring_data_cond);
+    pthread_cond_destroy(&reader->ring_space_cond);
+    free(reader);
+    return NULL;
+  }
 
   return reader;
 }
 
 uint32_t bgpstream_reader_get_next_time(bgpstream_reader_t *reader)
 {
+  uint32_t next_time;
   assert(bgpstream_reader_open_wait(reader) == 0);
-  return reader->next_time;
+
+  if (reader->decode_ahead == 0) {
+    return reader->next_time;
+  }
+
+  // wait until the record at the head of the ring has been decoded
+  pthread_mutex_lock(&reader->mutex);
+  schedule_decode(reader);
+  while (reader->ring_cnt == 0 && reader->decoder_done == 0) {
+    pthread_cond_wait(&reader->ring_data_cond, &reader->mutex);
+  }
+  if (reader->ring_cnt > 0) {
+    next_time = reader->ring[reader->ring_head]->time_sec;
+  } else {
+    next_time = reader->next_time;
+  }
+  pthread_mutex_unlock(&reader->mutex);
+
+  return next_time;
 }
 
 void bgpstream_reader_destroy(bgpstream_reader_t *reader)
@@ -239,10 +520,27 @@ void bgpstream_reader_destroy(bgpstream_reader_t *reader)
     return;
   }
 
+  // ask a decode-ahead thread to stop
+  pthread_mutex_lock(&reader->mutex);
+  reader->shutdown = 1;
+  pthread_cond_signal(&reader->ring_space_cond);
+  pthread_mutex_unlock(&reader->mutex);
+
   // Ensure the thread is done
-  pthread_join(reader->opener_thread, NULL);
+  if (reader->opener_pool == NULL) {
+    pthread_join(reader->opener_thread, NULL);
+  } else {
+    // drops the open if it has not started yet, otherwise waits for it
+    bgpstream_opener_pool_cancel(reader->opener_pool, reader->open_task);
+    reader->open_task = NULL;
+    // the open has finished, so no more decode steps can be queued
+    bgpstream_opener_pool_cancel(reader->opener_pool, reader->decode_task);
+    reader->decode_task = NULL;
+  }
   pthread_mutex_destroy(&reader->mutex);
   pthread_cond_destroy(&reader->dump_ready_cond);
+  pthread_cond_destroy(&reader->ring_data_cond);
+  pthread_cond_destroy(&reader->ring_space_cond);
 
   int i;
   for (i=0; i<2; i++) {
@@ -250,6 +548,14 @@ void bgpstream_reader_destroy(bgpstream_reader_t *reader)
     reader->rec_buf[i] = NULL;
   }
 
+  if (reader->ring != NULL) {
+    for (i = 0; i < reader->ring_size; i++) {
+      bgpstream_record_destroy(reader->ring[i]);
+    }
+    free(reader->ring);
+    reader->ring = NULL;
+  }
+
   bgpstream_format_destroy(reader->format);
 
   free(reader);
@@ -257,6 +563,8 @@ void bgpstream_reader_destroy(bgpstream_reader_t *reader)
 
 int bgpstream_reader_open_wait(bgpstream_reader_t *reader)
 {
+  int status;
+
   if (reader->skip_dump_check != 0) {
     return 0;
   }
@@ -265,9 +573,11 @@ int bgpstream_reader_open_wait(bgpstream_reader_t *reader)
   while (reader->dump_ready == 0) {
     pthread_cond_wait(&reader->dump_ready_cond, &reader->mutex);
   }
+  // a decode-ahead thread may already be updating the status
+  status = reader->status;
   pthread_mutex_unlock(&reader->mutex);
 
-  if (reader->status == BGPSTREAM_FORMAT_CANT_OPEN_DUMP) {
+  if (status == BGPSTREAM_FORMAT_CANT_OPEN_DUMP) {
     return -1;
   }
 
@@ -275,6 +585,28 @@ int bgpstream_reader_open_wait(bgpstream_reader_t *reader)
   return 0;
 }
 
+int bgpstream_reader_is_ready(bgpstream_reader_t *reader)
+{
+  int ready;
+
+  if (reader->skip_dump_check != 0 && reader->decode_ahead == 0) {
+    // open, and records are decoded on demand
+    return 1;
+  }
+
+  pthread_mutex_lock(&reader->mutex);
+  schedule_decode(reader);
+  ready = reader->dump_ready;
+  if (ready != 0 && reader->decode_ahead != 0 &&
+      reader->status != BGPSTREAM_FORMAT_CANT_OPEN_DUMP) {
+    // same condition that get_next_decoded_record waits for
+    ready = (reader->ring_cnt >= 2 || reader->decoder_done != 0);
+  }
+  pthread_mutex_unlock(&reader->mutex);
+
+  return ready;
+}
+
 int bgpstream_reader_get_next_record(bgpstream_reader_t *reader,
                                      bgpstream_record_t **record)
 {
@@ -290,6 +622,10 @@ int bgpstream_reader_get_next_record(bgpstream_reader_t *reader,
     return BGPSTREAM_READER_STATUS_EOS;
   }
 
+  if (reader->decode_ahead != 0) {
+    return get_next_decoded_record(reader, record);
+  }
+
   // mark the previous record as unfilled (about to become PREFETCH_IDX)
   reader->rec_buf_filled[EXPORTED_IDX] = 0;
   // the record contents will be cleared by the next prefetch
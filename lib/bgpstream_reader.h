@@ -28,7 +28,10 @@
 #define __BGPSTREAM_READER_H
 
 #include "bgpstream_resource.h"
+#include "bgpstream_buffer_pool.h"
+#include "bgpstream_decompress.h"
 #include "bgpstream_filter.h"
+#include "bgpstream_opener_pool.h"
 
 /** Opaque structure representing a reader instance */
 typedef struct bgpstream_reader bgpstream_reader_t;
@@ -50,10 +53,33 @@ typedef enum {
 
 } bgpstream_reader_status_t;
 
-/** Create a new reader for the given resource */
+/** Create a new reader for the given resource
+ *
+ * @param resource      pointer to the resource to read from
+ * @param filter_mgr    pointer to the filter manager to use
+ * @param decode_ahead  number of records to decode ahead of the consumer in
+ *                      the reader's thread (0 to decode synchronously)
+ * @param opener_pool   pointer to the pool to open the resource with (NULL to
+ *                      open it using a new thread)
+ * @param buf_pool      pointer to a shared pool of parse buffers (NULL to use
+ *                      a private buffer)
+ * @param decomp_pool   pointer to a shared pool to decompress the resource
+ *                      with (NULL to decompress serially)
+ * @param lazy_elem_attrs  set to defer decoding elem path attributes until
+ *                         they are accessed
+ * @return pointer to a reader instance if successful, NULL otherwise
+ *
+ * Stream resources (with a duration of BGPSTREAM_FOREVER) are always decoded
+ * synchronously.
+ */
 bgpstream_reader_t *
 bgpstream_reader_create(bgpstream_resource_t *resource,
-                        bgpstream_filter_mgr_t *filter_mgr);
+                        bgpstream_filter_mgr_t *filter_mgr,
+                        int decode_ahead,
+                        bgpstream_opener_pool_t *opener_pool,
+                        bgpstream_buffer_pool_t *buf_pool,
+                        bgpstream_decompress_pool_t *decomp_pool,
+                        int lazy_elem_attrs);
 
 /** Get the time of the next record available in the reader
  *
@@ -68,6 +94,17 @@ int bgpstream_reader_open_wait(bgpstream_reader_t *reader);
 /** Destroy the given reader */
 void bgpstream_reader_destroy(bgpstream_reader_t *reader);
 
+/** Check if the next record can be retrieved without waiting
+ *
+ * @param reader        pointer to the reader instance to check
+ * @return 1 if the reader has opened and (when decoding ahead) has its next
+ * record (or end-of-stream) ready, 0 otherwise
+ *
+ * This never blocks, so it can be used to pick a reader that
+ * bgpstream_reader_get_next_record will not have to wait on.
+ */
+int bgpstream_reader_is_ready(bgpstream_reader_t *reader);
+
 /** Populate the given record with the next data available
  *
  * @param reader        pointer to a reader instance
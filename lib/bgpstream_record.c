@@ -89,56 +89,6 @@ void bgpstream_record_print_mrt_data(bgpstream_record_t *const record)
   //bgpdump_print_entry(record->bd_entry);
 }
 
-static int bgpstream_elem_prefix_match(bgpstream_patricia_tree_t *prefixes,
-                                       bgpstream_pfx_t *search)
-{
-
-  bgpstream_patricia_tree_result_set_t *res = NULL;
-  bgpstream_patricia_node_t *it;
-  int matched = 0;
-
-  /* If this is an exact match, the allowable matches don't matter */
-  if (bgpstream_patricia_tree_search_exact(prefixes, search)) {
-    return 1;
-  }
-
-  bgpstream_patricia_node_t *n =
-    bgpstream_patricia_tree_insert(prefixes, search);
-
-  /* Check for less specific prefixes that have the "MORE" match flag */
-  res = bgpstream_patricia_tree_result_set_create();
-  bgpstream_patricia_tree_get_less_specifics(prefixes, n, res);
-
-  while ((it = bgpstream_patricia_tree_result_set_next(res)) != NULL) {
-    bgpstream_pfx_t *pfx = bgpstream_patricia_tree_get_pfx(it);
-
-    if (pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_ANY ||
-        pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_MORE) {
-      matched = 1;
-      goto endmatch;
-    }
-  }
-
-  bgpstream_patricia_tree_get_more_specifics(prefixes, n, res);
-
-  while ((it = bgpstream_patricia_tree_result_set_next(res)) != NULL) {
-    bgpstream_pfx_t *pfx = bgpstream_patricia_tree_get_pfx(it);
-
-    /* TODO maybe have a way of limiting the amount of bits we are allowed to
-     * go back? or make it specifiable via the language? */
-    if (pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_ANY ||
-        pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_LESS) {
-      matched = 1;
-      goto endmatch;
-    }
-  }
-
-endmatch:
-  bgpstream_patricia_tree_result_set_destroy(&res);
-  bgpstream_patricia_tree_remove_node(prefixes, n);
-  return matched;
-}
-
 static int elem_check_filters(bgpstream_record_t *record,
                               bgpstream_elem_t *elem)
 {
@@ -190,79 +140,69 @@ static int elem_check_filters(bgpstream_record_t *record,
       return 0;
   }
 
-  if (filter_mgr->prefixes) {
+  if (filter_mgr->prefix_index) {
     if (elem->type == BGPSTREAM_ELEM_TYPE_PEERSTATE) {
       return 0;
     }
-    return bgpstream_elem_prefix_match(filter_mgr->prefixes,
-                                       (bgpstream_pfx_t *)&elem->prefix);
+    /* exact matches, or more/less specifics of filter prefixes that allow
+     * them (using the index compiled by bgpstream_filter_mgr_validate) */
+    return bgpstream_pfx_index_lookup_match(filter_mgr->prefix_index,
+                                            (bgpstream_pfx_t *)&elem->prefix);
   }
 
-  /* Checking AS Path expressions */
+  /* Checking AS Path expressions (compiled by bgpstream_filter_mgr_validate) */
   if (filter_mgr->aspath_exprs) {
     char aspath[65536];
-    char *regexstr;
+    bgpstream_as_path_t *as_path;
+    bgpstream_aspath_expr_t *expr;
     int pathlen;
-    regex_t re;
     int result;
-    int negatives = 0;
     int positives = 0;
-    int totalpositives = 0;
+    int i;
 
     if (elem->type == BGPSTREAM_ELEM_TYPE_WITHDRAWAL ||
         elem->type == BGPSTREAM_ELEM_TYPE_PEERSTATE) {
       return 0;
     }
 
-    pathlen = bgpstream_as_path_get_filterable(aspath, 65535, elem->as_path);
-
-    if (pathlen == 65535) {
-      bgpstream_log(BGPSTREAM_LOG_WARN,
-                    "AS Path is too long? Filter may not work well.");
+    if ((as_path = bgpstream_elem_get_as_path(elem)) == NULL ||
+        bgpstream_as_path_get_len(as_path) == 0) {
+      return 0;
     }
 
-    if (pathlen == 0) {
+    /* most expressions are matched directly against the path segments */
+    if ((positives = bgpstream_aspath_matcher_match(
+           filter_mgr->aspath_matcher, record->__int->format->aspath_scratch,
+           as_path)) < 0) {
+      /* a negative match rules the elem out */
       return 0;
     }
 
-    bgpstream_str_set_rewind(filter_mgr->aspath_exprs);
-    while ((regexstr = bgpstream_str_set_next(filter_mgr->aspath_exprs)) !=
-           NULL) {
-      int negate = 0;
-
-      if (strlen(regexstr) == 0)
-        continue;
-
-      if (*regexstr == '!') {
-        negate = 1;
-        regexstr++;
-      } else {
-        totalpositives += 1;
-      }
+    /* the rest are regexes that need the path as a string */
+    if (filter_mgr->aspath_res_cnt > 0) {
+      pathlen = bgpstream_as_path_get_filterable(aspath, 65535, as_path);
 
-      if (regcomp(&re, regexstr, 0) < 0) {
-        /* XXX should really use regerror here for proper error reporting */
-        bgpstream_log(BGPSTREAM_LOG_ERR, "Failed to compile AS path regex");
-        break;
+      if (pathlen == 65535) {
+        bgpstream_log(BGPSTREAM_LOG_WARN,
+                      "AS Path is too long? Filter may not work well.");
       }
+    }
 
-      result = regexec(&re, aspath, 0, NULL, 0);
+    for (i = 0; i < filter_mgr->aspath_res_cnt; i++) {
+      expr = &filter_mgr->aspath_res[i];
+      result = regexec(&expr->re, aspath, 0, NULL, 0);
       if (result == 0) {
-        if (!negate) {
-          positives++;
-        }
-        if (negate) {
-          negatives++;
+        if (expr->negate) {
+          /* a negative match rules the elem out */
+          return 0;
         }
-      }
-
-      regfree(&re);
-      if (result != REG_NOMATCH && result != 0) {
+        positives++;
+      } else if (result != REG_NOMATCH) {
         bgpstream_log(BGPSTREAM_LOG_ERR, "Error while matching AS path regex");
         break;
       }
     }
-    if (positives == totalpositives && negatives == 0) {
+    if (positives == filter_mgr->aspath_positive_cnt) {
       return 1;
     } else {
       return 0;
@@ -277,13 +217,18 @@ static int elem_check_filters(bgpstream_record_t *record,
     }
 
     bgpstream_community_t *c;
+    bgpstream_community_set_t *communities;
     khiter_t k;
+
+    if ((communities = bgpstream_elem_get_communities(elem)) == NULL) {
+      return 0;
+    }
     for (k = kh_begin(filter_mgr->communities);
          k != kh_end(filter_mgr->communities); ++k) {
       if (kh_exist(filter_mgr->communities, k)) {
         c = &(kh_key(filter_mgr->communities, k));
         if (bgpstream_community_set_match(
-              elem->communities, c, kh_value(filter_mgr->communities, k))) {
+              communities, c, kh_value(filter_mgr->communities, k))) {
           pass = 1;
           break;
         }
@@ -316,7 +261,9 @@ int bgpstream_record_get_next_elem(bgpstream_record_t *record,
       return rc;
     }
 
-    // TODO: push elem filtering down into the formats
+    // the formats already skip elems whose type or prefix is filtered out
+    // (before decoding their path attributes), but the full set of filters
+    // is still checked here
     if (elem_check_filters(record, elem) == 0) {
       elem = NULL;
     }
@@ -326,6 +273,30 @@ int bgpstream_record_get_next_elem(bgpstream_record_t *record,
   return 1;
 }
 
+int bgpstream_record_get_elems(bgpstream_record_t *record,
+                               bgpstream_elem_t **elems, int max)
+{
+  if (record == NULL || record->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD ||
+      record->__int->format == NULL || max <= 0) {
+    return 0; // treat as end-of-elems
+  }
+
+  return bgpstream_format_get_elems(record->__int->format, record,
+                                    elem_check_filters, elems, max);
+}
+
+int bgpstream_record_get_elem_columns(bgpstream_record_t *record,
+                                      bgpstream_elem_columns_t *cols)
+{
+  if (record == NULL || record->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD ||
+      record->__int->format == NULL) {
+    return 0; // treat as end-of-elems
+  }
+
+  return bgpstream_format_get_elem_columns(record->__int->format, record,
+                                           elem_check_filters, cols);
+}
+
 int bgpstream_record_type_snprintf(char *buf, size_t len,
                                    bgpstream_record_type_t type)
 {
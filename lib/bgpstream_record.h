@@ -28,6 +28,7 @@
 #define __BGPSTREAM_RECORD_H
 
 #include "bgpstream_elem.h"
+#include "bgpstream_elem_columns.h"
 #include "bgpstream_utils.h"
 
 /** @file
@@ -241,6 +242,49 @@ typedef struct bgpstream_record {
 int bgpstream_record_get_next_elem(bgpstream_record_t *record,
                                    bgpstream_elem_t **elem);
 
+/** Retrieve a batch of elems from the record
+ *
+ * @param record        pointer to the BGP Stream Record to retrieve the elems
+ *                      from
+ * @param[out] elems    array to fill with borrowed elem pointers
+ * @param max           size of the elems array
+ * @return the number of elems written to the array, 0 if there are no more
+ * elems, -1 if an error occurred
+ *
+ * This returns the same elems as calling bgpstream_record_get_next_elem up to
+ * `max` times, but with the per-elem call overhead paid once per batch, which
+ * helps for large TABLE_DUMP_V2 records and for language bindings. Unlike the
+ * elem returned by bgpstream_record_get_next_elem, each elem in the batch is a
+ * distinct structure.
+ *
+ * The returned pointers are valid until the next call to this function for
+ * the same record, or until the record is re-used in a subsequent call to
+ * bgpstream_get_next_record or destroyed with bgpstream_record_destroy.
+ */
+int bgpstream_record_get_elems(bgpstream_record_t *record,
+                               bgpstream_elem_t **elems, int max);
+
+/** Append the elems of the record to a columnar elem batch
+ *
+ * @param record        pointer to the BGP Stream Record to retrieve the elems
+ *                      from
+ * @param cols          pointer to the batch to append the elems to
+ * @return 1 if the batch filled up before all of the elems were appended, 0 if
+ * all of the (remaining) elems of the record were appended, -1 if an error
+ * occurred
+ *
+ * Elems are written straight into the columns as they are extracted, without
+ * being copied into a bgpstream_elem_t of their own. Only the fields that the
+ * columns (and the elem filters) use are decoded, so, e.g., the communities of
+ * the elems are skipped. If the batch fills up, the caller can empty it (see
+ * bgpstream_elem_columns_clear) and call this function again to continue with
+ * the remaining elems of the record. Elems
+ * already retrieved with bgpstream_record_get_next_elem or
+ * bgpstream_record_get_elems are not appended again.
+ */
+int bgpstream_record_get_elem_columns(bgpstream_record_t *record,
+                                      bgpstream_elem_columns_t *cols);
+
 /** Dump the given record to stdout in bgpdump format
  *
  * @param record        pointer to a BGP Stream Record instance to dump
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_resource_heap.h"
+#include "utils.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/** Initial number of item slots allocated */
+#define HEAP_INIT_SIZE 64
+
+struct bgpstream_resource_heap {
+
+  /** Array of items, laid out as an implicit binary tree */
+  void **items;
+
+  /** Number of items in the heap */
+  int cnt;
+
+  /** Number of slots allocated in the items array */
+  int alloc_cnt;
+
+  /** Function used to order items */
+  bgpstream_resource_heap_cmp_t *cmp;
+};
+
+static void sift_up(bgpstream_resource_heap_t *heap, int idx)
+{
+  void *item = heap->items[idx];
+  int parent;
+
+  while (idx > 0) {
+    parent = (idx - 1) / 2;
+    if (heap->cmp(item, heap->items[parent]) >= 0) {
+      break;
+    }
+    heap->items[idx] = heap->items[parent];
+    idx = parent;
+  }
+  heap->items[idx] = item;
+}
+
+static void sift_down(bgpstream_resource_heap_t *heap, int idx)
+{
+  void *item = heap->items[idx];
+  int child;
+
+  while ((child = (2 * idx) + 1) < heap->cnt) {
+    // pick the smaller of the two children
+    if (child + 1 < heap->cnt &&
+        heap->cmp(heap->items[child + 1], heap->items[child]) < 0) {
+      child++;
+    }
+    if (heap->cmp(heap->items[child], item) >= 0) {
+      break;
+    }
+    heap->items[idx] = heap->items[child];
+    idx = child;
+  }
+  heap->items[idx] = item;
+}
+
+/* ========== PUBLIC METHODS BELOW HERE ========== */
+
+bgpstream_resource_heap_t *
+bgpstream_resource_heap_create(bgpstream_resource_heap_cmp_t *cmp)
+{
+  bgpstream_resource_heap_t *heap;
+
+  assert(cmp != NULL);
+
+  if ((heap = malloc_zero(sizeof(bgpstream_resource_heap_t))) == NULL) {
+    return NULL;
+  }
+
+  if ((heap->items = malloc(sizeof(void *) * HEAP_INIT_SIZE)) == NULL) {
+    free(heap);
+    return NULL;
+  }
+  heap->alloc_cnt = HEAP_INIT_SIZE;
+  heap->cmp = cmp;
+
+  return heap;
+}
+
+void
+bgpstream_resource_heap_destroy(bgpstream_resource_heap_t *heap)
+{
+  if (heap == NULL) {
+    return;
+  }
+  free(heap->items);
+  heap->items = NULL;
+  free(heap);
+}
+
+int
+bgpstream_resource_heap_push(bgpstream_resource_heap_t *heap, void *item)
+{
+  void **tmp;
+
+  if (heap->cnt == heap->alloc_cnt) {
+    if ((tmp = realloc(heap->items,
+                       sizeof(void *) * heap->alloc_cnt * 2)) == NULL) {
+      return -1;
+    }
+    heap->items = tmp;
+    heap->alloc_cnt *= 2;
+  }
+
+  heap->items[heap->cnt] = item;
+  heap->cnt++;
+  sift_up(heap, heap->cnt - 1);
+
+  return 0;
+}
+
+void *
+bgpstream_resource_heap_top(bgpstream_resource_heap_t *heap)
+{
+  return (heap->cnt == 0) ? NULL : heap->items[0];
+}
+
+void *
+bgpstream_resource_heap_pop(bgpstream_resource_heap_t *heap)
+{
+  void *top;
+
+  if (heap->cnt == 0) {
+    return NULL;
+  }
+
+  top = heap->items[0];
+  heap->cnt--;
+  if (heap->cnt > 0) {
+    heap->items[0] = heap->items[heap->cnt];
+    sift_down(heap, 0);
+  }
+
+  return top;
+}
+
+void
+bgpstream_resource_heap_update_top(bgpstream_resource_heap_t *heap)
+{
+  // the top has no parent, so it can only need to move down
+  if (heap->cnt > 1) {
+    sift_down(heap, 0);
+  }
+}
+
+int
+bgpstream_resource_heap_size(bgpstream_resource_heap_t *heap)
+{
+  return heap->cnt;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_RESOURCE_HEAP_H
+#define __BGPSTREAM_RESOURCE_HEAP_H
+
+/** @file
+ *
+ * @brief Binary min-heap used by the resource manager to merge open resources
+ * by the time of their next record.
+ *
+ * The heap stores borrowed pointers to caller-owned items and orders them
+ * using a caller-provided comparison function. The comparison function should
+ * only look at keys cached in the items (e.g. a reader's next time), since it
+ * is called O(log n) times for every heap operation.
+ */
+
+/** Opaque pointer representing a resource heap */
+typedef struct bgpstream_resource_heap bgpstream_resource_heap_t;
+
+/** Comparison function used to order heap items
+ *
+ * @return <0 if a should be popped before b, >0 if b should be popped before
+ * a, 0 if they are equivalent
+ */
+typedef int (bgpstream_resource_heap_cmp_t)(const void *a, const void *b);
+
+/** Create a new heap
+ *
+ * @param cmp           function used to order items
+ * @return pointer to the heap if successful, NULL otherwise
+ */
+bgpstream_resource_heap_t *
+bgpstream_resource_heap_create(bgpstream_resource_heap_cmp_t *cmp);
+
+/** Destroy the given heap
+ *
+ * @param heap          pointer to the heap to destroy
+ *
+ * Items still in the heap are not freed.
+ */
+void
+bgpstream_resource_heap_destroy(bgpstream_resource_heap_t *heap);
+
+/** Insert an item into the heap
+ *
+ * @param heap          pointer to the heap
+ * @param item          borrowed pointer to the item to insert
+ * @return 0 if the item was inserted successfully, -1 otherwise
+ */
+int
+bgpstream_resource_heap_push(bgpstream_resource_heap_t *heap, void *item);
+
+/** Get the item at the top of the heap without removing it
+ *
+ * @param heap          pointer to the heap
+ * @return borrowed pointer to the smallest item, NULL if the heap is empty
+ */
+void *
+bgpstream_resource_heap_top(bgpstream_resource_heap_t *heap);
+
+/** Remove the item at the top of the heap
+ *
+ * @param heap          pointer to the heap
+ * @return borrowed pointer to the removed item, NULL if the heap is empty
+ */
+void *
+bgpstream_resource_heap_pop(bgpstream_resource_heap_t *heap);
+
+/** Restore the heap order after the key of the top item has changed
+ *
+ * @param heap          pointer to the heap
+ *
+ * This is equivalent to popping the top item and pushing it back, but only
+ * walks down the heap once.
+ */
+void
+bgpstream_resource_heap_update_top(bgpstream_resource_heap_t *heap);
+
+/** Get the number of items in the heap
+ *
+ * @param heap          pointer to the heap
+ * @return the number of items in the heap
+ */
+int
+bgpstream_resource_heap_size(bgpstream_resource_heap_t *heap);
+
+#endif /* __BGPSTREAM_RESOURCE_HEAP_H */
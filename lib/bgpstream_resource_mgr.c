@@ -28,6 +28,7 @@
 #include "bgpstream_filter.h"
 #include "bgpstream_log.h"
 #include "bgpstream_reader.h"
+#include "bgpstream_resource_heap.h"
 #include "config.h"
 #include "utils.h"
 #include <assert.h>
@@ -45,64 +46,57 @@
 #define AGAIN_POLL_INTERVAL 500
 #define MSEC_TO_NSEC 1000000
 
-struct res_list_elem {
+/** Maximum number of resources that are open at once in unordered mode */
+#define UNORDERED_OPEN_MAX 32
+
+/** Number of records each reader decodes ahead in unordered mode (unless a
+    larger value has been set) */
+#define UNORDERED_DECODE_AHEAD 8
+
+struct res_elem {
   /** The resource info */
   bgpstream_resource_t *res;
 
   /** Pointer to a reader instance if the resource is "open" */
   bgpstream_reader_t *reader;
 
-  /** Is the reader open? (i.e. have we waited for it to open) */
-  int open;
-
   /** Time when this resource should next be polled (if 0 then poll
       immediately) */
   uint32_t next_poll;
 
-  /** Previous list elem */
-  struct res_list_elem *prev;
-
-  /** Next list elem */
-  struct res_list_elem *next;
-};
+  /** Cached time of the next record in this resource. Until the resource is
+      open this is our best guess (the initial time) */
+  uint32_t next_time;
 
-struct res_group {
-  /** The common "intial_time" of these resources */
-  uint32_t time;
-
-  /** The start time for overlap calculations (`time` for updates,
-      `time-duration` for RIBs) */
+  /** The start time for overlap calculations (`initial_time` for updates,
+      `initial_time-duration` for RIBs) */
   uint32_t overlap_start;
-  /** The end time for overlap calculations */
-  uint32_t overlap_end;
-
-  /** List of RIBs/updates at this timestamp
-      (use BGPSTREAM_UPDATE / BGPSTREAM_RIB to index */
-  struct res_list_elem *res_list[_BGPSTREAM_RECORD_TYPE_CNT];
 
-  /** Total number of resources in this group */
-  int res_cnt;
+  /** Insertion sequence number, used to break ties between resources with the
+      same next time and type (so that they are read round-robin) */
+  uint64_t seq;
 
-  /** The number of open resources in this group */
-  int res_open_cnt;
-
-  /** The number of open resources that have been checked and re-sorted */
-  int res_open_checked_cnt;
-
-  /** Previous group (newer timestamp) */
-  struct res_group *prev;
-
-  /** Next group (older timestamp) */
-  struct res_group *next;
+  /** Next elem in the batch that is currently being opened */
+  struct res_elem *batch_next;
 };
 
 struct bgpstream_resource_mgr {
 
-  /** Ordered queue of resources, grouped by timestamp (i.e. group by second).
-   * The oldest timestamp is at the head, newest at the tail */
-  struct res_group *head;
+  /** Resources that have not yet been opened, ordered by overlap start
+      time */
+  bgpstream_resource_heap_t *pending;
+
+  /** Open resources, ordered by the time of their next record, with RIBs
+   * before updates. We always read from the top of this heap */
+  bgpstream_resource_heap_t *open;
 
-  struct res_group *tail;
+  /** The latest end time (initial_time+duration) of any resource opened so
+   * far. Pending resources that start before this time overlap with an open
+   * resource and are opened in the same batch */
+  uint32_t batch_end;
+
+  /** Next insertion sequence number */
+  uint64_t seq;
 
   // the number of resources in the queue
   int res_cnt;
@@ -113,558 +107,266 @@ struct bgpstream_resource_mgr {
   // borrowed pointer to a filter manager instance
   bgpstream_filter_mgr_t *filter_mgr;
 
-};
-
-static int open_batch(bgpstream_resource_mgr_t *q, struct res_group *gp);
-
-static void res_list_destroy(struct res_list_elem *l, int destroy_resource) {
-  if (l == NULL) {
-    return;
-  }
-  struct res_list_elem *cur = l;
-  struct res_list_elem *tmp = NULL;
-
-  while (cur != NULL) {
-    tmp = cur;
-    cur = tmp->next; // move on
-    tmp->prev = NULL;
-    tmp->next = NULL;
-    if (destroy_resource != 0) {
-      bgpstream_reader_destroy(tmp->reader);
-      tmp->open = 0;
-      bgpstream_resource_destroy(tmp->res);
-    }
-    tmp->res = NULL;
-    free(tmp);
-  }
-}
+  // number of records each reader should decode ahead (0 = synchronous)
+  int decode_ahead;
 
-static struct res_list_elem *res_list_elem_create(bgpstream_resource_t *res)
-{
-  struct res_list_elem *el;
+  // number of threads in the opener pool (0 = one thread per reader)
+  int opener_threads;
 
-  if ((el = malloc_zero(sizeof(struct res_list_elem))) == NULL) {
-    return NULL;
-  }
+  // pool of threads used to open resources (created on first use)
+  bgpstream_opener_pool_t *opener_pool;
 
-  el->res = res;
+  // memory budget for parse buffers (0 = private buffer per reader)
+  size_t buffer_budget;
 
-  // its up the caller to connect it to something...
-
-  return el;
-}
-
-static int open_res_list(bgpstream_resource_mgr_t *q,
-                         struct res_group *gp,
-                         struct res_list_elem *el)
-{
-  while (el != NULL) {
-    assert(el->res != NULL);
-    // it is possible that this is already open (because of re-sorting)
-    if (el->reader != NULL) {
-      el = el->next;
-      continue;
-    }
-    // open this resource
-    if ((el->reader =
-         bgpstream_reader_create(el->res, q->filter_mgr)) == NULL) {
-      bgpstream_log(BGPSTREAM_LOG_ERR,
-                    "Failed to open resource: %s", el->res->uri);
-      return -1;
-    }
-    // update stats
-    q->res_open_cnt++;
-    gp->res_open_cnt++;
-    el = el->next;
-  }
+  // pool of parse buffers shared by all readers (created on first use)
+  bgpstream_buffer_pool_t *buf_pool;
 
-  return 0;
-}
+  // number of threads in the decompression pool (0 = decompress serially)
+  int decompress_threads;
 
-static int open_group(bgpstream_resource_mgr_t *q, struct res_group *gp)
-{
-  // do nothing if everything is open
-  if (gp->res_open_cnt == gp->res_cnt) {
-    return 0;
-  }
+  // pool of threads used to decompress files (created on first use)
+  bgpstream_decompress_pool_t *decomp_pool;
 
-  // first open RIBs
-  if (open_res_list(q, gp, gp->res_list[BGPSTREAM_RIB]) != 0) {
-    return -1;
-  }
+  // should readers defer decoding elem path attributes
+  int lazy_elem_attrs;
 
-  // then open updates
-  if (open_res_list(q, gp, gp->res_list[BGPSTREAM_UPDATE]) != 0) {
-    return -1;
-  }
+  // are records returned as soon as any resource has one ready, rather than
+  // in time order?
+  int unordered;
 
-  return 0;
-}
+  // open resources in unordered mode (the open heap is not used)
+  struct res_elem *unordered_open[UNORDERED_OPEN_MAX];
+  int unordered_open_cnt;
 
-static void res_group_destroy(struct res_group *g, int destroy_resource) {
-  if (g == NULL) {
-    return;
-  }
-  g->prev = NULL;
-  g->next = NULL;
-  int i;
-  for (i=0; i<_BGPSTREAM_RECORD_TYPE_CNT; i++) {
-    res_list_destroy(g->res_list[i], destroy_resource);
-    g->res_list[i] = NULL;
-  }
-  free(g);
-}
+  // index of the next resource to read from in unordered mode
+  int unordered_next;
 
-static uint32_t get_next_time(struct res_list_elem *el)
-{
-  if (el->reader != NULL) {
-    return bgpstream_reader_get_next_time(el->reader);
-  } else {
-    // our best guess
-    //
-    // this will be 0 for most stream resources, which will force them into the
-    // first group, we will then open the resource, and then re-sort
-    return el->res->initial_time;
-  }
-}
+};
 
-static void update_overlap(struct res_group *gp, struct res_list_elem *el)
+static void res_elem_destroy(struct res_elem *el)
 {
-  // if this is a "stream", the duration is 0 (BGPSTREAM_FOREVER), and so will
-  // not affect other items in the group
-
-  // is this a RIB, and is this our first RIB in the group, and are we safe to
-  // subtract without wrapping overlap_start?
-  if (el->res->record_type == BGPSTREAM_RIB &&
-      gp->res_list[BGPSTREAM_RIB] == NULL &&
-      gp->overlap_start > el->res->duration) {
-    // need to fudge the time because RIBs can start early
-    gp->overlap_start -= el->res->duration;
-  }
-
-  // update the max duration?
-  // if this is a new group, overlap_end will be 0, so this will always be true,
-  // except when dealing with a stream (then it will be left as 0)
-  if ((gp->time + el->res->duration) > gp->overlap_end) {
-    gp->overlap_end = gp->time + el->res->duration;
+  if (el == NULL) {
+    return;
   }
+  bgpstream_reader_destroy(el->reader);
+  el->reader = NULL;
+  bgpstream_resource_destroy(el->res);
+  el->res = NULL;
+  free(el);
 }
 
-static struct res_group *res_group_create(struct res_list_elem *el)
+static struct res_elem *res_elem_create(bgpstream_resource_t *res)
 {
-  struct res_group *gp;
-  assert(el->res != NULL);
+  struct res_elem *el;
 
-  if ((gp = malloc_zero(sizeof(struct res_group))) == NULL) {
+  if ((el = malloc_zero(sizeof(struct res_elem))) == NULL) {
     return NULL;
   }
 
-  gp->time = gp->overlap_start = get_next_time(el);
-  // set the overlap start and end times
-  update_overlap(gp, el);
+  el->res = res;
 
-  gp->res_list[el->res->record_type] = el;
-  el->next = NULL; el->prev = NULL;
-  gp->res_cnt = 1;
+  // this will be 0 for most stream resources, which will force them to be
+  // opened first, at which point we will know their real next time
+  el->next_time = el->overlap_start = res->initial_time;
 
-  if (el->reader != NULL) {
-    gp->res_open_cnt++;
-    if (el->open != 0) {
-      gp->res_open_checked_cnt++;
-    }
-  } else {
-    assert(el->open == 0);
+  // are we safe to subtract without wrapping overlap_start?
+  if (res->record_type == BGPSTREAM_RIB &&
+      el->overlap_start > res->duration) {
+    // need to fudge the time because RIBs can start early
+    el->overlap_start -= res->duration;
   }
 
-  return gp;
+  // its up the caller to insert it into a heap...
+
+  return el;
 }
 
-static int res_group_add(bgpstream_resource_mgr_t *q,
-                         struct res_group *gp,
-                         struct res_list_elem *el)
+/* order by next time, then RIBs before updates, then insertion order */
+static int res_elem_cmp(const struct res_elem *a, const struct res_elem *b)
 {
-  int is_dirty = 0;
-
-  assert(gp->time == get_next_time(el));
-
-  // potentially extend the overlap window based on this new element
-  update_overlap(gp, el);
-
-  // add to the appropriate list
-  if (gp->res_list[el->res->record_type] == NULL) {
-    gp->res_list[el->res->record_type] = el;
-  } else {
-    gp->res_list[el->res->record_type]->prev = el;
-    el->next = gp->res_list[el->res->record_type];
-    gp->res_list[el->res->record_type] = el;
+  if (a->next_time != b->next_time) {
+    return (a->next_time < b->next_time) ? -1 : 1;
   }
-
-  gp->res_cnt++;
-
-  if (el->reader != NULL) {
-    gp->res_open_cnt++;
-    // if we have just opened the first file in the group, then open the rest
-    if (gp->res_cnt > gp->res_open_cnt) {
-      is_dirty = 1;
-    }
-    if (el->open != 0) {
-      gp->res_open_checked_cnt++;
-    }
-  } else {
-    assert(el->open == 0);
+  if (a->res->record_type != b->res->record_type) {
+    return (a->res->record_type == BGPSTREAM_RIB) ? -1 : 1;
   }
-
-  return is_dirty;
-}
-
-#if 0
-static void list_dump(struct res_list_elem *el)
-{
-  while (el != NULL) {
-    fprintf(stderr, "    next_time: %d\n",
-                  get_next_time(el));
-    fprintf(stderr, "    res->uri: %s\n",
-                  el->res->uri);
-    fprintf(stderr, "    %s\n",
-                  (el->reader == NULL) ? "not-open" : "open");
-    el = el->next;
+  if (a->seq != b->seq) {
+    return (a->seq < b->seq) ? -1 : 1;
   }
+  return 0;
 }
 
-static void queue_dump(struct res_group *head)
+static int open_cmp(const void *a, const void *b)
 {
-  while (head != NULL) {
-    fprintf(stderr,
-            "res_group: time: %d, overlap_start: %d, "
-            "overlap_end: %d, "
-            "cnt: %d, open_cnt: %d, open_checked_cnt: %d\n",
-            head->time, head->overlap_start, head->overlap_end,
-            head->res_cnt, head->res_open_cnt, head->res_open_checked_cnt);
-
-    int i;
-    for (i=0; i<_BGPSTREAM_RECORD_TYPE_CNT; i++) {
-      fprintf(stderr, "  records (type %d):\n", i);
-      list_dump(head->res_list[i]);
-    }
-
-    head = head->next;
-  }
-  fprintf(stderr, "\n");
+  return res_elem_cmp(a, b);
 }
-#endif
 
-/** Insert a result into the queue from either end
- *
- * FROMEND = {head, tail};
- * TOEND = {tail, head};
- * CMP = {<, >};
- * TODIR = {next, prev};
- * FROMDIR = {prev, next};
- */
-#define QUEUE_PUSH(el, FROMEND, TOEND, CMPOP, TODIR, FROMDIR)                  \
-  do {                                                                         \
-    cur = q->FROMEND;                                                          \
-    last = NULL;                                                               \
-    while (cur != NULL && cur->time CMPOP get_next_time(el)) {                 \
-      last = cur;                                                              \
-      cur = cur->TODIR;                                                        \
-    }                                                                          \
-    if (cur != NULL && cur->time == get_next_time(el)) {                       \
-      /* just add to the current group */                                      \
-      if ((is_dirty = res_group_add(q, cur, el)) < 0) {                        \
-        goto err;                                                              \
-      }                                                                        \
-      dirty_cnt += is_dirty;                                                   \
-    } else {                                                                   \
-      /* we first need to create a new group */                                \
-      if ((gp = res_group_create(el)) == NULL) {                               \
-        goto err;                                                              \
-      }                                                                        \
-      gp->TODIR = cur;                                                         \
-      gp->FROMDIR = last;                                                      \
-      if (cur == NULL) {                                                       \
-        /* creating a new TOEND */                                             \
-        assert(last == q->TOEND);                                              \
-        last->TODIR = gp;                                                      \
-        q->TOEND = gp;                                                         \
-      } else if (last == NULL) {                                               \
-        /* creating a new FROMEND */                                           \
-        assert(q->FROMEND == cur);                                             \
-        cur->FROMDIR = gp;                                                     \
-        q->FROMEND = gp;                                                       \
-      } else {                                                                 \
-        /* splicing into the list */                                           \
-        cur->FROMDIR = gp;                                                     \
-        last->TODIR = gp;                                                      \
-      }                                                                        \
-    }                                                                          \
-  } while (0)
-
-static int insert_resource_elem(bgpstream_resource_mgr_t *q,
-                                struct res_list_elem *el)
+static int pending_cmp(const void *a, const void *b)
 {
-  struct res_group *gp = NULL, *cur = NULL, *last = NULL;
-  int dirty_cnt = 0, is_dirty = 0;
+  const struct res_elem *ea = a;
+  const struct res_elem *eb = b;
 
-  // is the list empty?
-  if (q->head == NULL) {
-    assert(q->tail == NULL);
-
-    // create a new res group
-    if ((gp = res_group_create(el)) == NULL) {
-      return -1;
-    }
-
-    // and make it the head/tail
-    q->head = q->tail = gp;
-  } else {
-    // by here head AND tail are guaranteed to be set
-    assert(q->head != NULL && q->tail != NULL);
-
-    // which end of the list is this record closer to?
-    // can probably be optimized somewhat, lists are not my specialty...
-    if (abs((int)get_next_time(el) - (int)q->head->time) <
-        abs((int)get_next_time(el) - (int)q->tail->time)) {
-      // closer to the head of the list
-      QUEUE_PUSH(el, head, tail, <, next, prev);
-    } else {
-      // equidistant, or closer to the tail
-      QUEUE_PUSH(el, tail, head, >, prev, next);
-    }
+  if (ea->overlap_start != eb->overlap_start) {
+    return (ea->overlap_start < eb->overlap_start) ? -1 : 1;
   }
-
-  // count the resource
-  q->res_cnt++;
-  if (el->reader != NULL) {
-    q->res_open_cnt++;
-  }
-
-  // we're done!
-  return dirty_cnt;
-
- err:
-  res_group_destroy(gp, 1);
-  return -1;
+  return res_elem_cmp(ea, eb);
 }
 
-static void pop_res_el(bgpstream_resource_mgr_t *q,
-                       struct res_group *gp,
-                       struct res_list_elem *el)
+/* should the given pending resource be opened before we read anything else
+   from the open resources? */
+static int needs_open(bgpstream_resource_mgr_t *q, struct res_elem *el)
 {
-  // disconnect from the list
-  if (el->next != NULL) {
-    el->next->prev = el->prev;
-  }
-  if (el->prev != NULL) {
-    el->prev->next = el->next;
-  }
+  struct res_elem *top;
 
-  // maybe update the group head
-  if (gp->res_list[el->res->record_type] == el) {
-    gp->res_list[el->res->record_type] = el->next;
-  }
-
-  // update group and queue stats
-  gp->res_cnt--;
-  q->res_cnt--;
-  if (el->open != 0) {
-    gp->res_open_cnt--;
-    gp->res_open_checked_cnt--;
-    q->res_open_cnt--;
+  // it overlaps with something that we have already opened
+  if (el->overlap_start < q->batch_end) {
+    return 1;
   }
-  assert(gp->res_cnt >= 0);
-  assert(gp->res_open_cnt >= 0);
-  assert(gp->res_open_checked_cnt >= 0);
-  assert(q->res_cnt >= 0);
-  assert(q->res_open_cnt >= 0);
-  assert(gp->res_open_checked_cnt <= gp->res_open_cnt);
-  assert(gp->res_open_cnt >= gp->res_cnt);
-  assert(gp->res_cnt <= q->res_cnt);
-  assert(gp->res_open_cnt <= q->res_open_cnt);
 
-  el->prev = NULL;
-  el->next = NULL;
+  // it may contain records that belong before the next open record. since the
+  // pending heap is ordered by overlap start, if the top is not needed, then
+  // nothing else in the pending heap is either.
+  top = bgpstream_resource_heap_top(q->open);
+  return (top != NULL && el->overlap_start <= top->next_time);
 }
 
-static void reap_groups(bgpstream_resource_mgr_t *q)
+static void destroy_batch(bgpstream_resource_mgr_t *q, struct res_elem *batch)
 {
-  struct res_group *gp = q->head;
-  struct res_group *nxt;
-
-  while (gp != NULL) {
-    nxt = gp->next;
+  struct res_elem *el;
 
-    if (gp->res_cnt == 0) {
-      if (gp->next != NULL) {
-        gp->next->prev = gp->prev;
-      }
-      if (gp->prev != NULL) {
-        gp->prev->next = gp->next;
-      }
-
-      if (q->head == gp) {
-        q->head = gp->next;
-      }
-      if (q->tail == gp) {
-        q->tail = gp->prev;
-      }
-
-      // and destroy the group
-      gp->prev = NULL;
-      gp->next = NULL;
-      res_group_destroy(gp, 0);
-    }
-
-    gp = nxt;
+  while (batch != NULL) {
+    el = batch;
+    batch = el->batch_next;
+    res_elem_destroy(el);
+    q->res_cnt--;
+    q->res_open_cnt--;
   }
 }
 
-static int sort_res_list(bgpstream_resource_mgr_t *q,
-                         struct res_group *gp,
-                         struct res_list_elem *el)
+// create the pools shared by the readers (if they are wanted)
+static int create_pools(bgpstream_resource_mgr_t *q)
 {
-  struct res_list_elem *el_nxt;
-  int dirty_cnt = 0;
-
-  while (el != NULL) {
-    el_nxt = el->next;
-    if (el->open != 0 || el->reader == NULL) {
-      el = el_nxt;
-      continue;
-    }
-
-    if (bgpstream_reader_open_wait(el->reader) != 0) {
-      return -1;
-    }
-    el->open = 1;
-    gp->res_open_checked_cnt++;
-    if (get_next_time(el) != el->res->initial_time) {
-      // this needs to be popped and then re-inserted
-      pop_res_el(q, gp, el);
-      if ((dirty_cnt = insert_resource_elem(q, el)) < 0) {
-        return -1;
-      }
-    }
-    el = el_nxt;
+  if (q->opener_threads > 0 && q->opener_pool == NULL &&
+      (q->opener_pool = bgpstream_opener_pool_create(q->opener_threads)) ==
+        NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create opener pool");
+    return -1;
   }
 
-  return dirty_cnt;
-}
-
-static int sort_group(bgpstream_resource_mgr_t *q,
-                      struct res_group *gp)
-{
-  int dirty_up = 0, dirty_rib = 0;
-
-  // wait for updates
-  if ((dirty_up = sort_res_list(q, gp, gp->res_list[BGPSTREAM_UPDATE])) < 0) {
+  if (q->buffer_budget > 0 && q->buf_pool == NULL &&
+      (q->buf_pool = bgpstream_buffer_pool_create(q->buffer_budget)) ==
+        NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create buffer pool");
     return -1;
   }
 
-  // wait for ribs
-  if ((dirty_rib = sort_res_list(q, gp, gp->res_list[BGPSTREAM_RIB])) < 0) {
+  if (q->decompress_threads > 0 && q->decomp_pool == NULL &&
+      (q->decomp_pool =
+         bgpstream_decompress_pool_create(q->decompress_threads)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create decompression pool");
     return -1;
   }
 
-  return dirty_up + dirty_rib;
+  return 0;
 }
 
-/* returns the number of "dirty" groups. i.e. the number of groups that were not
-   open but now have an open resource added (since this will require another
-   call to open_batch) */
-static int sort_batch(bgpstream_resource_mgr_t *q)
+// open all pending resources that overlap with the open resources, then wait
+// for them to open and add them to the open heap. returns the number of
+// resources opened, or -1 if an error occurred.
+static int open_batch(bgpstream_resource_mgr_t *q)
 {
-  struct res_group *cur = q->head;
-  int empty_groups = 0;
-  int dirty_cnt_total = 0, dirty_cnt = 0;
+  struct res_elem *el;
+  struct res_elem *batch = NULL, *batch_tail = NULL;
+  int batch_cnt = 0;
 
-  // wait for the batch to open first
-  while (cur != NULL && cur->res_open_cnt != 0) {
+  if (create_pools(q) != 0) {
+    return -1;
+  }
 
-    if (cur->res_open_checked_cnt == cur->res_open_cnt) {
-      cur = cur->next;
-      continue;
+  // first, start opening everything in the batch so that the readers can open
+  // in parallel
+  while ((el = bgpstream_resource_heap_top(q->pending)) != NULL) {
+    // if nothing is open, the first pending resource starts a new batch
+    if ((batch != NULL || bgpstream_resource_heap_size(q->open) != 0) &&
+        needs_open(q, el) == 0) {
+      break;
     }
-
-    if ((dirty_cnt = sort_group(q, cur)) < 0) {
-      return -1;
+    bgpstream_resource_heap_pop(q->pending);
+
+    if ((el->reader = bgpstream_reader_create(el->res, q->filter_mgr,
+                                              q->decode_ahead,
+                                              q->opener_pool,
+                                              q->buf_pool,
+                                              q->decomp_pool,
+                                              q->lazy_elem_attrs)) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR,
+                    "Failed to open resource: %s", el->res->uri);
+      res_elem_destroy(el);
+      q->res_cnt--;
+      goto err;
     }
-    dirty_cnt_total += dirty_cnt;
+    q->res_open_cnt++;
+    batch_cnt++;
 
-    if (cur->res_cnt == 0) {
-      empty_groups++;
+    // update our overlap calculation. if this is a "stream", the duration is 0
+    // (BGPSTREAM_FOREVER), and so will not extend the batch
+    if ((el->res->initial_time + el->res->duration) > q->batch_end) {
+      q->batch_end = el->res->initial_time + el->res->duration;
     }
 
-    cur = cur->next;
-  }
-
-  // now reap any empty groups that our sorting has created
-  if (empty_groups != 0) {
-    reap_groups(q);
+    if (batch == NULL) {
+      batch = el;
+    } else {
+      batch_tail->batch_next = el;
+    }
+    batch_tail = el;
   }
 
-  return dirty_cnt_total;
-}
-
-// open all overlapping resources. does not modify the queue
-static int open_batch(bgpstream_resource_mgr_t *q, struct res_group *gp)
-{
-  // start from the head of the queue and open resources until we
-  // find a group that does not overlap with the previous ones
-  struct res_group *cur = gp;
-  int first = 1;
-  uint32_t last_overlap_end = 0;
-
-  while (cur != NULL &&
-         (first != 0 || last_overlap_end > cur->overlap_start)) {
-    // this is included in the batch
-
-    if (open_group(q, cur) != 0) {
-      return -1;
+  // its possible that the timestamp of the first record in a dump file doesn't
+  // match the initial time reported to us from the broker (e.g., in the case
+  // of filtering), so we wait for each resource to open and then insert it
+  // using its real next time
+  while (batch != NULL) {
+    el = batch;
+    if (bgpstream_reader_open_wait(el->reader) != 0) {
+      goto err;
     }
-
-    // update our overlap calculation
-    if (first != 0 || cur->overlap_end > last_overlap_end) {
-      first = 0;
-      last_overlap_end = cur->overlap_end;
+    el->next_time = bgpstream_reader_get_next_time(el->reader);
+    el->seq = q->seq++;
+    if (bgpstream_resource_heap_push(q->open, el) != 0) {
+      goto err;
     }
-
-    cur = cur->next;
+    batch = el->batch_next;
+    el->batch_next = NULL;
   }
 
-  return 0;
+  return batch_cnt;
+
+ err:
+  destroy_batch(q, batch);
+  return -1;
 }
 
-// when this is called we are guaranteed to have at least one open resource, and
-// if things have gone right, we should read from the first resource in the
-// queue. once we have read from the resource, we should check the new time of
-// the resource and see if it needs to be moved.
+// when this is called we are guaranteed to have at least one open resource,
+// and we should read from the top of the open heap. once we have read from the
+// resource, we check the new time of the resource and move it if needed.
 static bgpstream_reader_status_t pop_record(bgpstream_resource_mgr_t *q,
                                             bgpstream_record_t **record)
 {
   uint32_t prev_time;
   bgpstream_reader_status_t rs;
-  struct res_list_elem *el = NULL;
-  struct res_list_elem *tmp_el = NULL;
-  struct res_group *gp = NULL;
+  struct res_elem *el = NULL;
   uint32_t now;
   uint64_t sleep_nsec;
   struct timespec rqtp;
 
-  // the resource we want to read from MUST be in the first group (q->head), and
-  // will either be the head of the RIBS list if there are any ribs, otherwise
-  // it will be the head of the updates list
-  if (q->head->res_list[BGPSTREAM_RIB] != NULL) {
-    el = q->head->res_list[BGPSTREAM_RIB];
-  } else {
-    el = q->head->res_list[BGPSTREAM_UPDATE];
-  }
-  assert(el != NULL && el->res != NULL);
-  assert(el->open != 0);
+  el = bgpstream_resource_heap_top(q->open);
+  assert(el != NULL && el->res != NULL && el->reader != NULL);
 
   // we assume that if this resource has a poll timer set that has not expired
-  // then since it would have been pushed to the end of the group and as such
-  // all other resources already polled.
+  // then since it would have been moved behind all other resources with the
+  // same key, all other resources have already been polled.
   if (el->next_poll > 0) {
     now = epoch_msec();
     if (el->next_poll > now) {
@@ -679,8 +381,8 @@ static bgpstream_reader_status_t pop_record(bgpstream_resource_mgr_t *q,
     el->next_poll = 0;
   }
 
-  // cache the current time so we can check if we need to remove and re-insert
-  prev_time = get_next_time(el);
+  // cache the current time so we can check if we need to move the resource
+  prev_time = el->next_time;
 
   // ask the resource to give us the next record (that it has already read). it
   // will internally grab the next record from the resource and update the time
@@ -692,20 +394,12 @@ static bgpstream_reader_status_t pop_record(bgpstream_resource_mgr_t *q,
     return rs;
   }
 
-  // if we got AGAIN, then move ourselves to the end of our group to give others
-  // a fair shake
+  // if we got AGAIN, then move ourselves behind the other resources with the
+  // same key to give others a fair shake
   if (rs == BGPSTREAM_READER_STATUS_AGAIN) {
-    assert(el->prev == NULL);
-    if (el->next != NULL) {
-      tmp_el = el;
-      while (tmp_el->next != NULL) {
-        tmp_el = tmp_el->next;
-      }
-      assert(el != tmp_el);
-      el->next = NULL;
-      tmp_el->next = el;
-      el->prev = tmp_el;
-    }
+    el->next_time = bgpstream_reader_get_next_time(el->reader);
+    el->seq = q->seq++;
+    bgpstream_resource_heap_update_top(q->open);
     // and then tell the caller that while we didn't get anything useful, they
     // should try again soon
     el->next_poll = epoch_msec() + AGAIN_POLL_INTERVAL;
@@ -715,39 +409,153 @@ static bgpstream_reader_status_t pop_record(bgpstream_resource_mgr_t *q,
   // otherwise we must valid, or EOS
   assert(rs == BGPSTREAM_READER_STATUS_EOS || rs == BGPSTREAM_READER_STATUS_OK);
 
-  // if the time has changed or we've reached EOS, pop from the queue
-  if (get_next_time(el) != prev_time || rs == BGPSTREAM_READER_STATUS_EOS) {
-    // first, remove this list elem from the group
-    pop_res_el(q, q->head, el);
-
-    // if we have emptied the group, remove the group
-    if (q->head->res_cnt == 0) {
-      gp = q->head;
-      q->head = gp->next;
-      if (q->head != NULL) {
-        q->head->prev = NULL;
+  if (rs == BGPSTREAM_READER_STATUS_EOS) {
+    // we're at EOS, so remove and destroy the resource
+    bgpstream_resource_heap_pop(q->open);
+    res_elem_destroy(el);
+    q->res_cnt--;
+    q->res_open_cnt--;
+    assert(q->res_cnt >= 0);
+    assert(q->res_open_cnt >= 0);
+  } else if ((el->next_time = bgpstream_reader_get_next_time(el->reader)) !=
+             prev_time) {
+    // time has changed, so we need to move it
+    el->seq = q->seq++;
+    bgpstream_resource_heap_update_top(q->open);
+  }
+
+  // all is well
+  return rs;
+}
+
+// start opening pending resources (in time order) until the maximum number of
+// resources are open. unlike open_batch, this does not wait for them to open.
+static int open_unordered(bgpstream_resource_mgr_t *q)
+{
+  struct res_elem *el;
+  int decode_ahead = (q->decode_ahead > UNORDERED_DECODE_AHEAD)
+                       ? q->decode_ahead
+                       : UNORDERED_DECODE_AHEAD;
+
+  if (create_pools(q) != 0) {
+    return -1;
+  }
+
+  while (q->unordered_open_cnt < UNORDERED_OPEN_MAX &&
+         (el = bgpstream_resource_heap_pop(q->pending)) != NULL) {
+    // every reader decodes ahead (in its own thread, or in the opener pool),
+    // so that resources are decoded in parallel while we read from whichever
+    // is ready
+    if ((el->reader = bgpstream_reader_create(el->res, q->filter_mgr,
+                                              decode_ahead,
+                                              q->opener_pool,
+                                              q->buf_pool,
+                                              q->decomp_pool,
+                                              q->lazy_elem_attrs)) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR,
+                    "Failed to open resource: %s", el->res->uri);
+      res_elem_destroy(el);
+      q->res_cnt--;
+      return -1;
+    }
+    q->res_open_cnt++;
+    q->unordered_open[q->unordered_open_cnt++] = el;
+  }
+
+  return 0;
+}
+
+// destroy the given open resource (in unordered mode)
+static void close_unordered(bgpstream_resource_mgr_t *q, int idx)
+{
+  res_elem_destroy(q->unordered_open[idx]);
+  // order does not matter, so fill the gap with the last resource
+  q->unordered_open[idx] = q->unordered_open[--q->unordered_open_cnt];
+  q->unordered_open[q->unordered_open_cnt] = NULL;
+  q->res_cnt--;
+  q->res_open_cnt--;
+  assert(q->res_cnt >= 0);
+  assert(q->res_open_cnt >= 0);
+}
+
+// unordered version of pop_record. reads from the open resources in turn,
+// skipping any that are still opening or decoding. only if none of them have a
+// record ready do we block on one.
+static bgpstream_reader_status_t
+pop_record_unordered(bgpstream_resource_mgr_t *q, bgpstream_record_t **record)
+{
+  bgpstream_reader_status_t rs;
+  struct res_elem *el;
+  int idx = -1;
+  int blocking_idx = -1;
+  int polling_idx = -1;
+  uint32_t now = 0;
+  uint64_t sleep_nsec;
+  struct timespec rqtp;
+  int i;
+
+  assert(q->unordered_open_cnt > 0);
+
+  for (i = 0; i < q->unordered_open_cnt; i++) {
+    el = q->unordered_open[(q->unordered_next + i) % q->unordered_open_cnt];
+
+    // skip stream resources that are waiting to be polled again
+    if (el->next_poll > 0) {
+      if (now == 0) {
+        now = epoch_msec();
       }
-      if (q->tail == gp) {
-        q->tail = q->head;
+      if (el->next_poll > now) {
+        if (polling_idx == -1 ||
+            el->next_poll < q->unordered_open[polling_idx]->next_poll) {
+          polling_idx = (q->unordered_next + i) % q->unordered_open_cnt;
+        }
+        continue;
       }
+      el->next_poll = 0;
+    }
 
-      // and then destroy the group
-      gp->next = NULL;
-      res_group_destroy(gp, 0);
+    if (blocking_idx == -1) {
+      blocking_idx = (q->unordered_next + i) % q->unordered_open_cnt;
     }
+    if (bgpstream_reader_is_ready(el->reader) != 0) {
+      idx = (q->unordered_next + i) % q->unordered_open_cnt;
+      break;
+    }
+  }
 
-    if (rs == BGPSTREAM_READER_STATUS_EOS) {
-      // we're at EOS, so destroy the resource
-      res_list_destroy(el, 1);
-    } else if (get_next_time(el) != prev_time) {
-      // time has changed, so we need to re-insert
-      if (insert_resource_elem(q, el) < 0) {
-        return -1;
-      }
+  if (idx == -1 && blocking_idx != -1) {
+    // nothing is ready, so wait for the next resource in turn
+    idx = blocking_idx;
+  } else if (idx == -1) {
+    // everything is waiting to be polled, so sleep until the first one is due
+    idx = polling_idx;
+    el = q->unordered_open[idx];
+    sleep_nsec = (el->next_poll - now) * MSEC_TO_NSEC;
+    rqtp.tv_sec = sleep_nsec / 1000000000;
+    rqtp.tv_nsec = sleep_nsec % 1000000000;
+    if (nanosleep(&rqtp, NULL) != 0) {
+      // interrupted
+      return -1;
     }
+    el->next_poll = 0;
+  }
+  el = q->unordered_open[idx];
+  q->unordered_next = idx + 1;
+
+  if ((rs = bgpstream_reader_get_next_record(el->reader, record)) ==
+      BGPSTREAM_READER_STATUS_ERROR) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Failed to get next record from reader");
+    return rs;
+  }
+
+  if (rs == BGPSTREAM_READER_STATUS_AGAIN) {
+    el->next_poll = epoch_msec() + AGAIN_POLL_INTERVAL;
+  } else if (rs == BGPSTREAM_READER_STATUS_EOS) {
+    close_unordered(q, idx);
+    // the last resource has been moved into this slot, so read it next
+    q->unordered_next = idx;
   }
 
-  // all is well
   return rs;
 }
 
@@ -796,9 +604,18 @@ bgpstream_resource_mgr_create(bgpstream_filter_mgr_t *filter_mgr)
     return NULL;
   }
 
+  if ((q->pending = bgpstream_resource_heap_create(pending_cmp)) == NULL ||
+      (q->open = bgpstream_resource_heap_create(open_cmp)) == NULL) {
+    goto err;
+  }
+
   q->filter_mgr = filter_mgr;
 
   return q;
+
+ err:
+  bgpstream_resource_mgr_destroy(q);
+  return NULL;
 }
 
 void
@@ -807,14 +624,33 @@ bgpstream_resource_mgr_destroy(bgpstream_resource_mgr_t *q)
   if (q == NULL) {
     return;
   }
-  struct res_group *cur = q->head;
+  if (q->pending != NULL) {
+    while (bgpstream_resource_heap_size(q->pending) != 0) {
+      res_elem_destroy(bgpstream_resource_heap_pop(q->pending));
+    }
+    bgpstream_resource_heap_destroy(q->pending);
+    q->pending = NULL;
+  }
 
-  while (cur != NULL) {
-    q->head = cur->next;
-    res_group_destroy(cur, 1);
-    cur = q->head;
+  if (q->open != NULL) {
+    while (bgpstream_resource_heap_size(q->open) != 0) {
+      res_elem_destroy(bgpstream_resource_heap_pop(q->open));
+    }
+    bgpstream_resource_heap_destroy(q->open);
+    q->open = NULL;
   }
-  q->tail = NULL;
+
+  while (q->unordered_open_cnt > 0) {
+    res_elem_destroy(q->unordered_open[--q->unordered_open_cnt]);
+  }
+
+  // all readers have been destroyed, so nothing is using the pools
+  bgpstream_opener_pool_destroy(q->opener_pool);
+  q->opener_pool = NULL;
+  bgpstream_buffer_pool_destroy(q->buf_pool);
+  q->buf_pool = NULL;
+  bgpstream_decompress_pool_destroy(q->decomp_pool);
+  q->decomp_pool = NULL;
 
   // filter manager is a borrowed pointer
   q->filter_mgr = NULL;
@@ -834,7 +670,7 @@ bgpstream_resource_mgr_push(bgpstream_resource_mgr_t *q,
                             bgpstream_resource_t **resp)
 {
   bgpstream_resource_t *res = NULL;
-  struct res_list_elem *el = NULL;
+  struct res_elem *el = NULL;
   if (resp != NULL) {
     *resp = NULL;
   }
@@ -853,33 +689,87 @@ bgpstream_resource_mgr_push(bgpstream_resource_mgr_t *q,
     return 0;
   }
 
-  // now create a list element to hold the resource
-  if ((el = res_list_elem_create(res)) == NULL) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create list element");
-    goto err;
+  // now create a heap element to hold the resource
+  if ((el = res_elem_create(res)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create heap element");
+    bgpstream_resource_destroy(res);
+    return -1;
   }
 
   // now we know we want to keep it
-  if (insert_resource_elem(q, el) < 0) {
+  el->seq = q->seq++;
+  if (bgpstream_resource_heap_push(q->pending, el) != 0) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "Could not insert resource into queue");
-    goto err;
+    res_elem_destroy(el);
+    return -1;
   }
+  q->res_cnt++;
 
   if (resp != NULL) {
     *resp = res;
   }
   return 1;
+}
 
- err:
-  res_list_destroy(el, 1);
-  bgpstream_resource_destroy(res);
-  return -1;
+void
+bgpstream_resource_mgr_set_decode_ahead(bgpstream_resource_mgr_t *q,
+                                        int queue_len)
+{
+  q->decode_ahead = (queue_len > 0) ? queue_len : 0;
+}
+
+void
+bgpstream_resource_mgr_set_opener_threads(bgpstream_resource_mgr_t *q,
+                                          int threads)
+{
+  assert(q->opener_pool == NULL);
+  q->opener_threads = (threads > 0) ? threads : 0;
+}
+
+void
+bgpstream_resource_mgr_set_buffer_budget(bgpstream_resource_mgr_t *q,
+                                         size_t budget)
+{
+  assert(q->buf_pool == NULL);
+  q->buffer_budget = budget;
+}
+
+void
+bgpstream_resource_mgr_set_decompress_threads(bgpstream_resource_mgr_t *q,
+                                              int threads)
+{
+  assert(q->decomp_pool == NULL);
+  q->decompress_threads = (threads > 0) ? threads : 0;
+}
+
+void
+bgpstream_resource_mgr_set_lazy_elem_attrs(bgpstream_resource_mgr_t *q)
+{
+  q->lazy_elem_attrs = 1;
+}
+
+void
+bgpstream_resource_mgr_set_unordered(bgpstream_resource_mgr_t *q)
+{
+  assert(q->res_open_cnt == 0);
+  q->unordered = 1;
+}
+
+void
+bgpstream_resource_mgr_get_opener_stats(bgpstream_resource_mgr_t *q,
+                                        bgpstream_opener_stats_t *stats)
+{
+  if (q->opener_pool == NULL) {
+    memset(stats, 0, sizeof(bgpstream_opener_stats_t));
+    return;
+  }
+  bgpstream_opener_pool_get_stats(q->opener_pool, stats);
 }
 
 int
 bgpstream_resource_mgr_empty(bgpstream_resource_mgr_t *q)
 {
-  return (q->head == NULL);
+  return (q->res_cnt == 0);
 }
 
 int
@@ -887,7 +777,7 @@ bgpstream_resource_mgr_get_record(bgpstream_resource_mgr_t *q,
                                   bgpstream_record_t **record)
 {
   int rs = BGPSTREAM_READER_STATUS_EOS;
-  int dirty_cnt = 0;
+  int opened = 0;
 
   // don't let EOF mean EOS until we have no more resources left
   while (rs == BGPSTREAM_READER_STATUS_EOS ||
@@ -897,22 +787,31 @@ bgpstream_resource_mgr_get_record(bgpstream_resource_mgr_t *q,
       return 0;
     }
 
-    // we know we have something in the queue, but if we have nothing open, then
-    // it is time to open some resources!
-    // we do this inside a loop since in some cases the first batch we open get
-    // sorted elsewhere in the queue, leaving the head still unopened.
-    dirty_cnt = 0;
-    while (q->head->res_open_cnt != q->head->res_cnt || dirty_cnt > 0) {
-      if (open_batch(q, q->head) != 0) {
+    if (q->unordered != 0) {
+      // no need to look for resources with earlier records, just keep as many
+      // resources open as we can and read from whichever is ready
+      if (open_unordered(q) != 0) {
         goto err;
       }
-      // its possible that the timestamp of the first record in a dump file doesn't
-      // match the initial time reported to us from the broker (e.g., in the
-      // case of filtering), so we re-sort the batch before we read anything
-      // from it.
-      if ((dirty_cnt = sort_batch(q)) < 0) {
-        goto err;
+      if ((rs = pop_record_unordered(q, record)) ==
+          BGPSTREAM_READER_STATUS_ERROR) {
+        return -1;
+      } else if (rs == BGPSTREAM_READER_STATUS_OK) {
+        return 1;
       }
+      continue;
+    }
+
+    // we know we have something in the queue, but before we read from the
+    // open resources we need to open any pending resources that might contain
+    // earlier records. we do this inside a loop since the resources we open
+    // may turn out to start earlier than the data interface told us, which
+    // can pull in more resources.
+    while ((opened = open_batch(q)) > 0) {
+      // keep opening
+    }
+    if (opened < 0) {
+      goto err;
     }
     // its possible that we failed to open all the files, perhaps in that case
     // we shouldn't abort, but instead return EOS and let the caller decide what
@@ -32,7 +32,9 @@
 #include "bgpstream_transport.h"
 #include "bgpstream_format.h"
 #include "bgpstream_resource.h"
+#include "bgpstream_buffer_pool.h"
 #include "bgpstream_filter.h"
+#include "bgpstream_opener_pool.h"
 
 /** Opaque pointer representing a resource manager */
 typedef struct bgpstream_resource_mgr bgpstream_resource_mgr_t;
@@ -72,6 +74,85 @@ bgpstream_resource_mgr_push(bgpstream_resource_mgr_t *q,
                             bgpstream_record_type_t record_type,
                             bgpstream_resource_t **res);
 
+/** Set the number of records that readers should decode ahead
+ *
+ * @param q             pointer to the queue
+ * @param queue_len     number of records to decode ahead of the consumer for
+ *                      each open resource (0 to decode synchronously)
+ *
+ * Only affects resources that are opened after this call.
+ */
+void
+bgpstream_resource_mgr_set_decode_ahead(bgpstream_resource_mgr_t *q,
+                                        int queue_len);
+
+/** Set the number of threads used to open resources
+ *
+ * @param q             pointer to the queue
+ * @param threads       number of opener threads (0 to use one thread per
+ *                      resource)
+ *
+ * The opener pool is created when the first resource is opened, so this must
+ * be called before reading any records.
+ */
+void
+bgpstream_resource_mgr_set_opener_threads(bgpstream_resource_mgr_t *q,
+                                          int threads);
+
+/** Set a memory budget for the parse buffers of open resources
+ *
+ * @param q             pointer to the queue
+ * @param budget        maximum number of bytes of full-size parse buffers to
+ *                      hand out (0 to give each resource a private buffer)
+ *
+ * The buffer pool is created when the first resource is opened, so this must
+ * be called before reading any records.
+ */
+void
+bgpstream_resource_mgr_set_buffer_budget(bgpstream_resource_mgr_t *q,
+                                         size_t budget);
+
+/** Set the number of threads used to decompress bzip2 (and BGZF) files
+ *
+ * @param q             pointer to the queue
+ * @param threads       number of decompression threads (0 to decompress each
+ *                      file serially)
+ *
+ * The decompression pool is created when the first resource is opened, so
+ * this must be called before reading any records.
+ */
+void
+bgpstream_resource_mgr_set_decompress_threads(bgpstream_resource_mgr_t *q,
+                                              int threads);
+
+/** Defer decoding elem path attributes until they are accessed
+ *
+ * @param q             pointer to the queue
+ *
+ * Only affects resources that are opened after this call.
+ */
+void
+bgpstream_resource_mgr_set_lazy_elem_attrs(bgpstream_resource_mgr_t *q);
+
+/** Return records from whichever open resource has one ready, rather than in
+ * time order
+ *
+ * @param q             pointer to the queue
+ *
+ * Must be called before any resources are opened.
+ */
+void
+bgpstream_resource_mgr_set_unordered(bgpstream_resource_mgr_t *q);
+
+/** Get statistics about the resources opened by the opener thread pool
+ *
+ * @param q             pointer to the queue
+ * @param[out] stats    pointer to a stats structure to fill
+ */
+void
+bgpstream_resource_mgr_get_opener_stats(bgpstream_resource_mgr_t *q,
+                                        bgpstream_opener_stats_t *stats);
+
 /** Check if the resource manager queue contains any resources
  *
  * @param q             pointer to the queue
@@ -63,7 +63,9 @@ static const transport_create_func_t create_functions[] = {
 
 };
 
-bgpstream_transport_t *bgpstream_transport_create(bgpstream_resource_t *res)
+bgpstream_transport_t *
+bgpstream_transport_create(bgpstream_resource_t *res,
+                           bgpstream_decompress_pool_t *decomp_pool)
 {
   bgpstream_transport_t *transport = NULL;
 
@@ -90,6 +92,7 @@ bgpstream_transport_t *bgpstream_transport_create(bgpstream_resource_t *res)
 
   // store a pointer to the resource
   transport->res = res;
+  transport->decomp_pool = decomp_pool;
 
   if (create_functions[res->transport_type](transport) != 0) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open resource (%s)", res->uri);
@@ -109,6 +112,13 @@ int64_t bgpstream_transport_read(bgpstream_transport_t *transport,
   return transport->read(transport, buffer, len);
 }
 
+const uint8_t *bgpstream_transport_get_mapped(bgpstream_transport_t *transport,
+                                              size_t *len)
+{
+  *len = transport->mapped_len;
+  return transport->mapped_data;
+}
+
 void bgpstream_transport_destroy(bgpstream_transport_t *transport)
 {
   if (transport == NULL) {
@@ -32,6 +32,7 @@
 #ifndef __BGPSTREAM_TRANSPORT_H
 #define __BGPSTREAM_TRANSPORT_H
 
+#include "bgpstream_decompress.h"
 #include "bgpstream_resource.h"
 
 
@@ -42,10 +43,13 @@ typedef struct bgpstream_transport bgpstream_transport_t;
 /** Create a transport handler for the given resource
  *
  * @param res           pointer to a resource
+ * @param decomp_pool   pointer to a pool to decompress data with (NULL to
+ *                      decompress serially)
  * @return pointer to a transport module instance if successful, NULL otherwise
  */
 bgpstream_transport_t *
-bgpstream_transport_create(bgpstream_resource_t *res);
+bgpstream_transport_create(bgpstream_resource_t *res,
+                           bgpstream_decompress_pool_t *decomp_pool);
 
 /** Read from the given transport handler
  *
@@ -55,6 +59,20 @@ bgpstream_transport_create(bgpstream_resource_t *res);
 int64_t bgpstream_transport_read(bgpstream_transport_t *transport,
                                  void *buffer, int64_t len);
 
+/** Get the in-memory content of the given transport handler, if any
+ *
+ * @param transport     pointer to a transport handler
+ * @param[out] len      set to the length of the content
+ * @return pointer to the entire content of the resource if the transport has
+ * it mapped into memory, NULL otherwise
+ *
+ * If content is returned, it may be parsed in place rather than read using
+ * bgpstream_transport_read. The content is valid until the transport is
+ * destroyed.
+ */
+const uint8_t *bgpstream_transport_get_mapped(bgpstream_transport_t *transport,
+                                              size_t *len);
+
 /** Shutdown and destroy the given transport handler
  *
  * @param transport     pointer to a transport handler to destroy
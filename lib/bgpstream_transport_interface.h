@@ -95,9 +95,21 @@ struct bgpstream_transport {
   /** Pointer to the resource the transport is reading from */
   bgpstream_resource_t *res;
 
+  /** Borrowed pointer to a pool that compressed files may be decompressed
+      with in parallel (may be NULL) */
+  bgpstream_decompress_pool_t *decomp_pool;
+
   /** An opaque pointer to transport-specific state if needed by the
       transport */
   void *state;
+
+  /** If set, the entire (uncompressed) content of the resource is mapped into
+      memory here, and may be parsed in place instead of being copied out
+      using the read method (which must still be supported) */
+  const uint8_t *mapped_data;
+
+  /** Length of the mapped content */
+  size_t mapped_len;
   
   /** }@ */
 };
@@ -34,7 +34,9 @@
 #include "utils.h"
 #include "libjsmn/jsmn.h"
 #include <assert.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -53,6 +55,7 @@ enum {
   OPTION_BROKER_URL,
   OPTION_PARAM,
   OPTION_CACHE_DIR,
+  OPTION_RESPONSE_CACHE_DIR,
 };
 
 /* define the options this data interface accepts */
@@ -78,14 +81,24 @@ static bgpstream_data_interface_option_t options[] = {
     "cache-dir", // name
     "Enable local cache at provided directory.", // description
   },
+  /* Broker Response Cache */
+  {
+    BGPSTREAM_DATA_INTERFACE_BROKER, // interface ID
+    OPTION_RESPONSE_CACHE_DIR, // internal ID
+    "response-cache-dir", // name
+    "Cache broker responses for closed time intervals at provided directory.",
+  },
 };
 
 /* create the class structure for this data interface */
-BSDI_CREATE_CLASS(
+BSDI_CREATE_CLASS_FULL_EXT(
   broker,
+  "broker",
   BGPSTREAM_DATA_INTERFACE_BROKER,
   "Retrieve metadata information from the BGPStream Broker service",
-  options
+  options,
+  bsdi_broker_poll_resources,
+  bsdi_broker_get_response_cache_stats
 );
 
 /* ---------- END CLASS DEFINITION ---------- */
@@ -98,6 +111,49 @@ BSDI_CREATE_CLASS(
    this) */
 #define URL_BUFLEN 4096
 
+/* Responses are only cached once every time interval in the query ended at
+   least this long ago (in seconds), since until then the broker may still be
+   adding dump files to the window */
+#define RESPONSE_CACHE_MIN_AGE 86400
+
+#define RESPONSE_CACHE_FILE_SUFFIX ".json"
+#define RESPONSE_CACHE_TEMP_FILE_SUFFIX ".temp"
+
+/* A query for one window of data */
+typedef struct broker_query {
+
+  // the full query url
+  char url[URL_BUFLEN];
+
+  // the normalized query, used as the response cache key (empty if the
+  // response must not be cached)
+  char cache_key[URL_BUFLEN];
+
+} broker_query_t;
+
+/* A broker response that has been read and tokenized, but not yet
+   processed */
+typedef struct broker_response {
+
+  // the raw JSON string (nul-terminated)
+  char *js;
+
+  size_t jslen;
+
+  // tokens found by the JSON parser
+  jsmntok_t *tok;
+
+  // number of tokens allocated
+  size_t tokcount;
+
+  // number of tokens used
+  int tokused;
+
+  // was this response read from the response cache?
+  int cached;
+
+} broker_response_t;
+
 typedef struct bsdi_broker_state {
 
   /* user-provided options: */
@@ -114,6 +170,9 @@ typedef struct bsdi_broker_state {
   // User-specified location for cache: NULL means cache disabled
   char *cache_dir;
 
+  // User-specified location for the response cache: NULL means disabled
+  char *response_cache_dir;
+
   /* internal state: */
 
   // working space to build query urls
@@ -127,12 +186,39 @@ typedef struct bsdi_broker_state {
   // have any parameters been added to the url?
   int first_param;
 
+  // values of first_param and query_url_remaining at query_url_end
+  int query_url_end_first_param;
+  size_t query_url_end_remaining;
+
   // time of the last response we got from the broker
   uint32_t last_response_time;
 
   // the max (file_time + duration) that we have seen
   uint32_t current_window_end;
 
+  /* background prefetch of the next window: */
+
+  // is the prefetch thread running? (only used by the consumer thread)
+  int prefetching;
+
+  pthread_t prefetch_thread;
+
+  // protects prefetch_done
+  pthread_mutex_t prefetch_mutex;
+
+  // set by the prefetch thread once the response has been read
+  int prefetch_done;
+
+  // query for the next window
+  broker_query_t prefetch_query;
+
+  // result of the prefetch (only valid once prefetch_done is set)
+  int prefetch_rc;
+  broker_response_t prefetch_resp;
+
+  // response cache statistics
+  bgpstream_response_cache_stats_t cache_stats;
+
 } bsdi_broker_state_t;
 
 // the max time we will wait between retries to the broker
@@ -257,6 +343,7 @@ static jsmntok_t *json_skip(jsmntok_t *t)
     }                                                                          \
   } while (0)
 
+// returns the number of dump files in the response, or an error code
 static int process_json(bsdi_t *di, const char *js, jsmntok_t *root_tok,
                         size_t count)
 {
@@ -266,6 +353,7 @@ static int process_json(bsdi_t *di, const char *js, jsmntok_t *root_tok,
   int arr_len, obj_len;
 
   int time_set = 0;
+  int files_cnt = 0;
 
   // per-file info
   char *url = NULL;
@@ -434,6 +522,8 @@ static int process_json(bsdi_t *di, const char *js, jsmntok_t *root_tok,
         fprintf(stderr, "Duration: %" PRIu32 "\n", duration);
 #endif
 
+        files_cnt++;
+
         // do we need to update our current_window_end?
         if (initial_time + duration > STATE->current_window_end) {
           STATE->current_window_end = (initial_time + duration);
@@ -467,7 +557,7 @@ static int process_json(bsdi_t *di, const char *js, jsmntok_t *root_tok,
   }
 
   free(url);
-  return 0;
+  return files_cnt;
 
 retry:
   free(url);
@@ -479,80 +569,361 @@ err:
   return ERR_RETRY;
 }
 
-static int read_json(bsdi_t *di, io_t *jsonfile)
+static void response_clear(broker_response_t *resp)
 {
-  jsmn_parser p;
-  jsmntok_t *tok = NULL;
-  size_t tokcount = 128;
+  free(resp->js);
+  free(resp->tok);
+  memset(resp, 0, sizeof(broker_response_t));
+}
 
+// slurp the whole file into the response buffer
+static int read_json(io_t *jsonfile, broker_response_t *resp)
+{
   int ret;
-  char *js = NULL;
-  size_t jslen = 0;
 #define BUFSIZE 1024
   char buf[BUFSIZE];
 
-  // prepare parser
-  jsmn_init(&p);
-
-  // allocate some tokens to start
-  if ((tok = malloc(sizeof(jsmntok_t) * tokcount)) == NULL) {
-    fprintf(stderr, "ERROR: Could not malloc initial tokens\n");
-    goto err;
-  }
-
-  // slurp the whole file into a buffer
   while (1) {
     /* do a read */
     ret = wandio_read(jsonfile, buf, BUFSIZE);
     if (ret < 0) {
       fprintf(stderr, "ERROR: Reading from broker failed\n");
-      goto err;
+      return -1;
     }
     if (ret == 0) {
       // we're done
       break;
     }
-    if ((js = realloc(js, jslen + ret + 1)) == NULL) {
+    if ((resp->js = realloc(resp->js, resp->jslen + ret + 1)) == NULL) {
       fprintf(stderr, "ERROR: Could not realloc json string\n");
-      goto err;
+      return -1;
     }
-    strncpy(js + jslen, buf, ret);
-    jslen += ret;
+    memcpy(resp->js + resp->jslen, buf, ret);
+    resp->jslen += ret;
+    resp->js[resp->jslen] = '\0';
+  }
+
+  return 0;
+}
+
+static int parse_json(broker_response_t *resp)
+{
+  jsmn_parser p;
+  int ret;
+
+  // prepare parser
+  jsmn_init(&p);
+
+  // allocate some tokens to start
+  resp->tokcount = 128;
+  if ((resp->tok = malloc(sizeof(jsmntok_t) * resp->tokcount)) == NULL) {
+    fprintf(stderr, "ERROR: Could not malloc initial tokens\n");
+    return -1;
   }
 
 again:
-  if ((ret = jsmn_parse(&p, js, jslen, tok, tokcount)) < 0) {
+  if ((ret = jsmn_parse(&p, resp->js, resp->jslen, resp->tok,
+                        resp->tokcount)) < 0) {
     if (ret == JSMN_ERROR_NOMEM) {
-      tokcount *= 2;
-      if ((tok = realloc(tok, sizeof(jsmntok_t) * tokcount)) == NULL) {
+      resp->tokcount *= 2;
+      if ((resp->tok = realloc(resp->tok,
+                               sizeof(jsmntok_t) * resp->tokcount)) == NULL) {
         fprintf(stderr, "ERROR: Could not realloc tokens\n");
-        goto err;
+        return -1;
       }
       goto again;
     }
     if (ret == JSMN_ERROR_INVAL) {
       fprintf(stderr, "ERROR: Invalid character in JSON string\n");
-      goto err;
+      return -1;
     }
     fprintf(stderr, "ERROR: JSON parser returned %d\n", ret);
+    return -1;
+  }
+  resp->tokused = p.toknext;
+
+  return 0;
+}
+
+// read and tokenize the response to the given query. this does not touch the
+// data interface state, so it is safe to call from the prefetch thread.
+static int fetch_json(const char *url, broker_response_t *resp)
+{
+  io_t *jsonfile = NULL;
+
+  assert(resp->js == NULL && resp->tok == NULL);
+
+  if ((jsonfile = wandio_create(url)) == NULL) {
+    fprintf(stderr, "ERROR: Could not open %s for reading\n", url);
+    return ERR_RETRY;
+  }
+  if (read_json(jsonfile, resp) != 0) {
     goto err;
   }
-  ret = process_json(di, js, tok, p.toknext);
+  wandio_destroy(jsonfile);
+  jsonfile = NULL;
 
-  free(js);
-  free(tok);
-  if (ret == ERR_FATAL) {
-    fprintf(stderr, "ERROR: Received fatal error from process_json\n");
+  if (parse_json(resp) != 0) {
+    goto err;
   }
-  return ret;
+
+  return 0;
 
 err:
-  free(js);
-  free(tok);
+  if (jsonfile != NULL) {
+    wandio_destroy(jsonfile);
+  }
+  response_clear(resp);
   fprintf(stderr, "%s: Returning fatal error code\n", __func__);
   return ERR_FATAL;
 }
 
+static int param_cmp(const void *a, const void *b)
+{
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// build the response cache key for a query url. the parameters are sorted so
+// that the key does not depend on the order that filters were added in, and
+// dataAddedSince is dropped, since it only matters for windows that are still
+// having data added to them, which we never cache.
+static int normalize_query(const char *url, char *key, size_t key_len)
+{
+  char buf[URL_BUFLEN];
+  char **params = NULL;
+  int params_cnt = 0;
+  char *query;
+  char *p;
+  char *saveptr = NULL;
+  size_t len;
+  int i;
+
+  if (strlen(url) >= sizeof(buf)) {
+    goto err;
+  }
+  strcpy(buf, url);
+
+  // the base url stays at the start of the key
+  if ((query = strchr(buf, '?')) != NULL) {
+    *query = '\0';
+    query++;
+  }
+  if ((len = strlen(buf)) >= key_len) {
+    goto err;
+  }
+  strcpy(key, buf);
+  if (query == NULL) {
+    return 0;
+  }
+
+  // each '&' separates two params
+  params_cnt = 1;
+  for (p = query; *p != '\0'; p++) {
+    if (*p == '&') {
+      params_cnt++;
+    }
+  }
+  if ((params = malloc(sizeof(char *) * params_cnt)) == NULL) {
+    goto err;
+  }
+  params_cnt = 0;
+  for (p = strtok_r(query, "&", &saveptr); p != NULL;
+       p = strtok_r(NULL, "&", &saveptr)) {
+    if (strncmp(p, "dataAddedSince=", strlen("dataAddedSince=")) != 0) {
+      params[params_cnt++] = p;
+    }
+  }
+  qsort(params, params_cnt, sizeof(char *), param_cmp);
+
+  for (i = 0; i < params_cnt; i++) {
+    if (len + strlen(params[i]) + 2 > key_len) {
+      goto err;
+    }
+    key[len++] = (i == 0) ? '?' : '&';
+    strcpy(key + len, params[i]);
+    len += strlen(params[i]);
+  }
+
+  free(params);
+  return 0;
+
+err:
+  free(params);
+  return -1;
+}
+
+// can the response to the next query be cached? only if every time interval
+// is closed and old enough that the broker will not add any more data to it
+static int query_is_closed(bsdi_t *di)
+{
+  bgpstream_interval_filter_t *tif = BSDI_GET_FILTER_MGR(di)->time_intervals;
+  uint32_t now = epoch_sec();
+
+  if (tif == NULL) {
+    return 0;
+  }
+  for (; tif != NULL; tif = tif->next) {
+    if (tif->end_time == BGPSTREAM_FOREVER ||
+        (uint64_t)tif->end_time + RESPONSE_CACHE_MIN_AGE > now) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int cache_file_path(const char *dir, const char *key,
+                           const char *suffix, char *buf, size_t len)
+{
+  // 64-bit FNV-1a hash of the key
+  uint64_t hash = 14695981039346656037ULL;
+  const char *p;
+
+  for (p = key; *p != '\0'; p++) {
+    hash ^= (uint8_t)*p;
+    hash *= 1099511628211ULL;
+  }
+  if (snprintf(buf, len, "%s/broker-%016" PRIx64 "%s", dir, hash, suffix) >=
+      (int)len) {
+    return -1;
+  }
+  return 0;
+}
+
+// look for a cached response to the given query. returns 0 and fills the
+// response if one was found
+static int cache_read(const char *dir, const char *key,
+                      broker_response_t *resp)
+{
+  char path[URL_BUFLEN];
+  io_t *file = NULL;
+  size_t key_len = strlen(key);
+
+  if (cache_file_path(dir, key, RESPONSE_CACHE_FILE_SUFFIX, path,
+                      sizeof(path)) != 0 ||
+      access(path, F_OK) == -1) {
+    return -1;
+  }
+  if ((file = wandio_create(path)) == NULL || read_json(file, resp) != 0) {
+    goto err;
+  }
+  wandio_destroy(file);
+  file = NULL;
+
+  // the file starts with the full key (in case of hash collisions)
+  if (resp->jslen <= key_len || strncmp(resp->js, key, key_len) != 0 ||
+      resp->js[key_len] != '\n') {
+    goto err;
+  }
+  resp->jslen -= key_len + 1;
+  memmove(resp->js, resp->js + key_len + 1, resp->jslen + 1);
+
+  if (parse_json(resp) != 0) {
+    goto err;
+  }
+  resp->cached = 1;
+  return 0;
+
+err:
+  if (file != NULL) {
+    wandio_destroy(file);
+  }
+  response_clear(resp);
+  return -1;
+}
+
+static int cache_write(const char *dir, const char *key,
+                       const broker_response_t *resp)
+{
+  char path[URL_BUFLEN];
+  char temp_path[URL_BUFLEN];
+  char temp_suffix[64];
+  iow_t *writer = NULL;
+  size_t key_len = strlen(key);
+
+  // other processes may be writing the same response, so each uses its own
+  // temporary file
+  snprintf(temp_suffix, sizeof(temp_suffix),
+           RESPONSE_CACHE_TEMP_FILE_SUFFIX ".%d", (int)getpid());
+  if (cache_file_path(dir, key, RESPONSE_CACHE_FILE_SUFFIX, path,
+                      sizeof(path)) != 0 ||
+      cache_file_path(dir, key, temp_suffix, temp_path,
+                      sizeof(temp_path)) != 0) {
+    return -1;
+  }
+
+  if ((writer = wandio_wcreate(temp_path, WANDIO_COMPRESS_NONE, 0,
+                               O_CREAT)) == NULL) {
+    fprintf(stderr, "ERROR: Could not open %s for writing\n", temp_path);
+    return -1;
+  }
+  if (wandio_wwrite(writer, key, key_len) != (int64_t)key_len ||
+      wandio_wwrite(writer, "\n", 1) != 1 ||
+      wandio_wwrite(writer, resp->js, resp->jslen) != (int64_t)resp->jslen) {
+    fprintf(stderr, "ERROR: Incomplete write of cached broker response\n");
+    wandio_wdestroy(writer);
+    remove(temp_path);
+    return -1;
+  }
+  wandio_wdestroy(writer);
+
+  // readers only ever see complete responses
+  if (rename(temp_path, path) != 0) {
+    fprintf(stderr, "ERROR: Renaming failed for file %s\n", temp_path);
+    remove(temp_path);
+    return -1;
+  }
+  return 0;
+}
+
+// get the response to a query, from the response cache if possible. this does
+// not touch the data interface state, so it is safe to call from the prefetch
+// thread.
+static int query_broker(const char *cache_dir, const broker_query_t *query,
+                        broker_response_t *resp)
+{
+  if (cache_dir != NULL && query->cache_key[0] != '\0' &&
+      cache_read(cache_dir, query->cache_key, resp) == 0) {
+    return 0;
+  }
+  return fetch_json(query->url, resp);
+}
+
+// update the response cache (and its statistics) once a response has been
+// processed
+static void cache_update(bsdi_t *di, const broker_query_t *query,
+                         const broker_response_t *resp, int rc)
+{
+  char path[URL_BUFLEN];
+
+  if (STATE->response_cache_dir == NULL) {
+    return;
+  }
+  if (query->cache_key[0] == '\0') {
+    STATE->cache_stats.uncacheable_cnt++;
+    return;
+  }
+
+  if (resp->cached != 0) {
+    if (rc >= 0) {
+      STATE->cache_stats.hit_cnt++;
+    } else if (cache_file_path(STATE->response_cache_dir, query->cache_key,
+                               RESPONSE_CACHE_FILE_SUFFIX, path,
+                               sizeof(path)) == 0) {
+      // the cached response is bad, so the retry should go to the broker
+      fprintf(stderr, "WARN: Removing invalid cached broker response %s\n",
+              path);
+      remove(path);
+    }
+    return;
+  }
+
+  STATE->cache_stats.miss_cnt++;
+  if (rc >= 0 &&
+      cache_write(STATE->response_cache_dir, query->cache_key, resp) == 0) {
+    STATE->cache_stats.store_cnt++;
+  }
+}
+
 static int update_query_url(bsdi_t *di)
 {
   bgpstream_filter_mgr_t *filter_mgr = BSDI_GET_FILTER_MGR(di);
@@ -644,6 +1015,8 @@ static int update_query_url(bsdi_t *di)
   // query later
   STATE->query_url_end = STATE->query_url_buf + strlen(STATE->query_url_buf);
   assert((*STATE->query_url_end) == '\0');
+  STATE->query_url_end_first_param = STATE->first_param;
+  STATE->query_url_end_remaining = STATE->query_url_remaining;
 
   return 0;
 
@@ -651,6 +1024,132 @@ static int update_query_url(bsdi_t *di)
   return -1;
 }
 
+// append the parameters that select the next window to the query url:
+//  - dataAddedSince ("time" from last response we got)
+//  - minInitialTime (max("initialTime"+"duration") of any file we've ever seen)
+static int append_window_params(bsdi_t *di)
+{
+#define BUFLEN 20
+  char buf[BUFLEN];
+
+  if (STATE->last_response_time > 0) {
+    // need to add dataAddedSince
+    if (snprintf(buf, BUFLEN, "%" PRIu32, STATE->last_response_time) >=
+        BUFLEN) {
+      fprintf(stderr, "ERROR: Could not build dataAddedSince param string\n");
+      goto err;
+    }
+    AMPORQ;
+    APPEND_STR("dataAddedSince=");
+    APPEND_STR(buf);
+  }
+  if (STATE->current_window_end > 0) {
+    // need to add minInitialTime
+    if (snprintf(buf, BUFLEN, "%" PRIu32, STATE->current_window_end) >=
+        BUFLEN) {
+      fprintf(stderr, "ERROR: Could not build minInitialTime param string\n");
+      goto err;
+    }
+    AMPORQ;
+    APPEND_STR("minInitialTime=");
+    APPEND_STR(buf);
+  }
+
+  return 0;
+
+err:
+  return -1;
+}
+
+// strip the window parameters back off the query url
+static void reset_window_params(bsdi_t *di)
+{
+  *STATE->query_url_end = '\0';
+  STATE->first_param = STATE->query_url_end_first_param;
+  STATE->query_url_remaining = STATE->query_url_end_remaining;
+}
+
+// build the query for the next window
+static int build_query(bsdi_t *di, broker_query_t *query)
+{
+  if (append_window_params(di) != 0) {
+    reset_window_params(di);
+    return -1;
+  }
+  strcpy(query->url, STATE->query_url_buf);
+  reset_window_params(di);
+
+  query->cache_key[0] = '\0';
+  if (STATE->response_cache_dir != NULL && query_is_closed(di) != 0 &&
+      normalize_query(query->url, query->cache_key, URL_BUFLEN) != 0) {
+    query->cache_key[0] = '\0';
+  }
+
+  return 0;
+}
+
+static void *prefetch_thread(void *user)
+{
+  bsdi_broker_state_t *state = user;
+  int rc;
+
+  rc = query_broker(state->response_cache_dir, &state->prefetch_query,
+                    &state->prefetch_resp);
+
+  pthread_mutex_lock(&state->prefetch_mutex);
+  state->prefetch_rc = rc;
+  state->prefetch_done = 1;
+  pthread_mutex_unlock(&state->prefetch_mutex);
+
+  return NULL;
+}
+
+// start fetching the window that follows the one we just queued. if this
+// fails we just fall back to querying once the queue is empty.
+static void prefetch_start(bsdi_t *di)
+{
+  assert(STATE->prefetching == 0);
+
+  if (build_query(di, &STATE->prefetch_query) != 0) {
+    return;
+  }
+
+#ifdef BROKER_DEBUG
+  fprintf(stderr, "\nPrefetch URL: \"%s\"\n", STATE->prefetch_query.url);
+#endif
+
+  STATE->prefetch_done = 0;
+  if (pthread_create(&STATE->prefetch_thread, NULL, prefetch_thread, STATE) !=
+      0) {
+    fprintf(stderr, "WARN: Could not start broker prefetch thread\n");
+    return;
+  }
+  STATE->prefetching = 1;
+}
+
+// wait for the prefetch thread and queue the resources it found. returns the
+// number of dump files in the response, or an error code.
+static int prefetch_finish(bsdi_t *di)
+{
+  int rc;
+
+  assert(STATE->prefetching != 0);
+  pthread_join(STATE->prefetch_thread, NULL);
+  STATE->prefetching = 0;
+
+  if (STATE->prefetch_rc == 0) {
+    rc = process_json(di, STATE->prefetch_resp.js, STATE->prefetch_resp.tok,
+                      STATE->prefetch_resp.tokused);
+    cache_update(di, &STATE->prefetch_query, &STATE->prefetch_resp, rc);
+  } else {
+    // the query will be retried in the foreground
+    rc = ERR_RETRY;
+  }
+  response_clear(&STATE->prefetch_resp);
+
+  return rc;
+}
+
 /* ========== PUBLIC METHODS BELOW HERE ========== */
 
 int bsdi_broker_init(bsdi_t *di)
@@ -661,6 +1160,7 @@ int bsdi_broker_init(bsdi_t *di)
     goto err;
   }
   BSDI_SET_STATE(di, state);
+  pthread_mutex_init(&state->prefetch_mutex, NULL);
 
   /* set default state */
   if ((state->broker_url = strdup(BGPSTREAM_DI_BROKER_URL)) == NULL) {
@@ -715,6 +1215,18 @@ int bsdi_broker_set_option(bsdi_t *di,
     }
     break;
 
+  case OPTION_RESPONSE_CACHE_DIR:
+    if (access(option_value, F_OK) == -1) {
+      fprintf(stderr, "ERROR: Response cache directory %s does not exist.\n",
+              option_value);
+      return -1;
+    }
+    free(STATE->response_cache_dir);
+    if ((STATE->response_cache_dir = strdup(option_value)) == NULL) {
+      return -1;
+    }
+    break;
+
   default:
     return -1;
   }
@@ -728,9 +1240,19 @@ void bsdi_broker_destroy(bsdi_t *di)
     return;
   }
 
+  if (STATE->prefetching != 0) {
+    pthread_join(STATE->prefetch_thread, NULL);
+    STATE->prefetching = 0;
+  }
+  response_clear(&STATE->prefetch_resp);
+  pthread_mutex_destroy(&STATE->prefetch_mutex);
+
   free(STATE->broker_url);
   STATE->broker_url = NULL;
 
+  free(STATE->response_cache_dir);
+  STATE->response_cache_dir = NULL;
+
   int i;
   for (i=0; i<STATE->params_cnt; i++) {
     free(STATE->params[i]);
@@ -744,43 +1266,25 @@ void bsdi_broker_destroy(bsdi_t *di)
 
 int bsdi_broker_update_resources(bsdi_t *di)
 {
-
-// we need to set two parameters:
-//  - dataAddedSince ("time" from last response we got)
-//  - minInitialTime (max("initialTime"+"duration") of any file we've ever seen)
-
-#define BUFLEN 20
-  char buf[BUFLEN];
-
-  io_t *jsonfile = NULL;
+  broker_query_t query;
+  broker_response_t resp = {0};
 
   int rc;
   int attempts = 0;
   int wait_time = 1;
 
-  int success = 0;
-
-  if (STATE->last_response_time > 0) {
-    // need to add dataAddedSince
-    if (snprintf(buf, BUFLEN, "%" PRIu32, STATE->last_response_time) >=
-        BUFLEN) {
-      fprintf(stderr, "ERROR: Could not build dataAddedSince param string\n");
+  // if the next window was prefetched then we just need to wait for it
+  if (STATE->prefetching != 0) {
+    if ((rc = prefetch_finish(di)) == ERR_FATAL) {
       goto err;
+    } else if (rc >= 0) {
+      goto done;
     }
-    AMPORQ;
-    APPEND_STR("dataAddedSince=");
-    APPEND_STR(buf);
+    // otherwise the prefetch failed, so query again with retries
   }
-  if (STATE->current_window_end > 0) {
-    // need to add minInitialTime
-    if (snprintf(buf, BUFLEN, "%" PRIu32, STATE->current_window_end) >=
-        BUFLEN) {
-      fprintf(stderr, "ERROR: Could not build minInitialTime param string\n");
-      goto err;
-    }
-    AMPORQ;
-    APPEND_STR("minInitialTime=");
-    APPEND_STR(buf);
+
+  if (build_query(di, &query) != 0) {
+    goto err;
   }
 
   do {
@@ -795,42 +1299,64 @@ int bsdi_broker_update_resources(bsdi_t *di)
     attempts++;
 
 #ifdef BROKER_DEBUG
-    fprintf(stderr, "\nQuery URL: \"%s\"\n", STATE->query_url_buf);
+    fprintf(stderr, "\nQuery URL: \"%s\"\n", query.url);
 #endif
 
-    if ((jsonfile = wandio_create(STATE->query_url_buf)) == NULL) {
-      fprintf(stderr, "ERROR: Could not open %s for reading\n",
-              STATE->query_url_buf);
-      goto retry;
+    if ((rc = query_broker(STATE->response_cache_dir, &query, &resp)) == 0) {
+      rc = process_json(di, resp.js, resp.tok, resp.tokused);
+      cache_update(di, &query, &resp, rc);
+      response_clear(&resp);
     }
-
-    if ((rc = read_json(di, jsonfile)) == ERR_FATAL) {
-      fprintf(stderr, "ERROR: Received fatal error code from read_json\n");
+    if (rc == ERR_FATAL) {
+      fprintf(stderr, "ERROR: Received fatal error code from broker query\n");
       goto err;
-    } else if (rc == ERR_RETRY) {
-      goto retry;
-    } else {
-      // success!
-      success = 1;
     }
+  } while (rc == ERR_RETRY);
 
-  retry:
-    if (jsonfile != NULL) {
-      wandio_destroy(jsonfile);
-      jsonfile = NULL;
-    }
-  } while (success == 0);
-
-  // reset the variable params
-  *STATE->query_url_end = '\0';
-  STATE->query_url_remaining = URL_BUFLEN - strlen(STATE->query_url_end);
+done:
+  // if this window had data, then start fetching the next one while this one
+  // is being read
+  if (rc > 0) {
+    prefetch_start(di);
+  }
   return 0;
 
 err:
   fprintf(stderr, "ERROR: Fatal error in broker data source\n");
-  if (jsonfile != NULL) {
-    wandio_destroy(jsonfile);
-  }
   return -1;
 }
 
+int bsdi_broker_poll_resources(bsdi_t *di)
+{
+  int done;
+  int rc;
+
+  if (STATE->prefetching == 0) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&STATE->prefetch_mutex);
+  done = STATE->prefetch_done;
+  pthread_mutex_unlock(&STATE->prefetch_mutex);
+  if (done == 0) {
+    return 0;
+  }
+
+  // queue the next window now so that it can be opened before this one is
+  // finished. if the prefetch failed it will be retried once the queue is
+  // empty.
+  if ((rc = prefetch_finish(di)) == ERR_FATAL) {
+    fprintf(stderr, "ERROR: Fatal error in broker data source\n");
+    return -1;
+  }
+  if (rc > 0) {
+    prefetch_start(di);
+  }
+  return 0;
+}
+
+void bsdi_broker_get_response_cache_stats(
+  bsdi_t *di, bgpstream_response_cache_stats_t *stats)
+{
+  *stats = STATE->cache_stats;
+}
@@ -31,4 +31,9 @@
 
 BSDI_GENERATE_PROTOS(broker);
 
+int bsdi_broker_poll_resources(bsdi_t *di);
+
+void bsdi_broker_get_response_cache_stats(
+  bsdi_t *di, bgpstream_response_cache_stats_t *stats);
+
 #endif /* __BSDI_BROKER_H */
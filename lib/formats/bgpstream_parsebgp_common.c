@@ -25,11 +25,14 @@
  */
 
 #include "bgpstream_parsebgp_common.h"
+#include "bgpstream_elem_int.h"
 #include "bgpstream_format_interface.h"
 #include "bgpstream_record_int.h"
 #include "bgpstream_utils_as_path_int.h"
 #include "bgpstream_utils_community_int.h"
 #include "bgpstream_log.h"
+#include "khash.h"
+#include "utils.h"
 #include <assert.h>
 #include <string.h>
 
@@ -40,6 +43,50 @@
 #include <stdio.h>
 #endif
 
+// maximum number of distinct attribute sets kept by an attribute cache before
+// it is flushed. it is only flushed between records, so a single record may
+// take it past this
+#define ATTR_CACHE_MAX_ENTRIES (1 << 17)
+
+// tags that separate the attributes in an attribute cache key
+#define ATTR_KEY_AS_PATH PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH
+#define ATTR_KEY_AS4_PATH PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH
+#define ATTR_KEY_COMMUNITIES PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES
+
+typedef struct attr_cache_entry {
+
+  // attribute bytes that this entry was built from
+  uint8_t *key;
+  size_t key_len;
+  size_t key_alloc_len;
+
+  // the AS path and communities built from the attributes
+  bgpstream_as_path_t *path;
+  bgpstream_community_set_t *comms;
+
+  // index of the next entry with the same key hash (or -1)
+  int next;
+
+} attr_cache_entry_t;
+
+KHASH_INIT(attr_cache, uint32_t, int, 1, kh_int_hash_func, kh_int_hash_equal)
+
+struct bgpstream_parsebgp_attr_cache {
+
+  // key hash -> index of the first entry with that hash
+  khash_t(attr_cache) * index;
+
+  // entries (those past entries_cnt are unused, but keep their memory)
+  attr_cache_entry_t *entries;
+  int entries_cnt;
+  int entries_alloc_cnt;
+
+  // key for the attributes currently being looked up
+  uint8_t *key;
+  size_t key_len;
+  size_t key_alloc_len;
+};
+
 static bgpstream_as_path_seg_type_t as_path_types[] = {
   BGPSTREAM_AS_PATH_SEG_INVALID,    // INVALID
   BGPSTREAM_AS_PATH_SEG_SET,        // PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SET
@@ -177,31 +224,85 @@ static int handle_as_paths(bgpstream_as_path_t *path,
   return 0;
 }
 
+static void release_buffer(bgpstream_parsebgp_decode_state_t *state)
+{
+  assert(state->remain == 0);
+  bgpstream_buffer_pool_put(state->buf_pool, &state->buf);
+  state->ptr = NULL;
+}
+
+static void consume_buffer(bgpstream_parsebgp_decode_state_t *state,
+                           size_t len)
+{
+  state->ptr += len;
+  state->remain -= len;
+  // keep the read pointer in the first copy of a mirrored buffer
+  if (state->buf.mirrored != 0 &&
+      state->ptr >= state->buf.data + state->buf.len) {
+    state->ptr -= state->buf.len;
+  }
+}
+
 static ssize_t refill_buffer(bgpstream_parsebgp_decode_state_t *state,
                              bgpstream_transport_t *transport)
 {
-  size_t len = 0;
   int64_t new_read = 0;
+  bgpstream_buffer_t new_buf;
+  const uint8_t *mapped;
+  size_t mapped_len;
+
+  // if the transport has the whole dump in memory, parse it in place. there
+  // is never anything more to read after that
+  if ((mapped = bgpstream_transport_get_mapped(transport, &mapped_len)) !=
+      NULL) {
+    if (state->mapped != 0) {
+      return state->remain;
+    }
+    assert(state->remain == 0);
+    state->mapped = 1;
+    // the parser only reads from the buffer
+    state->ptr = (uint8_t *)mapped;
+    return mapped_len;
+  }
+
+  if (state->buf.data == NULL) {
+    assert(state->remain == 0);
+    if (bgpstream_buffer_pool_get(state->buf_pool, 0, &state->buf) != 0) {
+      return -1;
+    }
+  }
 
-  if (state->remain > 0) {
+  if (state->remain == 0) {
+    state->ptr = state->buf.data;
+  } else if (state->remain == state->buf.len) {
+    // a single partial message fills the buffer, so we need a bigger one. if
+    // we can't get one, the read below will return nothing new, and the
+    // caller will treat the message as corrupted
+    if (bgpstream_buffer_pool_get(state->buf_pool, state->buf.len * 2,
+                                  &new_buf) == 0) {
+      memcpy(new_buf.data, state->ptr, state->remain);
+      bgpstream_buffer_pool_put(state->buf_pool, &state->buf);
+      state->buf = new_buf;
+      state->ptr = state->buf.data;
+    }
+  } else if (state->buf.mirrored == 0 && state->ptr != state->buf.data) {
     // need to move remaining data to start of buffer
-    memmove(state->buffer,
-            state->buffer + BGPSTREAM_PARSEBGP_BUFLEN - state->remain,
-            state->remain);
-    len += state->remain;
+    memmove(state->buf.data, state->ptr, state->remain);
+    state->ptr = state->buf.data;
   }
 
-  // try and do a read
-  if ((new_read = bgpstream_transport_read(transport, state->buffer + len,
-                                           BGPSTREAM_PARSEBGP_BUFLEN - len)) <
-      0) {
+  // try and do a read. if the buffer is mirrored, the free space after the
+  // unread data is contiguous even if it wraps around the end of the buffer
+  if ((new_read = bgpstream_transport_read(
+         transport, state->ptr + state->remain,
+         state->buf.len - state->remain)) < 0) {
     // read failed
     return new_read;
   }
 
   // new_read could be 0, indicating EOF, so need to check returned len is
   // larger than passed in remain
-  return len + new_read;
+  return state->remain + new_read;
 }
 
 static bgpstream_format_status_t
@@ -211,6 +312,12 @@ handle_eof(bgpstream_parsebgp_decode_state_t *state, bgpstream_record_t *record,
   // just to be kind, set the record time to the dump time
   record->time_sec = record->dump_time_sec;
 
+  // we won't be reading any more, so let someone else use the buffer
+  if (state->buf_pool != NULL && state->remain == 0 &&
+      state->buf.data != NULL) {
+    release_buffer(state);
+  }
+
   if (skipped_cnt == 0) {
     // signal that the previous record really was the last in the dump
     record->dump_pos = BGPSTREAM_DUMP_END;
@@ -244,8 +351,71 @@ void bgpstream_parsebgp_upd_state_reset(
   memset(upd_state, 0, sizeof(*upd_state));
 }
 
-static int handle_prefix(bgpstream_elem_t *elem,
-                         bgpstream_elem_type_t elem_type,
+int bgpstream_parsebgp_upd_state_remaining(
+  bgpstream_parsebgp_upd_state_t *upd_state)
+{
+  if (upd_state->ready == 0) {
+    return 0;
+  }
+  return upd_state->withdrawal_v4_cnt + upd_state->withdrawal_v6_cnt +
+         upd_state->announce_v4_cnt + upd_state->announce_v6_cnt;
+}
+
+void bgpstream_parsebgp_elem_filter_init(
+  bgpstream_parsebgp_elem_filter_t *filter,
+  bgpstream_filter_mgr_t *filter_mgr)
+{
+  memset(filter, 0, sizeof(*filter));
+
+  if (filter_mgr->elemtype_mask != 0) {
+    filter->elemtype_mask = filter_mgr->elemtype_mask;
+    filter->enabled = 1;
+  } else {
+    filter->elemtype_mask =
+      BGPSTREAM_FILTER_ELEM_TYPE_RIB | BGPSTREAM_FILTER_ELEM_TYPE_ANNOUNCEMENT |
+      BGPSTREAM_FILTER_ELEM_TYPE_WITHDRAWAL |
+      BGPSTREAM_FILTER_ELEM_TYPE_PEERSTATE;
+  }
+
+  if (filter_mgr->ipversion != 0) {
+    filter->ipversion = filter_mgr->ipversion;
+    filter->enabled = 1;
+  }
+
+  if (filter_mgr->prefix_index != NULL) {
+    filter->prefixes = filter_mgr->prefix_index;
+    filter->enabled = 1;
+  }
+}
+
+int bgpstream_parsebgp_elem_filter_match(
+  bgpstream_parsebgp_elem_filter_t *filter, uint8_t elemtype,
+  bgpstream_pfx_t *pfx)
+{
+  if (filter == NULL || filter->enabled == 0) {
+    return 1;
+  }
+
+  if ((filter->elemtype_mask & elemtype) == 0) {
+    return 0;
+  }
+
+  if (filter->ipversion != 0 && pfx->address.version != filter->ipversion) {
+    return 0;
+  }
+
+  if (filter->prefixes != NULL &&
+      bgpstream_pfx_index_lookup_match(filter->prefixes, pfx) == 0) {
+    return 0;
+  }
+
+  return 1;
+}
+
+// returns 1 if the prefix was copied into the elem, 0 if it should be skipped
+static int handle_prefix(bgpstream_parsebgp_elem_filter_t *filter,
+                         bgpstream_elem_t *elem,
+                         bgpstream_elem_type_t elem_type, uint8_t filter_type,
                          parsebgp_bgp_prefix_t *prefix)
 {
   if (prefix->type != PARSEBGP_BGP_PREFIX_UNICAST_IPV4 &&
@@ -253,12 +423,17 @@ static int handle_prefix(bgpstream_elem_t *elem,
     return 0;
   }
 
-  elem->type = elem_type;
-
   // Prefix
   COPY_IP(&elem->prefix.address, prefix->afi, prefix->addr, return 0);
   elem->prefix.mask_len = prefix->len;
 
+  if (bgpstream_parsebgp_elem_filter_match(
+        filter, filter_type, (bgpstream_pfx_t *)&elem->prefix) == 0) {
+    return 0;
+  }
+
+  elem->type = elem_type;
+
   return 1;
 }
 
@@ -267,7 +442,8 @@ static int handle_prefix(bgpstream_elem_t *elem,
     rc = 0;                                                                    \
     while (upd_state->withdrawal_##nlri_type##_cnt > 0 && rc == 0) {           \
       if ((rc = handle_prefix(                                                 \
-             elem, BGPSTREAM_ELEM_TYPE_WITHDRAWAL,                             \
+             filter, elem, BGPSTREAM_ELEM_TYPE_WITHDRAWAL,                     \
+             BGPSTREAM_FILTER_ELEM_TYPE_WITHDRAWAL,                            \
              &prefixes[upd_state->withdrawal_##nlri_type##_idx])) < 0) {       \
         bgpstream_log(BGPSTREAM_LOG_ERR, "Could not extract withdrawal elem"); \
         return -1;                                                             \
@@ -280,21 +456,49 @@ static int handle_prefix(bgpstream_elem_t *elem,
     }                                                                          \
   } while (0)
 
+// give an announcement the path attributes of its UPDATE. these are processed
+// (at most once per message) into attrs_elem, and other elems share them
+static int handle_update_path_attrs(bgpstream_parsebgp_upd_state_t *upd_state,
+                                    int lazy_attrs,
+                                    bgpstream_elem_t *attrs_elem,
+                                    bgpstream_elem_t *elem,
+                                    parsebgp_bgp_update_path_attr_t *attrs)
+{
+  uint8_t *data;
+  uint16_t data_len;
+
+  if (upd_state->path_attr_done == 0) {
+    if (bgpstream_parsebgp_handle_path_attrs(attrs_elem, attrs, lazy_attrs,
+                                             NULL) != 0) {
+      return -1;
+    }
+    upd_state->path_attr_done = 1;
+  }
+  if (elem == attrs_elem) {
+    return 0;
+  }
+
+  if (lazy_attrs != 0) {
+    // each elem builds its own fields if they are accessed
+    return bgpstream_parsebgp_handle_path_attrs(elem, attrs, 1, NULL);
+  }
+  data_len = bgpstream_as_path_get_data(attrs_elem->as_path, &data);
+  bgpstream_as_path_populate_from_data_zc(elem->as_path, data, data_len);
+  bgpstream_community_set_populate_from_array_zc(
+    elem->communities, bgpstream_community_set_get(attrs_elem->communities, 0),
+    bgpstream_community_set_size(attrs_elem->communities));
+  return 0;
+}
+
+// the path attributes and next-hop are only extracted once an announcement
+// has passed the filters
 #define ANNOUNCEMENT_GENERATOR(nlri_type, prefixes, is_mp_reach)               \
   do {                                                                         \
     rc = 0;                                                                    \
     while (upd_state->announce_##nlri_type##_cnt > 0 && rc == 0) {             \
-      if (upd_state->next_hop_##nlri_type##_done == 0) {                       \
-        if (bgpstream_parsebgp_process_next_hop(                               \
-              elem, update->path_attrs.attrs, is_mp_reach) != 0) {             \
-          bgpstream_log(BGPSTREAM_LOG_ERR, "Could not extract next-hop");      \
-          return -1;                                                           \
-        }                                                                      \
-        upd_state->next_hop_##nlri_type##_done = 1;                            \
-      }                                                                        \
-                                                                               \
       if ((rc = handle_prefix(                                                 \
-             elem, BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT,                           \
+             filter, elem, BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT,                   \
+             BGPSTREAM_FILTER_ELEM_TYPE_ANNOUNCEMENT,                          \
              &prefixes[upd_state->announce_##nlri_type##_idx])) < 0) {         \
         bgpstream_log(BGPSTREAM_LOG_ERR,                                       \
                       "Could not extract announcement elem");                  \
@@ -304,11 +508,24 @@ static int handle_prefix(bgpstream_elem_t *elem,
       upd_state->announce_##nlri_type##_idx++;                                 \
     }                                                                          \
     if (rc != 0) {                                                             \
+      if (handle_update_path_attrs(upd_state, lazy_attrs, attrs_elem, elem,    \
+                                   update->path_attrs.attrs) != 0) {           \
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Could not extract path attributes"); \
+        return -1;                                                             \
+      }                                                                        \
+      if (bgpstream_parsebgp_process_next_hop(                                 \
+            elem, update->path_attrs.attrs, is_mp_reach) != 0) {               \
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Could not extract next-hop");        \
+        return -1;                                                             \
+      }                                                                        \
       return rc;                                                               \
     }                                                                          \
   } while (0)
 
 int bgpstream_parsebgp_process_update(bgpstream_parsebgp_upd_state_t *upd_state,
+                                      bgpstream_parsebgp_elem_filter_t *filter,
+                                      int lazy_attrs,
+                                      bgpstream_elem_t *attrs_elem,
                                       bgpstream_elem_t *elem,
                                       parsebgp_bgp_msg_t *bgp)
 {
@@ -345,6 +562,20 @@ int bgpstream_parsebgp_process_update(bgpstream_parsebgp_upd_state_t *upd_state,
           .data.mp_reach->nlris_cnt;
     }
 
+    // don't even look at the NLRIs of an unwanted elem type
+    if (filter != NULL && filter->enabled != 0) {
+      if ((filter->elemtype_mask & BGPSTREAM_FILTER_ELEM_TYPE_WITHDRAWAL) ==
+          0) {
+        upd_state->withdrawal_v4_cnt = 0;
+        upd_state->withdrawal_v6_cnt = 0;
+      }
+      if ((filter->elemtype_mask & BGPSTREAM_FILTER_ELEM_TYPE_ANNOUNCEMENT) ==
+          0) {
+        upd_state->announce_v4_cnt = 0;
+        upd_state->announce_v6_cnt = 0;
+      }
+    }
+
     // all other flags left set to zero
 
     upd_state->ready = 1;
@@ -366,20 +597,12 @@ int bgpstream_parsebgp_process_update(bgpstream_parsebgp_upd_state_t *upd_state,
     v6, update->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI]
           .data.mp_unreach->withdrawn_nlris);
 
-  // at this point we need the path attributes processed
-  if (upd_state->path_attr_done == 0) {
-    if (bgpstream_parsebgp_process_path_attrs(elem,
-                                              update->path_attrs.attrs) != 0) {
-      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not extract path attributes");
-      return -1;
-    }
-    upd_state->path_attr_done = 1;
-  }
-
-  // IPv4 Announcements (will also trigger next-hop extraction)
+  // IPv4 Announcements (will also trigger path attribute and next-hop
+  // extraction)
   ANNOUNCEMENT_GENERATOR(v4, update->announced_nlris.prefixes, 0);
 
-  // IPv6 Announcements (will also trigger next-hop extraction)
+  // IPv6 Announcements (will also trigger path attribute and next-hop
+  // extraction)
   ANNOUNCEMENT_GENERATOR(
     v6,
     update->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI]
@@ -389,17 +612,96 @@ int bgpstream_parsebgp_process_update(bgpstream_parsebgp_upd_state_t *upd_state,
   return 0;
 }
 
+int bgpstream_parsebgp_get_elems(
+  bgpstream_elem_generator_t **batch, bgpstream_format_t *format,
+  bgpstream_record_t *record, bgpstream_parsebgp_gen_elem_cb_t *gen_cb,
+  bgpstream_parsebgp_remaining_cb_t *remaining_cb,
+  bgpstream_format_elem_check_cb_t *check_cb, bgpstream_elem_t **elems,
+  int max)
+{
+  bgpstream_elem_t *el;
+  int remaining;
+  int cnt = 0;
+  int rc = 0;
 
-int bgpstream_parsebgp_process_path_attrs(
-  bgpstream_elem_t *el, parsebgp_bgp_update_path_attr_t *attrs)
+  if (*batch == NULL && (*batch = bgpstream_elem_generator_create()) == NULL) {
+    return -1;
+  }
+  bgpstream_elem_generator_empty(*batch);
+
+  while (cnt < max) {
+    // until it is committed, the generator hands out the same (cleared) slot,
+    // so elems that are filtered out do not use up the batch
+    if ((el = bgpstream_elem_generator_get_new_elem(*batch)) == NULL) {
+      return -1;
+    }
+    if ((rc = gen_cb(format, record, el)) <= 0) {
+      break;
+    }
+    if (check_cb(record, el) == 0) {
+      continue;
+    }
+    bgpstream_elem_generator_commit_elem(*batch, el);
+    elems[cnt++] = el;
+
+    // once the first elem has been extracted, the record knows how many more
+    // it might yield, so make room for them all up front
+    if (cnt == 1) {
+      remaining = remaining_cb(format, record);
+      if (bgpstream_elem_generator_reserve(
+            *batch, (remaining < max - 1) ? remaining : max - 1) != 0) {
+        return -1;
+      }
+    }
+  }
+  if (rc < 0) {
+    return -1;
+  }
+
+  return cnt;
+}
+
+int bgpstream_parsebgp_get_elem_columns(
+  bgpstream_format_t *format, bgpstream_record_t *record,
+  bgpstream_elem_t *elem, int *lazy_attrs,
+  bgpstream_parsebgp_gen_elem_cb_t *gen_cb,
+  bgpstream_format_elem_check_cb_t *check_cb, bgpstream_elem_columns_t *cols)
+{
+  int lazy = *lazy_attrs;
+  int rc = 1;
+
+  // none of the columns need the communities, so only build the AS path, and
+  // only when a column asks for it
+  *lazy_attrs = 1;
+  while (cols->cnt < cols->size) {
+    if ((rc = gen_cb(format, record, elem)) <= 0) {
+      break;
+    }
+    if (check_cb(record, elem) != 0 &&
+        bgpstream_elem_columns_append(cols, elem, record->collector_name,
+                                      record->time_sec) < 0) {
+      rc = -1;
+      break;
+    }
+  }
+  *lazy_attrs = lazy;
+
+  // the elems of an UPDATE share the attributes of this elem, so if the rest
+  // of the record may be extracted eagerly, they must be built now
+  if (rc > 0 && lazy == 0 && (bgpstream_elem_get_as_path(elem) == NULL ||
+                              bgpstream_elem_get_communities(elem) == NULL)) {
+    return -1;
+  }
+
+  return rc;
+}
+
+static int process_as_path(bgpstream_as_path_t *path,
+                           parsebgp_bgp_update_path_attr_t *attrs)
 {
   parsebgp_bgp_update_as_path_t *aspath = NULL;
   parsebgp_bgp_update_as_path_t *as4path = NULL;
 
-  bgpstream_as_path_clear(el->as_path);
-  bgpstream_community_set_clear(el->communities);
-
-  // AS Path(s)
   if (attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH].type ==
       PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH) {
     aspath = attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH].data.as_path;
@@ -408,16 +710,23 @@ int bgpstream_parsebgp_process_path_attrs(
       PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH) {
     as4path = attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH].data.as_path;
   }
-  if (handle_as_paths(el->as_path, aspath, as4path) != 0) {
+  if (handle_as_paths(path, aspath, as4path) != 0) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "Could not parse AS_PATH");
     return -1;
   }
 
-  // Communities
+  return 0;
+}
+
+static int process_communities(bgpstream_community_set_t *comms,
+                               parsebgp_bgp_update_path_attr_t *attrs)
+{
+  bgpstream_community_set_clear(comms);
+
   if (attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES].type ==
         PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES &&
       bgpstream_community_set_populate(
-        el->communities,
+        comms,
         attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES].data.communities->raw,
         attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES].len) != 0) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "Could not parse COMMUNITIES");
@@ -427,6 +736,281 @@ int bgpstream_parsebgp_process_path_attrs(
   return 0;
 }
 
+static int lazy_path_attrs_cb(bgpstream_elem_t *el, void *attrs, int which)
+{
+  if (which == BGPSTREAM_ELEM_LAZY_AS_PATH) {
+    return process_as_path(el->as_path, attrs);
+  }
+  return process_communities(el->communities, attrs);
+}
+
+static int attr_key_append(bgpstream_parsebgp_attr_cache_t *cache,
+                           const void *data, size_t len)
+{
+  size_t new_len = cache->key_len + len;
+
+  if (cache->key_alloc_len < new_len) {
+    if ((cache->key = realloc(cache->key, new_len * 2)) == NULL) {
+      return -1;
+    }
+    cache->key_alloc_len = new_len * 2;
+  }
+  memcpy(cache->key + cache->key_len, data, len);
+  cache->key_len = new_len;
+  return 0;
+}
+
+static int attr_key_append_as_path(bgpstream_parsebgp_attr_cache_t *cache,
+                                   uint8_t tag,
+                                   parsebgp_bgp_update_as_path_t *path)
+{
+  parsebgp_bgp_update_as_path_seg_t *seg;
+  int i;
+
+  if (attr_key_append(cache, &tag, sizeof(tag)) != 0 ||
+      attr_key_append(cache, &path->segs_cnt, sizeof(path->segs_cnt)) != 0) {
+    return -1;
+  }
+  for (i = 0; i < path->segs_cnt; i++) {
+    seg = &path->segs[i];
+    if (attr_key_append(cache, &seg->type, sizeof(seg->type)) != 0 ||
+        attr_key_append(cache, &seg->asns_cnt, sizeof(seg->asns_cnt)) != 0 ||
+        attr_key_append(cache, seg->asns, sizeof(uint32_t) * seg->asns_cnt) !=
+          0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// serialize the attributes that the AS path and communities are built from
+static int attr_key_build(bgpstream_parsebgp_attr_cache_t *cache,
+                          parsebgp_bgp_update_path_attr_t *attrs)
+{
+  parsebgp_bgp_update_path_attr_t *comms;
+  uint8_t tag;
+
+  cache->key_len = 0;
+
+  if (attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH].type ==
+        PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH &&
+      attr_key_append_as_path(
+        cache, ATTR_KEY_AS_PATH,
+        attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH].data.as_path) != 0) {
+    return -1;
+  }
+  if (attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH].type ==
+        PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH &&
+      attr_key_append_as_path(
+        cache, ATTR_KEY_AS4_PATH,
+        attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH].data.as_path) != 0) {
+    return -1;
+  }
+
+  comms = &attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES];
+  if (comms->type == PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES) {
+    tag = ATTR_KEY_COMMUNITIES;
+    if (attr_key_append(cache, &tag, sizeof(tag)) != 0 ||
+        attr_key_append(cache, &comms->len, sizeof(comms->len)) != 0 ||
+        attr_key_append(cache, comms->data.communities->raw, comms->len) !=
+          0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+// FNV-1a
+static uint32_t attr_key_hash(uint8_t *key, size_t len)
+{
+  uint32_t h = 2166136261U;
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    h = (h ^ key[i]) * 16777619U;
+  }
+  return h;
+}
+
+static attr_cache_entry_t *
+attr_cache_find(bgpstream_parsebgp_attr_cache_t *cache, khiter_t k)
+{
+  attr_cache_entry_t *e;
+  int idx;
+
+  for (idx = kh_val(cache->index, k); idx != -1; idx = e->next) {
+    e = &cache->entries[idx];
+    if (e->key_len == cache->key_len &&
+        memcmp(e->key, cache->key, cache->key_len) == 0) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+static attr_cache_entry_t *
+attr_cache_add(bgpstream_parsebgp_attr_cache_t *cache, uint32_t hash,
+               parsebgp_bgp_update_path_attr_t *attrs)
+{
+  attr_cache_entry_t *e;
+  khiter_t k;
+  int khret;
+
+  if (cache->entries_cnt == cache->entries_alloc_cnt) {
+    if ((cache->entries = realloc(cache->entries,
+                                  sizeof(attr_cache_entry_t) *
+                                    (cache->entries_alloc_cnt * 2 + 1))) ==
+        NULL) {
+      return NULL;
+    }
+    memset(&cache->entries[cache->entries_alloc_cnt], 0,
+           sizeof(attr_cache_entry_t) * (cache->entries_alloc_cnt + 1));
+    cache->entries_alloc_cnt = cache->entries_alloc_cnt * 2 + 1;
+  }
+  e = &cache->entries[cache->entries_cnt];
+
+  if ((e->path == NULL && (e->path = bgpstream_as_path_create()) == NULL) ||
+      (e->comms == NULL &&
+       (e->comms = bgpstream_community_set_create()) == NULL)) {
+    return NULL;
+  }
+  if (e->key_alloc_len < cache->key_len) {
+    if ((e->key = realloc(e->key, cache->key_len)) == NULL) {
+      return NULL;
+    }
+    e->key_alloc_len = cache->key_len;
+  }
+  memcpy(e->key, cache->key, cache->key_len);
+  e->key_len = cache->key_len;
+
+  if (process_as_path(e->path, attrs) != 0 ||
+      process_communities(e->comms, attrs) != 0) {
+    return NULL;
+  }
+
+  // link the entry in at the head of the list for its hash
+  if ((k = kh_put(attr_cache, cache->index, hash, &khret)) == -1) {
+    return NULL;
+  }
+  e->next = (khret == 0) ? kh_val(cache->index, k) : -1;
+  kh_val(cache->index, k) = cache->entries_cnt;
+  cache->entries_cnt++;
+
+  return e;
+}
+
+static int process_path_attrs_cached(bgpstream_parsebgp_attr_cache_t *cache,
+                                     bgpstream_elem_t *el,
+                                     parsebgp_bgp_update_path_attr_t *attrs)
+{
+  attr_cache_entry_t *e = NULL;
+  uint32_t hash;
+  uint8_t *data;
+  uint16_t data_len;
+  khiter_t k;
+
+  if (attr_key_build(cache, attrs) != 0) {
+    return -1;
+  }
+  hash = attr_key_hash(cache->key, cache->key_len);
+
+  if ((k = kh_get(attr_cache, cache->index, hash)) != kh_end(cache->index)) {
+    e = attr_cache_find(cache, k);
+  }
+  if (e == NULL && (e = attr_cache_add(cache, hash, attrs)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not cache path attributes");
+    return -1;
+  }
+
+  // the elem shares the (immutable) objects in the cache
+  data_len = bgpstream_as_path_get_data(e->path, &data);
+  bgpstream_as_path_populate_from_data_zc(el->as_path, data, data_len);
+  bgpstream_community_set_populate_from_array_zc(
+    el->communities, bgpstream_community_set_get(e->comms, 0),
+    bgpstream_community_set_size(e->comms));
+
+  return 0;
+}
+
+bgpstream_parsebgp_attr_cache_t *bgpstream_parsebgp_attr_cache_create()
+{
+  bgpstream_parsebgp_attr_cache_t *cache;
+
+  if ((cache = malloc_zero(sizeof(bgpstream_parsebgp_attr_cache_t))) ==
+      NULL) {
+    return NULL;
+  }
+
+  if ((cache->index = kh_init(attr_cache)) == NULL) {
+    free(cache);
+    return NULL;
+  }
+
+  return cache;
+}
+
+void bgpstream_parsebgp_attr_cache_trim(bgpstream_parsebgp_attr_cache_t *cache)
+{
+  if (cache == NULL || cache->entries_cnt < ATTR_CACHE_MAX_ENTRIES) {
+    return;
+  }
+  // start over (the entries keep their memory for reuse)
+  kh_clear(attr_cache, cache->index);
+  cache->entries_cnt = 0;
+}
+
+void bgpstream_parsebgp_attr_cache_destroy(
+  bgpstream_parsebgp_attr_cache_t *cache)
+{
+  attr_cache_entry_t *e;
+  int i;
+
+  if (cache == NULL) {
+    return;
+  }
+
+  for (i = 0; i < cache->entries_alloc_cnt; i++) {
+    e = &cache->entries[i];
+    if (e->path != NULL) {
+      bgpstream_as_path_destroy(e->path);
+    }
+    if (e->comms != NULL) {
+      bgpstream_community_set_destroy(e->comms);
+    }
+    free(e->key);
+  }
+  free(cache->entries);
+  free(cache->key);
+  kh_destroy(attr_cache, cache->index);
+
+  free(cache);
+}
+
+int bgpstream_parsebgp_process_path_attrs(
+  bgpstream_elem_t *el, parsebgp_bgp_update_path_attr_t *attrs)
+{
+  if (process_as_path(el->as_path, attrs) != 0 ||
+      process_communities(el->communities, attrs) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+int bgpstream_parsebgp_handle_path_attrs(
+  bgpstream_elem_t *el, parsebgp_bgp_update_path_attr_t *attrs, int lazy,
+  bgpstream_parsebgp_attr_cache_t *cache)
+{
+  if (lazy != 0) {
+    bgpstream_elem_set_lazy_attrs(el, lazy_path_attrs_cb, attrs);
+    return 0;
+  }
+  if (cache != NULL) {
+    return process_path_attrs_cached(cache, el, attrs);
+  }
+  return bgpstream_parsebgp_process_path_attrs(el, attrs);
+}
+
 int bgpstream_parsebgp_process_next_hop(bgpstream_elem_t *el,
                                         parsebgp_bgp_update_path_attr_t *attrs,
                                         int is_mp_pfx)
@@ -480,8 +1064,9 @@ bgpstream_format_status_t bgpstream_parsebgp_populate_record(
   // case.
   // on the other hand, if there are some bytes left in the buffer, but we've
   // got to the end, and there's a partial message left, the "refill" flag will
-  // be set which causes us to do a forced refill (the remaining bytes will be
-  // shifted to the beginning of the buffer, and the rest filled).
+  // be set which causes us to do a forced refill (the rest of the buffer will
+  // be filled, shifting the remaining bytes to the beginning of the buffer
+  // first unless it is a mirrored ring buffer).
   if (state->remain == 0 || refill != 0) {
     // try to refill the buffer
     if ((fill_len = refill_buffer(state, format->transport)) == 0) {
@@ -499,9 +1084,9 @@ bgpstream_format_status_t bgpstream_parsebgp_populate_record(
       record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_RECORD;
       return BGPSTREAM_FORMAT_CORRUPTED_DUMP;
     }
-    // here we have something new to read
+    // here we have something new to read (refill_buffer has already moved
+    // ptr if needed)
     state->remain = fill_len;
-    state->ptr = state->buffer;
 
     // reset the "force refill" flag
     refill = 0;
@@ -520,8 +1105,7 @@ bgpstream_format_status_t bgpstream_parsebgp_populate_record(
       bgpstream_log(BGPSTREAM_LOG_ERR, "Failed to prep data buffer");
       return BGPSTREAM_FORMAT_UNKNOWN_ERROR;
     }
-    state->ptr += hdr_len;
-    state->remain -= hdr_len;
+    consume_buffer(state, hdr_len);
   }
 
   dec_len = state->remain;
@@ -548,8 +1132,14 @@ bgpstream_format_status_t bgpstream_parsebgp_populate_record(
     return BGPSTREAM_FORMAT_CORRUPTED_DUMP;
   }
   // else: successful read
-  state->ptr += dec_len;
-  state->remain -= dec_len;
+  consume_buffer(state, dec_len);
+
+  // if we are sharing buffers, give it back while we don't need it. the
+  // parsed message does not point into the buffer (we overwrite the buffer on
+  // refill anyway)
+  if (state->buf_pool != NULL && state->remain == 0) {
+    release_buffer(state);
+  }
 
   // got a message!
   // let the caller decide if they want it
@@ -613,6 +1203,15 @@ bgpstream_format_status_t bgpstream_parsebgp_populate_record(
   return BGPSTREAM_FORMAT_OK;
 }
 
+void bgpstream_parsebgp_decode_state_clear(
+  bgpstream_parsebgp_decode_state_t *state)
+{
+  bgpstream_buffer_pool_put(state->buf_pool, &state->buf);
+  state->ptr = NULL;
+  state->remain = 0;
+  state->mapped = 0;
+}
+
 void bgpstream_parsebgp_opts_init(parsebgp_opts_t *opts)
 {
   // select only the Path Attributes that we care about
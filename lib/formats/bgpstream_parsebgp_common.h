@@ -27,7 +27,11 @@
 #ifndef __BGPSTREAM_PARSEBGP_COMMON_H
 #define __BGPSTREAM_PARSEBGP_COMMON_H
 
+#include "bgpstream_buffer_pool.h"
 #include "bgpstream_elem.h"
+#include "bgpstream_elem_columns.h"
+#include "bgpstream_elem_generator.h"
+#include "bgpstream_filter.h"
 #include "bgpstream_format.h"
 #include "parsebgp.h"
 
@@ -52,7 +56,34 @@
 // read in chunks of 1MB to minimize the number of partial parses we end up
 // doing.  this is also the same length as the wandio thread buffer, so this
 // might help reduce the time waiting for locks
-#define BGPSTREAM_PARSEBGP_BUFLEN 1024 * 1024
+#define BGPSTREAM_PARSEBGP_BUFLEN BGPSTREAM_BUFFER_POOL_CHUNK_LEN
+
+/** Opaque cache of the AS paths and community sets built from the path
+ * attributes of RIB entries */
+typedef struct bgpstream_parsebgp_attr_cache bgpstream_parsebgp_attr_cache_t;
+
+/** Create a path attribute cache
+ *
+ * @return pointer to the cache if successful, NULL otherwise
+ */
+bgpstream_parsebgp_attr_cache_t *bgpstream_parsebgp_attr_cache_create();
+
+/** Destroy the given path attribute cache
+ *
+ * @param cache         pointer to the cache to destroy
+ */
+void bgpstream_parsebgp_attr_cache_destroy(
+  bgpstream_parsebgp_attr_cache_t *cache);
+
+/** Flush the given path attribute cache if it has grown too large
+ *
+ * @param cache         pointer to the cache to trim
+ *
+ * Elems share the objects in the cache, so this must only be called before
+ * the first elem of a record is extracted (when no elem that uses the cache
+ * can still be in use).
+ */
+void bgpstream_parsebgp_attr_cache_trim(bgpstream_parsebgp_attr_cache_t *cache);
 
 /** Process the given path attributes and populate the given elem
  *
@@ -66,6 +97,26 @@
 int bgpstream_parsebgp_process_path_attrs(
   bgpstream_elem_t *el, parsebgp_bgp_update_path_attr_t *attrs);
 
+/** Process the given path attributes now, or defer processing until the
+ * elem's AS path or communities are first accessed
+ *
+ * @param el            pointer to the elem to populate
+ * @param attrs         array of parsebgp path attributes to process
+ * @param lazy          set to defer processing (in which case attrs must stay
+ *                      valid until the elem is cleared or re-populated)
+ * @param cache         attribute cache to use when processing now (may be
+ *                      NULL)
+ * @return 0 if processing was successful, -1 otherwise
+ *
+ * With a cache, attributes that are identical to ones seen before are not
+ * processed again: the AS path and communities of the elem instead share the
+ * (immutable) objects that were built the first time. These stay valid until
+ * the cache is next trimmed (see bgpstream_parsebgp_attr_cache_trim).
+ */
+int bgpstream_parsebgp_handle_path_attrs(
+  bgpstream_elem_t *el, parsebgp_bgp_update_path_attr_t *attrs, int lazy,
+  bgpstream_parsebgp_attr_cache_t *cache);
+
 /** Extract the appropriate NEXT-HOP information from the given attributes
  *
  * @param el            pointer to the elem to populate
@@ -82,6 +133,53 @@ int bgpstream_parsebgp_process_next_hop(bgpstream_elem_t *el,
                                         parsebgp_bgp_update_path_attr_t *attrs,
                                         int is_mp_pfx);
 
+/** The elem filters that depend only on the elem type and prefix, compiled
+ * from the filter manager so that formats can drop an NLRI before any path
+ * attributes are processed */
+typedef struct bgpstream_parsebgp_elem_filter {
+
+  // set if any of the filters below is in use
+  int enabled;
+
+  // mask of the wanted BGPSTREAM_FILTER_ELEM_TYPE_* types (all set if there
+  // is no elem type filter)
+  uint8_t elemtype_mask;
+
+  // wanted address version (0 if any)
+  uint8_t ipversion;
+
+  // borrowed pointer to the index of the prefix filters (NULL if none)
+  const bgpstream_pfx_index_t *prefixes;
+
+} bgpstream_parsebgp_elem_filter_t;
+
+/** Compile the per-NLRI elem filters from the given filter manager
+ *
+ * @param filter        pointer to the filter context to populate
+ * @param filter_mgr    pointer to the (validated) filter manager
+ *
+ * @note the filter context borrows from the filter manager, so it must not be
+ * used after the filter manager has been destroyed
+ */
+void bgpstream_parsebgp_elem_filter_init(
+  bgpstream_parsebgp_elem_filter_t *filter,
+  bgpstream_filter_mgr_t *filter_mgr);
+
+/** Check if an elem of the given type for the given prefix could pass the
+ * elem filters
+ *
+ * @param filter        pointer to the filter context (may be NULL)
+ * @param elemtype      BGPSTREAM_FILTER_ELEM_TYPE_* type of the elem
+ * @param pfx           pointer to the elem prefix
+ * @return 1 if the elem should be generated, 0 if it is filtered out
+ *
+ * The remaining elem filters (peer, AS path, communities) are checked once the
+ * elem has been fully populated.
+ */
+int bgpstream_parsebgp_elem_filter_match(
+  bgpstream_parsebgp_elem_filter_t *filter, uint8_t elemtype,
+  bgpstream_pfx_t *pfx);
+
 /** State used when extracting elems from an UPDATE message */
 typedef struct bgpstream_parsebgp_upd_state {
 
@@ -104,33 +202,119 @@ typedef struct bgpstream_parsebgp_upd_state {
   int announce_v6_cnt;
   int announce_v6_idx;
 
-  // have path attributes been processed
+  // have path attributes been processed (into the attrs_elem given to
+  // bgpstream_parsebgp_process_update)
   int path_attr_done;
 
-  // has the native next-hop been processed
-  int next_hop_v4_done;
-
-  // has the mp_reach next-hop been processed
-  int next_hop_v6_done;
-
 } bgpstream_parsebgp_upd_state_t;
 
 /** Reset the given update state */
 void bgpstream_parsebgp_upd_state_reset(
   bgpstream_parsebgp_upd_state_t *upd_state);
 
+/** Get the number of NLRIs of the current UPDATE message that are still to be
+ * yielded as elems (some of which may yet be filtered out), or 0 if the
+ * message has not been prepared yet */
+int bgpstream_parsebgp_upd_state_remaining(
+  bgpstream_parsebgp_upd_state_t *upd_state);
+
 /** Process the given UPDATE message and extract a single elem from it
  *
  * @param upd_state     pointer to the generator state
+ * @param filter        pointer to the per-NLRI filters (may be NULL)
+ * @param lazy_attrs    set to defer processing of the path attributes until
+ *                      they are accessed
+ * @param attrs_elem    pointer to the elem that the path attributes are
+ *                      processed into (may be the same as elem)
  * @param elem          pointer to the elem to populate
  * @param bgp           pointer to a parsed BGP message
  * @return 1 if the elem was populated, 0 if there are no more elems, -1 if an
  * error occurred.
+ *
+ * NLRIs that do not pass the filters are skipped without being copied into the
+ * elem, and the path attributes are only processed (once) if at least one
+ * announcement passes. Announcements that are populated into an elem other
+ * than attrs_elem share its AS path and communities, so attrs_elem must not be
+ * cleared while they are in use.
  */
 int bgpstream_parsebgp_process_update(bgpstream_parsebgp_upd_state_t *upd_state,
+                                      bgpstream_parsebgp_elem_filter_t *filter,
+                                      int lazy_attrs,
+                                      bgpstream_elem_t *attrs_elem,
                                       bgpstream_elem_t *elem,
                                       parsebgp_bgp_msg_t *bgp);
 
+/** Extract the next elem of a record into the given elem
+ *
+ * @param format        pointer to the format object to use
+ * @param record        pointer to the record to extract the elem from
+ * @param elem          pointer to a cleared elem to populate
+ * @return 1 if the elem was populated, 0 if there are no more elems, -1 if an
+ * error occurred.
+ */
+typedef int(bgpstream_parsebgp_gen_elem_cb_t)(bgpstream_format_t *format,
+                                              bgpstream_record_t *record,
+                                              bgpstream_elem_t *elem);
+
+/** Get the number of elems that a record may still yield
+ *
+ * @param format        pointer to the format object to use
+ * @param record        pointer to the record
+ * @return an upper bound on the number of elems still to be extracted
+ */
+typedef int(bgpstream_parsebgp_remaining_cb_t)(bgpstream_format_t *format,
+                                               bgpstream_record_t *record);
+
+/** Extract a batch of elems that pass the filters (see
+ * bgpstream_format_get_elems)
+ *
+ * @param batch         pointer to the record's elem generator (created if
+ *                      NULL)
+ * @param format        pointer to the format object to use
+ * @param record        pointer to the record to extract elems from
+ * @param gen_cb        callback that extracts the next elem of the record
+ * @param remaining_cb  callback that bounds the number of elems left
+ * @param check_cb      callback that checks an elem against the filters
+ * @param elems         array to fill with borrowed pointers to the elems
+ * @param max           maximum number of elems to extract
+ * @return the number of elems extracted (0 at end-of-elems), or -1 if an error
+ * occurred.
+ *
+ * Each elem is generated directly into its own slot of the generator, and a
+ * slot whose elem is filtered out is reused for the next one. The elems stay
+ * valid until the next call for the same record, or until the record is
+ * cleared.
+ */
+int bgpstream_parsebgp_get_elems(
+  bgpstream_elem_generator_t **batch, bgpstream_format_t *format,
+  bgpstream_record_t *record, bgpstream_parsebgp_gen_elem_cb_t *gen_cb,
+  bgpstream_parsebgp_remaining_cb_t *remaining_cb,
+  bgpstream_format_elem_check_cb_t *check_cb, bgpstream_elem_t **elems,
+  int max);
+
+/** Append the elems that pass the filters to a columnar elem batch (see
+ * bgpstream_format_get_elem_columns)
+ *
+ * @param format        pointer to the format object to use
+ * @param record        pointer to the record to extract elems from
+ * @param elem          pointer to the record's reusable elem
+ * @param lazy_attrs    pointer to the record's lazy path attributes flag
+ * @param gen_cb        callback that extracts the next elem of the record
+ * @param check_cb      callback that checks an elem against the filters
+ * @param cols          pointer to the batch to append to
+ * @return 1 if the batch filled up, 0 at end-of-elems, or -1 if an error
+ * occurred.
+ *
+ * The path attributes are decoded lazily while the columns are filled, so the
+ * communities are never decoded, and the AS path is only decoded for elems
+ * that have origin and path ID columns (and, for an UPDATE, only once).
+ */
+int bgpstream_parsebgp_get_elem_columns(
+  bgpstream_format_t *format, bgpstream_record_t *record,
+  bgpstream_elem_t *elem, int *lazy_attrs,
+  bgpstream_parsebgp_gen_elem_cb_t *gen_cb,
+  bgpstream_format_elem_check_cb_t *check_cb, bgpstream_elem_columns_t *cols);
+
 typedef struct bgpstream_parsebgp_decode_state {
 
   // outer message type to decode (MRT or BMP)
@@ -139,15 +323,26 @@ typedef struct bgpstream_parsebgp_decode_state {
   // options for libparsebgp
   parsebgp_opts_t parser_opts;
 
-  // raw data buffer
+  // raw data buffer (allocated on the first read, and grown if a single
+  // message does not fit). if the buffer is mirrored it is used as a ring, so
+  // unread data never needs to be moved to make room for a refill.
   // TODO: once parsebgp supports reading using a read callback, just pass the
   // transport callback to the parser
-  uint8_t buffer[BGPSTREAM_PARSEBGP_BUFLEN];
+  bgpstream_buffer_t buf;
+
+  // borrowed pointer to a shared buffer pool. if set, the buffer is given back
+  // to the pool whenever it has been fully consumed
+  bgpstream_buffer_pool_t *buf_pool;
+
+  // set once the transport's in-memory content (if it has any) has been handed
+  // to the parser. in that case ptr points into the transport's content
+  // rather than into buf
+  int mapped;
 
   // number of bytes left to read in the buffer
   size_t remain;
 
-  // pointer into buffer
+  // pointer into buffer (always within the first copy of a mirrored buffer)
   uint8_t *ptr;
 
   // the total number of successful (filtered and not) reads
@@ -214,6 +409,13 @@ bgpstream_format_status_t bgpstream_parsebgp_populate_record(
   bgpstream_parsebgp_prep_buf_cb_t *prep_cb,
   bgpstream_parsebgp_check_filter_cb_t *filter_cb);
 
+/** Release the resources held by the given decode state
+ *
+ * @param state         pointer to the decode state
+ */
+void bgpstream_parsebgp_decode_state_clear(
+  bgpstream_parsebgp_decode_state_t *state);
+
 /** Set options specific to how we use libparsebgp in BGPStream */
 void bgpstream_parsebgp_opts_init(parsebgp_opts_t *opts);
 
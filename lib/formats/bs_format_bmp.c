@@ -25,6 +25,7 @@
  */
 
 #include "bs_format_bmp.h"
+#include "bgpstream_elem_generator.h"
 #include "bgpstream_format_interface.h"
 #include "bgpstream_record_int.h"
 #include "bgpstream_log.h"
@@ -38,21 +39,25 @@
 
 typedef struct rec_data {
 
-  // reusable elem instance
+  // reusable elem instance (which also holds the path attributes that the
+  // elems in a batch share)
   bgpstream_elem_t *elem;
 
   // have we extracted all the possible elems out of the current message?
   int end_of_elems;
 
-  // have we extracted the peer header info into the elem?
-  int peer_hdr_done;
-
   // state for UPDATE elem extraction
   bgpstream_parsebgp_upd_state_t upd_state;
 
+  // should path attributes be decoded only when they are accessed
+  int lazy_attrs;
+
   // reusable parser message structure
   parsebgp_msg_t *msg;
 
+  // pool of elems returned by get_elems (created on first use)
+  bgpstream_elem_generator_t *batch;
+
 } rec_data_t;
 
 typedef struct state {
@@ -60,13 +65,19 @@ typedef struct state {
   // parsebgp decode wrapper state
   bgpstream_parsebgp_decode_state_t decoder;
 
+  // elem filters compiled for the UPDATE (and RIB) elem generators
+  bgpstream_parsebgp_elem_filter_t elem_filter;
+
 } state_t;
 
-static int handle_update(rec_data_t *rd, parsebgp_bgp_msg_t *bgp)
+static int handle_update(rec_data_t *rd,
+                         bgpstream_parsebgp_elem_filter_t *elem_filter,
+                         bgpstream_elem_t *el, parsebgp_bgp_msg_t *bgp)
 {
   int rc;
 
-  if ((rc = bgpstream_parsebgp_process_update(&rd->upd_state, rd->elem,
+  if ((rc = bgpstream_parsebgp_process_update(&rd->upd_state, elem_filter,
+                                              rd->lazy_attrs, rd->elem, el,
                                               bgp)) < 0) {
     return rc;
   }
@@ -76,17 +87,18 @@ static int handle_update(rec_data_t *rd, parsebgp_bgp_msg_t *bgp)
   return rc;
 }
 
-static int handle_peer_up_down(rec_data_t *rd, int peer_up)
+static int handle_peer_up_down(rec_data_t *rd, bgpstream_elem_t *el,
+                               int peer_up)
 {
-  rd->elem->type = BGPSTREAM_ELEM_TYPE_PEERSTATE;
+  el->type = BGPSTREAM_ELEM_TYPE_PEERSTATE;
 
   // TODO: fix this after talking with Tim
   // it is possible we can assume UP means IDLE->ACTIVE
-  rd->elem->old_state = BGPSTREAM_ELEM_PEERSTATE_UNKNOWN;
+  el->old_state = BGPSTREAM_ELEM_PEERSTATE_UNKNOWN;
   if (peer_up) {
-    rd->elem->new_state = BGPSTREAM_ELEM_PEERSTATE_ACTIVE;
+    el->new_state = BGPSTREAM_ELEM_PEERSTATE_ACTIVE;
   } else {
-    rd->elem->new_state = BGPSTREAM_ELEM_PEERSTATE_IDLE;
+    el->new_state = BGPSTREAM_ELEM_PEERSTATE_IDLE;
   }
 
   rd->end_of_elems = 1;
@@ -387,6 +399,9 @@ int bs_format_bmp_create(bgpstream_format_t *format,
   }
 
   STATE->decoder.msg_type = PARSEBGP_MSG_TYPE_BMP;
+  STATE->decoder.buf_pool = format->buf_pool;
+
+  bgpstream_parsebgp_elem_filter_init(&STATE->elem_filter, format->filter_mgr);
 
   opts = &STATE->decoder.parser_opts;
   parsebgp_opts_init(opts);
@@ -410,13 +425,11 @@ bs_format_bmp_populate_record(bgpstream_format_t *format,
                                             populate_filter_cb);
 }
 
-int bs_format_bmp_get_next_elem(bgpstream_format_t *format,
-                                bgpstream_record_t *record,
-                                bgpstream_elem_t **elem)
+// extract the next elem of the record into the given elem
+static int gen_elem(bgpstream_format_t *format, bgpstream_record_t *record,
+                    bgpstream_elem_t *el)
 {
   parsebgp_bmp_msg_t *bmp;
-  int rc = 0;
-  *elem = NULL;
 
   if (RDATA == NULL || RDATA->end_of_elems != 0) {
     // end-of-elems
@@ -427,31 +440,51 @@ int bs_format_bmp_get_next_elem(bgpstream_format_t *format,
 
   // assume we'll find at least something juicy, so process the peer header and
   // fill the common parts of the elem
-  if (RDATA->peer_hdr_done == 0 && handle_peer_hdr(RDATA->elem, bmp) != 0) {
+  if (handle_peer_hdr(el, bmp) != 0) {
     return -1;
   }
-  RDATA->peer_hdr_done = 1;
 
   // what kind of BMP message are we dealing with?
   switch (bmp->type) {
   case PARSEBGP_BMP_TYPE_ROUTE_MON:
     // TODO: explicitly handle end-of-RIB marker
-    rc = handle_update(RDATA, bmp->types.route_mon);
-    break;
+    return handle_update(RDATA, &STATE->elem_filter, el, bmp->types.route_mon);
 
   case PARSEBGP_BMP_TYPE_PEER_DOWN:
-    rc = handle_peer_up_down(RDATA, 0);
-    break;
+    return handle_peer_up_down(RDATA, el, 0);
 
   case PARSEBGP_BMP_TYPE_PEER_UP:
-    rc = handle_peer_up_down(RDATA, 1);
-    break;
+    return handle_peer_up_down(RDATA, el, 1);
 
   default:
     // not implemented
     return 0;
   }
-  if (rc <= 0) {
+}
+
+// how many more elems (at most) the current record will yield
+static int remaining_elem_cnt(bgpstream_format_t *format,
+                              bgpstream_record_t *record)
+{
+  if (RDATA->end_of_elems != 0) {
+    return 0;
+  }
+
+  // (zero for anything other than a route monitoring message)
+  return bgpstream_parsebgp_upd_state_remaining(&RDATA->upd_state);
+}
+
+int bs_format_bmp_get_next_elem(bgpstream_format_t *format,
+                                bgpstream_record_t *record,
+                                bgpstream_elem_t **elem)
+{
+  int rc;
+
+  *elem = NULL;
+  if (RDATA == NULL) {
+    return 0;
+  }
+  if ((rc = gen_elem(format, record, RDATA->elem)) <= 0) {
     return rc;
   }
 
@@ -460,6 +493,32 @@ int bs_format_bmp_get_next_elem(bgpstream_format_t *format,
   return 1;
 }
 
+int bs_format_bmp_get_elems(bgpstream_format_t *format,
+                            bgpstream_record_t *record,
+                            bgpstream_format_elem_check_cb_t *check_cb,
+                            bgpstream_elem_t **elems, int max)
+{
+  if (RDATA == NULL) {
+    return 0;
+  }
+  return bgpstream_parsebgp_get_elems(&RDATA->batch, format, record, gen_elem,
+                                      remaining_elem_cnt, check_cb, elems,
+                                      max);
+}
+
+int bs_format_bmp_get_elem_columns(bgpstream_format_t *format,
+                                    bgpstream_record_t *record,
+                                    bgpstream_format_elem_check_cb_t *check_cb,
+                                    bgpstream_elem_columns_t *cols)
+{
+  if (RDATA == NULL) {
+    return 0;
+  }
+  return bgpstream_parsebgp_get_elem_columns(format, record, RDATA->elem,
+                                             &RDATA->lazy_attrs, gen_elem,
+                                             check_cb, cols);
+}
+
 int bs_format_bmp_init_data(bgpstream_format_t *format, void **data)
 {
   rec_data_t *rd;
@@ -477,6 +536,8 @@ int bs_format_bmp_init_data(bgpstream_format_t *format, void **data)
     return -1;
   }
 
+  rd->lazy_attrs = format->lazy_elem_attrs;
+
   *data = rd;
   return 0;
 }
@@ -487,7 +548,6 @@ void bs_format_bmp_clear_data(bgpstream_format_t *format, void *data)
   assert(rd != NULL);
   bgpstream_elem_clear(rd->elem);
   rd->end_of_elems = 0;
-  rd->peer_hdr_done = 0;
   bgpstream_parsebgp_upd_state_reset(&rd->upd_state);
   parsebgp_clear_msg(rd->msg);
 }
@@ -500,6 +560,8 @@ void bs_format_bmp_destroy_data(bgpstream_format_t *format, void *data)
   }
   bgpstream_elem_destroy(rd->elem);
   rd->elem = NULL;
+  bgpstream_elem_generator_destroy(rd->batch);
+  rd->batch = NULL;
   parsebgp_destroy_msg(rd->msg);
   rd->msg = NULL;
   free(data);
@@ -507,6 +569,8 @@ void bs_format_bmp_destroy_data(bgpstream_format_t *format, void *data)
 
 void bs_format_bmp_destroy(bgpstream_format_t *format)
 {
+  bgpstream_parsebgp_decode_state_clear(&STATE->decoder);
+
   free(format->state);
   format->state = NULL;
 }
@@ -25,12 +25,14 @@
  */
 
 #include "bs_format_mrt.h"
+#include "bgpstream_elem_generator.h"
 #include "bgpstream_format_interface.h"
 #include "bgpstream_record_int.h"
 #include "bgpstream_log.h"
 #include "bgpstream_parsebgp_common.h"
 #include "utils.h"
 #include <assert.h>
+#include <pthread.h>
 
 #define STATE ((state_t*)(format->state))
 
@@ -44,14 +46,29 @@ typedef struct peer_index_entry {
   /** Peer IP */
   bgpstream_addr_storage_t peer_ip;
 
+  /** Set if the elem filters remove everything from this peer */
+  int filtered;
+
 } peer_index_entry_t;
 
 KHASH_INIT(td2_peer, int, peer_index_entry_t, 1, kh_int_hash_func,
            kh_int_hash_equal);
 
+typedef struct peer_table {
+
+  // peer index -> peer info
+  khash_t(td2_peer) *peers;
+
+  // references held by the format state (while this is the current table) and
+  // by the records whose RIB entries refer to it
+  int ref_cnt;
+
+} peer_table_t;
+
 typedef struct rec_data {
 
-  // reusable elem instance
+  // reusable elem instance (which also holds the path attributes that the
+  // elems of an UPDATE in a batch share)
   bgpstream_elem_t *elem;
 
   // have we extracted all the possible elems out of the current message?
@@ -63,9 +80,23 @@ typedef struct rec_data {
   // state for UPDATE elem extraction
   bgpstream_parsebgp_upd_state_t upd_state;
 
+  // should path attributes be decoded only when they are accessed
+  int lazy_attrs;
+
+  // cache of the path attributes of RIB entries (borrowed from the state)
+  bgpstream_parsebgp_attr_cache_t *attr_cache;
+
   // reusable parser message structure
   parsebgp_msg_t *msg;
 
+  // pool of elems returned by get_elems (created on first use)
+  bgpstream_elem_generator_t *batch;
+
+  // peer index table that was current when this (TABLE_DUMP_V2) record was
+  // read. the record holds a reference, since with decode-ahead a newer
+  // table may be read before the elems of this record are extracted
+  peer_table_t *peer_table;
+
 } rec_data_t;
 
 typedef struct state {
@@ -73,17 +104,30 @@ typedef struct state {
   // parsebgp decode wrapper state
   bgpstream_parsebgp_decode_state_t decoder;
 
+  // elem filters compiled for the UPDATE (and RIB) elem generators
+  bgpstream_parsebgp_elem_filter_t elem_filter;
+
   // state to store the "peer index table" when reading TABLE_DUMP_V2 records
-  khash_t(td2_peer) *peer_table;
+  peer_table_t *peer_table;
+
+  // protects the table reference counts. references are taken by the decoding
+  // thread but may be dropped by whichever thread clears a record
+  pthread_mutex_t peer_table_mutex;
+
+  // RIB entries of the same peer tend to share their path attributes, so
+  // their AS paths and communities are only built once
+  bgpstream_parsebgp_attr_cache_t *attr_cache;
 
 } state_t;
 
-static int handle_table_dump(rec_data_t *rd,
+static int handle_table_dump(rec_data_t *rd, bgpstream_elem_t *el,
                              parsebgp_mrt_msg_t *mrt)
 {
-  bgpstream_elem_t *el = rd->elem;
   parsebgp_mrt_table_dump_t *td = mrt->types.table_dump;
 
+  // no elem of a previous record is still using the cache
+  bgpstream_parsebgp_attr_cache_trim(rd->attr_cache);
+
   // legacy table dump format is basically an elem
   el->type = BGPSTREAM_ELEM_TYPE_RIB;
   el->orig_time_sec = td->originated_time;
@@ -101,7 +145,9 @@ static int handle_table_dump(rec_data_t *rd,
     return -1;
   }
 
-  if (bgpstream_parsebgp_process_path_attrs(el, td->path_attrs.attrs) != 0) {
+  if (bgpstream_parsebgp_handle_path_attrs(el, td->path_attrs.attrs,
+                                           rd->lazy_attrs,
+                                           rd->attr_cache) != 0) {
     return -1;
   }
 
@@ -111,40 +157,28 @@ static int handle_table_dump(rec_data_t *rd,
   return 1;
 }
 
-static int handle_td2_rib_entry(rec_data_t *rd,
-                                khash_t(td2_peer) *peer_table,
-                                parsebgp_mrt_msg_t *mrt,
+static int handle_td2_rib_entry(rec_data_t *rd, bgpstream_elem_t *el,
+                                peer_index_entry_t *bs_pie,
                                 parsebgp_bgp_afi_t afi,
                                 parsebgp_mrt_table_dump_v2_rib_entry_t *re)
 {
-  peer_index_entry_t *bs_pie;
-  khiter_t k;
-
-  rd->elem->orig_time_sec = re->originated_time;
-  rd->elem->orig_time_usec = 0;
+  el->orig_time_sec = re->originated_time;
+  el->orig_time_usec = 0;
 
-  // look the peer up in the peer index table
-  if ((k = kh_get(td2_peer, peer_table, re->peer_index)) ==
-      kh_end(peer_table)) {
-    bgpstream_log(BGPSTREAM_LOG_ERR,
-                  "Missing Peer Index Table entry for Peer ID %d",
-                  re->peer_index);
-    return -1;
-  }
-  bs_pie = &kh_val(peer_table, k);
-  bgpstream_addr_copy((bgpstream_ip_addr_t *)&rd->elem->peer_ip,
+  bgpstream_addr_copy((bgpstream_ip_addr_t *)&el->peer_ip,
                       (bgpstream_ip_addr_t *)&bs_pie->peer_ip);
 
-  rd->elem->peer_asn = bs_pie->peer_asn;
+  el->peer_asn = bs_pie->peer_asn;
 
   if (bgpstream_parsebgp_process_next_hop(
-        rd->elem, re->path_attrs.attrs,
+        el, re->path_attrs.attrs,
         afi == PARSEBGP_BGP_AFI_IPV6 ? 1 : 0) != 0) {
     return -1;
   }
 
-  if (bgpstream_parsebgp_process_path_attrs(rd->elem,
-                                            re->path_attrs.attrs) != 0) {
+  if (bgpstream_parsebgp_handle_path_attrs(el, re->path_attrs.attrs,
+                                           rd->lazy_attrs,
+                                           rd->attr_cache) != 0) {
     return -1;
   }
 
@@ -152,16 +186,26 @@ static int handle_td2_rib_entry(rec_data_t *rd,
 }
 
 static int
-handle_td2_afi_safi_rib(rec_data_t *rd, khash_t(td2_peer) * peer_table,
+handle_td2_afi_safi_rib(rec_data_t *rd, bgpstream_elem_t *el,
+                        bgpstream_parsebgp_elem_filter_t *elem_filter,
+                        khash_t(td2_peer) * peer_table,
                         parsebgp_mrt_msg_t *mrt, parsebgp_bgp_afi_t afi,
                         parsebgp_mrt_table_dump_v2_afi_safi_rib_t *asr)
 {
-  // if this is the first time we've been called, prep the elem
+  parsebgp_mrt_table_dump_v2_rib_entry_t *re = NULL;
+  peer_index_entry_t *bs_pie = NULL;
+  khiter_t k;
+
+  // every entry is for the same prefix (the other elem fields are specific to
+  // the entry)
+  el->type = BGPSTREAM_ELEM_TYPE_RIB;
+  COPY_IP(&el->prefix.address, afi, asr->prefix, return 0);
+  el->prefix.mask_len = asr->prefix_len;
+
+  // if this is the first time we've been called, check the whole message
   if (rd->next_re == 0) {
-    rd->elem->type = BGPSTREAM_ELEM_TYPE_RIB;
-    COPY_IP(&rd->elem->prefix.address, afi, asr->prefix, return 0);
-    rd->elem->prefix.mask_len = asr->prefix_len;
-    // other elem fields are specific to the entry
+    // no elem of a previous record is still using the cache
+    bgpstream_parsebgp_attr_cache_trim(rd->attr_cache);
 
     // if we haven't seen a peer index table yet, then just give up
     if (peer_table == NULL) {
@@ -169,11 +213,40 @@ handle_td2_afi_safi_rib(rec_data_t *rd, khash_t(td2_peer) * peer_table,
                     "Missing Peer Index Table, skipping RIB entry");
       return -1;
     }
+
+    // if the prefix is filtered out, then so are all of its entries
+    if (bgpstream_parsebgp_elem_filter_match(
+          elem_filter, BGPSTREAM_FILTER_ELEM_TYPE_RIB,
+          (bgpstream_pfx_t *)&el->prefix) == 0) {
+      rd->end_of_elems = 1;
+      return 0;
+    }
+  }
+
+  // since this is a generator, we just process one rib entry each time,
+  // skipping over entries from peers that are filtered out
+  for (; rd->next_re < asr->entry_count; rd->next_re++) {
+    re = &asr->entries[rd->next_re];
+
+    // look the peer up in the peer index table
+    if ((k = kh_get(td2_peer, peer_table, re->peer_index)) ==
+        kh_end(peer_table)) {
+      bgpstream_log(BGPSTREAM_LOG_ERR,
+                    "Missing Peer Index Table entry for Peer ID %d",
+                    re->peer_index);
+      return -1;
+    }
+    bs_pie = &kh_val(peer_table, k);
+    if (bs_pie->filtered == 0) {
+      break;
+    }
+  }
+  if (rd->next_re == asr->entry_count) {
+    rd->end_of_elems = 1;
+    return 0;
   }
 
-  // since this is a generator, we just process one rib entry each time
-  if (handle_td2_rib_entry(rd, peer_table, mrt, afi,
-                           &asr->entries[rd->next_re]) != 0) {
+  if (handle_td2_rib_entry(rd, el, bs_pie, afi, re) != 0) {
     return -1;
   }
 
@@ -186,7 +259,8 @@ handle_td2_afi_safi_rib(rec_data_t *rd, khash_t(td2_peer) * peer_table,
   return 1;
 }
 
-static int handle_table_dump_v2(rec_data_t *rd,
+static int handle_table_dump_v2(rec_data_t *rd, bgpstream_elem_t *el,
+                                bgpstream_parsebgp_elem_filter_t *elem_filter,
                                 khash_t(td2_peer) *peer_table,
                                 parsebgp_mrt_msg_t *mrt)
 {
@@ -204,11 +278,11 @@ static int handle_table_dump_v2(rec_data_t *rd,
     break;
 
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
-    return handle_td2_afi_safi_rib(rd, peer_table, mrt, PARSEBGP_BGP_AFI_IPV4,
-                                   &td2->afi_safi_rib);
+    return handle_td2_afi_safi_rib(rd, el, elem_filter, peer_table, mrt,
+                                   PARSEBGP_BGP_AFI_IPV4, &td2->afi_safi_rib);
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
-    return handle_td2_afi_safi_rib(rd, peer_table, mrt, PARSEBGP_BGP_AFI_IPV6,
-                                   &td2->afi_safi_rib);
+    return handle_td2_afi_safi_rib(rd, el, elem_filter, peer_table, mrt,
+                                   PARSEBGP_BGP_AFI_IPV6, &td2->afi_safi_rib);
     break;
 
   default:
@@ -219,40 +293,43 @@ static int handle_table_dump_v2(rec_data_t *rd,
   return 0;
 }
 
-static int handle_bgp4mp_state_change(rec_data_t *rd,
+static int handle_bgp4mp_state_change(rec_data_t *rd, bgpstream_elem_t *el,
                                       parsebgp_mrt_bgp4mp_t *bgp4mp)
 {
-  rd->elem->type = BGPSTREAM_ELEM_TYPE_PEERSTATE;
-  rd->elem->old_state = bgp4mp->data.state_change.old_state;
-  rd->elem->new_state = bgp4mp->data.state_change.new_state;
+  el->type = BGPSTREAM_ELEM_TYPE_PEERSTATE;
+  el->old_state = bgp4mp->data.state_change.old_state;
+  el->new_state = bgp4mp->data.state_change.new_state;
   rd->end_of_elems = 1;
   return 1;
 }
 
-static int handle_bgp4mp(rec_data_t *rd, parsebgp_mrt_msg_t *mrt)
+static int handle_bgp4mp(rec_data_t *rd, bgpstream_elem_t *el,
+                         bgpstream_parsebgp_elem_filter_t *elem_filter,
+                         parsebgp_mrt_msg_t *mrt)
 {
   int rc = 0;
   parsebgp_mrt_bgp4mp_t *bgp4mp = mrt->types.bgp4mp;
 
   // no originated time information in BGP4MP
-  rd->elem->orig_time_sec = 0;
-  rd->elem->orig_time_usec = 0;
+  el->orig_time_sec = 0;
+  el->orig_time_usec = 0;
 
-  COPY_IP(&rd->elem->peer_ip, bgp4mp->afi, bgp4mp->peer_ip, return 0);
-  rd->elem->peer_asn = bgp4mp->peer_asn;
+  COPY_IP(&el->peer_ip, bgp4mp->afi, bgp4mp->peer_ip, return 0);
+  el->peer_asn = bgp4mp->peer_asn;
   // other elem fields are specific to the message
 
   switch (mrt->subtype) {
   case PARSEBGP_MRT_BGP4MP_STATE_CHANGE:
   case PARSEBGP_MRT_BGP4MP_STATE_CHANGE_AS4:
-    rc = handle_bgp4mp_state_change(rd, bgp4mp);
+    rc = handle_bgp4mp_state_change(rd, el, bgp4mp);
     break;
 
   case PARSEBGP_MRT_BGP4MP_MESSAGE:
   case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
   case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
   case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
-    rc = bgpstream_parsebgp_process_update(&rd->upd_state, rd->elem,
+    rc = bgpstream_parsebgp_process_update(&rd->upd_state, elem_filter,
+                                           rd->lazy_attrs, rd->elem, el,
                                            bgp4mp->data.bgp_msg);
     if (rc == 0) {
       rd->end_of_elems = 1;
@@ -270,6 +347,34 @@ static int handle_bgp4mp(rec_data_t *rd, parsebgp_mrt_msg_t *mrt)
 
 /* -------------------- RECORD FILTERING -------------------- */
 
+static peer_table_t *peer_table_ref(state_t *state, peer_table_t *pt)
+{
+  if (pt == NULL) {
+    return NULL;
+  }
+  pthread_mutex_lock(&state->peer_table_mutex);
+  pt->ref_cnt++;
+  pthread_mutex_unlock(&state->peer_table_mutex);
+  return pt;
+}
+
+static void peer_table_unref(state_t *state, peer_table_t *pt)
+{
+  int ref_cnt;
+
+  if (pt == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&state->peer_table_mutex);
+  ref_cnt = --pt->ref_cnt;
+  pthread_mutex_unlock(&state->peer_table_mutex);
+
+  if (ref_cnt == 0) {
+    kh_destroy(td2_peer, pt->peers);
+    free(pt);
+  }
+}
+
 static int is_wanted_time(uint32_t record_time,
                           bgpstream_filter_mgr_t *filter_mgr)
 {
@@ -300,29 +405,51 @@ static int handle_td2_peer_index(bgpstream_format_t *format,
   int i;
   khiter_t k;
   int khret;
+  peer_table_t *pt;
   peer_index_entry_t *bs_pie;
   parsebgp_mrt_table_dump_v2_peer_entry_t *pie;
 
   // alloc the table hash
-  if ((STATE->peer_table = kh_init(td2_peer)) == NULL) {
+  if ((pt = malloc_zero(sizeof(peer_table_t))) == NULL) {
     return -1;
   }
+  pt->ref_cnt = 1;
+  if ((pt->peers = kh_init(td2_peer)) == NULL) {
+    goto err;
+  }
 
   // add peers to the table
   for (i = 0; i < pi->peer_count; i++) {
-    k = kh_put(td2_peer, STATE->peer_table, i, &khret);
+    k = kh_put(td2_peer, pt->peers, i, &khret);
     if (khret == -1) {
-      return -1;
+      goto err;
     }
 
     pie = &pi->peer_entries[i];
-    bs_pie = &kh_val(STATE->peer_table, k);
+    bs_pie = &kh_val(pt->peers, k);
 
     bs_pie->peer_asn = pie->asn;
-    COPY_IP(&bs_pie->peer_ip, pie->ip_afi, pie->ip, return -1);
+    COPY_IP(&bs_pie->peer_ip, pie->ip_afi, pie->ip, goto err);
+
+    // the peer ASN filter is checked once here rather than for every entry
+    bs_pie->filtered =
+      (format->filter_mgr->peer_asns != NULL &&
+       bgpstream_id_set_exists(format->filter_mgr->peer_asns, pie->asn) == 0);
   }
 
+  // a dump may contain more than one table. records read before this one keep
+  // their reference to the table they were read with
+  peer_table_unref(STATE, STATE->peer_table);
+  STATE->peer_table = pt;
+
   return 0;
+
+err:
+  if (pt->peers != NULL) {
+    kh_destroy(td2_peer, pt->peers);
+  }
+  free(pt);
+  return -1;
 }
 
 static bgpstream_parsebgp_check_filter_rc_t
@@ -332,10 +459,9 @@ populate_filter_cb(bgpstream_format_t *format, bgpstream_record_t *record,
   uint32_t ts_sec;
   assert(msg->type == PARSEBGP_MSG_TYPE_MRT);
 
-  // if this is a peer index table message, we parse it now and move on (we
-  // could also add a "filtered" flag to the peer_index_entry_t struct so that
-  // when elem parsing happens it can quickly filter out unwanted peers
-  // without having to check ASN or IP
+  // if this is a peer index table message, we parse it now and move on (peers
+  // that are filtered out are flagged so that elem parsing can skip their
+  // entries without processing any path attributes)
   if (msg->types.mrt->type == PARSEBGP_MRT_TYPE_TABLE_DUMP_V2 &&
       msg->types.mrt->subtype ==
       PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE) {
@@ -369,7 +495,11 @@ populate_filter_cb(bgpstream_format_t *format, bgpstream_record_t *record,
   }
 
   if (is_wanted_time(ts_sec, format->filter_mgr) != 0) {
-    // we want this entry
+    // we want this entry, so pin the peer index table its RIB entries refer to
+    if (msg->types.mrt->type == PARSEBGP_MRT_TYPE_TABLE_DUMP_V2) {
+      peer_table_unref(STATE, RDATA->peer_table);
+      RDATA->peer_table = peer_table_ref(STATE, STATE->peer_table);
+    }
     return BGPSTREAM_PARSEBGP_KEEP;
   } else {
     return BGPSTREAM_PARSEBGP_FILTER_OUT;
@@ -387,8 +517,16 @@ int bs_format_mrt_create(bgpstream_format_t *format,
   if ((format->state = malloc_zero(sizeof(state_t))) == NULL) {
     return -1;
   }
+  pthread_mutex_init(&STATE->peer_table_mutex, NULL);
 
   STATE->decoder.msg_type = PARSEBGP_MSG_TYPE_MRT;
+  STATE->decoder.buf_pool = format->buf_pool;
+
+  bgpstream_parsebgp_elem_filter_init(&STATE->elem_filter, format->filter_mgr);
+
+  if ((STATE->attr_cache = bgpstream_parsebgp_attr_cache_create()) == NULL) {
+    return -1;
+  }
 
   opts = &STATE->decoder.parser_opts;
   parsebgp_opts_init(opts);
@@ -405,14 +543,11 @@ bs_format_mrt_populate_record(bgpstream_format_t *format,
                                             record, NULL, populate_filter_cb);
 }
 
-int bs_format_mrt_get_next_elem(bgpstream_format_t *format,
-                                bgpstream_record_t *record,
-                                bgpstream_elem_t **elem)
+// extract the next elem of the record into the given elem
+static int gen_elem(bgpstream_format_t *format, bgpstream_record_t *record,
+                    bgpstream_elem_t *el)
 {
   parsebgp_mrt_msg_t *mrt;
-  int rc;
-
-  *elem = NULL;
 
   if (RDATA == NULL || RDATA->end_of_elems != 0) {
     // end-of-elems
@@ -422,27 +557,57 @@ int bs_format_mrt_get_next_elem(bgpstream_format_t *format,
   mrt = RDATA->msg->types.mrt;
   switch (mrt->type) {
   case PARSEBGP_MRT_TYPE_TABLE_DUMP:
-    rc = handle_table_dump(RDATA, mrt);
-    break;
+    return handle_table_dump(RDATA, el, mrt);
 
   case PARSEBGP_MRT_TYPE_TABLE_DUMP_V2:
-    rc = handle_table_dump_v2(RDATA, STATE->peer_table, mrt);
-    break;
+    return handle_table_dump_v2(RDATA, el, &STATE->elem_filter,
+                                (RDATA->peer_table != NULL) ?
+                                  RDATA->peer_table->peers : NULL,
+                                mrt);
 
   case PARSEBGP_MRT_TYPE_BGP4MP:
   case PARSEBGP_MRT_TYPE_BGP4MP_ET:
-    rc = handle_bgp4mp(RDATA, mrt);
-    break;
+    return handle_bgp4mp(RDATA, el, &STATE->elem_filter, mrt);
 
   default:
     // a type we don't care about, so return end-of-elems
     bgpstream_log(BGPSTREAM_LOG_WARN, "Skipping unknown MRT record type %d",
                   mrt->type);
-    rc = 0;
-    break;
+    return 0;
+  }
+}
+
+// how many more elems (at most) the current record will yield
+static int remaining_elem_cnt(bgpstream_format_t *format,
+                              bgpstream_record_t *record)
+{
+  parsebgp_mrt_msg_t *mrt = RDATA->msg->types.mrt;
+
+  if (RDATA->end_of_elems != 0) {
+    return 0;
   }
 
-  if (rc <= 0) {
+  if (mrt->type == PARSEBGP_MRT_TYPE_TABLE_DUMP_V2 &&
+      (mrt->subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST ||
+       mrt->subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST)) {
+    return mrt->types.table_dump_v2->afi_safi_rib.entry_count - RDATA->next_re;
+  }
+
+  // (zero for anything other than an UPDATE)
+  return bgpstream_parsebgp_upd_state_remaining(&RDATA->upd_state);
+}
+
+int bs_format_mrt_get_next_elem(bgpstream_format_t *format,
+                                bgpstream_record_t *record,
+                                bgpstream_elem_t **elem)
+{
+  int rc;
+
+  *elem = NULL;
+  if (RDATA == NULL) {
+    return 0;
+  }
+  if ((rc = gen_elem(format, record, RDATA->elem)) <= 0) {
     return rc;
   }
 
@@ -451,6 +616,32 @@ int bs_format_mrt_get_next_elem(bgpstream_format_t *format,
   return 1;
 }
 
+int bs_format_mrt_get_elems(bgpstream_format_t *format,
+                            bgpstream_record_t *record,
+                            bgpstream_format_elem_check_cb_t *check_cb,
+                            bgpstream_elem_t **elems, int max)
+{
+  if (RDATA == NULL) {
+    return 0;
+  }
+  return bgpstream_parsebgp_get_elems(&RDATA->batch, format, record, gen_elem,
+                                      remaining_elem_cnt, check_cb, elems,
+                                      max);
+}
+
+int bs_format_mrt_get_elem_columns(bgpstream_format_t *format,
+                                    bgpstream_record_t *record,
+                                    bgpstream_format_elem_check_cb_t *check_cb,
+                                    bgpstream_elem_columns_t *cols)
+{
+  if (RDATA == NULL) {
+    return 0;
+  }
+  return bgpstream_parsebgp_get_elem_columns(format, record, RDATA->elem,
+                                             &RDATA->lazy_attrs, gen_elem,
+                                             check_cb, cols);
+}
+
 int bs_format_mrt_init_data(bgpstream_format_t *format, void **data)
 {
   rec_data_t *rd;
@@ -468,6 +659,9 @@ int bs_format_mrt_init_data(bgpstream_format_t *format, void **data)
     return -1;
   }
 
+  rd->lazy_attrs = format->lazy_elem_attrs;
+  rd->attr_cache = STATE->attr_cache;
+
   *data = rd;
   return 0;
 }
@@ -481,6 +675,8 @@ void bs_format_mrt_clear_data(bgpstream_format_t *format, void *data)
   rd->next_re = 0;
   bgpstream_parsebgp_upd_state_reset(&rd->upd_state);
   parsebgp_clear_msg(rd->msg);
+  peer_table_unref(STATE, rd->peer_table);
+  rd->peer_table = NULL;
 }
 
 void bs_format_mrt_destroy_data(bgpstream_format_t *format, void *data)
@@ -491,17 +687,26 @@ void bs_format_mrt_destroy_data(bgpstream_format_t *format, void *data)
   }
   bgpstream_elem_destroy(rd->elem);
   rd->elem = NULL;
+  bgpstream_elem_generator_destroy(rd->batch);
+  rd->batch = NULL;
   parsebgp_destroy_msg(rd->msg);
   rd->msg = NULL;
+  peer_table_unref(STATE, rd->peer_table);
+  rd->peer_table = NULL;
   free(data);
 }
 
 void bs_format_mrt_destroy(bgpstream_format_t *format)
 {
-  if (STATE->peer_table != NULL) {
-    kh_destroy(td2_peer, STATE->peer_table);
-    STATE->peer_table = NULL;
-  }
+  // records are destroyed before their format, so this is the last reference
+  peer_table_unref(STATE, STATE->peer_table);
+  STATE->peer_table = NULL;
+  pthread_mutex_destroy(&STATE->peer_table_mutex);
+
+  bgpstream_parsebgp_attr_cache_destroy(STATE->attr_cache);
+  STATE->attr_cache = NULL;
+
+  bgpstream_parsebgp_decode_state_clear(&STATE->decoder);
 
   free(format->state);
   format->state = NULL;
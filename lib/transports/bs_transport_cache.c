@@ -67,6 +67,10 @@ typedef struct cache_state {
   /** content reader, either from local cache or from remote URI */
   io_t* reader;
 
+  /** parallel decompressor for the remote URI (used instead of reader if the
+      remote file can be split into blocks) */
+  bgpstream_decompress_t *pd;
+
   /** cache content writer */
   iow_t* writer;
 
@@ -203,7 +207,13 @@ int bs_transport_cache_create(bgpstream_transport_t *transport)
       }
     }
 
-    // open reader that reads from remote file
+    // open reader that reads from remote file, decompressing it in parallel if
+    // we can
+    if (transport->decomp_pool != NULL &&
+        (STATE->pd = bgpstream_decompress_create(
+           transport->decomp_pool, transport->res->uri)) != NULL) {
+      return 0;
+    }
     if ((STATE->reader = wandio_create(transport->res->uri)) == NULL) {
       bgpstream_log(BGPSTREAM_LOG_ERR, "ERROR: Could not open %s for reading",
                     transport->res->uri);
@@ -219,7 +229,9 @@ int64_t bs_transport_cache_read(bgpstream_transport_t *transport,
 {
 
   // read content
-  int64_t ret = wandio_read(STATE->reader, buffer, len);
+  int64_t ret = (STATE->pd != NULL) ?
+    bgpstream_decompress_read(STATE->pd, buffer, len) :
+    wandio_read(STATE->reader, buffer, len);
 
   // if cache-writing is enabled
   if(STATE->write_to_cache == 1){
@@ -269,6 +281,8 @@ void bs_transport_cache_destroy(bgpstream_transport_t *transport)
     wandio_destroy(STATE->reader);
     STATE->reader = NULL;
   }
+  bgpstream_decompress_destroy(STATE->pd);
+  STATE->pd = NULL;
 
   // close writer
   if (STATE->writer != NULL) {
@@ -27,35 +27,182 @@
 #include "bgpstream_transport_interface.h"
 #include "bgpstream_log.h"
 #include "bs_transport_file.h"
+#include "utils.h"
 #include "wandio.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-int bs_transport_file_create(bgpstream_transport_t *transport)
+#define STATE ((file_state_t*)(transport->state))
+
+/* length of the longest compression magic number we check for */
+#define MAGIC_LEN 6
+
+typedef struct file_state {
+
+  /** wandio reader (if the file is neither mapped nor decompressed in
+      parallel) */
+  io_t *fh;
+
+  /** parallel decompressor (if the file can be split into blocks) */
+  bgpstream_decompress_t *pd;
+
+  /** mapping of the whole file (if it is a local, uncompressed file) */
+  uint8_t *map;
+  size_t map_len;
+
+  /** read position within the mapping */
+  size_t map_pos;
+
+} file_state_t;
+
+/* does the data start with a magic number that wandio would decompress? */
+static int is_compressed(const uint8_t *buf, size_t len)
+{
+  static const struct {
+    const char *magic;
+    size_t len;
+  } magics[] = {
+    {"\x1f\x8b", 2},                 // gzip
+    {"BZh", 3},                      // bzip2
+    {"\xfd" "7zXZ\x00", 6},          // xz
+    {"\x89LZO\x00", 5},              // lzo
+    {"\x04\x22\x4d\x18", 4},         // lz4
+    {"\x28\xb5\x2f\xfd", 4},         // zstd
+  };
+  size_t i;
+
+  for (i = 0; i < ARR_CNT(magics); i++) {
+    if (len >= magics[i].len &&
+        memcmp(buf, magics[i].magic, magics[i].len) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* try to map the file, returns 0 if mapped, -1 if the file should be read
+   through wandio instead */
+static int map_file(bgpstream_transport_t *transport)
 {
-  io_t *fh = NULL;
+  const char *path = transport->res->uri;
+  uint8_t magic[MAGIC_LEN];
+  struct stat st;
+  ssize_t magic_len;
+  void *map;
+  int fd;
+
+  // remote files (and stdin) are left to wandio
+  if (strstr(path, "://") != NULL || strcmp(path, "-") == 0) {
+    return -1;
+  }
+  if ((fd = open(path, O_RDONLY)) < 0) {
+    return -1;
+  }
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+      (uint64_t)st.st_size > SIZE_MAX ||
+      (magic_len = pread(fd, magic, MAGIC_LEN, 0)) <= 0 ||
+      is_compressed(magic, magic_len) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps the file open
+  close(fd);
+  if (map == MAP_FAILED) {
+    bgpstream_log(BGPSTREAM_LOG_WARN, "Could not map %s, reading it instead",
+                  path);
+    return -1;
+  }
+  // we parse the file front-to-back, so let the kernel read ahead and drop
+  // pages behind us
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  STATE->map = map;
+  STATE->map_len = st.st_size;
+  transport->mapped_data = STATE->map;
+  transport->mapped_len = STATE->map_len;
 
+  return 0;
+}
+
+int bs_transport_file_create(bgpstream_transport_t *transport)
+{
   BS_TRANSPORT_SET_METHODS(file, transport);
 
-  if ((fh = wandio_create(transport->res->uri)) == NULL) {
+  if ((transport->state = malloc_zero(sizeof(file_state_t))) == NULL) {
+    return -1;
+  }
+
+  // local, uncompressed files can be parsed straight from a mapping
+  if (map_file(transport) == 0) {
+    return 0;
+  }
+
+  // compressed files that can be split into blocks are decompressed in
+  // parallel
+  if (transport->decomp_pool != NULL &&
+      (STATE->pd = bgpstream_decompress_create(transport->decomp_pool,
+                                               transport->res->uri)) != NULL) {
+    return 0;
+  }
+
+  if ((STATE->fh = wandio_create(transport->res->uri)) == NULL) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open %s for reading",
                   transport->res->uri);
+    free(transport->state);
+    transport->state = NULL;
     return -1;
   }
 
-  transport->state = fh;
-
   return 0;
 }
 
 int64_t bs_transport_file_read(bgpstream_transport_t *transport,
                                uint8_t *buffer, int64_t len)
 {
-  return wandio_read((io_t*)transport->state, buffer, len);
+  size_t n;
+
+  if (STATE->pd != NULL) {
+    return bgpstream_decompress_read(STATE->pd, buffer, len);
+  }
+  if (STATE->map == NULL) {
+    return wandio_read(STATE->fh, buffer, len);
+  }
+
+  n = STATE->map_len - STATE->map_pos;
+  if ((size_t)len < n) {
+    n = len;
+  }
+  memcpy(buffer, STATE->map + STATE->map_pos, n);
+  STATE->map_pos += n;
+  return n;
 }
 
 void bs_transport_file_destroy(bgpstream_transport_t *transport)
 {
-  if (transport->state != NULL) {
-    wandio_destroy((io_t*)transport->state);
-    transport->state = NULL;
+  if (transport->state == NULL) {
+    return;
   }
+
+  if (STATE->fh != NULL) {
+    wandio_destroy(STATE->fh);
+    STATE->fh = NULL;
+  }
+
+  bgpstream_decompress_destroy(STATE->pd);
+  STATE->pd = NULL;
+
+  if (STATE->map != NULL) {
+    munmap(STATE->map, STATE->map_len);
+    STATE->map = NULL;
+    transport->mapped_data = NULL;
+    transport->mapped_len = 0;
+  }
+
+  free(transport->state);
+  transport->state = NULL;
 }
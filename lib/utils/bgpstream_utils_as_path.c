@@ -51,6 +51,16 @@
 #define CUR_SEG(path, iter)                                                    \
   ((bgpstream_as_path_seg_t *)((path)->data + (iter)->cur_offset))
 
+/* forget about path data that is owned by someone else, before the path needs
+ * to (re)allocate a buffer of its own */
+static void release_external_data(bgpstream_as_path_t *path)
+{
+  if (path->data_alloc_len == UINT16_MAX) {
+    path->data = NULL;
+    path->data_alloc_len = 0;
+  }
+}
+
 static bgpstream_as_path_seg_asn_t *
 seg_asn_dup(bgpstream_as_path_seg_asn_t *src)
 {
@@ -306,10 +316,8 @@ void bgpstream_as_path_destroy(bgpstream_as_path_t *path)
 
 int bgpstream_as_path_copy(bgpstream_as_path_t *dst, bgpstream_as_path_t *src)
 {
-  if (dst->data_alloc_len == UINT16_MAX) {
-    /* no longer points to external memory */
-    dst->data_alloc_len = 0;
-  }
+  /* no longer points to external memory */
+  release_external_data(dst);
   if (dst->data_alloc_len < src->data_len) {
     if ((dst->data = realloc(dst->data, src->data_len)) == NULL) {
       return -1;
@@ -404,11 +412,8 @@ int bgpstream_as_path_populate_from_data(bgpstream_as_path_t *path,
 
   bgpstream_as_path_clear(path);
 
-  if (path->data_alloc_len == UINT16_MAX) {
-    /* the data is not owned by us */
-    path->data_alloc_len = 0;
-    path->data = NULL;
-  }
+  /* the data is not owned by us */
+  release_external_data(path);
 
   if (path->data_alloc_len < data_len) {
     if ((path->data = realloc(path->data, data_len)) == NULL) {
@@ -432,6 +437,11 @@ int bgpstream_as_path_populate_from_data_zc(bgpstream_as_path_t *path,
 
   bgpstream_as_path_clear(path);
 
+  /* drop any buffer of our own, rather than leaking it */
+  if (path->data_alloc_len != UINT16_MAX) {
+    free(path->data);
+  }
+
   /* signal that this is external data */
   path->data_alloc_len = UINT16_MAX;
   path->data = data;
@@ -557,6 +567,16 @@ int bgpstream_as_path_append(bgpstream_as_path_t *path,
   // seek the iterator to the end of the path where we'll add our new segment
   iter.cur_offset = path->data_len;
 
+  // segments cannot be appended to data that is owned by someone else
+  if (path->data_alloc_len == UINT16_MAX) {
+    if (path->data_len != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR,
+                    "Cannot append to an AS path that does not own its data");
+      return -1;
+    }
+    release_external_data(path);
+  }
+
   /* ensure that the path data buffer is long enough */
   if (type == BGPSTREAM_AS_PATH_SEG_ASN) {
       new_len =
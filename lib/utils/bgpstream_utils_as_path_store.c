@@ -29,6 +29,7 @@
 #include <assert.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "khash.h"
 #include "utils.h"
@@ -292,6 +293,7 @@ int bgpstream_as_path_store_insert_path(bgpstream_as_path_store_t *store,
                                         bgpstream_as_path_store_path_id_t *id)
 {
   bgpstream_as_path_store_path_t findme;
+  memset(&findme, 0, sizeof(findme));
   findme.is_core = is_core;
 
   bgpstream_as_path_populate_from_data_zc(&findme.path, path_data, path_len);
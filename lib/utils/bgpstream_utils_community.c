@@ -53,6 +53,16 @@ struct bgpstream_community_set {
   uint32_t communities_hash;
 };
 
+/* forget about communities that are owned by someone else, before the set
+ * needs to (re)allocate an array of its own */
+static void release_external_communities(bgpstream_community_set_t *set)
+{
+  if (set->communities_alloc_cnt < 0) {
+    set->communities = NULL;
+    set->communities_alloc_cnt = 0;
+  }
+}
+
 /* ========== PUBLIC FUNCTIONS ========== */
 
 int bgpstream_community_snprintf(char *buf, size_t len,
@@ -226,6 +236,7 @@ void bgpstream_community_set_destroy(bgpstream_community_set_t *set)
 int bgpstream_community_set_copy(bgpstream_community_set_t *dst,
                                  bgpstream_community_set_t *src)
 {
+  release_external_communities(dst);
   if (dst->communities_alloc_cnt < src->communities_cnt) {
     if ((dst->communities =
            realloc(dst->communities, sizeof(bgpstream_community_t) *
@@ -258,6 +269,14 @@ int bgpstream_community_set_size(bgpstream_community_set_t *set)
 int bgpstream_community_set_insert(bgpstream_community_set_t *set,
                                    bgpstream_community_t *comm)
 {
+  if (set->communities_alloc_cnt < 0) {
+    // copy the external communities into an array of our own first
+    bgpstream_community_set_t tmp = *set;
+    release_external_communities(set);
+    if (bgpstream_community_set_copy(set, &tmp) != 0) {
+      return -1;
+    }
+  }
   if (set->communities_cnt == set->communities_alloc_cnt) {
     if ((set->communities = realloc(
            set->communities, sizeof(bgpstream_community_t) *
@@ -277,7 +296,7 @@ int bgpstream_community_set_populate_from_array(bgpstream_community_set_t *set,
                                                 bgpstream_community_t *comms,
                                                 int comms_cnt)
 {
-  bgpstream_community_set_t tmp;
+  bgpstream_community_set_t tmp = {NULL, 0, 0, 0};
   if (bgpstream_community_set_populate_from_array_zc(&tmp, comms, comms_cnt) !=
       0) {
     return -1;
@@ -288,6 +307,10 @@ int bgpstream_community_set_populate_from_array(bgpstream_community_set_t *set,
 int bgpstream_community_set_populate_from_array_zc(
   bgpstream_community_set_t *set, bgpstream_community_t *comms, int comms_cnt)
 {
+  /* drop any array of our own, rather than leaking it */
+  if (set->communities_alloc_cnt > 0) {
+    free(set->communities);
+  }
   set->communities_alloc_cnt = -1; /* signal that memory is not owned by us */
   set->communities = comms;
   set->communities_cnt = comms_cnt;
@@ -350,6 +373,7 @@ int bgpstream_community_set_populate(bgpstream_community_set_t *set,
 
   cnt = len / sizeof(uint32_t);
 
+  release_external_communities(set);
   if (set->communities_alloc_cnt < cnt) {
     if ((set->communities = realloc(
            set->communities, sizeof(bgpstream_community_t) * cnt)) == NULL) {
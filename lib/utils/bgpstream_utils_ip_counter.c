@@ -26,19 +26,22 @@
 
 #include "bgpstream_utils_ip_counter.h"
 #include "bgpstream_utils_addr.h"
+#include "config.h"
 #include "utils.h"
 #include <inttypes.h>
-#include <inttypes.h>
-#include <stdio.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-/* static char buffer[INET6_ADDRSTRLEN]; */
+/* Initial number of intervals allocated for each vector */
+#define INTERVALS_INIT_SIZE 64
+
+/* Number of 64 bit words in the IPv4 /24 bitmap (2^24 bits, 2 MiB) */
+#define BM_WORDS ((1 << 24) / 64)
 
 typedef struct struct_v4pfx_int_t {
   uint32_t start;
   uint32_t end;
-  struct struct_v4pfx_int_t *next;
 } v4pfx_int_t;
 
 typedef struct struct_v6pfx_int_t {
@@ -46,251 +49,375 @@ typedef struct struct_v6pfx_int_t {
   uint64_t start_ls;
   uint64_t end_ms;
   uint64_t end_ls;
-  struct struct_v6pfx_int_t *next;
 } v6pfx_int_t;
 
-/* IP Counter Linked List */
+/* IP Counter
+ *
+ * Each address family is a contiguous vector of intervals. Once normalized
+ * the vector is sorted by start address and no two intervals overlap, so
+ * lookups can binary search it. New intervals are simply pushed at the end of
+ * the vector. The next normalization sorts just those, and then merges them
+ * with the normalized head in a linear pass (into the spare vector, which
+ * then takes the place of the old one).
+ */
 struct bgpstream_ip_counter {
-  v4pfx_int_t *v4list;
-  v6pfx_int_t *v6list;
+  v4pfx_int_t *v4;
+  size_t v4_cnt;
+  size_t v4_alloc;
+  /* number of intervals at the head of v4 that are normalized */
+  size_t v4_sorted;
+  v4pfx_int_t *v4_spare;
+  size_t v4_spare_alloc;
+
+  v6pfx_int_t *v6;
+  size_t v6_cnt;
+  size_t v6_alloc;
+  /* number of intervals at the head of v6 that are normalized */
+  size_t v6_sorted;
+  v6pfx_int_t *v6_spare;
+  size_t v6_spare_alloc;
+
+  /* In /24 mode, IPv4 space is a bitmap with one bit per /24 rather than
+   * the v4 interval vector */
+  uint64_t *v4_bm;
+  /* [v4_bm_lo, v4_bm_hi) is the range of words that may have bits set, so
+   * that sparse counters are cheap to count, combine and clear */
+  uint32_t v4_bm_lo;
+  uint32_t v4_bm_hi;
 };
 
-/* static void */
-/* print_pfx_int_list(bgpstream_ip_counter_t *ipc) */
-/*  {  */
-/*    v4pfx_int_t *current4 = ipc->v4list; */
-/*    bgpstream_ipv4_addr_t ip4; */
-
-/*    ip4.version = BGPSTREAM_ADDR_VERSION_IPV4;  */
-/*    while(current4 != NULL)  */
-/*      {  */
-/*        ip4.ipv4.s_addr = htonl(current4->start);  */
-/*        bgpstream_addr_ntop(buffer, INET_ADDRSTRLEN, &ip4);  */
-/*        printf("IP space:\t%s\t", buffer);  */
-/*        ip4.ipv4.s_addr = htonl(current4->end);  */
-/*        bgpstream_addr_ntop(buffer, INET_ADDRSTRLEN, &ip4);  */
-/*        printf("%s\n", buffer);  */
-/*        current4 = current4->next;  */
-/*      } */
-
-/*    v6pfx_int_t *current6 = ipc->v6list;  */
-/*    bgpstream_ipv6_addr_t ip6; */
-/*    uint64_t tmp; */
-/*    ip6.version = BGPSTREAM_ADDR_VERSION_IPV6; */
-
-/*    while(current6 != NULL)  */
-/*      { */
-/*        tmp = htonll(current6->start_ms); */
-/*        memcpy(&ip6.ipv6.s6_addr[0], &tmp, sizeof(uint64_t)); */
-/*        tmp = htonll(current6->start_ls); */
-/*        memcpy(&ip6.ipv6.s6_addr[8], &tmp, sizeof(uint64_t)); */
-/*        bgpstream_addr_ntop(buffer, INET6_ADDRSTRLEN, &ip6);  */
-/*        printf("IP space:\t%s\t", buffer); */
-/*        tmp = htonll(current6->end_ms); */
-/*        memcpy(&ip6.ipv6.s6_addr[0], &tmp, sizeof(uint64_t)); */
-/*        tmp = htonll(current6->end_ls); */
-/*        memcpy(&ip6.ipv6.s6_addr[8],&tmp, sizeof(uint64_t)); */
-/*        bgpstream_addr_ntop(buffer, INET6_ADDRSTRLEN, &ip6);  */
-/*        printf("%s\n", buffer); */
-/*        current6 = current6->next;  */
-/*      } */
-/*  }  */
-
-static void one_step_merge4(v4pfx_int_t *pil)
-{
-  v4pfx_int_t *current = pil;
-  v4pfx_int_t *previous = pil;
-  if (current->next == NULL) {
-    return;
+/* returns <0, 0, >0 if a is less than, equal to, or greater than b */
+static inline int cmp128(uint64_t a_ms, uint64_t a_ls, uint64_t b_ms,
+                         uint64_t b_ls)
+{
+  if (a_ms != b_ms) {
+    return a_ms < b_ms ? -1 : 1;
   }
-  current = current->next;
+  if (a_ls != b_ls) {
+    return a_ls < b_ls ? -1 : 1;
+  }
+  return 0;
+}
 
-  while (current != NULL) {
-    if (current->start <= previous->end) {
-      if (current->end > previous->end) {
-        previous->end = current->end;
-      }
-      previous->next = current->next;
-      free(current);
-      current = previous->next;
-    } else {
-      break;
-    }
+static inline uint64_t popcount64(uint64_t x)
+{
+#ifdef HAVE___BUILTIN_POPCOUNTLL
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (x * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+/* mask selecting bits [from, to] (inclusive) of a bitmap word */
+static inline uint64_t bm_word_mask(uint32_t from, uint32_t to)
+{
+  uint64_t mask = ~(uint64_t)0 << from;
+  if (to < 63) {
+    mask &= ((uint64_t)1 << (to + 1)) - 1;
   }
+  return mask;
 }
 
-static void one_step_merge6(v6pfx_int_t *pil)
+/* set bits [first, last] (i.e. /24s) of the bitmap */
+static void bm_set_range(bgpstream_ip_counter_t *ipc, uint32_t first,
+                         uint32_t last)
 {
-  v6pfx_int_t *current = pil;
-  v6pfx_int_t *previous = pil;
-  if (current->next == NULL) {
-    return;
+  uint32_t fw = first / 64;
+  uint32_t lw = last / 64;
+
+  if (fw == lw) {
+    ipc->v4_bm[fw] |= bm_word_mask(first % 64, last % 64);
+  } else {
+    ipc->v4_bm[fw] |= bm_word_mask(first % 64, 63);
+    memset(&ipc->v4_bm[fw + 1], 0xff, (lw - fw - 1) * sizeof(uint64_t));
+    ipc->v4_bm[lw] |= bm_word_mask(0, last % 64);
   }
-  current = current->next;
 
-  while (current != NULL) {
+  if (fw < ipc->v4_bm_lo) {
+    ipc->v4_bm_lo = fw;
+  }
+  if (lw + 1 > ipc->v4_bm_hi) {
+    ipc->v4_bm_hi = lw + 1;
+  }
+}
 
-    /* current->start <= previous->end */
-    if (current->start_ms < previous->end_ms ||
-        (current->start_ms == previous->end_ms &&
-         current->start_ls <= previous->end_ls)) {
-      /* current->end > previous->end */
-      if (current->end_ms > previous->end_ms ||
-          (current->end_ms == previous->end_ms &&
-           current->end_ls > previous->end_ls)) {
-        previous->end_ms = current->end_ms;
-        previous->end_ls = current->end_ls;
-      }
-      previous->next = current->next;
-      free(current);
-      current = previous->next;
-    } else {
-      break;
-    }
+/* count the bits set in [first, last] of the bitmap */
+/* clear all the /24s of the bitmap */
+static void bm_clear(bgpstream_ip_counter_t *ipc)
+{
+  if (ipc->v4_bm_lo < ipc->v4_bm_hi) {
+    memset(&ipc->v4_bm[ipc->v4_bm_lo], 0,
+           (ipc->v4_bm_hi - ipc->v4_bm_lo) * sizeof(uint64_t));
   }
+  ipc->v4_bm_lo = BM_WORDS;
+  ipc->v4_bm_hi = 0;
 }
 
-static int merge_in_sorted_queue4(v4pfx_int_t **pil, uint32_t start,
-                                  uint32_t end)
+static uint64_t bm_count_range(bgpstream_ip_counter_t *ipc, uint32_t first,
+                               uint32_t last)
 {
-  // create new v4pfx_int_t
-  v4pfx_int_t *p = NULL;
-  v4pfx_int_t *previous = *pil;
-  v4pfx_int_t *current = *pil;
+  uint32_t fw = first / 64;
+  uint32_t lw = last / 64;
+  uint64_t cnt = 0;
+  uint32_t w;
 
-  while (current != NULL) {
-    if (start > current->end) {
-      previous = current;
-      current = current->next;
-      continue;
-    }
-    if (end < current->start) {
-      /* found a position where to insert  */
-      if ((p = (v4pfx_int_t *)malloc_zero(sizeof(v4pfx_int_t))) == NULL) {
-        fprintf(stderr, "ERROR: can't malloc v4pfx_int_t structure\n");
-        return -1;
-      }
-      p->start = start;
-      p->end = end;
-      p->next = NULL;
-      if (previous != current) {
-        previous->next = p;
-      } else {
-        *pil = p;
-      }
-      p->next = current;
-      return 0;
-    }
-    /* At this point S <= cE and E >= cS
-     * so we can merge them */
-    if (current->start > start) {
-      current->start = start;
-    }
-    if (current->end < end) {
-      current->end = end;
-    }
-    /* Now check from here on if there are other things
-     * to merge */
-    one_step_merge4(current);
-    return 0;
+  if (fw == lw) {
+    return popcount64(ipc->v4_bm[fw] & bm_word_mask(first % 64, last % 64));
   }
-
-  /*   if here we didn't find a place where to insert the
-   * interval, it is either the first position or the last */
-  if ((p = (v4pfx_int_t *)malloc_zero(sizeof(v4pfx_int_t))) == NULL) {
-    fprintf(stderr, "ERROR: can't malloc v4pfx_int_t structure\n");
-    return -1;
+  cnt += popcount64(ipc->v4_bm[fw] & bm_word_mask(first % 64, 63));
+  cnt += popcount64(ipc->v4_bm[lw] & bm_word_mask(0, last % 64));
+  /* only words within the dirty range can have bits set */
+  if (fw + 1 < ipc->v4_bm_lo) {
+    fw = ipc->v4_bm_lo - 1;
+  }
+  if (lw > ipc->v4_bm_hi) {
+    lw = ipc->v4_bm_hi;
+  }
+  for (w = fw + 1; w < lw; w++) {
+    cnt += popcount64(ipc->v4_bm[w]);
   }
-  p->start = start;
-  p->end = end;
-  p->next = NULL;
-  /* adding at the beginning of the queue */
-  if (previous == current) {
-    *pil = p;
+  return cnt;
+}
+
+static int reserve(void **vec, size_t *alloc, size_t need, size_t size)
+{
+  size_t new_alloc;
+  void *tmp;
+
+  if (need <= *alloc) {
     return 0;
   }
-  // adding at the end of the queue
-  previous->next = p;
+  new_alloc = (*alloc == 0) ? INTERVALS_INIT_SIZE : *alloc;
+  while (new_alloc < need) {
+    new_alloc *= 2;
+  }
+  if ((tmp = realloc(*vec, new_alloc * size)) == NULL) {
+    fprintf(stderr, "ERROR: can't realloc ip counter intervals\n");
+    return -1;
+  }
+  *vec = tmp;
+  *alloc = new_alloc;
   return 0;
 }
 
-static int merge_in_sorted_queue6(v6pfx_int_t **pil, uint64_t start_ms,
-                                  uint64_t start_ls, uint64_t end_ms,
-                                  uint64_t end_ls)
+static void pfx2int4(bgpstream_ipv4_pfx_t *pfx, uint32_t *start,
+                     uint32_t *end)
+{
+  uint32_t mask = ~(((uint64_t)1 << (32 - pfx->mask_len)) - 1);
+  *start = ntohl(pfx->address.ipv4.s_addr) & mask;
+  *end = *start | (~mask);
+}
+
+static void pfx2int6(bgpstream_ipv6_pfx_t *pfx, v6pfx_int_t *i)
+{
+  uint64_t mask_ms;
+  uint64_t mask_ls;
+  uint64_t tmp;
+
+  memcpy(&tmp, &pfx->address.ipv6.s6_addr[0], sizeof(uint64_t));
+  i->start_ms = ntohll(tmp);
+  memcpy(&tmp, &pfx->address.ipv6.s6_addr[8], sizeof(uint64_t));
+  i->start_ls = ntohll(tmp);
+
+  if (pfx->mask_len > 64) {
+    mask_ms = ~((uint64_t)0);
+    mask_ls = ~(((uint64_t)1 << (64 - (pfx->mask_len - 64))) - 1);
+  } else if (pfx->mask_len == 0) {
+    mask_ms = 0;
+    mask_ls = 0;
+  } else {
+    mask_ms = ~(((uint64_t)1 << (64 - pfx->mask_len)) - 1);
+    mask_ls = 0;
+  }
+
+  i->start_ms &= mask_ms;
+  i->end_ms = i->start_ms | (~mask_ms);
+  i->start_ls &= mask_ls;
+  i->end_ls = i->start_ls | (~mask_ls);
+}
+
+/* index of the first normalized interval whose end is >= addr */
+static size_t lower_bound4(v4pfx_int_t *v, size_t cnt, uint32_t addr)
 {
-  // create new v4pfx_int_t
-  v6pfx_int_t *p = NULL;
-  v6pfx_int_t *previous = *pil;
-  v6pfx_int_t *current = *pil;
+  size_t lo = 0;
+  size_t hi = cnt;
+  size_t mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (v[mid].end < addr) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
 
-  while (current != NULL) {
-    /* start > current->end */
-    if (start_ms > current->end_ms ||
-        (start_ms == current->end_ms && start_ls > current->end_ls)) {
-      previous = current;
-      current = current->next;
-      continue;
+static size_t lower_bound6(v6pfx_int_t *v, size_t cnt, uint64_t addr_ms,
+                           uint64_t addr_ls)
+{
+  size_t lo = 0;
+  size_t hi = cnt;
+  size_t mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (cmp128(v[mid].end_ms, v[mid].end_ls, addr_ms, addr_ls) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
     }
-    /* end < current->start */
-    if (end_ms < current->start_ms ||
-        (end_ms == current->start_ms && end_ls < current->start_ls)) {
-      /* found a position where to insert  */
-      if ((p = (v6pfx_int_t *)malloc_zero(sizeof(v6pfx_int_t))) == NULL) {
-        fprintf(stderr, "ERROR: can't malloc v6pfx_int_t structure\n");
-        return -1;
+  }
+  return lo;
+}
+
+static int int4_cmp(const void *a, const void *b)
+{
+  const v4pfx_int_t *ia = a;
+  const v4pfx_int_t *ib = b;
+  if (ia->start != ib->start) {
+    return ia->start < ib->start ? -1 : 1;
+  }
+  return 0;
+}
+
+static int int6_cmp(const void *a, const void *b)
+{
+  const v6pfx_int_t *ia = a;
+  const v6pfx_int_t *ib = b;
+  return cmp128(ia->start_ms, ia->start_ls, ib->start_ms, ib->start_ls);
+}
+
+/* append an interval to a sorted vector, merging it with the last interval
+ * if they overlap */
+static inline void push4(v4pfx_int_t *out, size_t *cnt, v4pfx_int_t *in)
+{
+  v4pfx_int_t *last;
+
+  if (*cnt > 0) {
+    last = &out[*cnt - 1];
+    if (in->start <= last->end) {
+      if (in->end > last->end) {
+        last->end = in->end;
       }
-      p->start_ms = start_ms;
-      p->start_ls = start_ls;
-      p->end_ms = end_ms;
-      p->end_ls = end_ls;
-      p->next = NULL;
-      if (previous != current) {
-        previous->next = p;
-      } else {
-        *pil = p;
+      return;
+    }
+  }
+  out[(*cnt)++] = *in;
+}
+
+static inline void push6(v6pfx_int_t *out, size_t *cnt, v6pfx_int_t *in)
+{
+  v6pfx_int_t *last;
+
+  if (*cnt > 0) {
+    last = &out[*cnt - 1];
+    if (cmp128(in->start_ms, in->start_ls, last->end_ms, last->end_ls) <= 0) {
+      if (cmp128(in->end_ms, in->end_ls, last->end_ms, last->end_ls) > 0) {
+        last->end_ms = in->end_ms;
+        last->end_ls = in->end_ls;
       }
-      p->next = current;
-      return 0;
+      return;
     }
-    /* At this point S <= cE and E >= cS
-     * so we can merge them */
-    /* current->start > start */
-    if (current->start_ms > start_ms ||
-        (current->start_ms == start_ms && current->start_ls > start_ls)) {
-      current->start_ms = start_ms;
-      current->start_ls = start_ls;
+  }
+  out[(*cnt)++] = *in;
+}
+
+/* sort the intervals pushed since the last normalization, and merge them with
+ * the normalized head of the vector in a linear pass */
+static void normalize4(bgpstream_ip_counter_t *ipc)
+{
+  v4pfx_int_t *v = ipc->v4;
+  v4pfx_int_t *out;
+  size_t head = ipc->v4_sorted;
+  size_t i = 0;
+  size_t j = head;
+  size_t cnt = 0;
+  size_t alloc;
+
+  if (head == ipc->v4_cnt) {
+    return;
+  }
+  qsort(&v[head], ipc->v4_cnt - head, sizeof(v4pfx_int_t), int4_cmp);
+
+  if (head > 0 && reserve((void **)&ipc->v4_spare, &ipc->v4_spare_alloc,
+                          ipc->v4_cnt, sizeof(v4pfx_int_t)) != 0) {
+    /* without a spare vector, sort the whole vector instead */
+    qsort(v, ipc->v4_cnt, sizeof(v4pfx_int_t), int4_cmp);
+    head = 0;
+  }
+
+  if (head == 0) {
+    /* a single sorted run can be merged in place */
+    for (i = 0; i < ipc->v4_cnt; i++) {
+      push4(v, &cnt, &v[i]);
     }
-    /* current->end < end */
-    if (current->end_ms < end_ms ||
-        (current->end_ms == end_ms && current->end_ls < end_ls)) {
-      current->end_ms = end_ms;
-      current->end_ls = end_ls;
+  } else {
+    out = ipc->v4_spare;
+    while (i < head || j < ipc->v4_cnt) {
+      if (j == ipc->v4_cnt || (i < head && v[i].start <= v[j].start)) {
+        push4(out, &cnt, &v[i++]);
+      } else {
+        push4(out, &cnt, &v[j++]);
+      }
     }
-    /* Now check from here on if there are other things
-     * to merge */
-    one_step_merge6(current);
-    return 0;
+    alloc = ipc->v4_alloc;
+    ipc->v4_spare = v;
+    ipc->v4_alloc = ipc->v4_spare_alloc;
+    ipc->v4_spare_alloc = alloc;
+    ipc->v4 = out;
   }
+  ipc->v4_cnt = cnt;
+  ipc->v4_sorted = cnt;
+}
 
-  /*   if here we didn't find a place where to insert the
-   * interval, it is either the first position or the last */
-  if ((p = (v6pfx_int_t *)malloc_zero(sizeof(v6pfx_int_t))) == NULL) {
-    fprintf(stderr, "ERROR: can't malloc v6pfx_int_t structure\n");
-    return -1;
+static void normalize6(bgpstream_ip_counter_t *ipc)
+{
+  v6pfx_int_t *v = ipc->v6;
+  v6pfx_int_t *out;
+  size_t head = ipc->v6_sorted;
+  size_t i = 0;
+  size_t j = head;
+  size_t cnt = 0;
+  size_t alloc;
+
+  if (head == ipc->v6_cnt) {
+    return;
   }
-  p->start_ms = start_ms;
-  p->start_ls = start_ls;
-  p->end_ms = end_ms;
-  p->end_ls = end_ls;
-  p->next = NULL;
-  /* adding at the beginning of the queue */
-  if (previous == current) {
-    *pil = p;
-    return 0;
+  qsort(&v[head], ipc->v6_cnt - head, sizeof(v6pfx_int_t), int6_cmp);
+
+  if (head > 0 && reserve((void **)&ipc->v6_spare, &ipc->v6_spare_alloc,
+                          ipc->v6_cnt, sizeof(v6pfx_int_t)) != 0) {
+    qsort(v, ipc->v6_cnt, sizeof(v6pfx_int_t), int6_cmp);
+    head = 0;
   }
-  // adding at the end of the queue
-  previous->next = p;
-  return 0;
+
+  if (head == 0) {
+    for (i = 0; i < ipc->v6_cnt; i++) {
+      push6(v, &cnt, &v[i]);
+    }
+  } else {
+    out = ipc->v6_spare;
+    while (i < head || j < ipc->v6_cnt) {
+      if (j == ipc->v6_cnt ||
+          (i < head && int6_cmp(&v[i], &v[j]) <= 0)) {
+        push6(out, &cnt, &v[i++]);
+      } else {
+        push6(out, &cnt, &v[j++]);
+      }
+    }
+    alloc = ipc->v6_alloc;
+    ipc->v6_spare = v;
+    ipc->v6_alloc = ipc->v6_spare_alloc;
+    ipc->v6_spare_alloc = alloc;
+    ipc->v6 = out;
+  }
+  ipc->v6_cnt = cnt;
+  ipc->v6_sorted = cnt;
 }
 
 bgpstream_ip_counter_t *bgpstream_ip_counter_create()
@@ -301,8 +428,23 @@ bgpstream_ip_counter_t *bgpstream_ip_counter_create()
     fprintf(stderr, "ERROR: can't malloc bgpstream_ip_counter_t structure\n");
     return NULL;
   }
-  ipc->v4list = NULL;
-  ipc->v6list = NULL;
+  return ipc;
+}
+
+bgpstream_ip_counter_t *bgpstream_ip_counter_create_slash24()
+{
+  bgpstream_ip_counter_t *ipc;
+
+  if ((ipc = bgpstream_ip_counter_create()) == NULL) {
+    return NULL;
+  }
+  if ((ipc->v4_bm = calloc(BM_WORDS, sizeof(uint64_t))) == NULL) {
+    fprintf(stderr, "ERROR: can't malloc IPv4 /24 bitmap\n");
+    free(ipc);
+    return NULL;
+  }
+  ipc->v4_bm_lo = BM_WORDS;
+  ipc->v4_bm_hi = 0;
   return ipc;
 }
 
@@ -310,294 +452,491 @@ int bgpstream_ip_counter_add(bgpstream_ip_counter_t *ipc, bgpstream_pfx_t *pfx)
 {
   uint32_t start;
   uint32_t end;
-  uint32_t mask;
-  unsigned char *tmp;
-  uint64_t start_ms = 0;
-  uint64_t start_ls = 0;
-  uint64_t end_ms = 0;
-  uint64_t end_ls = 0;
-  uint64_t mask_ms;
-  uint64_t mask_ls;
 
-  if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
-    mask = ~(((uint64_t)1 << (32 - pfx->mask_len)) - 1);
-    start = ntohl(((bgpstream_ipv4_pfx_t *)pfx)->address.ipv4.s_addr);
-    start = start & mask;
-    end = start | (~mask);
-    return merge_in_sorted_queue4(&ipc->v4list, start, end);
-  } else {
-    if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV6) {
-      tmp = &((bgpstream_ipv6_pfx_t *)pfx)->address.ipv6.s6_addr[0];
-      start_ms = ntohll(*((uint64_t *)tmp));
-      tmp = &((bgpstream_ipv6_pfx_t *)pfx)->address.ipv6.s6_addr[8];
-      start_ls = ntohll(*((uint64_t *)tmp));
-      /* printf("+++++++++  %"PRIu64" %"PRIu64"\n", start_ms, start_ls); */
-      if (pfx->mask_len > 64) {
-        /* len_ms = 0 */
-        mask_ms = ~((uint64_t)0);
-        /* len_ls = 64 - (pfx->mask_len - 64); */
-        mask_ls = ~(((uint64_t)1 << (64 - (pfx->mask_len - 64))) - 1);
-      } else {
-        /* len_ms = 64 - pfx->mask_len; */
-        mask_ms = ~(((uint64_t)1 << (64 - pfx->mask_len)) - 1);
-        /* len_ls = 64; */
-        /* mask_ls = ~( ((uint64_t)1 << 64) - 1); */
-        mask_ls = 0;
-      }
+  if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4 &&
+      ipc->v4_bm != NULL) {
+    pfx2int4((bgpstream_ipv4_pfx_t *)pfx, &start, &end);
+    bm_set_range(ipc, start >> 8, end >> 8);
+    return 0;
+  }
 
-      /* printf("MASKS:  %"PRIu64" %"PRIu64"\n", mask_ms, mask_ls); */
+  if (bgpstream_ip_counter_append(ipc, pfx) != 0) {
+    return -1;
+  }
 
-      /* most significant */
-      start_ms = start_ms & mask_ms;
-      end_ms = start_ms | (~mask_ms);
-      /* printf("MS:  %"PRIu64" %"PRIu64"\n", start_ms, end_ms); */
+  /* normalize once the new intervals outnumber the normalized ones, so the
+   * vectors stay within about twice their normalized size (e.g., when the
+   * same prefixes are added over and over), and each normalization is paid
+   * for by as many additions */
+  if (ipc->v4_cnt - ipc->v4_sorted > INTERVALS_INIT_SIZE &&
+      ipc->v4_cnt - ipc->v4_sorted > ipc->v4_sorted) {
+    normalize4(ipc);
+  }
+  if (ipc->v6_cnt - ipc->v6_sorted > INTERVALS_INIT_SIZE &&
+      ipc->v6_cnt - ipc->v6_sorted > ipc->v6_sorted) {
+    normalize6(ipc);
+  }
+  return 0;
+}
 
-      /* least significant */
-      start_ls = start_ls & mask_ls;
-      end_ls = start_ls | (~mask_ls);
-      /* printf("LS:  %"PRIu64" %"PRIu64"\n", start_ls, end_ls); */
+int bgpstream_ip_counter_append(bgpstream_ip_counter_t *ipc,
+                                bgpstream_pfx_t *pfx)
+{
+  v4pfx_int_t *i4;
 
-      return merge_in_sorted_queue6(&ipc->v6list, start_ms, start_ls, end_ms,
-                                    end_ls);
+  if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
+    if (ipc->v4_bm != NULL) {
+      /* setting bits is already as cheap as appending */
+      return bgpstream_ip_counter_add(ipc, pfx);
     }
+    if (reserve((void **)&ipc->v4, &ipc->v4_alloc, ipc->v4_cnt + 1,
+                sizeof(v4pfx_int_t)) != 0) {
+      return -1;
+    }
+    i4 = &ipc->v4[ipc->v4_cnt++];
+    pfx2int4((bgpstream_ipv4_pfx_t *)pfx, &i4->start, &i4->end);
+  } else if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV6) {
+    if (reserve((void **)&ipc->v6, &ipc->v6_alloc, ipc->v6_cnt + 1,
+                sizeof(v6pfx_int_t)) != 0) {
+      return -1;
+    }
+    pfx2int6((bgpstream_ipv6_pfx_t *)pfx, &ipc->v6[ipc->v6_cnt++]);
   }
-  /* print_pfx_int_list(ipc); */
   return 0;
 }
 
-uint32_t bgpstream_ip_counter_is_overlapping4(bgpstream_ip_counter_t *ipc,
-                                              bgpstream_ipv4_pfx_t *pfx,
-                                              uint8_t *more_specific)
+void bgpstream_ip_counter_normalize(bgpstream_ip_counter_t *ipc)
 {
-  v4pfx_int_t *current = ipc->v4list;
-  uint32_t start = 0;
-  uint32_t end = 0;
-  uint32_t len = 0;
-  uint32_t pfx_size;
-  uint32_t overlap_count = 0;
-  *more_specific = 0;
-  len = 32 - pfx->mask_len;
-  start = ntohl(pfx->address.ipv4.s_addr);
-  start = (start >> len) << len;
-  end = 0;
-  end = ~end;
-  end = (end >> len) << len;
-  end = start | (~end);
-  pfx_size = end - start + 1;
+  normalize4(ipc);
+  normalize6(ipc);
+}
+
+static uint64_t is_overlapping4(bgpstream_ip_counter_t *ipc,
+                                bgpstream_ipv4_pfx_t *pfx,
+                                uint8_t *more_specific)
+{
+  uint32_t start;
+  uint32_t end;
+  uint64_t pfx_size;
+  uint64_t overlap_count = 0;
+  size_t i;
   /* intersection endpoints */
   uint32_t int_start;
   uint32_t int_end;
-  while (current != NULL) {
-    if (current->start > end) {
-      break;
-    }
-    if (current->end < start) {
-      current = current->next;
-      continue;
-    }
-    /* there is some overlap
-     * max(start) and min(end) */
-    int_start = current->start;
-    int_end = current->end;
-    if (current->start < start) {
-      int_start = start;
-    }
-    if (current->end > end) {
-      int_end = end;
+
+  pfx2int4(pfx, &start, &end);
+  pfx_size = (uint64_t)end - start + 1;
+
+  if (ipc->v4_bm != NULL) {
+    overlap_count = bm_count_range(ipc, start >> 8, end >> 8);
+    if (overlap_count == (((uint64_t)end >> 8) - (start >> 8) + 1)) {
+      *more_specific = 1;
     }
-    if ((int_end - int_start + 1) == pfx_size) {
+    overlap_count *= 256;
+    /* a prefix more specific than a /24 overlaps at most itself */
+    return overlap_count > pfx_size ? pfx_size : overlap_count;
+  }
+
+  normalize4(ipc);
+
+  for (i = lower_bound4(ipc->v4, ipc->v4_cnt, start);
+       i < ipc->v4_cnt && ipc->v4[i].start <= end; i++) {
+    /* there is some overlap: max(start) and min(end) */
+    int_start = ipc->v4[i].start < start ? start : ipc->v4[i].start;
+    int_end = ipc->v4[i].end > end ? end : ipc->v4[i].end;
+    if ((uint64_t)int_end - int_start + 1 == pfx_size) {
       *more_specific = 1;
     }
-    overlap_count += int_end - int_start + 1;
-    current = current->next;
+    overlap_count += (uint64_t)int_end - int_start + 1;
   }
   return overlap_count;
 }
 
-uint64_t bgpstream_ip_counter_is_overlapping6(bgpstream_ip_counter_t *ipc,
-                                              bgpstream_ipv6_pfx_t *pfx,
-                                              uint8_t *more_specific)
+/* IPv6 space is counted in /64s: a /64 shared by two intervals (i.e. the
+ * intervals are more specific than /64) is only counted once */
+static uint64_t is_overlapping6(bgpstream_ip_counter_t *ipc,
+                                bgpstream_ipv6_pfx_t *pfx,
+                                uint8_t *more_specific)
 {
-  v6pfx_int_t *current = ipc->v6list;
-  v6pfx_int_t *previous = ipc->v6list;
-
-  uint64_t start_ms = 0;
-  uint64_t start_ls = 0;
-  uint64_t end_ms = 0;
-  uint64_t end_ls = 0;
-  uint64_t mask_ms;
-  uint64_t mask_ls;
-  unsigned char *tmp;
-  uint64_t overlap_count = 0;
+  v6pfx_int_t p;
   uint64_t pfx_size;
+  uint64_t overlap_count = 0;
+  size_t i;
+  int counted = 0;
+  uint64_t last_ms = 0;
+  /* intersection endpoints (only most significant) */
+  uint64_t int_start_ms;
+  uint64_t int_end_ms;
+
+  normalize6(ipc);
+  pfx2int6(pfx, &p);
+  pfx_size = p.end_ms - p.start_ms + 1;
+
+  for (i = lower_bound6(ipc->v6, ipc->v6_cnt, p.start_ms, p.start_ls);
+       i < ipc->v6_cnt && cmp128(ipc->v6[i].start_ms, ipc->v6[i].start_ls,
+                                 p.end_ms, p.end_ls) <= 0;
+       i++) {
+    int_start_ms =
+      ipc->v6[i].start_ms < p.start_ms ? p.start_ms : ipc->v6[i].start_ms;
+    int_end_ms = ipc->v6[i].end_ms > p.end_ms ? p.end_ms : ipc->v6[i].end_ms;
+    if (int_end_ms - int_start_ms + 1 == pfx_size) {
+      *more_specific = 1;
+    }
+    if (counted && int_start_ms <= last_ms) {
+      if (int_end_ms <= last_ms) {
+        continue;
+      }
+      int_start_ms = last_ms + 1;
+    }
+    overlap_count += int_end_ms - int_start_ms + 1;
+    last_ms = int_end_ms;
+    counted = 1;
+  }
+  return overlap_count;
+}
+
+uint64_t bgpstream_ip_counter_is_overlapping(bgpstream_ip_counter_t *ipc,
+                                             bgpstream_pfx_t *pfx,
+                                             uint8_t *more_specific)
+{
   *more_specific = 0;
+  if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
+    return is_overlapping4(ipc, (bgpstream_ipv4_pfx_t *)pfx, more_specific);
+  } else if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV6) {
+    return is_overlapping6(ipc, (bgpstream_ipv6_pfx_t *)pfx, more_specific);
+  }
+  return 0;
+}
 
-  tmp = &(pfx->address.ipv6.s6_addr[0]);
-  start_ms = ntohll(*((uint64_t *)tmp));
-  tmp = &(pfx->address.ipv6.s6_addr[8]);
-  start_ls = ntohll(*((uint64_t *)tmp));
+uint64_t bgpstream_ip_counter_get_ipcount(bgpstream_ip_counter_t *ipc,
+                                          bgpstream_addr_version_t v)
+{
+  uint64_t ip_count = 0;
+  size_t i;
+  int counted = 0;
+  uint64_t last_ms = 0;
+  uint64_t start_ms;
 
-  /* printf("+++++++++  %"PRIu64" %"PRIu64"\n", start_ms, start_ls); */
-  if (pfx->mask_len > 64) {
-    /* len_ms = 0 */
-    mask_ms = ~((uint64_t)0);
-    /* len_ls = 64 - (pfx->mask_len - 64); */
-    mask_ls = ~(((uint64_t)1 << (64 - (pfx->mask_len - 64))) - 1);
-  } else {
-    /* len_ms = 64 - pfx->mask_len; */
-    mask_ms = ~(((uint64_t)1 << (64 - pfx->mask_len)) - 1);
-    /* len_ls = 64; */
-    /* mask_ls = ~( ((uint64_t)1 << 64) - 1); */
-    mask_ls = 0;
+  if (v == BGPSTREAM_ADDR_VERSION_IPV4 && ipc->v4_bm != NULL) {
+    ip_count = bm_count_range(ipc, 0, (1 << 24) - 1) * 256;
+  } else if (v == BGPSTREAM_ADDR_VERSION_IPV4) {
+    normalize4(ipc);
+    for (i = 0; i < ipc->v4_cnt; i++) {
+      ip_count += ((uint64_t)ipc->v4[i].end - ipc->v4[i].start) + 1;
+    }
+  } else if (v == BGPSTREAM_ADDR_VERSION_IPV6) {
+    normalize6(ipc);
+    for (i = 0; i < ipc->v6_cnt; i++) {
+      start_ms = ipc->v6[i].start_ms;
+      /* do not count the same /64 twice if the previous interval
+       * already covered (part of) it */
+      if (counted && start_ms <= last_ms) {
+        if (ipc->v6[i].end_ms <= last_ms) {
+          continue;
+        }
+        start_ms = last_ms + 1;
+      }
+      ip_count += (ipc->v6[i].end_ms - start_ms) + 1;
+      last_ms = ipc->v6[i].end_ms;
+      counted = 1;
+    }
   }
+  return ip_count;
+}
 
-  /* printf("MASKS:  %"PRIu64" %"PRIu64"\n", mask_ms, mask_ls); */
+/* 128 bit increment/decrement of an IPv6 address */
+static inline void inc128(uint64_t *ms, uint64_t *ls)
+{
+  if (++(*ls) == 0) {
+    (*ms)++;
+  }
+}
 
-  /* most significant */
-  start_ms = start_ms & mask_ms;
-  end_ms = start_ms | (~mask_ms);
-  /* printf("MS:  %"PRIu64" %"PRIu64"\n", start_ms, end_ms); */
+static inline void dec128(uint64_t *ms, uint64_t *ls)
+{
+  if ((*ls)-- == 0) {
+    (*ms)--;
+  }
+}
 
-  /* least significant */
-  start_ls = start_ls & mask_ls;
-  end_ls = start_ls | (~mask_ls);
-  /* printf("LS:  %"PRIu64" %"PRIu64"\n", start_ls, end_ls); */
+/* replace the v4 vector with out (containing cnt normalized intervals) */
+static void swap_vector4(bgpstream_ip_counter_t *ipc, v4pfx_int_t *out,
+                         size_t cnt, size_t alloc)
+{
+  free(ipc->v4);
+  ipc->v4 = out;
+  ipc->v4_cnt = cnt;
+  ipc->v4_alloc = alloc;
+  ipc->v4_sorted = cnt;
+}
 
-  pfx_size = end_ms - start_ms + 1;
+static void swap_vector6(bgpstream_ip_counter_t *ipc, v6pfx_int_t *out,
+                         size_t cnt, size_t alloc)
+{
+  free(ipc->v6);
+  ipc->v6 = out;
+  ipc->v6_cnt = cnt;
+  ipc->v6_alloc = alloc;
+  ipc->v6_sorted = cnt;
+}
 
-  /* intersection endpoints
-   * (only most significant)*/
-  uint64_t int_start_ms;
-  uint64_t int_end_ms;
+static int union_vectors(bgpstream_ip_counter_t *dst,
+                         bgpstream_ip_counter_t *src)
+{
+  if (dst->v4_bm == NULL && src->v4_cnt > 0) {
+    if (reserve((void **)&dst->v4, &dst->v4_alloc,
+                dst->v4_cnt + src->v4_cnt, sizeof(v4pfx_int_t)) != 0) {
+      return -1;
+    }
+    memcpy(&dst->v4[dst->v4_cnt], src->v4, src->v4_cnt * sizeof(v4pfx_int_t));
+    dst->v4_cnt += src->v4_cnt;
+    normalize4(dst);
+  }
+  if (src->v6_cnt > 0) {
+    if (reserve((void **)&dst->v6, &dst->v6_alloc,
+                dst->v6_cnt + src->v6_cnt, sizeof(v6pfx_int_t)) != 0) {
+      return -1;
+    }
+    memcpy(&dst->v6[dst->v6_cnt], src->v6, src->v6_cnt * sizeof(v6pfx_int_t));
+    dst->v6_cnt += src->v6_cnt;
+    normalize6(dst);
+  }
+  return 0;
+}
+
+/* linear sweep over the two normalized vectors, keeping the parts of dst
+ * that are (intersect) or are not (!intersect) covered by src */
+static int sweep_vector4(bgpstream_ip_counter_t *dst,
+                         bgpstream_ip_counter_t *src, int intersect)
+{
+  v4pfx_int_t *a = dst->v4;
+  v4pfx_int_t *b = src->v4;
+  size_t alloc = dst->v4_cnt + src->v4_cnt + 1;
+  v4pfx_int_t *out;
+  size_t cnt = 0;
+  size_t i, j = 0, k;
+  uint32_t s, e;
+  int done;
+
+  if ((out = malloc(alloc * sizeof(v4pfx_int_t))) == NULL) {
+    fprintf(stderr, "ERROR: can't malloc ip counter intervals\n");
+    return -1;
+  }
 
-  while (current != NULL) {
-    /* current->start > end */
-    if (current->start_ms > end_ms ||
-        (current->start_ms == end_ms && current->start_ls > end_ls)) {
-      break;
+  for (i = 0; i < dst->v4_cnt; i++) {
+    s = a[i].start;
+    e = a[i].end;
+    while (j < src->v4_cnt && b[j].end < s) {
+      j++;
     }
-    /* current->end < start */
-    if (current->end_ms < start_ms ||
-        (current->end_ms == start_ms && current->end_ms < start_ls)) {
-      previous = current;
-      current = current->next;
-      continue;
+    done = 0;
+    for (k = j; k < src->v4_cnt && b[k].start <= e; k++) {
+      if (intersect) {
+        out[cnt].start = b[k].start > s ? b[k].start : s;
+        out[cnt].end = b[k].end < e ? b[k].end : e;
+        cnt++;
+        continue;
+      }
+      if (b[k].start > s) {
+        out[cnt].start = s;
+        out[cnt].end = b[k].start - 1;
+        cnt++;
+      }
+      if (b[k].end >= e) {
+        done = 1;
+        break;
+      }
+      s = b[k].end + 1;
     }
-    /* there is some overlap
-     * max(start) and min(end) */
-    int_start_ms = current->start_ms;
-    int_end_ms = current->end_ms;
-    /* int_start_ls = current->start_ls; */
-    /* int_end_ls = current->end_ls; */
-    /* current->start < start */
-    if (current->start_ms < start_ms ||
-        (current->start_ms == start_ms && current->start_ms < start_ls)) {
-      int_start_ms = start_ms;
-      /* int_start_ls = start_ls; */
+    if (!intersect && !done) {
+      out[cnt].start = s;
+      out[cnt].end = e;
+      cnt++;
     }
-    /* current->end > end */
-    if (current->end_ms > end_ms ||
-        (current->end_ms == end_ms && current->end_ls > end_ls)) {
-      int_end_ms = end_ms;
-      /* int_end_ls = end_ls; */
+  }
+
+  swap_vector4(dst, out, cnt, alloc);
+  return 0;
+}
+
+static int sweep_vector6(bgpstream_ip_counter_t *dst,
+                         bgpstream_ip_counter_t *src, int intersect)
+{
+  v6pfx_int_t *a = dst->v6;
+  v6pfx_int_t *b = src->v6;
+  size_t alloc = dst->v6_cnt + src->v6_cnt + 1;
+  v6pfx_int_t *out;
+  size_t cnt = 0;
+  size_t i, j = 0, k;
+  v6pfx_int_t cur;
+  int done;
+
+  if ((out = malloc(alloc * sizeof(v6pfx_int_t))) == NULL) {
+    fprintf(stderr, "ERROR: can't malloc ip counter intervals\n");
+    return -1;
+  }
+
+  for (i = 0; i < dst->v6_cnt; i++) {
+    cur = a[i];
+    while (j < src->v6_cnt &&
+           cmp128(b[j].end_ms, b[j].end_ls, cur.start_ms, cur.start_ls) < 0) {
+      j++;
     }
-    if (previous != current) {
-      if (current->start_ms != previous->start_ms ||
-          current->end_ms != previous->end_ms) {
-        if ((int_end_ms - int_start_ms + 1) == pfx_size) {
-          *more_specific = 1;
+    done = 0;
+    for (k = j; k < src->v6_cnt && cmp128(b[k].start_ms, b[k].start_ls,
+                                          cur.end_ms, cur.end_ls) <= 0;
+         k++) {
+      if (intersect) {
+        out[cnt] = cur;
+        if (cmp128(b[k].start_ms, b[k].start_ls, cur.start_ms,
+                   cur.start_ls) > 0) {
+          out[cnt].start_ms = b[k].start_ms;
+          out[cnt].start_ls = b[k].start_ls;
+        }
+        if (cmp128(b[k].end_ms, b[k].end_ls, cur.end_ms, cur.end_ls) < 0) {
+          out[cnt].end_ms = b[k].end_ms;
+          out[cnt].end_ls = b[k].end_ls;
         }
-        overlap_count += int_end_ms - int_start_ms + 1;
+        cnt++;
+        continue;
       }
-    } else {
-      if ((int_end_ms - int_start_ms + 1) == pfx_size) {
-        *more_specific = 1;
+      if (cmp128(b[k].start_ms, b[k].start_ls, cur.start_ms, cur.start_ls) >
+          0) {
+        out[cnt] = cur;
+        out[cnt].end_ms = b[k].start_ms;
+        out[cnt].end_ls = b[k].start_ls;
+        dec128(&out[cnt].end_ms, &out[cnt].end_ls);
+        cnt++;
+      }
+      if (cmp128(b[k].end_ms, b[k].end_ls, cur.end_ms, cur.end_ls) >= 0) {
+        done = 1;
+        break;
       }
-      overlap_count += int_end_ms - int_start_ms + 1;
+      cur.start_ms = b[k].end_ms;
+      cur.start_ls = b[k].end_ls;
+      inc128(&cur.start_ms, &cur.start_ls);
+    }
+    if (!intersect && !done) {
+      out[cnt++] = cur;
     }
-    previous = current;
-    current = current->next;
   }
-  return overlap_count;
+
+  swap_vector6(dst, out, cnt, alloc);
+  return 0;
 }
 
-uint64_t bgpstream_ip_counter_is_overlapping(bgpstream_ip_counter_t *ipc,
-                                             bgpstream_pfx_t *pfx,
-                                             uint8_t *more_specific)
+/* check that the counters can be combined, and normalize them */
+static int prepare_set_op(bgpstream_ip_counter_t *dst,
+                          bgpstream_ip_counter_t *src)
 {
-  *more_specific = 0;
-  if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
-    return bgpstream_ip_counter_is_overlapping4(
-      ipc, (bgpstream_ipv4_pfx_t *)pfx, more_specific);
-  } else {
-    if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV6) {
-      return bgpstream_ip_counter_is_overlapping6(
-        ipc, (bgpstream_ipv6_pfx_t *)pfx, more_specific);
-    }
+  if ((dst->v4_bm == NULL) != (src->v4_bm == NULL)) {
+    fprintf(stderr, "ERROR: can't combine IP counters of different modes\n");
+    return -1;
   }
+  bgpstream_ip_counter_normalize(dst);
+  bgpstream_ip_counter_normalize(src);
   return 0;
 }
 
-uint64_t bgpstream_ip_counter_get_ipcount(bgpstream_ip_counter_t *ipc,
-                                          bgpstream_addr_version_t v)
+int bgpstream_ip_counter_union(bgpstream_ip_counter_t *dst,
+                               bgpstream_ip_counter_t *src)
 {
-  uint64_t ip_count = 0;
-
-  v4pfx_int_t *current4 = ipc->v4list;
-  v6pfx_int_t *current6 = ipc->v6list;
-  v6pfx_int_t *previous6 = ipc->v6list;
+  uint32_t w;
 
-  if (v == BGPSTREAM_ADDR_VERSION_IPV4) {
-    while (current4 != NULL) {
-      ip_count += (current4->end - current4->start) + 1;
-      current4 = current4->next;
+  if (prepare_set_op(dst, src) != 0) {
+    return -1;
+  }
+  if (dst->v4_bm != NULL) {
+    for (w = src->v4_bm_lo; w < src->v4_bm_hi; w++) {
+      dst->v4_bm[w] |= src->v4_bm[w];
     }
-  } else {
-    if (v == BGPSTREAM_ADDR_VERSION_IPV6) {
-      while (current6 != NULL) {
-
-        if (previous6 != current6) {
-          /* add a new /64 to the count if the previous one
-           * was different (it could have been a /64+ */
-          if (current6->start_ms != previous6->start_ms ||
-              current6->end_ms != previous6->end_ms) {
-            ip_count += (current6->end_ms - current6->start_ms) + 1;
-          }
-        } else { /* if it is the first interval, than we always add it */
-          ip_count += (current6->end_ms - current6->start_ms) + 1;
-        }
-        previous6 = current6;
-        current6 = current6->next;
+    if (src->v4_bm_lo < dst->v4_bm_lo) {
+      dst->v4_bm_lo = src->v4_bm_lo;
+    }
+    if (src->v4_bm_hi > dst->v4_bm_hi) {
+      dst->v4_bm_hi = src->v4_bm_hi;
+    }
+  }
+  return union_vectors(dst, src);
+}
+
+int bgpstream_ip_counter_intersect(bgpstream_ip_counter_t *dst,
+                                   bgpstream_ip_counter_t *src)
+{
+  uint32_t lo, hi, w;
+
+  if (prepare_set_op(dst, src) != 0) {
+    return -1;
+  }
+  if (dst->v4_bm != NULL) {
+    lo = dst->v4_bm_lo > src->v4_bm_lo ? dst->v4_bm_lo : src->v4_bm_lo;
+    hi = dst->v4_bm_hi < src->v4_bm_hi ? dst->v4_bm_hi : src->v4_bm_hi;
+    if (lo >= hi) {
+      /* no /24 in common (this must not touch the IPv6 prefixes, which are
+       * intersected below) */
+      bm_clear(dst);
+    } else {
+      /* words outside the range of src are cleared */
+      for (w = dst->v4_bm_lo; w < lo; w++) {
+        dst->v4_bm[w] = 0;
+      }
+      for (w = lo; w < hi; w++) {
+        dst->v4_bm[w] &= src->v4_bm[w];
+      }
+      for (w = hi; w < dst->v4_bm_hi; w++) {
+        dst->v4_bm[w] = 0;
       }
+      dst->v4_bm_lo = lo;
+      dst->v4_bm_hi = hi;
     }
+  } else if (sweep_vector4(dst, src, 1) != 0) {
+    return -1;
   }
-  return ip_count;
+  return sweep_vector6(dst, src, 1);
 }
 
-void bgpstream_ip_counter_clear(bgpstream_ip_counter_t *ipc)
+int bgpstream_ip_counter_subtract(bgpstream_ip_counter_t *dst,
+                                  bgpstream_ip_counter_t *src)
 {
-  v4pfx_int_t *current4 = ipc->v4list;
-  v4pfx_int_t *tmp4 = ipc->v4list;
-  v6pfx_int_t *current6 = ipc->v6list;
-  v6pfx_int_t *tmp6 = ipc->v6list;
+  uint32_t lo, hi, w;
 
-  while (tmp4 != NULL) {
-    current4 = tmp4;
-    tmp4 = tmp4->next;
-    free(current4);
+  if (prepare_set_op(dst, src) != 0) {
+    return -1;
   }
-  ipc->v4list = NULL;
+  if (dst->v4_bm != NULL) {
+    lo = dst->v4_bm_lo > src->v4_bm_lo ? dst->v4_bm_lo : src->v4_bm_lo;
+    hi = dst->v4_bm_hi < src->v4_bm_hi ? dst->v4_bm_hi : src->v4_bm_hi;
+    for (w = lo; w < hi; w++) {
+      dst->v4_bm[w] &= ~src->v4_bm[w];
+    }
+  } else if (sweep_vector4(dst, src, 0) != 0) {
+    return -1;
+  }
+  return sweep_vector6(dst, src, 0);
+}
 
-  while (tmp6 != NULL) {
-    current6 = tmp6;
-    tmp6 = tmp6->next;
-    free(current6);
+void bgpstream_ip_counter_clear(bgpstream_ip_counter_t *ipc)
+{
+  /* keep the vectors around so they can be reused */
+  ipc->v4_cnt = 0;
+  ipc->v4_sorted = 0;
+  ipc->v6_cnt = 0;
+  ipc->v6_sorted = 0;
+
+  if (ipc->v4_bm != NULL) {
+    bm_clear(ipc);
   }
-  ipc->v6list = NULL;
 }
 
 void bgpstream_ip_counter_destroy(bgpstream_ip_counter_t *ipc)
 {
-  bgpstream_ip_counter_clear(ipc);
+  if (ipc == NULL) {
+    return;
+  }
+  free(ipc->v4);
+  free(ipc->v4_spare);
+  free(ipc->v6);
+  free(ipc->v6_spare);
+  free(ipc->v4_bm);
   free(ipc);
 }
@@ -61,14 +61,54 @@ typedef struct bgpstream_ip_counter bgpstream_ip_counter_t;
  */
 bgpstream_ip_counter_t *bgpstream_ip_counter_create();
 
+/** Create a new IP Counter instance that tracks IPv4 space at /24 granularity
+ *
+ * @return a pointer to the structure, or NULL if an error occurred
+ *
+ * IPv4 space is stored in a 2 MiB bitmap with one bit per /24, which makes
+ * adding, counting and combining counters independent of the number of
+ * prefixes. A prefix more specific than a /24 marks its whole /24 as
+ * covered, and each covered /24 counts as 256 IPs. IPv6 space is tracked
+ * exactly as by a regular IP Counter.
+ */
+bgpstream_ip_counter_t *bgpstream_ip_counter_create_slash24();
+
 /** Add a prefix to the IP Counter
  *
  * @param counter      pointer to the IP Counter
  * @param pfx          prefix to insert in IP Counter
  * @return             0 if a prefix was added correctly, -1 otherwise
+ *
+ * Prefixes are merged in batches: new prefixes are sorted and merged with the
+ * others by the next call to any other IP Counter function, or once they
+ * outnumber the prefixes already merged. Adding n prefixes therefore costs
+ * O(n log n) overall, but a query that follows each addition still costs time
+ * linear in the size of the counter to merge the new prefix in.
  */
 int bgpstream_ip_counter_add(bgpstream_ip_counter_t *ipc, bgpstream_pfx_t *pfx);
 
+/** Append a prefix to the IP Counter without merging it in
+ *
+ * @param counter      pointer to the IP Counter
+ * @param pfx          prefix to insert in IP Counter
+ * @return             0 if a prefix was added correctly, -1 otherwise
+ *
+ * This is the fast path for adding many prefixes at once: appended prefixes
+ * are sorted and merged in a single pass by
+ * bgpstream_ip_counter_normalize, or implicitly by the next call to any
+ * other IP Counter function. Unlike bgpstream_ip_counter_add, they are never
+ * merged before then, so the counter grows with every appended prefix, even
+ * duplicates.
+ */
+int bgpstream_ip_counter_append(bgpstream_ip_counter_t *ipc,
+                                bgpstream_pfx_t *pfx);
+
+/** Merge all the prefixes appended to the IP Counter
+ *
+ * @param counter      pointer to the IP Counter
+ */
+void bgpstream_ip_counter_normalize(bgpstream_ip_counter_t *ipc);
+
 /** Get the number of unique IPs in the IP Counter
  *
  * @param counter        pointer to the IP Counter
@@ -92,6 +132,40 @@ uint64_t bgpstream_ip_counter_is_overlapping(bgpstream_ip_counter_t *ipc,
                                              bgpstream_pfx_t *pfx,
                                              uint8_t *more_specific);
 
+/** Add the address space of one IP Counter to another
+ *
+ * @param dst            pointer to the IP Counter to update
+ * @param src            pointer to the IP Counter to add to dst
+ * @return 0 if the counters were combined correctly, -1 otherwise
+ *
+ * Both counters must have been created in the same mode (i.e. both or
+ * neither with bgpstream_ip_counter_create_slash24).
+ */
+int bgpstream_ip_counter_union(bgpstream_ip_counter_t *dst,
+                               bgpstream_ip_counter_t *src);
+
+/** Remove from an IP Counter the address space not covered by another
+ *
+ * @param dst            pointer to the IP Counter to update
+ * @param src            pointer to the IP Counter to intersect dst with
+ * @return 0 if the counters were combined correctly, -1 otherwise
+ *
+ * Both counters must have been created in the same mode.
+ */
+int bgpstream_ip_counter_intersect(bgpstream_ip_counter_t *dst,
+                                   bgpstream_ip_counter_t *src);
+
+/** Remove from an IP Counter the address space covered by another
+ *
+ * @param dst            pointer to the IP Counter to update
+ * @param src            pointer to the IP Counter to subtract from dst
+ * @return 0 if the counters were combined correctly, -1 otherwise
+ *
+ * Both counters must have been created in the same mode.
+ */
+int bgpstream_ip_counter_subtract(bgpstream_ip_counter_t *dst,
+                                  bgpstream_ip_counter_t *src);
+
 /** Empty the IP Counter
  *
  * @param counter        pointer to the IP Counter to clear
@@ -43,6 +43,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <netdb.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -60,6 +61,15 @@
 
 #define BIT_TEST(f, b) ((f) & (b))
 
+/* Nodes are allocated from one pool of slabs per address family. Slabs are
+ * never moved, so nodes can refer to each other with plain pointers */
+
+/* number of nodes per slab */
+#define PATRICIA_SLAB_NODES 4096
+
+/* initial size of the array of slab pointers */
+#define PATRICIA_SLABS_INIT_SIZE 16
+
 static int comp_with_mask(void *addr, void *dest, u_int mask)
 {
 
@@ -75,23 +85,64 @@ static int comp_with_mask(void *addr, void *dest, u_int mask)
 
 struct bgpstream_patricia_node {
 
-  /* flag if this node used */
-  u_int bit;
-
-  /* who we are in patricia tree */
-  bgpstream_pfx_storage_t prefix;
-
   /* left and right children */
   bgpstream_patricia_node_t *l;
   bgpstream_patricia_node_t *r;
 
-  /* parent node */
+  /* flag if this node used */
+  uint8_t bit;
+
+  /* set if the node belongs to the IPv6 pool (glue nodes have no address
+   * version to tell) */
+  uint8_t ipv6;
+
+  /* parent node (or next free node, once the node is released) */
   bgpstream_patricia_node_t *parent;
 
   /* pointer to user data */
   void *user;
+
+  /* number of /24 (IPv4) or /64 (IPv6) subnets covered by the subtree rooted
+   * at this node, kept up to date by insert and remove */
+  uint64_t subnets;
+
+  /* who we are in patricia tree: the nodes of the IPv4 and IPv6 pools are
+   * sized so that this is a complete bgpstream_ipv4_pfx_t or
+   * bgpstream_ipv6_pfx_t respectively (glue nodes have an unknown address
+   * version) */
+  bgpstream_pfx_t prefix;
 };
 
+/* size of a node holding a prefix of the given type, padded so that nodes
+ * packed in a slab stay aligned */
+#define PATRICIA_NODE_SIZE(pfx_type)                                           \
+  ((offsetof(bgpstream_patricia_node_t, prefix) + sizeof(pfx_type) +          \
+    sizeof(void *) - 1) &                                                      \
+   ~(sizeof(void *) - 1))
+#define PATRICIA_NODE4_SIZE PATRICIA_NODE_SIZE(bgpstream_ipv4_pfx_t)
+#define PATRICIA_NODE6_SIZE PATRICIA_NODE_SIZE(bgpstream_ipv6_pfx_t)
+
+typedef struct patricia_pool {
+
+  /* size of the nodes in this pool */
+  size_t node_size;
+
+  /* 1 for the IPv6 pool, 0 otherwise */
+  uint8_t ipv6;
+
+  /* array of slabs, each of PATRICIA_SLAB_NODES nodes */
+  char **slabs;
+  uint32_t slabs_cnt;
+  uint32_t slabs_alloc;
+
+  /* number of the first node that has never been used */
+  uint64_t next_unused;
+
+  /* list of released nodes */
+  bgpstream_patricia_node_t *free_list;
+
+} patricia_pool_t;
+
 struct bgpstream_patricia_tree {
 
   /* IPv4 tree */
@@ -100,6 +151,10 @@ struct bgpstream_patricia_tree {
   /* IPv6 tree */
   bgpstream_patricia_node_t *head6;
 
+  /* Node pools */
+  patricia_pool_t pool4;
+  patricia_pool_t pool6;
+
   /* Number of nodes per tree */
   uint64_t ipv4_active_nodes;
   uint64_t ipv6_active_nodes;
@@ -138,8 +193,140 @@ static unsigned char *bgpstream_pfx_get_first_byte(bgpstream_pfx_t *pfx)
   return NULL;
 }
 
+/* child to follow when looking for addr; the child is selected without a
+ * branch, since the direction taken at each step of a lookup is essentially
+ * random */
+static inline bgpstream_patricia_node_t *
+node_next(const bgpstream_patricia_node_t *node, const unsigned char *addr)
+{
+  uint32_t right = (addr[node->bit >> 3] >> (7 - (node->bit & 0x07))) & 1;
+  return right ? node->r : node->l;
+}
+
+/* ======================= NODE POOL FUNCTIONS ======================= */
+
+static void bgpstream_patricia_pool_init(patricia_pool_t *pool,
+                                         size_t node_size, uint8_t ipv6)
+{
+  pool->node_size = node_size;
+  pool->ipv6 = ipv6;
+  pool->next_unused = 0;
+  pool->free_list = NULL;
+}
+
+/* i-th node of the pool, counting from the start of the first slab */
+static bgpstream_patricia_node_t *
+bgpstream_patricia_pool_node(const patricia_pool_t *pool, uint64_t i)
+{
+  return (bgpstream_patricia_node_t *)(pool->slabs[i / PATRICIA_SLAB_NODES] +
+                                       (i % PATRICIA_SLAB_NODES) *
+                                         pool->node_size);
+}
+
+static patricia_pool_t *
+bgpstream_patricia_get_pool(bgpstream_patricia_tree_t *pt,
+                            bgpstream_addr_version_t v)
+{
+  switch (v) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    return &pt->pool4;
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    return &pt->pool6;
+  default:
+    assert(0);
+  }
+  return NULL;
+}
+
+/* get a zeroed node from the pool (a released one if possible) */
+static bgpstream_patricia_node_t *
+bgpstream_patricia_pool_alloc(patricia_pool_t *pool)
+{
+  bgpstream_patricia_node_t *node;
+  char **slabs;
+
+  if (pool->free_list != NULL) {
+    node = pool->free_list;
+    pool->free_list = node->parent;
+  } else {
+    if (pool->next_unused / PATRICIA_SLAB_NODES == pool->slabs_cnt) {
+      /* all slabs are in use, add a new one */
+      if (pool->slabs_cnt == pool->slabs_alloc) {
+        pool->slabs_alloc = (pool->slabs_alloc == 0) ? PATRICIA_SLABS_INIT_SIZE
+                                                     : pool->slabs_alloc * 2;
+        if ((slabs = realloc(pool->slabs,
+                             sizeof(char *) * pool->slabs_alloc)) == NULL) {
+          return NULL;
+        }
+        pool->slabs = slabs;
+      }
+      if ((pool->slabs[pool->slabs_cnt] =
+             malloc(pool->node_size * PATRICIA_SLAB_NODES)) == NULL) {
+        return NULL;
+      }
+      pool->slabs_cnt++;
+    }
+    node = bgpstream_patricia_pool_node(pool, pool->next_unused++);
+  }
+
+  memset(node, 0, pool->node_size);
+  node->ipv6 = pool->ipv6;
+  return node;
+}
+
+/* give a node (that must not be linked to the tree anymore) back to its
+ * pool */
+static void bgpstream_patricia_pool_release(bgpstream_patricia_tree_t *pt,
+                                            bgpstream_patricia_node_t *node)
+{
+  patricia_pool_t *pool = node->ipv6 ? &pt->pool6 : &pt->pool4;
+
+  node->prefix.address.version = BGPSTREAM_ADDR_VERSION_UNKNOWN;
+  node->user = NULL;
+  node->l = NULL;
+  node->r = NULL;
+  node->parent = pool->free_list;
+  pool->free_list = node;
+}
+
+/* call the user destructor on all the nodes of the pool, and make all of its
+ * nodes available again */
+static void bgpstream_patricia_pool_clear(bgpstream_patricia_tree_t *pt,
+                                          patricia_pool_t *pool)
+{
+  bgpstream_patricia_node_t *node;
+  uint64_t i;
+
+  if (pt->node_user_destructor != NULL) {
+    /* released nodes have no user pointer */
+    for (i = 0; i < pool->next_unused; i++) {
+      node = bgpstream_patricia_pool_node(pool, i);
+      if (node->user != NULL) {
+        pt->node_user_destructor(node->user);
+        node->user = NULL;
+      }
+    }
+  }
+  pool->next_unused = 0;
+  pool->free_list = NULL;
+}
+
+static void bgpstream_patricia_pool_destroy(patricia_pool_t *pool)
+{
+  uint32_t i;
+
+  for (i = 0; i < pool->slabs_cnt; i++) {
+    free(pool->slabs[i]);
+  }
+  free(pool->slabs);
+  pool->slabs = NULL;
+  pool->slabs_cnt = 0;
+  pool->slabs_alloc = 0;
+}
+
 /* ======================= RESULT SET FUNCTIONS  ======================= */
 
+
 static int bgpstream_patricia_tree_result_set_add_node(
   bgpstream_patricia_tree_result_set_t *set, bgpstream_patricia_node_t *node)
 {
@@ -180,7 +367,8 @@ bgpstream_patricia_node_create(bgpstream_patricia_tree_t *pt,
   assert(pfx->mask_len <= BGPSTREAM_PATRICIA_MAXBITS);
   assert(pfx->address.version != BGPSTREAM_ADDR_VERSION_UNKNOWN);
 
-  if ((node = malloc_zero(sizeof(bgpstream_patricia_node_t))) == NULL) {
+  if ((node = bgpstream_patricia_pool_alloc(
+         bgpstream_patricia_get_pool(pt, pfx->address.version))) == NULL) {
     return NULL;
   }
 
@@ -190,28 +378,24 @@ bgpstream_patricia_node_create(bgpstream_patricia_tree_t *pt,
     pt->ipv6_active_nodes++;
   }
 
-  bgpstream_pfx_copy((bgpstream_pfx_t*)&node->prefix, pfx);
+  bgpstream_pfx_copy(&node->prefix, pfx);
 
-  node->parent = NULL;
   node->bit = pfx->mask_len;
-  node->l = NULL;
-  node->r = NULL;
-  node->user = NULL;
   return node;
 }
 
-static bgpstream_patricia_node_t *bgpstream_patricia_gluenode_create()
+static bgpstream_patricia_node_t *
+bgpstream_patricia_gluenode_create(bgpstream_patricia_tree_t *pt,
+                                   bgpstream_addr_version_t v)
 {
   bgpstream_patricia_node_t *node;
 
-  if ((node = malloc_zero(sizeof(bgpstream_patricia_node_t))) == NULL) {
+  if ((node = bgpstream_patricia_pool_alloc(
+         bgpstream_patricia_get_pool(pt, v))) == NULL) {
     return NULL;
   }
   node->prefix.address.version = BGPSTREAM_ADDR_VERSION_UNKNOWN;
-  node->parent = NULL;
   node->bit = 0;
-  node->l = NULL;
-  node->r = NULL;
   return node;
 }
 
@@ -248,42 +432,59 @@ static void bgpstream_patricia_set_head(bgpstream_patricia_tree_t *pt,
   }
 }
 
+/* number of /subnet_size subnets covered by the subtree rooted at node,
+ * computed from the counts of its children */
 static uint64_t
-bgpstream_patricia_tree_count_subnets(bgpstream_patricia_node_t *node,
-                                      uint64_t subnet_size)
+bgpstream_patricia_node_count_subnets(bgpstream_patricia_node_t *node)
 {
-  if (node == NULL) {
-    return 0;
-  }
+  /* glue nodes have no address version, so use the pool of the node */
+  uint8_t subnet_size = node->ipv6 ? 64 : 24;
+  bgpstream_patricia_node_t *child;
+  uint64_t cnt = 0;
+
   /* if the node is a glue node, then the /subnet_size subnets are the sum of
-   * the
-   * /24 subnets contained in its left and right subtrees */
+   * the subnets contained in its left and right subtrees */
   if (node->prefix.address.version == BGPSTREAM_ADDR_VERSION_UNKNOWN) {
     /* if the glue node is already a /subnet_size, then just return 1 (even
-     * though
-     * the subnetworks below could be a non complete /subnet_size */
+     * though the subnetworks below could be a non complete /subnet_size */
     if (node->bit >= subnet_size) {
       return 1;
-    } else {
-      return bgpstream_patricia_tree_count_subnets(node->l, subnet_size) +
-             bgpstream_patricia_tree_count_subnets(node->r, subnet_size);
     }
-  } else {
-    /* otherwise we just count the subnet for the given network and return
-     * we don't need to go deeper in the tree (everything else beyond this
-     * point is covered */
+    if ((child = node->l) != NULL) {
+      cnt += child->subnets;
+    }
+    if ((child = node->r) != NULL) {
+      cnt += child->subnets;
+    }
+    return cnt;
+  }
 
-    /* compute how many /subnet_size are in this prefix */
-    if (node->prefix.mask_len >= subnet_size) {
-      return 1;
-    } else {
-      uint8_t diff = subnet_size - node->prefix.mask_len;
-      if (diff == 64) {
-        return UINT64_MAX;
-      } else {
-        return (uint64_t)1 << diff;
-      }
+  /* otherwise we just count the subnets of the given network: everything
+   * else beyond this point is covered */
+  if (node->prefix.mask_len >= subnet_size) {
+    return 1;
+  }
+  if (subnet_size - node->prefix.mask_len == 64) {
+    return UINT64_MAX;
+  }
+  return (uint64_t)1 << (subnet_size - node->prefix.mask_len);
+}
+
+/* recompute the subnet count of a node whose prefix or children changed, and
+ * of its ancestors, stopping at the first ancestor whose count is
+ * unchanged */
+static void
+bgpstream_patricia_node_update_subnets(bgpstream_patricia_node_t *node)
+{
+  uint64_t cnt;
+
+  node->subnets = bgpstream_patricia_node_count_subnets(node);
+  while ((node = node->parent) != NULL) {
+    cnt = bgpstream_patricia_node_count_subnets(node);
+    if (cnt == node->subnets) {
+      break;
     }
+    node->subnets = cnt;
   }
 }
 
@@ -357,6 +558,128 @@ bgpstream_patricia_tree_find_more_specific(bgpstream_patricia_node_t *node)
   return 1;
 }
 
+/* check whether a tree prefix allows the given type of match
+ * (BGPSTREAM_PREFIX_MATCH_MORE or BGPSTREAM_PREFIX_MATCH_LESS) */
+static int bgpstream_patricia_node_allows(bgpstream_patricia_node_t *node,
+                                          uint8_t match)
+{
+  return node->prefix.allowed_matches == BGPSTREAM_PREFIX_MATCH_ANY ||
+         node->prefix.allowed_matches == match;
+}
+
+/* like bgpstream_patricia_tree_find_more_specific, but optionally only
+ * considers prefixes that allow less specific matches */
+static int bgpstream_patricia_tree_find_more_specific_allowed(
+  bgpstream_patricia_node_t *node, int check_allowed)
+{
+  if (node == NULL) {
+    return 0;
+  }
+  if (node->prefix.address.version != BGPSTREAM_ADDR_VERSION_UNKNOWN &&
+      (check_allowed == 0 ||
+       bgpstream_patricia_node_allows(node, BGPSTREAM_PREFIX_MATCH_LESS))) {
+    return 1;
+  }
+  return bgpstream_patricia_tree_find_more_specific_allowed(node->l,
+                                                            check_allowed) ||
+         bgpstream_patricia_tree_find_more_specific_allowed(node->r,
+                                                            check_allowed);
+}
+
+/* find how the given prefix overlaps with the prefixes in the tree, without
+ * modifying the tree. If check_allowed is set, less specific prefixes only
+ * count if they allow more specific matches (and vice versa). If best is not
+ * NULL, it is set to the most specific tree prefix that covers (or is equal
+ * to) the given prefix */
+static uint8_t
+bgpstream_patricia_tree_lookup(const bgpstream_patricia_tree_t *pt,
+                               const bgpstream_pfx_t *pfx, int check_allowed,
+                               bgpstream_patricia_node_t **best)
+{
+  bgpstream_patricia_node_t *node;
+  bgpstream_patricia_node_t *real;
+  unsigned char *addr = bgpstream_pfx_get_first_byte((bgpstream_pfx_t *)pfx);
+  uint8_t bitlen = pfx->mask_len;
+  uint8_t mask = 0;
+
+  assert(pfx->mask_len <= BGPSTREAM_PATRICIA_MAXBITS);
+
+  if (best != NULL) {
+    *best = NULL;
+  }
+
+  switch (pfx->address.version) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    node = pt->head4;
+    break;
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    node = pt->head6;
+    break;
+  default:
+    assert(0);
+    return 0;
+  }
+
+  /* walk down the path of the prefix: every real prefix we pass through that
+   * agrees with the prefix on its mask is a less specific */
+  while (node != NULL && node->bit < bitlen) {
+    if (node->prefix.address.version != BGPSTREAM_ADDR_VERSION_UNKNOWN) {
+      if (!comp_with_mask(
+            bgpstream_pfx_get_first_byte((bgpstream_pfx_t *)&node->prefix),
+            addr, node->bit)) {
+        /* neither this prefix nor anything below it overlaps */
+        return mask;
+      }
+      if (best != NULL) {
+        *best = node;
+      }
+      if (check_allowed == 0 ||
+          bgpstream_patricia_node_allows(node, BGPSTREAM_PREFIX_MATCH_MORE)) {
+        mask |= BGPSTREAM_PATRICIA_LESS_SPECIFICS;
+      }
+    }
+    node = node_next(node, addr);
+  }
+
+  if (node == NULL) {
+    return mask;
+  }
+
+  /* all the prefixes below node share their first node->bit bits, so any real
+   * one tells us whether the subtree is inside the prefix */
+  real = node;
+  while (real->prefix.address.version == BGPSTREAM_ADDR_VERSION_UNKNOWN) {
+    real = (real->l != NULL) ? real->l : real->r;
+    assert(real != NULL);
+  }
+  if (!comp_with_mask(
+        bgpstream_pfx_get_first_byte((bgpstream_pfx_t *)&real->prefix), addr,
+        bitlen)) {
+    return mask;
+  }
+
+  if (node->bit == bitlen) {
+    if (node->prefix.address.version != BGPSTREAM_ADDR_VERSION_UNKNOWN) {
+      mask |= BGPSTREAM_PATRICIA_EXACT_MATCH;
+      if (best != NULL) {
+        *best = node;
+      }
+    }
+    /* we do not consider the node itself */
+    if (bgpstream_patricia_tree_find_more_specific_allowed(node->l,
+                                                           check_allowed) ||
+        bgpstream_patricia_tree_find_more_specific_allowed(node->r,
+                                                           check_allowed)) {
+      mask |= BGPSTREAM_PATRICIA_MORE_SPECIFICS;
+    }
+  } else if (bgpstream_patricia_tree_find_more_specific_allowed(
+               node, check_allowed)) {
+    mask |= BGPSTREAM_PATRICIA_MORE_SPECIFICS;
+  }
+
+  return mask;
+}
+
 static void bgpstream_patricia_tree_merge_tree(bgpstream_patricia_tree_t *dst,
                                                bgpstream_patricia_node_t *node)
 {
@@ -416,22 +739,6 @@ static void bgpstream_patricia_tree_print_tree(bgpstream_patricia_node_t *node)
   bgpstream_patricia_tree_print_tree(node->r);
 }
 
-static void
-bgpstream_patricia_tree_destroy_tree(bgpstream_patricia_tree_t *pt,
-                                     bgpstream_patricia_node_t *head)
-{
-  if (head != NULL) {
-    bgpstream_patricia_node_t *l = head->l;
-    bgpstream_patricia_node_t *r = head->r;
-    bgpstream_patricia_tree_destroy_tree(pt, l);
-    bgpstream_patricia_tree_destroy_tree(pt, r);
-    if (head->user != NULL && pt->node_user_destructor != NULL) {
-      pt->node_user_destructor(head->user);
-    }
-    free(head);
-  }
-}
-
 /* ======================= PUBLIC API FUNCTIONS ======================= */
 
 bgpstream_patricia_tree_result_set_t *
@@ -515,6 +822,8 @@ bgpstream_patricia_tree_t *bgpstream_patricia_tree_create(
   }
   pt->head4 = NULL;
   pt->head6 = NULL;
+  bgpstream_patricia_pool_init(&pt->pool4, PATRICIA_NODE4_SIZE, 0);
+  bgpstream_patricia_pool_init(&pt->pool6, PATRICIA_NODE6_SIZE, 1);
   pt->ipv4_active_nodes = 0;
   pt->ipv6_active_nodes = 0;
   pt->node_user_destructor = bspt_user_destructor;
@@ -544,6 +853,7 @@ bgpstream_patricia_tree_insert(bgpstream_patricia_tree_t *pt,
     }
     /* attach first node in Tree */
     bgpstream_patricia_set_head(pt, v, new_node);
+    bgpstream_patricia_node_update_subnets(new_node);
     /* DEBUG       fprintf(stderr, "Adding %s to HEAD\n", buffer); */
     return new_node;
   }
@@ -632,12 +942,13 @@ bgpstream_patricia_tree_insert(bgpstream_patricia_tree_t *pt,
     }
     /* otherwise replace the info in the glue node with proper
      * prefix information and increment the right counter*/
-    node_it->prefix = *((bgpstream_pfx_storage_t *)pfx);
+    bgpstream_pfx_copy(&node_it->prefix, pfx);
     if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
       pt->ipv4_active_nodes++;
     } else {
       pt->ipv6_active_nodes++;
     }
+    bgpstream_patricia_node_update_subnets(node_it);
 
     /* patricia_lookup: new node #1 (glue mod) */
     /* DEBUG fprintf(stderr, "Using %s to replace a GLUE node\n", buffer); */
@@ -662,6 +973,7 @@ bgpstream_patricia_tree_insert(bgpstream_patricia_tree_t *pt,
       assert(node_it->l == NULL);
       node_it->l = new_node;
     }
+    bgpstream_patricia_node_update_subnets(new_node);
     /* patricia_lookup: new_node #2 (child) */
     /* DEBUG  fprintf(stderr, "Adding %s as a CHILD node\n", buffer); */
     return new_node;
@@ -677,17 +989,18 @@ bgpstream_patricia_tree_insert(bgpstream_patricia_tree_t *pt,
       new_node->l = node_it;
     }
     new_node->parent = node_it->parent;
-    if (node_it->parent == NULL) {
+    if (parent == NULL) {
       assert(bgpstream_patricia_get_head(pt, v) == node_it);
       bgpstream_patricia_set_head(pt, v, new_node);
     } else {
-      if (node_it->parent->r == node_it) {
-        node_it->parent->r = new_node;
+      if (parent->r == node_it) {
+        parent->r = new_node;
       } else {
-        node_it->parent->l = new_node;
+        parent->l = new_node;
       }
     }
     node_it->parent = new_node;
+    bgpstream_patricia_node_update_subnets(new_node);
     /* patricia_lookup: new_node #3 (parent) */
     /* DEBUG fprintf(stderr, "Adding %s as a PARENT node\n", buffer); */
     return new_node;
@@ -695,7 +1008,16 @@ bgpstream_patricia_tree_insert(bgpstream_patricia_tree_t *pt,
     /* Insert the new node in the Patricia Tree: CREATE A GLUE NODE AND APPEND
      * TO IT*/
 
-    glue_node = bgpstream_patricia_gluenode_create();
+    if ((glue_node = bgpstream_patricia_gluenode_create(pt, v)) == NULL) {
+      fprintf(stderr, "Error creating pt glue node\n");
+      bgpstream_patricia_pool_release(pt, new_node);
+      if (v == BGPSTREAM_ADDR_VERSION_IPV4) {
+        pt->ipv4_active_nodes--;
+      } else {
+        pt->ipv6_active_nodes--;
+      }
+      return NULL;
+    }
 
     glue_node->bit = differ_bit;
     glue_node->parent = node_it->parent;
@@ -710,17 +1032,19 @@ bgpstream_patricia_tree_insert(bgpstream_patricia_tree_t *pt,
     }
     new_node->parent = glue_node;
 
-    if (node_it->parent == NULL) {
+    if (parent == NULL) {
       assert(bgpstream_patricia_get_head(pt, v) == node_it);
       bgpstream_patricia_set_head(pt, v, glue_node);
     } else {
-      if (node_it->parent->r == node_it) {
-        node_it->parent->r = glue_node;
+      if (parent->r == node_it) {
+        parent->r = glue_node;
       } else {
-        node_it->parent->l = glue_node;
+        parent->l = glue_node;
       }
     }
     node_it->parent = glue_node;
+    new_node->subnets = bgpstream_patricia_node_count_subnets(new_node);
+    bgpstream_patricia_node_update_subnets(glue_node);
     /* "patricia_lookup: new_node #4 (glue+node) */
     /* DEBUG fprintf(stderr, "Adding %s as a CHILD of a NEW GLUE node\n",
      * buffer); */
@@ -754,20 +1078,7 @@ uint8_t
 bgpstream_patricia_tree_get_pfx_overlap_info(bgpstream_patricia_tree_t *pt,
                                              bgpstream_pfx_t *pfx)
 {
-
-  bgpstream_patricia_node_t *n = bgpstream_patricia_tree_search_exact(pt, pfx);
-  if (n != NULL) {
-    return bgpstream_patricia_tree_get_node_overlap_info(pt, n) |
-           BGPSTREAM_PATRICIA_EXACT_MATCH;
-  } else {
-    /* we basically simulate an insertion, to understand whether the prefix
-     * would overlap or not */
-    n = bgpstream_patricia_tree_insert(pt, pfx);
-    uint8_t mask = bgpstream_patricia_tree_get_node_overlap_info(pt, n);
-    bgpstream_patricia_tree_remove_node(pt, n);
-    return mask & (~BGPSTREAM_PATRICIA_EXACT_MATCH);
-  }
-  return 0;
+  return bgpstream_patricia_tree_lookup_overlap_info(pt, pfx);
 }
 
 void bgpstream_patricia_tree_remove(bgpstream_patricia_tree_t *pt,
@@ -787,6 +1098,7 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
 
   bgpstream_addr_version_t v = node->prefix.address.version;
   bgpstream_patricia_node_t *parent;
+  bgpstream_patricia_node_t *grandparent;
   bgpstream_patricia_node_t *child;
 
   uint64_t *num_active_node = &pt->ipv4_active_nodes;
@@ -815,6 +1127,7 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
     if (node->prefix.address.version != BGPSTREAM_ADDR_VERSION_UNKNOWN) {
       node->prefix.address.version = BGPSTREAM_ADDR_VERSION_UNKNOWN;
     }
+    bgpstream_patricia_node_update_subnets(node);
     /* node data remains, unless we decide to pass a destroy function somewehere
      */
     /* node->user = NULL; */
@@ -825,13 +1138,13 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
   /* if node has no children */
   if (node->r == NULL && node->l == NULL) {
     parent = node->parent;
-    free(node);
     (*num_active_node) = (*num_active_node) - 1;
 
     /* removing head of tree */
     if (parent == NULL) {
       assert(node == bgpstream_patricia_get_head(pt, v));
       bgpstream_patricia_set_head(pt, v, NULL);
+      bgpstream_patricia_pool_release(pt, node);
       /* DEBUG fprintf(stderr, "Removing head (that had no children)\n"); */
       return;
     }
@@ -845,8 +1158,10 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
       parent->l = NULL;
       child = parent->r;
     }
+    bgpstream_patricia_pool_release(pt, node);
 
-    /* if the current parent was a valid prefix, return */
+    /* if the current parent was a valid prefix, return (it covers all of its
+     * subtree, so no subnet count changes) */
     if (parent->prefix.address.version != BGPSTREAM_ADDR_VERSION_UNKNOWN) {
       /* DEBUG fprintf(stderr, "Removing node with no children\n"); */
       return;
@@ -855,22 +1170,25 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
     /* otherwise it makes no sense to have a glue node
      * with only one child, the parent has to be removed */
 
-    if (parent->parent ==
-        NULL) { /* if the parent parent is the head, then attach
-                 * the only child directly */
+    grandparent = parent->parent;
+    if (grandparent == NULL) { /* if the parent parent is the head, then
+                                * attach the only child directly */
       assert(parent == bgpstream_patricia_get_head(pt, v));
       bgpstream_patricia_set_head(pt, v, child);
     } else {
-      if (parent->parent->r == parent) { /* if the parent is a right child */
-        parent->parent->r = child;
+      if (grandparent->r == parent) { /* if the parent is a right child */
+        grandparent->r = child;
       } else { /* if the parent is a left child */
-        assert(parent->parent->l == parent);
-        parent->parent->l = child;
+        assert(grandparent->l == parent);
+        grandparent->l = child;
       }
     }
     /* the child parent, is now the grand-parent */
     child->parent = parent->parent;
-    free(parent);
+    bgpstream_patricia_pool_release(pt, parent);
+    if (grandparent != NULL) {
+      bgpstream_patricia_node_update_subnets(grandparent);
+    }
     return;
   }
 
@@ -883,16 +1201,14 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
   }
   /* the child parent, is now the grand-parent */
   parent = node->parent;
-  child->parent = parent;
+  child->parent = node->parent;
 
-  free(node);
   (*num_active_node) = (*num_active_node) - 1;
 
   if (parent == NULL) { /* if the parent is the head, then attach
                          * the only child directly */
     assert(node == bgpstream_patricia_get_head(pt, v));
     bgpstream_patricia_set_head(pt, v, child);
-    return;
   } else {
     /* attach child node to the correct parent child pointer */
     if (parent->r == node) { /* if node was a right child */
@@ -902,6 +1218,10 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
       parent->l = child;
     }
   }
+  bgpstream_patricia_pool_release(pt, node);
+  if (parent != NULL) {
+    bgpstream_patricia_node_update_subnets(parent);
+  }
 }
 
 bgpstream_patricia_node_t *
@@ -925,13 +1245,7 @@ bgpstream_patricia_tree_search_exact(bgpstream_patricia_tree_t *pt,
   unsigned char *addr = bgpstream_pfx_get_first_byte(pfx);
 
   while (node_it->bit < bitlen) {
-    if (BIT_TEST(addr[node_it->bit >> 3], 0x80 >> (node_it->bit & 0x07))) {
-      /* patricia_lookup: take right at node->bit */
-      node_it = node_it->r;
-    } else {
-      /* patricia_lookup: take left at node->bit */
-      node_it = node_it->l;
-    }
+    node_it = node_next(node_it, addr);
     if (node_it == NULL) {
       return NULL;
     }
@@ -956,6 +1270,35 @@ bgpstream_patricia_tree_search_exact(bgpstream_patricia_tree_t *pt,
   return NULL;
 }
 
+bgpstream_patricia_node_t *
+bgpstream_patricia_tree_search_best(const bgpstream_patricia_tree_t *pt,
+                                    const bgpstream_pfx_t *pfx)
+{
+  bgpstream_patricia_node_t *best;
+
+  assert(pt);
+  assert(pfx);
+  bgpstream_patricia_tree_lookup(pt, pfx, 0, &best);
+  return best;
+}
+
+uint8_t
+bgpstream_patricia_tree_lookup_overlap_info(const bgpstream_patricia_tree_t *pt,
+                                            const bgpstream_pfx_t *pfx)
+{
+  assert(pt);
+  assert(pfx);
+  return bgpstream_patricia_tree_lookup(pt, pfx, 0, NULL);
+}
+
+int bgpstream_patricia_tree_lookup_match(const bgpstream_patricia_tree_t *pt,
+                                         const bgpstream_pfx_t *pfx)
+{
+  assert(pt);
+  assert(pfx);
+  return bgpstream_patricia_tree_lookup(pt, pfx, 1, NULL) != 0;
+}
+
 uint64_t bgpstream_patricia_prefix_count(bgpstream_patricia_tree_t *pt,
                                          bgpstream_addr_version_t v)
 {
@@ -972,12 +1315,14 @@ uint64_t bgpstream_patricia_prefix_count(bgpstream_patricia_tree_t *pt,
 
 uint64_t bgpstream_patricia_tree_count_24subnets(bgpstream_patricia_tree_t *pt)
 {
-  return bgpstream_patricia_tree_count_subnets(pt->head4, 24);
+  bgpstream_patricia_node_t *head = pt->head4;
+  return (head == NULL) ? 0 : head->subnets;
 }
 
 uint64_t bgpstream_patricia_tree_count_64subnets(bgpstream_patricia_tree_t *pt)
 {
-  return bgpstream_patricia_tree_count_subnets(pt->head6, 64);
+  bgpstream_patricia_node_t *head = pt->head6;
+  return (head == NULL) ? 0 : head->subnets;
 }
 
 int bgpstream_patricia_tree_get_more_specifics(
@@ -1107,11 +1452,13 @@ void bgpstream_patricia_tree_clear(bgpstream_patricia_tree_t *pt)
 {
   assert(pt);
 
-  bgpstream_patricia_tree_destroy_tree(pt, pt->head4);
+  /* the slabs are kept so that the tree can be refilled without
+   * allocating */
+  bgpstream_patricia_pool_clear(pt, &pt->pool4);
   pt->ipv4_active_nodes = 0;
   pt->head4 = NULL;
 
-  bgpstream_patricia_tree_destroy_tree(pt, pt->head6);
+  bgpstream_patricia_pool_clear(pt, &pt->pool6);
   pt->ipv6_active_nodes = 0;
   pt->head6 = NULL;
 }
@@ -1120,6 +1467,8 @@ void bgpstream_patricia_tree_destroy(bgpstream_patricia_tree_t *pt)
 {
   if (pt != NULL) {
     bgpstream_patricia_tree_clear(pt);
+    bgpstream_patricia_pool_destroy(&pt->pool4);
+    bgpstream_patricia_pool_destroy(&pt->pool6);
     free(pt);
   }
 }
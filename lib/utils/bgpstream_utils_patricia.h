@@ -214,6 +214,51 @@ bgpstream_patricia_node_t *
 bgpstream_patricia_tree_search_exact(bgpstream_patricia_tree_t *pt,
                                      bgpstream_pfx_t *pfx);
 
+/** Find the most specific prefix in the Patricia Tree that covers (or is equal
+ *  to) the given prefix (i.e. a longest prefix match)
+ *
+ * @param pt           pointer to the patricia tree to lookup in
+ * @param pfx          pointer to the prefix to search
+ * @return a pointer to the node of the best matching prefix, or NULL if no
+ * prefix in the tree covers the given prefix
+ *
+ * The tree is not modified and no memory is allocated, so several threads may
+ * search the same tree at once (as long as nobody modifies it).
+ */
+bgpstream_patricia_node_t *
+bgpstream_patricia_tree_search_best(const bgpstream_patricia_tree_t *pt,
+                                    const bgpstream_pfx_t *pfx);
+
+/** Check how a prefix overlaps with the prefixes in the Patricia Tree
+ *
+ * @param pt           pointer to the patricia tree
+ * @param pfx          pointer to the prefix to check
+ * @return a mask of BGPSTREAM_PATRICIA_LESS_SPECIFICS (the prefix is covered
+ * by a prefix in the tree), BGPSTREAM_PATRICIA_EXACT_MATCH (the prefix is in
+ * the tree) and BGPSTREAM_PATRICIA_MORE_SPECIFICS (the prefix covers a prefix
+ * in the tree)
+ *
+ * Like bgpstream_patricia_tree_search_best, this is a read-only lookup.
+ */
+uint8_t
+bgpstream_patricia_tree_lookup_overlap_info(const bgpstream_patricia_tree_t *pt,
+                                            const bgpstream_pfx_t *pfx);
+
+/** Check whether a prefix matches one of the prefixes in the Patricia Tree,
+ *  according to the allowed_matches of the prefixes in the tree
+ *
+ * @param pt           pointer to the patricia tree
+ * @param pfx          pointer to the prefix to check
+ * @return 1 if the prefix is in the tree, or is a more specific of a tree
+ * prefix that allows BGPSTREAM_PREFIX_MATCH_MORE (or _ANY), or is a less
+ * specific of a tree prefix that allows BGPSTREAM_PREFIX_MATCH_LESS (or _ANY);
+ * 0 otherwise
+ *
+ * Like bgpstream_patricia_tree_search_best, this is a read-only lookup.
+ */
+int bgpstream_patricia_tree_lookup_match(const bgpstream_patricia_tree_t *pt,
+                                         const bgpstream_pfx_t *pfx);
+
 /** Count the number of prefixes in the Patricia Tree
  *
  * @param pt         pointer to the patricia tree
@@ -226,12 +271,18 @@ uint64_t bgpstream_patricia_prefix_count(bgpstream_patricia_tree_t *pt,
 /** Count the number of unique /24 IPv4 prefixes in the Patricia Tree
  *
  * @param pt           pointer to the patricia tree
+ *
+ * The count is kept up to date as prefixes are inserted and removed, so this
+ * takes constant time.
  */
 uint64_t bgpstream_patricia_tree_count_24subnets(bgpstream_patricia_tree_t *pt);
 
 /** Count the number of unique /64 IPv6 prefixes in the Patricia Tree
  *
  * @param pt           pointer to the patricia tree
+ *
+ * The count is kept up to date as prefixes are inserted and removed, so this
+ * takes constant time.
  */
 uint64_t bgpstream_patricia_tree_count_64subnets(bgpstream_patricia_tree_t *pt);
 
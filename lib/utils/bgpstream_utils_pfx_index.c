@@ -0,0 +1,680 @@
+/*
+ * Copyright (C) 2015 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_utils_pfx_index.h"
+#include "config.h"
+#include "utils.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Prefixes are stored in a multibit trie that consumes STRIDE address bits
+ * per level, using the tree bitmap layout: a node at depth d holds the
+ * prefixes of length d to d+STRIDE-1 that fall under it (in its "internal"
+ * bitmap), and has one child per value of the next STRIDE address bits under
+ * which there are longer prefixes (in its "external" bitmap). The children of
+ * a node, and the IDs of its prefixes, are stored contiguously, so that the
+ * one for bit i is found by counting the bits set before bit i. */
+#define STRIDE 6
+#define STRIDE_SLOTS (1 << STRIDE)
+
+/* Position in the internal bitmap of the prefix of (relative) length len that
+ * covers slot, i.e. the given value of the next STRIDE address bits */
+#define INTERNAL_POS(len, slot) ((1U << (len)) | ((slot) >> (STRIDE - (len))))
+
+/* Size of the buffer holding the address of a prefix, padded so that the
+ * STRIDE bits at any depth can be read from two consecutive bytes */
+#define ADDR_BUF_LEN 17
+
+/* Root nodes of the IPv4 and IPv6 tries */
+#define ROOT_IPV4 0
+#define ROOT_IPV6 1
+
+/* Initial number of nodes allocated */
+#define NODES_INIT_SIZE 64
+
+typedef struct pfx_index_node {
+
+  /* prefixes held by this node */
+  uint64_t internal;
+
+  /* children of this node */
+  uint64_t external;
+
+  /* index of the first child in the nodes array */
+  uint32_t children;
+
+  /* index of the first prefix ID in the ids array */
+  uint32_t ids;
+
+  /* prefixes that allow more specific matches */
+  uint64_t internal_more;
+
+  /* prefixes that allow less specific matches */
+  uint64_t internal_less;
+
+  /* children with a prefix that allows less specific matches below them */
+  uint64_t external_less;
+
+} pfx_index_node_t;
+
+/* a prefix to index, as sorted while building the trie */
+typedef struct pfx_index_item {
+  bgpstream_addr_version_t version;
+  uint8_t addr[ADDR_BUF_LEN];
+  uint8_t mask_len;
+  uint8_t allowed_matches;
+  int id;
+} pfx_index_item_t;
+
+typedef struct pfx_index_entry {
+  bgpstream_pfx_storage_t pfx;
+  void *user;
+} pfx_index_entry_t;
+
+struct bgpstream_pfx_index {
+
+  /* prefixes, indexed by ID */
+  pfx_index_entry_t *entries;
+  int entries_cnt;
+
+  /* trie nodes (starting with the IPv4 and IPv6 roots) */
+  pfx_index_node_t *nodes;
+  uint32_t nodes_cnt;
+  uint32_t nodes_alloc;
+
+  /* prefix IDs of the trie nodes */
+  uint32_t *ids;
+  uint32_t ids_cnt;
+  uint32_t ids_alloc;
+
+  /* internal bitmap positions of the prefixes that cover each slot */
+  uint64_t path[STRIDE_SLOTS];
+};
+
+/* ========== PRIVATE FUNCTIONS ========== */
+
+static inline int popcount64(uint64_t x)
+{
+#ifdef HAVE___BUILTIN_POPCOUNTLL
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (x * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+/* index of the highest bit set in x (which must not be 0) */
+static inline int highest_bit64(uint64_t x)
+{
+#ifdef HAVE___BUILTIN_CLZLL
+  return 63 - __builtin_clzll(x);
+#else
+  int n = 0;
+  int shift;
+  for (shift = 32; shift > 0; shift /= 2) {
+    if (x >> shift) {
+      x >>= shift;
+      n += shift;
+    }
+  }
+  return n;
+#endif
+}
+
+/* copy the address of pfx into a zero-padded buffer */
+static int pfx_index_get_addr(const bgpstream_pfx_t *pfx, uint8_t *buf)
+{
+  memset(buf, 0, ADDR_BUF_LEN);
+  switch (pfx->address.version) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    if (pfx->mask_len > 32) {
+      return -1;
+    }
+    memcpy(buf, &((const bgpstream_ipv4_pfx_t *)pfx)->address.ipv4.s_addr, 4);
+    return 0;
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    if (pfx->mask_len > 128) {
+      return -1;
+    }
+    memcpy(buf, ((const bgpstream_ipv6_pfx_t *)pfx)->address.ipv6.s6_addr,
+           16);
+    return 0;
+  default:
+    return -1;
+  }
+}
+
+/* value of the STRIDE address bits starting at bit depth */
+static inline uint32_t pfx_index_slot(const uint8_t *addr, int depth)
+{
+  uint32_t word = ((uint32_t)addr[depth >> 3] << 8) | addr[(depth >> 3) + 1];
+  return (word >> (16 - STRIDE - (depth & 7))) & (STRIDE_SLOTS - 1);
+}
+
+/* ID of the longest of the given prefixes of a node */
+static inline int pfx_index_node_id(const bgpstream_pfx_index_t *pfx_index,
+                                    const pfx_index_node_t *node,
+                                    uint64_t matches)
+{
+  int pos = highest_bit64(matches);
+  return pfx_index->ids[node->ids + popcount64(node->internal &
+                                               (((uint64_t)1 << pos) - 1))];
+}
+
+static int pfx_index_item_cmp(const void *a, const void *b)
+{
+  const pfx_index_item_t *ia = a;
+  const pfx_index_item_t *ib = b;
+  int rc;
+
+  if (ia->version != ib->version) {
+    return (ia->version < ib->version) ? -1 : 1;
+  }
+  if ((rc = memcmp(ia->addr, ib->addr, ADDR_BUF_LEN)) != 0) {
+    return rc;
+  }
+  if (ia->mask_len != ib->mask_len) {
+    return (ia->mask_len < ib->mask_len) ? -1 : 1;
+  }
+  return (ia->id < ib->id) ? -1 : (ia->id > ib->id);
+}
+
+static int pfx_index_alloc_nodes(bgpstream_pfx_index_t *pfx_index,
+                                 uint32_t cnt, uint32_t *first)
+{
+  uint32_t alloc = pfx_index->nodes_alloc;
+  pfx_index_node_t *nodes;
+
+  if (pfx_index->nodes_cnt + cnt > alloc) {
+    if (alloc == 0) {
+      alloc = NODES_INIT_SIZE;
+    }
+    while (pfx_index->nodes_cnt + cnt > alloc) {
+      alloc *= 2;
+    }
+    if ((nodes = realloc(pfx_index->nodes, sizeof(pfx_index_node_t) *
+                                             alloc)) == NULL) {
+      return -1;
+    }
+    pfx_index->nodes = nodes;
+    pfx_index->nodes_alloc = alloc;
+  }
+  memset(&pfx_index->nodes[pfx_index->nodes_cnt], 0,
+         sizeof(pfx_index_node_t) * cnt);
+  *first = pfx_index->nodes_cnt;
+  pfx_index->nodes_cnt += cnt;
+  return 0;
+}
+
+static int pfx_index_alloc_ids(bgpstream_pfx_index_t *pfx_index, uint32_t cnt,
+                               uint32_t *first)
+{
+  uint32_t alloc = pfx_index->ids_alloc;
+  uint32_t *ids;
+
+  if (pfx_index->ids_cnt + cnt > alloc) {
+    if (alloc == 0) {
+      alloc = NODES_INIT_SIZE;
+    }
+    while (pfx_index->ids_cnt + cnt > alloc) {
+      alloc *= 2;
+    }
+    if ((ids = realloc(pfx_index->ids, sizeof(uint32_t) * alloc)) == NULL) {
+      return -1;
+    }
+    pfx_index->ids = ids;
+    pfx_index->ids_alloc = alloc;
+  }
+  *first = pfx_index->ids_cnt;
+  pfx_index->ids_cnt += cnt;
+  return 0;
+}
+
+/* build the node at the given depth from the sorted items [lo, hi), which all
+ * share the first depth bits, except for the ones shorter than depth (that
+ * belong to an ancestor and are ignored) */
+static int pfx_index_build_node(bgpstream_pfx_index_t *pfx_index,
+                                const pfx_index_item_t *items,
+                                uint32_t node_idx, int depth, int lo, int hi)
+{
+  pfx_index_node_t node;
+  uint32_t ids[STRIDE_SLOTS];
+  uint32_t first;
+  uint32_t child;
+  uint32_t slot;
+  uint64_t bit;
+  int len;
+  int pos;
+  int i, j;
+
+  memset(&node, 0, sizeof(node));
+
+  for (i = lo; i < hi; i++) {
+    len = items[i].mask_len - depth;
+    if (len < 0) {
+      continue;
+    }
+    slot = pfx_index_slot(items[i].addr, depth);
+    if (len >= STRIDE) {
+      node.external |= (uint64_t)1 << slot;
+      continue;
+    }
+    bit = (uint64_t)1 << INTERNAL_POS(len, slot);
+    if ((node.internal & bit) != 0) {
+      /* duplicate prefix: the first ID wins */
+      continue;
+    }
+    node.internal |= bit;
+    ids[INTERNAL_POS(len, slot)] = items[i].id;
+    if (items[i].allowed_matches == BGPSTREAM_PREFIX_MATCH_ANY ||
+        items[i].allowed_matches == BGPSTREAM_PREFIX_MATCH_MORE) {
+      node.internal_more |= bit;
+    }
+    if (items[i].allowed_matches == BGPSTREAM_PREFIX_MATCH_ANY ||
+        items[i].allowed_matches == BGPSTREAM_PREFIX_MATCH_LESS) {
+      node.internal_less |= bit;
+    }
+  }
+
+  /* prefix IDs, in the order of their bitmap positions */
+  if (pfx_index_alloc_ids(pfx_index, popcount64(node.internal), &first) != 0) {
+    return -1;
+  }
+  node.ids = first;
+  for (pos = 0; pos < STRIDE_SLOTS; pos++) {
+    if ((node.internal & ((uint64_t)1 << pos)) != 0) {
+      pfx_index->ids[first++] = ids[pos];
+    }
+  }
+
+  /* children are allocated together, and built depth first */
+  if (pfx_index_alloc_nodes(pfx_index, popcount64(node.external), &child) !=
+      0) {
+    return -1;
+  }
+  node.children = child;
+  pfx_index->nodes[node_idx] = node;
+
+  i = lo;
+  while (i < hi) {
+    if (items[i].mask_len < depth + STRIDE) {
+      i++;
+      continue;
+    }
+    slot = pfx_index_slot(items[i].addr, depth);
+    for (j = i + 1; j < hi; j++) {
+      if (items[j].mask_len >= depth + STRIDE &&
+          pfx_index_slot(items[j].addr, depth) != slot) {
+        break;
+      }
+    }
+    if (pfx_index_build_node(pfx_index, items, child, depth + STRIDE, i, j) !=
+        0) {
+      return -1;
+    }
+    if (pfx_index->nodes[child].internal_less != 0 ||
+        pfx_index->nodes[child].external_less != 0) {
+      pfx_index->nodes[node_idx].external_less |= (uint64_t)1 << slot;
+    }
+    child++;
+    i = j;
+  }
+
+  return 0;
+}
+
+/* build an index from the given entries, which it takes ownership of */
+static bgpstream_pfx_index_t *pfx_index_build(pfx_index_entry_t *entries,
+                                              int entries_cnt)
+{
+  bgpstream_pfx_index_t *pfx_index = NULL;
+  pfx_index_item_t *items = NULL;
+  bgpstream_pfx_t *pfx;
+  uint32_t roots;
+  uint32_t slot;
+  int len;
+  int v6_first;
+  int i;
+
+  if ((pfx_index = malloc_zero(sizeof(bgpstream_pfx_index_t))) == NULL) {
+    free(entries);
+    return NULL;
+  }
+  pfx_index->entries = entries;
+  pfx_index->entries_cnt = entries_cnt;
+
+  for (slot = 0; slot < STRIDE_SLOTS; slot++) {
+    for (len = 0; len < STRIDE; len++) {
+      pfx_index->path[slot] |= (uint64_t)1 << INTERNAL_POS(len, slot);
+    }
+  }
+
+  if (entries_cnt > 0 &&
+      (items = malloc(sizeof(pfx_index_item_t) * entries_cnt)) == NULL) {
+    goto err;
+  }
+  for (i = 0; i < entries_cnt; i++) {
+    pfx = (bgpstream_pfx_t *)&entries[i].pfx;
+    items[i].version = pfx->address.version;
+    if (pfx_index_get_addr(pfx, items[i].addr) != 0) {
+      fprintf(stderr, "ERROR: Invalid prefix at position %d\n", i);
+      goto err;
+    }
+    /* clear the host bits */
+    len = pfx->mask_len;
+    if (len % 8 != 0) {
+      items[i].addr[len / 8] &= (uint8_t)(0xff << (8 - len % 8));
+      len += 8 - len % 8;
+    }
+    memset(&items[i].addr[len / 8], 0, ADDR_BUF_LEN - len / 8);
+    items[i].mask_len = pfx->mask_len;
+    items[i].allowed_matches = pfx->allowed_matches;
+    items[i].id = i;
+  }
+  if (entries_cnt > 0) {
+    qsort(items, entries_cnt, sizeof(pfx_index_item_t), pfx_index_item_cmp);
+  }
+
+  /* IPv4 prefixes sort before IPv6 ones */
+  for (v6_first = 0; v6_first < entries_cnt &&
+                     items[v6_first].version == BGPSTREAM_ADDR_VERSION_IPV4;
+       v6_first++)
+    ;
+
+  if (pfx_index_alloc_nodes(pfx_index, 2, &roots) != 0 ||
+      pfx_index_build_node(pfx_index, items, ROOT_IPV4, 0, 0, v6_first) != 0 ||
+      pfx_index_build_node(pfx_index, items, ROOT_IPV6, 0, v6_first,
+                           entries_cnt) != 0) {
+    goto err;
+  }
+
+  free(items);
+  return pfx_index;
+
+err:
+  free(items);
+  bgpstream_pfx_index_destroy(pfx_index);
+  return NULL;
+}
+
+/* find how the given prefix overlaps with the prefixes in the index. If
+ * check_allowed is set, less specific prefixes only count if they allow more
+ * specific matches (and vice versa). best is set to the ID of the most
+ * specific prefix that covers (or is equal to) the given prefix, or -1 */
+static uint8_t pfx_index_lookup(const bgpstream_pfx_index_t *pfx_index,
+                                const bgpstream_pfx_t *pfx, int check_allowed,
+                                int *best)
+{
+  const pfx_index_node_t *node;
+  uint8_t addr[ADDR_BUF_LEN];
+  uint64_t matches;
+  uint64_t exact;
+  uint64_t below;
+  uint64_t slots;
+  uint32_t slot;
+  uint32_t v;
+  int depth = 0;
+  int len;
+  int r;
+  uint8_t mask = 0;
+
+  *best = -1;
+
+  switch (pfx->address.version) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    node = &pfx_index->nodes[ROOT_IPV4];
+    break;
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    node = &pfx_index->nodes[ROOT_IPV6];
+    break;
+  default:
+    return 0;
+  }
+  if (pfx_index_get_addr(pfx, addr) != 0) {
+    return 0;
+  }
+
+  /* walk down the nodes that the prefix goes all the way through: all the
+   * prefixes of a node on the path of the prefix are less specifics */
+  while (pfx->mask_len >= depth + STRIDE) {
+    slot = pfx_index_slot(addr, depth);
+    if ((matches = node->internal & pfx_index->path[slot]) != 0) {
+      *best = pfx_index_node_id(pfx_index, node, matches);
+      if (check_allowed == 0 || (node->internal_more & matches) != 0) {
+        mask |= BGPSTREAM_PATRICIA_LESS_SPECIFICS;
+      }
+    }
+    if ((node->external & ((uint64_t)1 << slot)) == 0) {
+      return mask;
+    }
+    node = &pfx_index->nodes[node->children +
+                             popcount64(node->external &
+                                        (((uint64_t)1 << slot) - 1))];
+    depth += STRIDE;
+  }
+
+  /* the prefix ends within this node: only the prefixes on its path that are
+   * not longer than it cover it */
+  slot = pfx_index_slot(addr, depth);
+  len = pfx->mask_len - depth;
+  exact = (uint64_t)1 << INTERNAL_POS(len, slot);
+  matches = node->internal & pfx_index->path[slot] & ((exact << 1) - 1);
+  if (matches != 0) {
+    *best = pfx_index_node_id(pfx_index, node, matches);
+    if ((matches & exact) != 0) {
+      mask |= BGPSTREAM_PATRICIA_EXACT_MATCH;
+    }
+    matches &= ~exact;
+    if (matches != 0 &&
+        (check_allowed == 0 || (node->internal_more & matches) != 0)) {
+      mask |= BGPSTREAM_PATRICIA_LESS_SPECIFICS;
+    }
+  }
+
+  /* more specifics are the longer prefixes of this node that start with the
+   * same len bits, and everything below the children in the slots that these
+   * bits cover */
+  v = slot >> (STRIDE - len);
+  below = 0;
+  for (r = len + 1; r < STRIDE; r++) {
+    below |= (((uint64_t)1 << (1 << (r - len))) - 1)
+             << INTERNAL_POS(r, v << (STRIDE - len));
+  }
+  if (len == 0) {
+    slots = ~(uint64_t)0;
+  } else {
+    slots = (((uint64_t)1 << (1 << (STRIDE - len))) - 1)
+            << (v << (STRIDE - len));
+  }
+  if (check_allowed == 0) {
+    below &= node->internal;
+    slots &= node->external;
+  } else {
+    below &= node->internal_less;
+    slots &= node->external_less;
+  }
+  if ((below | slots) != 0) {
+    mask |= BGPSTREAM_PATRICIA_MORE_SPECIFICS;
+  }
+
+  return mask;
+}
+
+/* state of the walk that copies the prefixes of a patricia tree */
+typedef struct pfx_index_walk {
+  pfx_index_entry_t *entries;
+  int entries_cnt;
+  int entries_alloc;
+  int err;
+} pfx_index_walk_t;
+
+static void pfx_index_walk_node(bgpstream_patricia_tree_t *pt,
+                                bgpstream_patricia_node_t *node, void *data)
+{
+  pfx_index_walk_t *walk = data;
+  pfx_index_entry_t *entries;
+  int alloc;
+
+  if (walk->err != 0) {
+    return;
+  }
+  if (walk->entries_cnt == walk->entries_alloc) {
+    alloc = (walk->entries_alloc == 0) ? NODES_INIT_SIZE
+                                       : walk->entries_alloc * 2;
+    if ((entries = realloc(walk->entries, sizeof(pfx_index_entry_t) *
+                                            alloc)) == NULL) {
+      walk->err = 1;
+      return;
+    }
+    walk->entries = entries;
+    walk->entries_alloc = alloc;
+  }
+  bgpstream_pfx_copy((bgpstream_pfx_t *)&walk->entries[walk->entries_cnt].pfx,
+                     bgpstream_patricia_tree_get_pfx(node));
+  walk->entries[walk->entries_cnt].user =
+    bgpstream_patricia_tree_get_user(node);
+  walk->entries_cnt++;
+}
+
+/* ========== PUBLIC FUNCTIONS ========== */
+
+bgpstream_pfx_index_t *
+bgpstream_pfx_index_create(const bgpstream_pfx_storage_t *pfxs, int pfxs_cnt)
+{
+  pfx_index_entry_t *entries = NULL;
+  int i;
+
+  assert(pfxs != NULL || pfxs_cnt == 0);
+
+  if (pfxs_cnt > 0 &&
+      (entries = malloc(sizeof(pfx_index_entry_t) * pfxs_cnt)) == NULL) {
+    return NULL;
+  }
+  for (i = 0; i < pfxs_cnt; i++) {
+    entries[i].pfx = pfxs[i];
+    entries[i].user = NULL;
+  }
+  return pfx_index_build(entries, pfxs_cnt);
+}
+
+bgpstream_pfx_index_t *
+bgpstream_pfx_index_create_from_patricia(bgpstream_patricia_tree_t *pt)
+{
+  pfx_index_walk_t walk;
+
+  assert(pt);
+
+  memset(&walk, 0, sizeof(walk));
+  bgpstream_patricia_tree_walk(pt, pfx_index_walk_node, &walk);
+  if (walk.err != 0) {
+    free(walk.entries);
+    return NULL;
+  }
+  return pfx_index_build(walk.entries, walk.entries_cnt);
+}
+
+int bgpstream_pfx_index_lookup_exact(const bgpstream_pfx_index_t *pfx_index,
+                                     const bgpstream_pfx_t *pfx)
+{
+  int best;
+
+  assert(pfx_index);
+  assert(pfx);
+  if ((pfx_index_lookup(pfx_index, pfx, 0, &best) &
+       BGPSTREAM_PATRICIA_EXACT_MATCH) == 0) {
+    return -1;
+  }
+  return best;
+}
+
+int bgpstream_pfx_index_lookup_best(const bgpstream_pfx_index_t *pfx_index,
+                                    const bgpstream_pfx_t *pfx)
+{
+  int best;
+
+  assert(pfx_index);
+  assert(pfx);
+  pfx_index_lookup(pfx_index, pfx, 0, &best);
+  return best;
+}
+
+uint8_t
+bgpstream_pfx_index_lookup_overlap_info(const bgpstream_pfx_index_t *pfx_index,
+                                        const bgpstream_pfx_t *pfx)
+{
+  int best;
+
+  assert(pfx_index);
+  assert(pfx);
+  return pfx_index_lookup(pfx_index, pfx, 0, &best);
+}
+
+int bgpstream_pfx_index_lookup_match(const bgpstream_pfx_index_t *pfx_index,
+                                     const bgpstream_pfx_t *pfx)
+{
+  int best;
+
+  assert(pfx_index);
+  assert(pfx);
+  return pfx_index_lookup(pfx_index, pfx, 1, &best) != 0;
+}
+
+const bgpstream_pfx_t *
+bgpstream_pfx_index_get_pfx(const bgpstream_pfx_index_t *pfx_index, int id)
+{
+  assert(pfx_index);
+  assert(id >= 0 && id < pfx_index->entries_cnt);
+  return (const bgpstream_pfx_t *)&pfx_index->entries[id].pfx;
+}
+
+void *bgpstream_pfx_index_get_user(const bgpstream_pfx_index_t *pfx_index,
+                                   int id)
+{
+  assert(pfx_index);
+  assert(id >= 0 && id < pfx_index->entries_cnt);
+  return pfx_index->entries[id].user;
+}
+
+int bgpstream_pfx_index_size(const bgpstream_pfx_index_t *pfx_index)
+{
+  assert(pfx_index);
+  return pfx_index->entries_cnt;
+}
+
+void bgpstream_pfx_index_destroy(bgpstream_pfx_index_t *pfx_index)
+{
+  if (pfx_index == NULL) {
+    return;
+  }
+  free(pfx_index->entries);
+  free(pfx_index->nodes);
+  free(pfx_index->ids);
+  free(pfx_index);
+}
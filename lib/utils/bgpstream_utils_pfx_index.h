@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2015 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_UTILS_PFX_INDEX_H
+#define __BGPSTREAM_UTILS_PFX_INDEX_H
+
+#include <stdint.h>
+
+#include "bgpstream_utils_patricia.h"
+#include "bgpstream_utils_pfx.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of BGP Stream Prefix
+ * Index objects
+ *
+ * A Prefix Index is an immutable set of prefixes, built once from a Patricia
+ * Tree or from a list of prefixes, and optimized for lookups. Prefixes are
+ * stored in a multibit trie (6 bits per level, in the "tree bitmap" layout)
+ * whose nodes and prefixes are laid out in flat arrays, so a lookup visits at
+ * most 6 nodes for an IPv4 prefix and 22 for an IPv6 prefix.
+ *
+ * Since an index is never modified after it has been created, any number of
+ * threads may look it up at the same time without locking. To change the set
+ * of prefixes, build a new index.
+ *
+ * Each prefix of an index has an ID: its position in the list the index was
+ * created from, or its position in the in-order walk of the Patricia Tree.
+ */
+
+/**
+ * @name Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure containing a Prefix Index instance */
+typedef struct bgpstream_pfx_index bgpstream_pfx_index_t;
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new Prefix Index from a list of prefixes
+ *
+ * @param pfxs          array of prefixes to index
+ * @param pfxs_cnt      number of prefixes in the array
+ * @return a pointer to the index, or NULL if an error occurred
+ *
+ * The ID of a prefix is its position in the array. If a prefix appears more
+ * than once, lookups return the ID of its first occurrence. The
+ * allowed_matches field of the prefixes is used by
+ * bgpstream_pfx_index_lookup_match.
+ */
+bgpstream_pfx_index_t *
+bgpstream_pfx_index_create(const bgpstream_pfx_storage_t *pfxs, int pfxs_cnt);
+
+/** Create a new Prefix Index holding the prefixes of a Patricia Tree
+ *
+ * @param pt            pointer to the patricia tree to index
+ * @return a pointer to the index, or NULL if an error occurred
+ *
+ * The user pointer of each tree node is copied into the index (see
+ * bgpstream_pfx_index_get_user), but it remains owned by the tree. The index
+ * does not refer to the tree, which may be modified or destroyed afterwards.
+ */
+bgpstream_pfx_index_t *
+bgpstream_pfx_index_create_from_patricia(bgpstream_patricia_tree_t *pt);
+
+/** Find a prefix in the Prefix Index
+ *
+ * @param pfx_index     pointer to the prefix index
+ * @param pfx           pointer to the prefix to search
+ * @return the ID of the prefix, or -1 if it is not in the index
+ */
+int bgpstream_pfx_index_lookup_exact(const bgpstream_pfx_index_t *pfx_index,
+                                     const bgpstream_pfx_t *pfx);
+
+/** Find the most specific prefix in the Prefix Index that covers (or is
+ *  equal to) the given prefix (i.e. a longest prefix match)
+ *
+ * @param pfx_index     pointer to the prefix index
+ * @param pfx           pointer to the prefix to search
+ * @return the ID of the best matching prefix, or -1 if no prefix in the index
+ * covers the given prefix
+ */
+int bgpstream_pfx_index_lookup_best(const bgpstream_pfx_index_t *pfx_index,
+                                    const bgpstream_pfx_t *pfx);
+
+/** Check how a prefix overlaps with the prefixes in the Prefix Index
+ *
+ * @param pfx_index     pointer to the prefix index
+ * @param pfx           pointer to the prefix to check
+ * @return a mask of BGPSTREAM_PATRICIA_LESS_SPECIFICS (the prefix is covered
+ * by a prefix in the index), BGPSTREAM_PATRICIA_EXACT_MATCH (the prefix is in
+ * the index) and BGPSTREAM_PATRICIA_MORE_SPECIFICS (the prefix covers a prefix
+ * in the index)
+ *
+ * The result is the same as bgpstream_patricia_tree_lookup_overlap_info on a
+ * tree holding the same prefixes.
+ */
+uint8_t
+bgpstream_pfx_index_lookup_overlap_info(const bgpstream_pfx_index_t *pfx_index,
+                                        const bgpstream_pfx_t *pfx);
+
+/** Check whether a prefix matches one of the prefixes in the Prefix Index,
+ *  according to the allowed_matches of the prefixes in the index
+ *
+ * @param pfx_index     pointer to the prefix index
+ * @param pfx           pointer to the prefix to check
+ * @return 1 if the prefix matches, 0 otherwise
+ *
+ * The result is the same as bgpstream_patricia_tree_lookup_match on a tree
+ * holding the same prefixes.
+ */
+int bgpstream_pfx_index_lookup_match(const bgpstream_pfx_index_t *pfx_index,
+                                     const bgpstream_pfx_t *pfx);
+
+/** Get the prefix with the given ID
+ *
+ * @param pfx_index     pointer to the prefix index
+ * @param id            ID of the prefix
+ * @return a borrowed pointer to the prefix
+ */
+const bgpstream_pfx_t *
+bgpstream_pfx_index_get_pfx(const bgpstream_pfx_index_t *pfx_index, int id);
+
+/** Get the user pointer associated with the prefix with the given ID
+ *
+ * @param pfx_index     pointer to the prefix index
+ * @param id            ID of the prefix
+ * @return the user pointer of the Patricia Tree node the prefix was copied
+ * from, or NULL if the index was created from a list of prefixes
+ */
+void *bgpstream_pfx_index_get_user(const bgpstream_pfx_index_t *pfx_index,
+                                   int id);
+
+/** Get the number of prefixes in the Prefix Index
+ *
+ * @param pfx_index     pointer to the prefix index
+ * @return the number of prefix IDs (including duplicates, if the index was
+ * created from a list of prefixes)
+ */
+int bgpstream_pfx_index_size(const bgpstream_pfx_index_t *pfx_index);
+
+/** Destroy the given Prefix Index
+ *
+ * @param pfx_index     pointer to the prefix index to destroy
+ */
+void bgpstream_pfx_index_destroy(bgpstream_pfx_index_t *pfx_index);
+
+/** @} */
+
+#endif /* __BGPSTREAM_UTILS_PFX_INDEX_H */
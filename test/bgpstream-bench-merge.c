@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2015 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Benchmark of the resource manager's merge step.
+ *
+ * Drives the real resource manager with k update dumps covering the same time
+ * window, each read by a stub reader (defined below, in place of
+ * bgpstream_reader.c) that returns records in time order without doing any
+ * I/O or decoding. Reports the cost of getting each record from the resource
+ * manager in ns/record as k grows, which is the cost of keeping the readers
+ * ordered.
+ *
+ * Records are spread evenly over the window, so a short window gives many
+ * readers with the same next time, and a long one gives each reader a
+ * different next time.
+ *
+ * Usage: bgpstream-bench-merge [total-records [window-length]]
+ */
+
+#include "bgpstream_reader.h"
+#include "bgpstream_resource_mgr.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_RECORDS 4000000
+#define MAX_READERS 1024
+
+/* start and default length of the simulated dump window (seconds) */
+#define WINDOW_START 1427846400
+#define DEFAULT_WINDOW_LEN 900
+
+#define URI_LEN 32
+
+/* simulated records of each dump, indexed by the number in the dump URI */
+struct sim_dump {
+  uint32_t *times;
+  int cnt;
+};
+
+static struct sim_dump dumps[MAX_READERS];
+
+/* ========== STUB READER ========== */
+
+struct bgpstream_reader {
+  struct sim_dump *dump;
+  int pos;
+  bgpstream_record_t record;
+};
+
+bgpstream_reader_t *
+bgpstream_reader_create(bgpstream_resource_t *resource,
+                        bgpstream_filter_mgr_t *filter_mgr,
+                        int decode_ahead,
+                        bgpstream_opener_pool_t *opener_pool,
+                        bgpstream_buffer_pool_t *buf_pool,
+                        bgpstream_decompress_pool_t *decomp_pool,
+                        int lazy_elem_attrs)
+{
+  bgpstream_reader_t *reader;
+  int idx;
+
+  if (sscanf(resource->uri, "sim:%d", &idx) != 1 || idx < 0 ||
+      idx >= MAX_READERS ||
+      (reader = calloc(1, sizeof(bgpstream_reader_t))) == NULL) {
+    return NULL;
+  }
+  reader->dump = &dumps[idx];
+  return reader;
+}
+
+uint32_t bgpstream_reader_get_next_time(bgpstream_reader_t *reader)
+{
+  // like the real reader, the time does not change once we reach EOS
+  return reader->dump->times[(reader->pos < reader->dump->cnt)
+                               ? reader->pos
+                               : reader->dump->cnt - 1];
+}
+
+int bgpstream_reader_open_wait(bgpstream_reader_t *reader)
+{
+  return 0;
+}
+
+void bgpstream_reader_destroy(bgpstream_reader_t *reader)
+{
+  free(reader);
+}
+
+int bgpstream_reader_is_ready(bgpstream_reader_t *reader)
+{
+  return 1;
+}
+
+bgpstream_reader_status_t
+bgpstream_reader_get_next_record(bgpstream_reader_t *reader,
+                                 bgpstream_record_t **record)
+{
+  if (reader->pos == reader->dump->cnt) {
+    return BGPSTREAM_READER_STATUS_EOS;
+  }
+  reader->record.time_sec = reader->dump->times[reader->pos++];
+  *record = &reader->record;
+  return BGPSTREAM_READER_STATUS_OK;
+}
+
+/* the benchmark does not enable any of the pools */
+
+bgpstream_opener_pool_t *bgpstream_opener_pool_create(int threads)
+{
+  return NULL;
+}
+
+void bgpstream_opener_pool_destroy(bgpstream_opener_pool_t *pool)
+{
+}
+
+void bgpstream_opener_pool_get_stats(bgpstream_opener_pool_t *pool,
+                                     bgpstream_opener_stats_t *stats)
+{
+  memset(stats, 0, sizeof(bgpstream_opener_stats_t));
+}
+
+bgpstream_buffer_pool_t *bgpstream_buffer_pool_create(size_t budget)
+{
+  return NULL;
+}
+
+void bgpstream_buffer_pool_destroy(bgpstream_buffer_pool_t *pool)
+{
+}
+
+bgpstream_decompress_pool_t *bgpstream_decompress_pool_create(int threads)
+{
+  return NULL;
+}
+
+void bgpstream_decompress_pool_destroy(bgpstream_decompress_pool_t *pool)
+{
+}
+
+/* ========== BENCHMARK ========== */
+
+static uint64_t now_nsec()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/* returns the number of records merged, or -1 on error */
+static long run(int k, uint32_t window_len, uint64_t *elapsed)
+{
+  bgpstream_filter_mgr_t filter_mgr;
+  bgpstream_resource_mgr_t *q;
+  bgpstream_record_t *record;
+  char uri[URI_LEN];
+  uint64_t start;
+  uint32_t last_time = 0;
+  long merged = 0;
+  int ret;
+  int i;
+
+  // there is no RIB period filter, so the filter manager is not used
+  memset(&filter_mgr, 0, sizeof(filter_mgr));
+  if ((q = bgpstream_resource_mgr_create(&filter_mgr)) == NULL) {
+    return -1;
+  }
+
+  start = now_nsec();
+
+  for (i = 0; i < k; i++) {
+    snprintf(uri, URI_LEN, "sim:%d", i);
+    if (bgpstream_resource_mgr_push(q, BGPSTREAM_RESOURCE_TRANSPORT_FILE,
+                                    BGPSTREAM_RESOURCE_FORMAT_MRT, uri,
+                                    WINDOW_START, window_len, "sim", "sim",
+                                    BGPSTREAM_UPDATE, NULL) != 1) {
+      goto err;
+    }
+  }
+
+  while ((ret = bgpstream_resource_mgr_get_record(q, &record)) > 0) {
+    if (record->time_sec < last_time) {
+      fprintf(stderr, "ERROR: records merged out of order\n");
+      goto err;
+    }
+    last_time = record->time_sec;
+    merged++;
+  }
+  if (ret < 0) {
+    goto err;
+  }
+
+  *elapsed = now_nsec() - start;
+  bgpstream_resource_mgr_destroy(q);
+  return merged;
+
+ err:
+  bgpstream_resource_mgr_destroy(q);
+  return -1;
+}
+
+int main(int argc, char **argv)
+{
+  long total = DEFAULT_RECORDS;
+  long window_len = DEFAULT_WINDOW_LEN;
+  long merged;
+  uint64_t elapsed;
+  uint32_t t;
+  int k, i, j;
+  int rc = -1;
+
+  if ((argc > 1 && (total = strtol(argv[1], NULL, 10)) <= 0) ||
+      (argc > 2 && (window_len = strtol(argv[2], NULL, 10)) <= 0)) {
+    fprintf(stderr, "Usage: %s [total-records [window-length]]\n", argv[0]);
+    return -1;
+  }
+
+  srand(42);
+  printf("%8s %12s %12s\n", "readers", "records", "ns/record");
+
+  for (k = 1; k <= MAX_READERS; k *= 2) {
+    // spread the records over k dumps, each covering the whole window
+    for (i = 0; i < k; i++) {
+      dumps[i].cnt = (total / k) + ((i < (total % k)) ? 1 : 0);
+      if (dumps[i].cnt == 0) {
+        dumps[i].cnt = 1;
+      }
+      free(dumps[i].times);
+      if ((dumps[i].times = malloc(sizeof(uint32_t) * dumps[i].cnt)) ==
+          NULL) {
+        goto done;
+      }
+      for (j = 0; j < dumps[i].cnt; j++) {
+        t = (uint32_t)(((uint64_t)j * window_len) / dumps[i].cnt);
+        dumps[i].times[j] = WINDOW_START + t + (rand() % 2);
+        if (j > 0 && dumps[i].times[j] < dumps[i].times[j - 1]) {
+          dumps[i].times[j] = dumps[i].times[j - 1];
+        }
+      }
+    }
+
+    if ((merged = run(k, window_len, &elapsed)) < 0) {
+      goto done;
+    }
+    printf("%8d %12ld %12.1f\n", k, merged, (double)elapsed / merged);
+  }
+
+  rc = 0;
+
+ done:
+  for (i = 0; i < MAX_READERS; i++) {
+    free(dumps[i].times);
+  }
+  return rc;
+}
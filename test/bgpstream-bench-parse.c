@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Benchmark of the MRT parse loop's buffer refill.
+ *
+ * Decompresses each dump into memory (repeating it until it spans many
+ * buffer refills), then parses it with bgpstream_parsebgp_populate_record
+ * through an in-memory transport, with a mirrored (ring) parse buffer and with
+ * a plain buffer (where the unread tail of the buffer is moved to the front on
+ * every refill), each at the full and at the small (over budget) buffer size.
+ * Reports the throughput of each in MB/s and records/s.
+ *
+ * Usage: bgpstream-bench-parse [dump-file ...]
+ */
+
+#include "bgpstream_buffer_pool.h"
+#include "bgpstream_format_interface.h"
+#include "bgpstream_parsebgp_common.h"
+#include "bgpstream_record_int.h"
+#include "bgpstream_transport_interface.h"
+#include "parsebgp.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wandio.h>
+
+#define READ_CHUNK_LEN (1024 * 1024)
+
+/* number of times each dump is parsed (in each mode) */
+#define ROUNDS 5
+
+/* dumps are repeated in memory until they are at least this long, since the
+ * sample dumps are smaller than a single parse buffer */
+#define MIN_DATA_LEN (64 * 1024 * 1024)
+
+static const char *default_files[] = {
+  "ris.rrc06.updates.1427846400.gz",
+  "routeviews.route-views.jinx.updates.1427846400.bz2",
+};
+
+struct mem_state {
+  uint8_t *data;
+  size_t len;
+  size_t pos;
+};
+
+static int64_t mem_read(bgpstream_transport_t *t, uint8_t *buffer, int64_t len)
+{
+  struct mem_state *ms = t->state;
+  size_t n = ms->len - ms->pos;
+
+  if ((size_t)len < n) {
+    n = len;
+  }
+  memcpy(buffer, ms->data + ms->pos, n);
+  ms->pos += n;
+  return n;
+}
+
+static bgpstream_parsebgp_check_filter_rc_t
+keep_all(bgpstream_format_t *format, bgpstream_record_t *record,
+         parsebgp_msg_t *msg)
+{
+  record->time_sec = msg->types.mrt->timestamp_sec;
+  return BGPSTREAM_PARSEBGP_KEEP;
+}
+
+static uint64_t now_nsec()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static uint8_t *load_file(const char *path, size_t *len)
+{
+  io_t *fh;
+  uint8_t *data = NULL, *tmp;
+  size_t alloc_len = 0, dump_len;
+  int64_t rd;
+
+  *len = 0;
+  if ((fh = wandio_create(path)) == NULL) {
+    fprintf(stderr, "ERROR: Could not open %s\n", path);
+    return NULL;
+  }
+  do {
+    if (*len + READ_CHUNK_LEN > alloc_len) {
+      alloc_len = (alloc_len == 0) ? READ_CHUNK_LEN * 4 : alloc_len * 2;
+      if ((tmp = realloc(data, alloc_len)) == NULL) {
+        goto err;
+      }
+      data = tmp;
+    }
+    if ((rd = wandio_read(fh, data + *len, READ_CHUNK_LEN)) < 0) {
+      fprintf(stderr, "ERROR: Could not read %s\n", path);
+      goto err;
+    }
+    *len += rd;
+  } while (rd > 0);
+  wandio_destroy(fh);
+
+  if (*len == 0) {
+    return data;
+  }
+  dump_len = *len;
+  if ((tmp = realloc(data, MIN_DATA_LEN + dump_len)) == NULL) {
+    free(data);
+    return NULL;
+  }
+  data = tmp;
+  while (*len < MIN_DATA_LEN) {
+    memcpy(data + *len, data, dump_len);
+    *len += dump_len;
+  }
+  return data;
+
+ err:
+  wandio_destroy(fh);
+  free(data);
+  return NULL;
+}
+
+/* returns the number of records parsed, or -1 on error */
+static long run(uint8_t *data, size_t len, int mirrored, int small,
+                uint64_t *elapsed)
+{
+  struct mem_state ms = {data, len, 0};
+  struct bgpstream_record_internal record_int;
+  bgpstream_buffer_pool_t *pool = NULL;
+  bgpstream_transport_t transport;
+  bgpstream_resource_t res;
+  bgpstream_format_t format;
+  bgpstream_record_t record;
+  bgpstream_parsebgp_decode_state_t state;
+  bgpstream_format_status_t status;
+  parsebgp_msg_t *msg;
+  uint64_t start;
+  long cnt = 0;
+
+  memset(&transport, 0, sizeof(transport));
+  transport.read = mem_read;
+  transport.state = &ms;
+
+  memset(&res, 0, sizeof(res));
+  res.uri = "memory";
+
+  memset(&format, 0, sizeof(format));
+  format.res = &res;
+  format.transport = &transport;
+
+  memset(&record_int, 0, sizeof(record_int));
+  record_int.format = &format;
+
+  memset(&state, 0, sizeof(state));
+  state.msg_type = PARSEBGP_MSG_TYPE_MRT;
+  parsebgp_opts_init(&state.parser_opts);
+  bgpstream_parsebgp_opts_init(&state.parser_opts);
+
+  // give the decoder the kind of buffer we want to measure. small buffers are
+  // what a pool hands out once its budget is used up
+  if (mirrored != 0) {
+    if (small != 0 && (pool = bgpstream_buffer_pool_create(0)) == NULL) {
+      return -1;
+    }
+    state.buf_pool = pool;
+    if (bgpstream_buffer_pool_get(pool, 0, &state.buf) != 0 ||
+        state.buf.mirrored == 0) {
+      fprintf(stderr, "ERROR: Mirrored buffers are not supported\n");
+      bgpstream_parsebgp_decode_state_clear(&state);
+      bgpstream_buffer_pool_destroy(pool);
+      return -1;
+    }
+  } else {
+    state.buf.len = (small != 0) ? BGPSTREAM_BUFFER_POOL_MIN_LEN
+                                 : BGPSTREAM_BUFFER_POOL_CHUNK_LEN;
+    if ((state.buf.data = malloc(state.buf.len)) == NULL) {
+      return -1;
+    }
+  }
+
+  if ((msg = parsebgp_create_msg()) == NULL) {
+    bgpstream_parsebgp_decode_state_clear(&state);
+    bgpstream_buffer_pool_destroy(pool);
+    return -1;
+  }
+
+  start = now_nsec();
+  while (1) {
+    memset(&record, 0, sizeof(record));
+    record.__int = &record_int;
+    status = bgpstream_parsebgp_populate_record(&state, msg, &format, &record,
+                                                NULL, keep_all);
+    if (status != BGPSTREAM_FORMAT_OK) {
+      break;
+    }
+    cnt++;
+  }
+  *elapsed = now_nsec() - start;
+
+  parsebgp_destroy_msg(msg);
+  bgpstream_parsebgp_decode_state_clear(&state);
+  bgpstream_buffer_pool_destroy(pool);
+
+  if (status != BGPSTREAM_FORMAT_END_OF_DUMP) {
+    fprintf(stderr, "ERROR: Parsing failed (%d)\n", status);
+    return -1;
+  }
+  return cnt;
+}
+
+int main(int argc, char **argv)
+{
+  const char **files = default_files;
+  int files_cnt = sizeof(default_files) / sizeof(default_files[0]);
+  uint8_t *data;
+  size_t len;
+  uint64_t elapsed, best;
+  long cnt = 0;
+  int i, mirrored, small, round;
+
+  if (argc > 1) {
+    files = (const char **)&argv[1];
+    files_cnt = argc - 1;
+  }
+
+  printf("%-52s %-8s %-6s %10s %12s\n", "dump", "buffer", "size", "MB/s",
+         "records/s");
+
+  for (i = 0; i < files_cnt; i++) {
+    if ((data = load_file(files[i], &len)) == NULL) {
+      return -1;
+    }
+    for (small = 0; small <= 1; small++) {
+      for (mirrored = 1; mirrored >= 0; mirrored--) {
+        // report the best of a few rounds to reduce noise
+        best = UINT64_MAX;
+        for (round = 0; round < ROUNDS; round++) {
+          if ((cnt = run(data, len, mirrored, small, &elapsed)) < 0) {
+            free(data);
+            return -1;
+          }
+          if (elapsed < best) {
+            best = elapsed;
+          }
+        }
+        if (best == 0) {
+          best = 1;
+        }
+        printf("%-52s %-8s %-6s %10.1f %12.0f\n", files[i],
+               (mirrored != 0) ? "ring" : "memmove",
+               (small != 0) ? "small" : "full",
+               ((double)len / (1024 * 1024)) / ((double)best / 1e9),
+               (double)cnt / ((double)best / 1e9));
+      }
+    }
+    free(data);
+  }
+
+  return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2015 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Benchmark of the patricia tree on a full-table sized set of prefixes.
+ *
+ * Builds a synthetic IPv4+IPv6 table with a realistic mask length mix, then
+ * reports the cost of inserting it into a tree, of exact and best-match
+ * lookups, and of destroying the tree.
+ *
+ * Usage: bgpstream-bench-patricia [ipv4-prefixes [ipv6-prefixes]]
+ */
+
+#include "bgpstream_utils_patricia.h"
+#include "bgpstream_utils_pfx.h"
+#include "bgpstream_utils_pfx_index.h"
+
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_IPV4_PREFIXES 950000
+#define DEFAULT_IPV6_PREFIXES 200000
+
+/* number of best-match lookups of random addresses */
+#define LOOKUPS 2000000
+
+/* number of /24 and /64 subnet count queries */
+#define SUBNET_COUNTS 100
+
+static uint64_t now_nsec()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static uint32_t rand32()
+{
+  return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+/* roughly the mask length mix of a full IPv4 table: mostly /24s */
+static uint8_t ipv4_mask_len()
+{
+  int r = rand() % 100;
+  if (r < 60) {
+    return 24;
+  }
+  if (r < 95) {
+    return 16 + rand() % 8;
+  }
+  return 8 + rand() % 8;
+}
+
+/* and of a full IPv6 table: mostly /48s, then /32-/47 */
+static uint8_t ipv6_mask_len()
+{
+  int r = rand() % 100;
+  if (r < 50) {
+    return 48;
+  }
+  if (r < 95) {
+    return 32 + rand() % 16;
+  }
+  return 49 + rand() % 16;
+}
+
+static void rand_ipv4(bgpstream_pfx_storage_t *pfx, uint8_t mask_len)
+{
+  memset(pfx, 0, sizeof(*pfx));
+  pfx->address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+  /* mask the address to the prefix length */
+  pfx->address.ipv4.s_addr =
+    htonl(rand32() & (uint32_t)(~(((uint64_t)1 << (32 - mask_len)) - 1)));
+  pfx->mask_len = mask_len;
+}
+
+static void rand_ipv6(bgpstream_pfx_storage_t *pfx, uint8_t mask_len)
+{
+  uint32_t hi = 0x20000000 | (rand32() & 0x0fffffff);
+  uint32_t lo = rand32();
+  uint64_t addr = ((uint64_t)hi << 32) | lo;
+  int i;
+
+  memset(pfx, 0, sizeof(*pfx));
+  pfx->address.version = BGPSTREAM_ADDR_VERSION_IPV6;
+  addr &= ~(((uint64_t)1 << (64 - mask_len)) - 1);
+  for (i = 0; i < 8; i++) {
+    pfx->address.ipv6.s6_addr[i] = addr >> (56 - i * 8);
+  }
+  pfx->mask_len = mask_len;
+}
+
+static void report(const char *what, long ops, uint64_t elapsed)
+{
+  printf("%-24s %10ld %12.1f %10.1f\n", what, ops, (double)elapsed / ops,
+         (double)elapsed / 1000000);
+}
+
+int main(int argc, char **argv)
+{
+  bgpstream_pfx_storage_t *pfxs = NULL;
+  bgpstream_pfx_storage_t addr;
+  bgpstream_patricia_tree_t *pt = NULL;
+  bgpstream_pfx_index_t *idx = NULL;
+  long v4_cnt = DEFAULT_IPV4_PREFIXES;
+  long v6_cnt = DEFAULT_IPV6_PREFIXES;
+  long total, found = 0;
+  uint64_t start;
+  long i;
+  int rc = -1;
+
+  if ((argc > 1 && (v4_cnt = strtol(argv[1], NULL, 10)) < 0) ||
+      (argc > 2 && (v6_cnt = strtol(argv[2], NULL, 10)) < 0)) {
+    fprintf(stderr, "Usage: %s [ipv4-prefixes [ipv6-prefixes]]\n", argv[0]);
+    return -1;
+  }
+  total = v4_cnt + v6_cnt;
+  if (total == 0) {
+    return 0;
+  }
+
+  if ((pfxs = malloc(sizeof(bgpstream_pfx_storage_t) * total)) == NULL) {
+    return -1;
+  }
+  srand(42);
+  for (i = 0; i < v4_cnt; i++) {
+    rand_ipv4(&pfxs[i], ipv4_mask_len());
+  }
+  for (i = v4_cnt; i < total; i++) {
+    rand_ipv6(&pfxs[i], ipv6_mask_len());
+  }
+
+  printf("%-24s %10s %12s %10s\n", "operation", "ops", "ns/op", "total ms");
+
+  if ((pt = bgpstream_patricia_tree_create(NULL)) == NULL) {
+    goto done;
+  }
+  start = now_nsec();
+  for (i = 0; i < total; i++) {
+    if (bgpstream_patricia_tree_insert(pt, (bgpstream_pfx_t *)&pfxs[i]) ==
+        NULL) {
+      fprintf(stderr, "ERROR: could not insert prefix\n");
+      goto done;
+    }
+  }
+  report("insert", total, now_nsec() - start);
+
+  start = now_nsec();
+  for (i = 0; i < total; i++) {
+    found += bgpstream_patricia_tree_search_exact(
+               pt, (bgpstream_pfx_t *)&pfxs[i]) != NULL;
+  }
+  report("search exact", total, now_nsec() - start);
+  if (found != total) {
+    fprintf(stderr, "ERROR: %ld prefixes not found\n", total - found);
+    goto done;
+  }
+
+  start = now_nsec();
+  found = 0;
+  for (i = 0; i < LOOKUPS; i++) {
+    if (i % 5 == 0) {
+      rand_ipv6(&addr, 64);
+    } else {
+      rand_ipv4(&addr, 32);
+    }
+    found +=
+      bgpstream_patricia_tree_search_best(pt, (bgpstream_pfx_t *)&addr) !=
+      NULL;
+  }
+  report("search best", LOOKUPS, now_nsec() - start);
+
+  start = now_nsec();
+  for (i = 0; i < SUBNET_COUNTS; i++) {
+    found += bgpstream_patricia_tree_count_24subnets(pt) +
+             bgpstream_patricia_tree_count_64subnets(pt);
+  }
+  report("count subnets", SUBNET_COUNTS, now_nsec() - start);
+
+  start = now_nsec();
+  if ((idx = bgpstream_pfx_index_create_from_patricia(pt)) == NULL) {
+    fprintf(stderr, "ERROR: could not create prefix index\n");
+    goto done;
+  }
+  report("index create", total, now_nsec() - start);
+
+  start = now_nsec();
+  found = 0;
+  for (i = 0; i < total; i++) {
+    found += bgpstream_pfx_index_lookup_exact(
+               idx, (bgpstream_pfx_t *)&pfxs[i]) >= 0;
+  }
+  report("index exact", total, now_nsec() - start);
+  if (found != total) {
+    fprintf(stderr, "ERROR: %ld prefixes not indexed\n", total - found);
+    goto done;
+  }
+
+  start = now_nsec();
+  for (i = 0; i < LOOKUPS; i++) {
+    if (i % 5 == 0) {
+      rand_ipv6(&addr, 64);
+    } else {
+      rand_ipv4(&addr, 32);
+    }
+    found +=
+      bgpstream_pfx_index_lookup_best(idx, (bgpstream_pfx_t *)&addr) >= 0;
+  }
+  report("index best", LOOKUPS, now_nsec() - start);
+
+  start = now_nsec();
+  bgpstream_patricia_tree_destroy(pt);
+  pt = NULL;
+  report("destroy", total, now_nsec() - start);
+
+  rc = 0;
+
+ done:
+  bgpstream_pfx_index_destroy(idx);
+  bgpstream_patricia_tree_destroy(pt);
+  free(pfxs);
+  return rc;
+}
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+#include "bgpstream_aspath_matcher.h"
+#include "bgpstream_utils_as_path_int.h"
+
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_LEN 65536
+char buffer[BUFFER_LEN];
+
+/* expressions that the matcher should compile */
+static const char *supported[] = {
+  "_3356_",
+  "^174_",
+  "_13335$",
+  "^3356$",
+  "^174_3356_",
+  "_174_3356$",
+  "^174_.*_3356$",
+  "^.*_3356_",
+  "_.*$",
+  "^.*$",
+  "_3356_.*_",
+  "^174\\(_174\\)*_3356_",
+  "_174\\(_.*\\)*_3356$",
+  "^1\\(_2\\)*\\(_3\\)*$",
+  "_0_",
+  "_4294967295$",
+};
+
+/* expressions that must be left to a regex */
+static const char *unsupported[] = {
+  "3356",
+  "^174",
+  "174$",
+  "_3356",
+  "_33[0-9]6_",
+  "_3356 ",
+  "^_3356_",
+  "_03356_",
+  "_4294967296_",
+  "^174_3356_$",
+  ".*_3356_",
+  "^174\\(_174\\)\\{2\\}_",
+  "^\\(174_\\)*3356$",
+  "_{1,2}_",
+};
+
+/* ASNs used to build random paths */
+static uint32_t asns[] = {0, 1, 2, 3, 174, 3356, 13335, 4294967295};
+#define ASNS_CNT (sizeof(asns) / sizeof(asns[0]))
+
+static void random_path(bgpstream_as_path_t *path)
+{
+  uint32_t set[3];
+  int len = 1 + (rand() % 6);
+  int i, j;
+
+  bgpstream_as_path_clear(path);
+  for (i = 0; i < len; i++) {
+    if ((rand() % 8) == 0) {
+      for (j = 0; j < 3; j++) {
+        set[j] = asns[rand() % ASNS_CNT];
+      }
+      bgpstream_as_path_append(path, BGPSTREAM_AS_PATH_SEG_SET, set,
+                               1 + (rand() % 3));
+    } else {
+      bgpstream_as_path_append(path, BGPSTREAM_AS_PATH_SEG_ASN,
+                               &asns[rand() % ASNS_CNT], 1);
+    }
+  }
+}
+
+static int regex_match(const char *expr, bgpstream_as_path_t *path)
+{
+  regex_t re;
+  int ret;
+
+  bgpstream_as_path_get_filterable(buffer, BUFFER_LEN, path);
+  if (regcomp(&re, expr, 0) != 0) {
+    return -1;
+  }
+  ret = (regexec(&re, buffer, 0, NULL, 0) == 0);
+  regfree(&re);
+  return ret;
+}
+
+int test_aspath_matcher_compile()
+{
+  bgpstream_aspath_matcher_t *m;
+  int i;
+  int ok = 1;
+
+  CHECK("create matcher", (m = bgpstream_aspath_matcher_create()) != NULL);
+
+  for (i = 0; i < sizeof(supported) / sizeof(supported[0]); i++) {
+    if (bgpstream_aspath_matcher_add(m, supported[i], 0) != 0) {
+      fprintf(stderr, "   not compiled: %s\n", supported[i]);
+      ok = 0;
+    }
+  }
+  CHECK("compile supported expressions", ok);
+
+  for (i = 0; i < sizeof(unsupported) / sizeof(unsupported[0]); i++) {
+    if (bgpstream_aspath_matcher_add(m, unsupported[i], 0) != 1) {
+      fprintf(stderr, "   compiled: %s\n", unsupported[i]);
+      ok = 0;
+    }
+  }
+  CHECK("reject unsupported expressions", ok);
+
+  CHECK("expression count", bgpstream_aspath_matcher_get_cnt(m) ==
+                              sizeof(supported) / sizeof(supported[0]));
+
+  bgpstream_aspath_matcher_destroy(m);
+  return 0;
+}
+
+int test_aspath_matcher_regex()
+{
+  bgpstream_aspath_matcher_t *single[sizeof(supported) / sizeof(supported[0])];
+  bgpstream_aspath_matcher_scratch_t
+    *single_scratch[sizeof(supported) / sizeof(supported[0])];
+  bgpstream_aspath_matcher_t *all;
+  bgpstream_aspath_matcher_scratch_t *all_scratch[2];
+  bgpstream_aspath_matcher_t *neg;
+  bgpstream_aspath_matcher_scratch_t *neg_scratch;
+  bgpstream_as_path_t *path;
+  int cnt = sizeof(supported) / sizeof(supported[0]);
+  int expected;
+  int res;
+  int i, j;
+  int ok = 1;
+
+  srand(42);
+  CHECK("create path", (path = bgpstream_as_path_create()) != NULL);
+  CHECK("create matchers", (all = bgpstream_aspath_matcher_create()) != NULL &&
+                             (neg = bgpstream_aspath_matcher_create()) != NULL);
+  for (i = 0; i < cnt; i++) {
+    CHECK("create matcher", (single[i] = bgpstream_aspath_matcher_create()) !=
+                              NULL &&
+                              bgpstream_aspath_matcher_add(
+                                single[i], supported[i], 0) == 0 &&
+                              bgpstream_aspath_matcher_add(all, supported[i],
+                                                           0) == 0);
+  }
+  /* "_3356_" and "^.*_3356_" both rule a path out */
+  CHECK("create negated matcher",
+        bgpstream_aspath_matcher_add(neg, "_3356_", 1) == 0 &&
+          bgpstream_aspath_matcher_add(neg, "^.*_3356_", 1) == 0 &&
+          bgpstream_aspath_matcher_add(neg, "^174_", 0) == 0);
+
+  /* scratch space is created once all the expressions have been added. the
+   * "all" matcher is shared by two scratch spaces, which are used in turn */
+  for (i = 0; i < cnt; i++) {
+    CHECK("create scratch", (single_scratch[i] =
+                               bgpstream_aspath_matcher_scratch_create(
+                                 single[i])) != NULL);
+  }
+  CHECK("create shared scratch",
+        (all_scratch[0] = bgpstream_aspath_matcher_scratch_create(all)) !=
+            NULL &&
+          (all_scratch[1] = bgpstream_aspath_matcher_scratch_create(all)) !=
+            NULL &&
+          (neg_scratch = bgpstream_aspath_matcher_scratch_create(neg)) !=
+            NULL);
+
+  for (j = 0; j < 20000 && ok; j++) {
+    random_path(path);
+    expected = 0;
+    for (i = 0; i < cnt; i++) {
+      res = regex_match(supported[i], path);
+      expected += res;
+      if (bgpstream_aspath_matcher_match(single[i], single_scratch[i],
+                                         path) != res) {
+        bgpstream_as_path_get_filterable(buffer, BUFFER_LEN, path);
+        fprintf(stderr, "   '%s' on '%s': expected %d\n", supported[i], buffer,
+                res);
+        ok = 0;
+      }
+    }
+    if (bgpstream_aspath_matcher_match(all, all_scratch[j % 2], path) !=
+        expected) {
+      ok = 0;
+    }
+    if (regex_match("_3356_", path)) {
+      expected = -1;
+    } else {
+      expected = regex_match("^174_", path);
+    }
+    if (bgpstream_aspath_matcher_match(neg, neg_scratch, path) != expected) {
+      ok = 0;
+    }
+  }
+  CHECK("match random paths like regexes", ok);
+
+  for (i = 0; i < cnt; i++) {
+    bgpstream_aspath_matcher_scratch_destroy(single_scratch[i]);
+    bgpstream_aspath_matcher_destroy(single[i]);
+  }
+  bgpstream_aspath_matcher_scratch_destroy(all_scratch[0]);
+  bgpstream_aspath_matcher_scratch_destroy(all_scratch[1]);
+  bgpstream_aspath_matcher_destroy(all);
+  bgpstream_aspath_matcher_scratch_destroy(neg_scratch);
+  bgpstream_aspath_matcher_destroy(neg);
+  bgpstream_as_path_destroy(path);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("AS path matcher compile", test_aspath_matcher_compile() == 0);
+  CHECK_SECTION("AS path matcher vs regex", test_aspath_matcher_regex() == 0);
+  return 0;
+}
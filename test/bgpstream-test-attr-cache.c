@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "bgpstream_test.h"
+#include "bgpstream_test_mrt.h"
+
+#include "utils.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Tests that RIB elems whose AS paths and communities are shared through the
+ * attribute cache are the same as when the attributes are decoded for every
+ * entry (as they are with lazy attributes, which bypass the cache).
+ * Consecutive RIB entries repeat, and nearly repeat, each other's attributes,
+ * including TABLE_DUMP entries whose AS_PATH is the same but whose AS4_PATH
+ * is not. */
+
+#define RIB_FILE "attr-cache.mrt"
+#define RIB_TIME 1427846400
+
+#define MRT_TYPE_TABLE_DUMP 12
+#define TD_AFI_IPV4 1
+#define TD2_PEER_INDEX_TABLE 1
+#define TD2_RIB_IPV4_UNICAST 2
+
+#define PATH_ATTR_AS_PATH 2
+#define PATH_ATTR_AS4_PATH 17
+
+#define ELEM_STR_LEN 256
+#define MAX_ELEMS 32
+
+#define COMM(asn, value) (((uint32_t)(asn) << 16) | (value))
+
+#define PEER_CNT 3
+static const uint32_t peer_asns[PEER_CNT] = {65001, 65002, 65003};
+
+typedef struct attr_set {
+  uint32_t seq[2];
+  int seq_cnt;
+  uint32_t set[2];
+  int set_cnt;
+  uint32_t comms[2];
+  int comms_cnt;
+} attr_set_t;
+
+enum { ATTRS_A, ATTRS_B, ATTRS_C, ATTRS_D, ATTRS_E, ATTRS_F };
+
+static const attr_set_t attr_sets[] = {
+  // A
+  {{65001, 65100}, 2, {0}, 0, {COMM(65001, 100), COMM(65001, 200)}, 2},
+  // B: A without communities
+  {{65001, 65100}, 2, {0}, 0, {0}, 0},
+  // C: A with only one of its communities
+  {{65001, 65100}, 2, {0}, 0, {COMM(65001, 100)}, 1},
+  // D: A with a different AS path
+  {{65002, 65100}, 2, {0}, 0, {COMM(65001, 100), COMM(65001, 200)}, 2},
+  // E: an AS path that ends with an AS_SET
+  {{65001}, 1, {65200, 65201}, 2, {COMM(65001, 100), COMM(65001, 200)}, 2},
+  // F: A with its communities in the opposite order
+  {{65001, 65100}, 2, {0}, 0, {COMM(65001, 200), COMM(65001, 100)}, 2},
+};
+
+/* the attributes of each TABLE_DUMP_V2 RIB (one per peer) */
+static const int rib_attrs[][PEER_CNT] = {
+  {ATTRS_A, ATTRS_A, ATTRS_B},
+  {ATTRS_C, ATTRS_A, ATTRS_C},
+  {ATTRS_D, ATTRS_A, ATTRS_D},
+  {ATTRS_E, ATTRS_E, ATTRS_F},
+};
+
+/* the AS4_PATH (if any) of each TABLE_DUMP entry, all of which have the
+   AS_PATH 65001 23456 */
+static const uint32_t td_as4_paths[] = {4200000000U, 4200000001U, 0};
+
+static const char *expected[] = {
+  "10.0.0.0/8|65001|65001 65100|65001:100 65001:200",
+  "10.0.0.0/8|65002|65001 65100|65001:100 65001:200",
+  "10.0.0.0/8|65003|65001 65100|",
+  "10.1.0.0/16|65001|65001 65100|65001:100",
+  "10.1.0.0/16|65002|65001 65100|65001:100 65001:200",
+  "10.1.0.0/16|65003|65001 65100|65001:100",
+  "10.2.0.0/16|65001|65002 65100|65001:100 65001:200",
+  "10.2.0.0/16|65002|65001 65100|65001:100 65001:200",
+  "10.2.0.0/16|65003|65002 65100|65001:100 65001:200",
+  "10.3.0.0/16|65001|65001 {65200,65201}|65001:100 65001:200",
+  "10.3.0.0/16|65002|65001 {65200,65201}|65001:100 65001:200",
+  "10.3.0.0/16|65003|65001 65100|65001:200 65001:100",
+  "10.4.0.0/16|65001|65001 4200000000|",
+  "10.5.0.0/16|65001|65001 4200000001|",
+  "10.6.0.0/16|65001|65001 23456|",
+};
+
+static void put_asn(struct buf *b, int asn_size, uint32_t asn)
+{
+  if (asn_size == 2) {
+    put16(b, asn);
+  } else {
+    put32(b, asn);
+  }
+}
+
+/* an AS_PATH (or AS4_PATH) attribute with an AS_SEQUENCE segment and, if
+   set_cnt is not 0, an AS_SET segment */
+static void put_path_attr(struct buf *b, uint8_t type, int asn_size,
+                          const uint32_t *seq, int seq_cnt,
+                          const uint32_t *set, int set_cnt)
+{
+  struct buf v = {{0}, 0};
+  int i;
+
+  put8(&v, 2);
+  put8(&v, seq_cnt);
+  for (i = 0; i < seq_cnt; i++) {
+    put_asn(&v, asn_size, seq[i]);
+  }
+  if (set_cnt > 0) {
+    put8(&v, 1);
+    put8(&v, set_cnt);
+    for (i = 0; i < set_cnt; i++) {
+      put_asn(&v, asn_size, set[i]);
+    }
+  }
+
+  put8(b, (type == PATH_ATTR_AS4_PATH) ? 0xc0 : 0x40);
+  put8(b, type);
+  put8(b, v.len);
+  put_buf(b, &v);
+}
+
+/* ORIGIN (IGP) and NEXT_HOP attributes */
+static void put_origin_next_hop(struct buf *b, uint32_t next_hop)
+{
+  put8(b, 0x40);
+  put8(b, 1);
+  put8(b, 1);
+  put8(b, 0);
+
+  put8(b, 0x40);
+  put8(b, 3);
+  put8(b, 4);
+  put32(b, next_hop);
+}
+
+static void put_communities_attr(struct buf *b, const uint32_t *comms,
+                                 int comms_cnt)
+{
+  int i;
+
+  if (comms_cnt == 0) {
+    return;
+  }
+  put8(b, 0xc0);
+  put8(b, 8);
+  put8(b, 4 * comms_cnt);
+  for (i = 0; i < comms_cnt; i++) {
+    put32(b, comms[i]);
+  }
+}
+
+static void put_peer_index_table(struct buf *out)
+{
+  struct buf b = {{0}, 0};
+  int i;
+
+  put32(&b, 0x0a000001); // collector BGP ID
+  put16(&b, 0);          // view name length
+  put16(&b, PEER_CNT);
+  for (i = 0; i < PEER_CNT; i++) {
+    put8(&b, 0x02);            // IPv4, 4-byte ASN
+    put32(&b, 0x0a000101 + i); // peer BGP ID
+    put32(&b, 0xc0000201 + i);
+    put32(&b, peer_asns[i]);
+  }
+
+  put_mrt_header(out, RIB_TIME, MRT_TYPE_TABLE_DUMP_V2, TD2_PEER_INDEX_TABLE,
+                 b.len);
+  put_buf(out, &b);
+}
+
+/* a RIB for 10.<seq>.0.0/16 (or 10.0.0.0/8 for the first), with an entry for
+   each peer */
+static void put_td2_rib(struct buf *out, uint32_t seq, const int *attrs)
+{
+  struct buf b = {{0}, 0};
+  struct buf a;
+  const attr_set_t *as;
+  int i;
+
+  put32(&b, seq);
+  if (seq == 0) {
+    put8(&b, 8);
+    put8(&b, 10);
+  } else {
+    put8(&b, 16);
+    put8(&b, 10);
+    put8(&b, seq);
+  }
+  put16(&b, PEER_CNT);
+  for (i = 0; i < PEER_CNT; i++) {
+    as = &attr_sets[attrs[i]];
+    a.len = 0;
+    put_origin_next_hop(&a, 0xc0000201 + i);
+    put_path_attr(&a, PATH_ATTR_AS_PATH, 4, as->seq, as->seq_cnt, as->set,
+                  as->set_cnt);
+    put_communities_attr(&a, as->comms, as->comms_cnt);
+
+    put16(&b, i);
+    put32(&b, RIB_TIME);
+    put16(&b, a.len);
+    put_buf(&b, &a);
+  }
+
+  put_mrt_header(out, RIB_TIME, MRT_TYPE_TABLE_DUMP_V2, TD2_RIB_IPV4_UNICAST,
+                 b.len);
+  put_buf(out, &b);
+}
+
+/* a (legacy) TABLE_DUMP entry for 10.<seq>.0.0/16 from the first peer, with
+   the AS_PATH 65001 23456 and the given AS4_PATH ASN (if not 0) */
+static void put_td_entry(struct buf *out, uint16_t seq, uint32_t as4)
+{
+  struct buf b = {{0}, 0};
+  struct buf a = {{0}, 0};
+  static const uint32_t path[] = {65001, 23456};
+
+  put_origin_next_hop(&a, 0xc0000201);
+  put_path_attr(&a, PATH_ATTR_AS_PATH, 2, path, 2, NULL, 0);
+  if (as4 != 0) {
+    put_path_attr(&a, PATH_ATTR_AS4_PATH, 4, &as4, 1, NULL, 0);
+  }
+
+  put16(&b, 0); // view
+  put16(&b, seq);
+  put32(&b, 0x0a000000 | (seq << 16));
+  put8(&b, 16);
+  put8(&b, 1); // status
+  put32(&b, RIB_TIME);
+  put32(&b, 0xc0000201);
+  put16(&b, peer_asns[0]);
+  put16(&b, a.len);
+  put_buf(&b, &a);
+
+  put_mrt_header(out, RIB_TIME, MRT_TYPE_TABLE_DUMP, TD_AFI_IPV4, b.len);
+  put_buf(out, &b);
+}
+
+static int write_rib_file()
+{
+  static struct buf out;
+  int i;
+
+  out.len = 0;
+  put_peer_index_table(&out);
+  for (i = 0; i < ARR_CNT(rib_attrs); i++) {
+    put_td2_rib(&out, i, rib_attrs[i]);
+  }
+  for (i = 0; i < ARR_CNT(td_as4_paths); i++) {
+    put_td_entry(&out, ARR_CNT(rib_attrs) + i, td_as4_paths[i]);
+  }
+
+  return write_file(RIB_FILE, &out);
+}
+
+/* describe an elem as "prefix|peer ASN|AS path|communities" */
+static int add_elem_str(char strs[][ELEM_STR_LEN], int *cnt,
+                        bgpstream_elem_t *elem)
+{
+  char pfx[64];
+  char path[64];
+  char comms[64];
+
+  if (*cnt == MAX_ELEMS ||
+      bgpstream_pfx_snprintf(pfx, sizeof(pfx),
+                             (bgpstream_pfx_t *)&elem->prefix) == NULL ||
+      bgpstream_as_path_snprintf(path, sizeof(path),
+                                 bgpstream_elem_get_as_path(elem)) < 0 ||
+      bgpstream_community_set_snprintf(
+        comms, sizeof(comms), bgpstream_elem_get_communities(elem)) < 0) {
+    return -1;
+  }
+  snprintf(strs[*cnt], ELEM_STR_LEN, "%s|%" PRIu32 "|%s|%s", pfx,
+           elem->peer_asn, path, comms);
+  (*cnt)++;
+  return 0;
+}
+
+/* describe every elem in the RIB file, reading them either one at a time (if
+   batch_len is 0) or in batches of batch_len. returns the number of elems, or
+   -1 on error */
+static int read_elem_strs(int lazy, int batch_len, char strs[][ELEM_STR_LEN])
+{
+  bgpstream_t *bs;
+  bgpstream_record_t *rec;
+  bgpstream_elem_t *elem;
+  bgpstream_elem_t *elems[MAX_ELEMS];
+  bgpstream_data_interface_id_t di_id;
+  bgpstream_data_interface_option_t *option;
+  int cnt = 0;
+  int ret;
+  int i;
+
+  if ((bs = bgpstream_create()) == NULL) {
+    return -1;
+  }
+  di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile");
+  option =
+    bgpstream_get_data_interface_option_by_name(bs, di_id, "rib-file");
+  if (di_id == 0 || option == NULL) {
+    goto err;
+  }
+  bgpstream_set_data_interface(bs, di_id);
+  bgpstream_set_data_interface_option(bs, option, RIB_FILE);
+  if (lazy != 0) {
+    bgpstream_set_lazy_elem_attrs(bs);
+  }
+
+  if (bgpstream_start(bs) != 0) {
+    goto err;
+  }
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    if (batch_len == 0) {
+      while ((ret = bgpstream_record_get_next_elem(rec, &elem)) > 0) {
+        if (add_elem_str(strs, &cnt, elem) != 0) {
+          goto err;
+        }
+      }
+    } else {
+      // the elems of a batch all share the cached attributes at once
+      while ((ret = bgpstream_record_get_elems(rec, elems, batch_len)) > 0) {
+        for (i = 0; i < ret; i++) {
+          if (add_elem_str(strs, &cnt, elems[i]) != 0) {
+            goto err;
+          }
+        }
+      }
+    }
+    if (ret < 0) {
+      goto err;
+    }
+  }
+  if (ret < 0) {
+    goto err;
+  }
+
+  bgpstream_destroy(bs);
+  return cnt;
+
+err:
+  bgpstream_destroy(bs);
+  return -1;
+}
+
+static int check_elem_strs(int lazy, int batch_len)
+{
+  static char strs[MAX_ELEMS][ELEM_STR_LEN];
+  int cnt;
+  int i;
+
+  if ((cnt = read_elem_strs(lazy, batch_len, strs)) != ARR_CNT(expected)) {
+    fprintf(stderr, " ! Expected %d elems, got %d\n", (int)ARR_CNT(expected),
+            cnt);
+    return -1;
+  }
+  for (i = 0; i < cnt; i++) {
+    if (strcmp(strs[i], expected[i]) != 0) {
+      fprintf(stderr, " ! Expected elem '%s', got '%s'\n", expected[i],
+              strs[i]);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int test_attr_cache()
+{
+  CHECK("write RIB file", write_rib_file() == 0);
+
+  CHECK("uncached elems", check_elem_strs(1, 0) == 0);
+  CHECK("cached elems", check_elem_strs(0, 0) == 0);
+  CHECK("cached elems (batches of 2)", check_elem_strs(0, 2) == 0);
+  CHECK("cached elems (whole records)", check_elem_strs(0, MAX_ELEMS) == 0);
+
+  remove(RIB_FILE);
+  return 0;
+}
+
+int main()
+{
+#ifdef WITH_DATA_INTERFACE_SINGLEFILE
+  CHECK_SECTION("RIB attribute cache", test_attr_cache() == 0);
+#else
+  SKIPPED_SECTION("RIB attribute cache");
+#endif
+
+  return 0;
+}
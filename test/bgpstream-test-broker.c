@@ -0,0 +1,429 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+
+#include "utils.h"
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* The broker stand-in serves the rrc06 dump as the first window, the jinx dump
+   as the second window, and then no more data */
+#define INTERVAL_START 1427846400
+#define INTERVAL_END 1427849100
+#define WINDOW1_END "1427847300"
+
+#define RESPONSE_HEAD                                                          \
+  "{\"time\":1427900000,\"type\":\"data\",\"error\":null,"                     \
+  "\"queryParameters\":{},\"data\":{\"dumpFiles\":["
+
+#define RESPONSE_TAIL "]}}"
+
+#define DUMP_FILE(url, project, collector, initial_time)                       \
+  "{\"urlType\":\"simple\",\"url\":\"" url "\",\"project\":\"" project         \
+  "\",\"collector\":\"" collector "\",\"type\":\"updates\","                   \
+  "\"initialTime\":" initial_time ",\"duration\":900}"
+
+#define RRC06_FILE "ris.rrc06.updates.1427846400.gz"
+#define JINX_FILE "routeviews.route-views.jinx.updates.1427846400.bz2"
+
+static const char *window1_json =
+  RESPONSE_HEAD DUMP_FILE(RRC06_FILE, "ris", "rrc06",
+                          "1427846400") RESPONSE_TAIL;
+
+static const char *window2_json =
+  RESPONSE_HEAD DUMP_FILE(JINX_FILE, "routeviews", "route-views.jinx",
+                          WINDOW1_END) RESPONSE_TAIL;
+
+static const char *empty_json = RESPONSE_HEAD RESPONSE_TAIL;
+
+/* How long to wait for the second window to be requested (in sec) */
+#define PREFETCH_TIMEOUT 10
+
+#define REQ_BUFLEN 4096
+
+struct standin {
+  int sock;
+  int port;
+  pthread_t thread;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+  // number of requests served
+  int requests;
+
+  // number of requests for the second window
+  int window2_requests;
+
+  // number of malformed query strings
+  int bad_requests;
+};
+
+static struct standin standin;
+
+/* number of records in the two dump files served by the stand-in */
+static int expected_records;
+
+bgpstream_t *bs;
+bgpstream_record_t *rec;
+bgpstream_data_interface_id_t di_id = 0;
+bgpstream_data_interface_option_t *option;
+bgpstream_response_cache_stats_t cache_stats;
+
+#define SETUP                                                                  \
+  do {                                                                         \
+    bs = bgpstream_create();                                                   \
+    bgpstream_add_interval_filter(bs, INTERVAL_START, INTERVAL_END);           \
+  } while (0)
+
+#define TEARDOWN                                                               \
+  do {                                                                         \
+    bgpstream_destroy(bs);                                                     \
+    bs = NULL;                                                                 \
+  } while (0)
+
+static void handle_request(int conn)
+{
+  char req[REQ_BUFLEN];
+  size_t req_len = 0;
+  ssize_t ret;
+  char *p;
+  const char *body;
+  char head[256];
+
+  // read until the end of the request headers
+  while (req_len < sizeof(req) - 1) {
+    if ((ret = read(conn, req + req_len, sizeof(req) - 1 - req_len)) <= 0) {
+      return;
+    }
+    req_len += ret;
+    req[req_len] = '\0';
+    if (strstr(req, "\r\n\r\n") != NULL) {
+      break;
+    }
+  }
+  // only look at the request line
+  if ((p = strstr(req, "\r\n")) != NULL) {
+    *p = '\0';
+  }
+
+  pthread_mutex_lock(&standin.mutex);
+  standin.requests++;
+  if (strstr(req, "GET /data") == NULL || strstr(req, "/data&") != NULL ||
+      strstr(req, "&&") != NULL || strstr(req, "?&") != NULL) {
+    standin.bad_requests++;
+  }
+  if ((p = strstr(req, "minInitialTime=")) == NULL) {
+    body = window1_json;
+  } else if (strncmp(p + strlen("minInitialTime="), WINDOW1_END,
+                     strlen(WINDOW1_END)) == 0) {
+    body = window2_json;
+    standin.window2_requests++;
+  } else {
+    body = empty_json;
+  }
+  pthread_cond_broadcast(&standin.cond);
+  pthread_mutex_unlock(&standin.mutex);
+
+  snprintf(head, sizeof(head),
+           "HTTP/1.1 200 OK\r\n"
+           "Content-Type: application/json\r\n"
+           "Content-Length: %d\r\n"
+           "Connection: close\r\n\r\n",
+           (int)strlen(body));
+  if (write(conn, head, strlen(head)) < 0 ||
+      write(conn, body, strlen(body)) < 0) {
+    fprintf(stderr, "WARN: broker stand-in failed to write response\n");
+  }
+}
+
+static void *standin_thread(void *user)
+{
+  int conn;
+
+  // the listening socket is shut down when the test is done
+  while ((conn = accept(standin.sock, NULL, NULL)) >= 0) {
+    handle_request(conn);
+    close(conn);
+  }
+
+  return NULL;
+}
+
+static int standin_start()
+{
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+
+  pthread_mutex_init(&standin.mutex, NULL);
+  pthread_cond_init(&standin.cond, NULL);
+
+  if ((standin.sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+    return -1;
+  }
+
+  // let the kernel pick a free port on the loopback interface
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  if (bind(standin.sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(standin.sock, 8) != 0 ||
+      getsockname(standin.sock, (struct sockaddr *)&addr, &addr_len) != 0) {
+    close(standin.sock);
+    return -1;
+  }
+  standin.port = ntohs(addr.sin_port);
+
+  if (pthread_create(&standin.thread, NULL, standin_thread, NULL) != 0) {
+    close(standin.sock);
+    return -1;
+  }
+
+  return 0;
+}
+
+static void standin_stop()
+{
+  shutdown(standin.sock, SHUT_RDWR);
+  pthread_join(standin.thread, NULL);
+  close(standin.sock);
+  pthread_cond_destroy(&standin.cond);
+  pthread_mutex_destroy(&standin.mutex);
+}
+
+/* wait until the second window has been requested, or until we time out */
+static int wait_for_window2()
+{
+  struct timespec deadline;
+  int requested;
+
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += PREFETCH_TIMEOUT;
+
+  pthread_mutex_lock(&standin.mutex);
+  while (standin.window2_requests == 0 &&
+         pthread_cond_timedwait(&standin.cond, &standin.mutex, &deadline) ==
+           0) {
+    // keep waiting
+  }
+  requested = standin.window2_requests;
+  pthread_mutex_unlock(&standin.mutex);
+
+  return requested;
+}
+
+/* count the valid records in the given dump file using the singlefile data
+   interface */
+static int count_singlefile(const char *upd_file)
+{
+  int ret;
+  int counter = 0;
+
+  SETUP;
+  if ((di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile")) ==
+        0 ||
+      (option = bgpstream_get_data_interface_option_by_name(
+         bs, di_id, "upd-file")) == NULL) {
+    TEARDOWN;
+    return -1;
+  }
+  bgpstream_set_data_interface(bs, di_id);
+  bgpstream_set_data_interface_option(bs, option, upd_file);
+
+  if (bgpstream_start(bs) != 0) {
+    TEARDOWN;
+    return -1;
+  }
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status == BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      counter++;
+    }
+  }
+  TEARDOWN;
+
+  return (ret == 0) ? counter : -1;
+}
+
+static int get_requests()
+{
+  int requests;
+
+  pthread_mutex_lock(&standin.mutex);
+  requests = standin.requests;
+  pthread_mutex_unlock(&standin.mutex);
+
+  return requests;
+}
+
+/* read everything the stand-in serves using the broker data interface, and
+   return the number of valid records (or -1 on error) */
+static int run_broker(const char *response_cache_dir, int wait_prefetch,
+                      int *window2_requested)
+{
+  char url[64];
+  int ret;
+  int counter = 0;
+
+  SETUP;
+  if ((di_id = bgpstream_get_data_interface_id_by_name(bs, "broker")) == 0 ||
+      (option = bgpstream_get_data_interface_option_by_name(bs, di_id,
+                                                            "url")) == NULL) {
+    TEARDOWN;
+    return -1;
+  }
+  bgpstream_set_data_interface(bs, di_id);
+  snprintf(url, sizeof(url), "http://127.0.0.1:%d", standin.port);
+  bgpstream_set_data_interface_option(bs, option, url);
+
+  if (response_cache_dir != NULL &&
+      ((option = bgpstream_get_data_interface_option_by_name(
+          bs, di_id, "response-cache-dir")) == NULL ||
+       bgpstream_set_data_interface_option(bs, option, response_cache_dir) !=
+         0)) {
+    TEARDOWN;
+    return -1;
+  }
+
+  if (bgpstream_start(bs) != 0) {
+    TEARDOWN;
+    return -1;
+  }
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status == BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      counter++;
+    }
+    // while we sit on the first record, the next window should be fetched in
+    // the background
+    if (wait_prefetch != 0 && counter == 1 && *window2_requested == 0) {
+      *window2_requested = wait_for_window2();
+    }
+  }
+  if (response_cache_dir != NULL) {
+    bgpstream_get_response_cache_stats(bs, &cache_stats);
+  }
+  TEARDOWN;
+
+  return (ret == 0) ? counter : -1;
+}
+
+static void remove_dir(const char *path)
+{
+  DIR *dir;
+  struct dirent *ent;
+  char buf[1024];
+
+  if ((dir = opendir(path)) == NULL) {
+    return;
+  }
+  while ((ent = readdir(dir)) != NULL) {
+    if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+      continue;
+    }
+    snprintf(buf, sizeof(buf), "%s/%s", path, ent->d_name);
+    remove(buf);
+  }
+  closedir(dir);
+  rmdir(path);
+}
+
+int test_broker_prefetch()
+{
+  int window2_requested = 0;
+
+  CHECK("read records (broker)",
+        run_broker(NULL, 1, &window2_requested) == expected_records);
+  CHECK("next window requested before first window was read",
+        window2_requested != 0);
+  CHECK("well-formed broker queries", standin.bad_requests == 0);
+
+  return 0;
+}
+
+int test_broker_response_cache()
+{
+  char cache_dir[] = "broker-cache-XXXXXX";
+  int requests;
+  int window2_requested = 0;
+
+  CHECK("create cache directory", mkdtemp(cache_dir) != NULL);
+
+  // cold run: everything comes from the broker and is then cached
+  requests = get_requests();
+  CHECK("read records (cold cache)",
+        run_broker(cache_dir, 0, &window2_requested) == expected_records);
+  CHECK("broker queried (cold cache)", get_requests() > requests);
+  CHECK("cache misses (cold cache)", cache_stats.miss_cnt > 0);
+  CHECK("cache stores (cold cache)",
+        cache_stats.store_cnt == cache_stats.miss_cnt);
+  CHECK("no uncacheable queries", cache_stats.uncacheable_cnt == 0);
+
+  // warm run: the resource queue is built without asking the broker
+  requests = get_requests();
+  CHECK("read records (warm cache)",
+        run_broker(cache_dir, 0, &window2_requested) == expected_records);
+  CHECK("broker not queried (warm cache)", get_requests() == requests);
+  CHECK("cache hits (warm cache)", cache_stats.hit_cnt > 0);
+  CHECK("no cache misses (warm cache)", cache_stats.miss_cnt == 0);
+
+  remove_dir(cache_dir);
+  return 0;
+}
+
+int main()
+{
+#if defined(WITH_DATA_INTERFACE_BROKER) &&                                     \
+  defined(WITH_DATA_INTERFACE_SINGLEFILE)
+  int rrc06_cnt, jinx_cnt;
+
+  CHECK("count rrc06 records",
+        (rrc06_cnt = count_singlefile(RRC06_FILE)) > 0);
+  CHECK("count jinx records", (jinx_cnt = count_singlefile(JINX_FILE)) > 0);
+  expected_records = rrc06_cnt + jinx_cnt;
+
+  CHECK("start broker stand-in", standin_start() == 0);
+
+  CHECK_SECTION("broker prefetch", test_broker_prefetch() == 0);
+  CHECK_SECTION("broker response cache", test_broker_response_cache() == 0);
+
+  standin_stop();
+#else
+  SKIPPED_SECTION("broker prefetch");
+  SKIPPED_SECTION("broker response cache");
+#endif
+
+  return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2015 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+#include "bgpstream_decompress.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wandio.h>
+
+#define THREADS 3
+
+/* larger than any of the decompressed test files */
+#define MAX_LEN (1024 * 1024)
+
+/* an odd read size, so that reads straddle block boundaries */
+#define READ_LEN 10007
+
+#define RV_UPDATES "routeviews.route-views.jinx.updates.1427846400"
+#define RIS_UPDATES "ris.rrc06.updates.1427846400"
+
+static uint8_t serial_buf[MAX_LEN];
+static uint8_t parallel_buf[MAX_LEN];
+
+/* read a file using wandio (if d is NULL) or the given parallel stream.
+   returns the number of bytes read, and sets rc to the return code of the
+   last read */
+static int64_t read_all(io_t *io, bgpstream_decompress_t *d, uint8_t *buf,
+                        int64_t *rc)
+{
+  int64_t len = 0;
+
+  while (len < MAX_LEN) {
+    *rc = (d == NULL) ? wandio_read(io, buf + len, READ_LEN)
+                      : bgpstream_decompress_read(d, buf + len, READ_LEN);
+    if (*rc <= 0) {
+      break;
+    }
+    len += *rc;
+  }
+  return len;
+}
+
+/* check that decompressing the parallel file gives the same bytes as reading
+   the serial file with wandio. returns the number of bytes, or -1 */
+static int64_t compare(bgpstream_decompress_pool_t *pool, const char *serial,
+                       const char *parallel)
+{
+  io_t *io;
+  bgpstream_decompress_t *d;
+  int64_t serial_len, parallel_len;
+  int64_t serial_rc, parallel_rc;
+
+  CHECK("open file (serial)", (io = wandio_create(serial)) != NULL);
+  serial_len = read_all(io, NULL, serial_buf, &serial_rc);
+  wandio_destroy(io);
+
+  CHECK("open file (parallel)",
+        (d = bgpstream_decompress_create(pool, parallel)) != NULL);
+  parallel_len = read_all(NULL, d, parallel_buf, &parallel_rc);
+  bgpstream_decompress_destroy(d);
+
+  CHECK("read whole file", serial_len > 0 && serial_len < MAX_LEN);
+  CHECK("same bytes as wandio",
+        parallel_len == serial_len &&
+          memcmp(serial_buf, parallel_buf, serial_len) == 0 &&
+          (parallel_rc < 0) == (serial_rc < 0));
+
+  return serial_len;
+}
+
+static int test_decompress_bzip2(bgpstream_decompress_pool_t *pool)
+{
+  int64_t full_len;
+  int64_t len;
+
+  /* a single block */
+  CHECK("single block",
+        (full_len = compare(pool, RV_UPDATES ".bz2", RV_UPDATES ".bz2")) >
+          0);
+
+  /* the same data as two streams, the first of which has two blocks (wandio
+     stops at the end of the first stream, so compare with the original) */
+  CHECK("multiple blocks and streams",
+        compare(pool, RV_UPDATES ".bz2", RV_UPDATES ".multi.bz2") ==
+          full_len);
+
+  /* the first block decompresses in parallel, but the second is cut short,
+     so the rest of the file is read by wandio */
+  CHECK("truncated (serial fall back)",
+        (len = compare(pool, RV_UPDATES ".truncated.bz2",
+                       RV_UPDATES ".truncated.bz2")) > 0 &&
+          len < full_len);
+
+  return 0;
+}
+
+static int test_decompress_bgzf(bgpstream_decompress_pool_t *pool)
+{
+  /* plain gzip members cannot be split */
+  CHECK("not BGZF",
+        bgpstream_decompress_create(pool, RIS_UPDATES ".gz") == NULL);
+
+  /* two members, and the empty EOF member */
+  CHECK("BGZF members",
+        compare(pool, RIS_UPDATES ".gz", RIS_UPDATES ".bgzf.gz") > 0);
+
+  return 0;
+}
+
+int main()
+{
+  bgpstream_decompress_pool_t *pool;
+
+  CHECK("create pool",
+        (pool = bgpstream_decompress_pool_create(THREADS)) != NULL);
+
+#if defined(HAVE_LIBBZ2) && defined(HAVE_BZLIB_H)
+  CHECK_SECTION("bzip2 decompression", test_decompress_bzip2(pool) == 0);
+#else
+  SKIPPED_SECTION("bzip2 decompression");
+#endif
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+  CHECK_SECTION("BGZF decompression", test_decompress_bgzf(pool) == 0);
+#else
+  SKIPPED_SECTION("BGZF decompression");
+#endif
+
+  bgpstream_decompress_pool_destroy(pool);
+  return 0;
+}
@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2016 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "bgpstream_test.h"
+#include "bgpstream_test_mrt.h"
+
+#include "utils.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Tests that bgpstream_record_get_elems returns exactly the same elems as
+ * bgpstream_record_get_next_elem, whatever the batch size, for both MRT and
+ * BMP records. Each dump holds an UPDATE, an End-of-RIB marker (a record
+ * without elems), a peer state change and the UPDATE again, so batches both
+ * end part-way through a record and exactly at its end. */
+
+#define MRT_FILE "elem-batches.mrt"
+#define BMP_FILE "elem-batches.bmp"
+#define UPD_TIME 1427846400
+
+#define BMP_TYPE_ROUTE_MON 0
+#define BMP_TYPE_PEER_DOWN 2
+
+#define ELEM_STR_LEN 512
+#define MAX_ELEMS 32
+#define MAX_RECORDS 8
+
+/* number of elems in each record of both dumps */
+static const int expected_rec_cnts[] = {8, 0, 1, 8};
+#define EXPECTED_ELEM_CNT 17
+
+static void put_bgp4mp_msg(struct buf *out, uint16_t subtype,
+                           struct buf *body)
+{
+  struct buf msg = {{0}, 0};
+
+  // peer and local ASNs, interface, AFI, peer and local IPs
+  put32(&msg, 65001);
+  put32(&msg, 65000);
+  put16(&msg, 0);
+  put16(&msg, 1);
+  put32(&msg, 0xc0000201);
+  put32(&msg, 0xc00002fe);
+  put_buf(&msg, body);
+
+  put_mrt_header(out, UPD_TIME, MRT_TYPE_BGP4MP, subtype, msg.len);
+  put_buf(out, &msg);
+}
+
+static int write_mrt_file()
+{
+  static struct buf out;
+  struct buf body = {{0}, 0};
+
+  out.len = 0;
+
+  put_test_update(&body);
+  put_bgp4mp_msg(&out, BGP4MP_MESSAGE_AS4, &body);
+
+  body.len = 0;
+  put_end_of_rib(&body);
+  put_bgp4mp_msg(&out, BGP4MP_MESSAGE_AS4, &body);
+
+  // IDLE to ESTABLISHED
+  body.len = 0;
+  put16(&body, 1);
+  put16(&body, 6);
+  put_bgp4mp_msg(&out, BGP4MP_STATE_CHANGE_AS4, &body);
+
+  body.len = 0;
+  put_test_update(&body);
+  put_bgp4mp_msg(&out, BGP4MP_MESSAGE_AS4, &body);
+
+  return write_file(MRT_FILE, &out);
+}
+
+static void put_bmp_msg(struct buf *out, uint8_t type, struct buf *body)
+{
+  // common header: version, length and type
+  put8(out, 3);
+  put32(out, 6 + 42 + body->len);
+  put8(out, type);
+
+  // per-peer header: global instance peer, IPv4 with 4-byte AS paths, no
+  // distinguisher, address, ASN, BGP ID and timestamp
+  put8(out, 0);
+  put8(out, 0);
+  put32(out, 0);
+  put32(out, 0);
+  put32(out, 0);
+  put32(out, 0);
+  put32(out, 0);
+  put32(out, 0xc0000201);
+  put32(out, 65001);
+  put32(out, 0xc0000201);
+  put32(out, UPD_TIME);
+  put32(out, 0);
+
+  put_buf(out, body);
+}
+
+static int write_bmp_file()
+{
+  static struct buf out;
+  struct buf body = {{0}, 0};
+
+  out.len = 0;
+
+  put_test_update(&body);
+  put_bmp_msg(&out, BMP_TYPE_ROUTE_MON, &body);
+
+  body.len = 0;
+  put_end_of_rib(&body);
+  put_bmp_msg(&out, BMP_TYPE_ROUTE_MON, &body);
+
+  // remote system closed the session without a notification
+  body.len = 0;
+  put8(&body, 4);
+  put_bmp_msg(&out, BMP_TYPE_PEER_DOWN, &body);
+
+  body.len = 0;
+  put_test_update(&body);
+  put_bmp_msg(&out, BMP_TYPE_ROUTE_MON, &body);
+
+  return write_file(BMP_FILE, &out);
+}
+
+static int add_elem_str(char strs[][ELEM_STR_LEN], int *cnt,
+                        bgpstream_elem_t *elem)
+{
+  if (*cnt == MAX_ELEMS ||
+      bgpstream_elem_snprintf(strs[*cnt], ELEM_STR_LEN, elem) == NULL) {
+    return -1;
+  }
+  (*cnt)++;
+  return 0;
+}
+
+/* describe every elem in the given dump, reading them either one at a time (if
+   batch_len is 0) or in batches of batch_len, and count the elems of each
+   record. returns the number of elems, or -1 on error */
+static int read_elems(const char *file, const char *type, int lazy,
+                      int batch_len, char strs[][ELEM_STR_LEN], int *rec_cnts,
+                      int *rec_cnt)
+{
+  bgpstream_t *bs;
+  bgpstream_record_t *rec;
+  bgpstream_elem_t *elem;
+  bgpstream_elem_t *elems[MAX_ELEMS];
+  bgpstream_data_interface_id_t di_id;
+  bgpstream_data_interface_option_t *option;
+  bgpstream_data_interface_option_t *type_option;
+  int cnt = 0;
+  int ret;
+  int i, j;
+
+  *rec_cnt = 0;
+
+  if ((bs = bgpstream_create()) == NULL) {
+    return -1;
+  }
+  di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile");
+  option =
+    bgpstream_get_data_interface_option_by_name(bs, di_id, "upd-file");
+  type_option =
+    bgpstream_get_data_interface_option_by_name(bs, di_id, "upd-type");
+  if (di_id == 0 || option == NULL || type_option == NULL) {
+    goto err;
+  }
+  bgpstream_set_data_interface(bs, di_id);
+  bgpstream_set_data_interface_option(bs, option, file);
+  bgpstream_set_data_interface_option(bs, type_option, type);
+  if (lazy != 0) {
+    bgpstream_set_lazy_elem_attrs(bs);
+  }
+
+  if (bgpstream_start(bs) != 0) {
+    goto err;
+  }
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    if (*rec_cnt == MAX_RECORDS) {
+      goto err;
+    }
+    rec_cnts[*rec_cnt] = 0;
+
+    if (batch_len == 0) {
+      while ((ret = bgpstream_record_get_next_elem(rec, &elem)) > 0) {
+        if (add_elem_str(strs, &cnt, elem) != 0) {
+          goto err;
+        }
+        rec_cnts[*rec_cnt]++;
+      }
+    } else {
+      while ((ret = bgpstream_record_get_elems(rec, elems, batch_len)) > 0) {
+        if (ret > batch_len) {
+          goto err;
+        }
+        // every elem of the batch is a distinct structure, and is still valid
+        // once the whole batch has been extracted
+        for (i = 0; i < ret; i++) {
+          for (j = 0; j < i; j++) {
+            if (elems[i] == elems[j]) {
+              goto err;
+            }
+          }
+          if (add_elem_str(strs, &cnt, elems[i]) != 0) {
+            goto err;
+          }
+        }
+        rec_cnts[*rec_cnt] += ret;
+      }
+      // and once the end of the record is reached, it stays there
+      if (ret == 0 && bgpstream_record_get_elems(rec, elems, batch_len) != 0) {
+        goto err;
+      }
+    }
+    if (ret < 0) {
+      goto err;
+    }
+    (*rec_cnt)++;
+  }
+  if (ret < 0) {
+    goto err;
+  }
+
+  bgpstream_destroy(bs);
+  return cnt;
+
+err:
+  bgpstream_destroy(bs);
+  return -1;
+}
+
+/* check that batches of every size return the same elems as reading them one
+   at a time, both with and without lazy path attributes */
+static int check_batches(const char *file, const char *type)
+{
+  static const int batch_lens[] = {1, 2, 3, 4, 8, 9, MAX_ELEMS};
+  static char ref_strs[MAX_ELEMS][ELEM_STR_LEN];
+  static char strs[MAX_ELEMS][ELEM_STR_LEN];
+  int ref_rec_cnts[MAX_RECORDS];
+  int rec_cnts[MAX_RECORDS];
+  int ref_cnt, cnt;
+  int rec_cnt;
+  int lazy;
+  int b, i;
+
+  for (lazy = 0; lazy <= 1; lazy++) {
+    ref_cnt = read_elems(file, type, lazy, 0, ref_strs, ref_rec_cnts,
+                         &rec_cnt);
+    if (ref_cnt != EXPECTED_ELEM_CNT ||
+        rec_cnt != ARR_CNT(expected_rec_cnts) ||
+        memcmp(ref_rec_cnts, expected_rec_cnts, sizeof(expected_rec_cnts)) !=
+          0) {
+      fprintf(stderr, " ! Expected %d elems in %d records, got %d in %d\n",
+              EXPECTED_ELEM_CNT, (int)ARR_CNT(expected_rec_cnts), ref_cnt,
+              rec_cnt);
+      return -1;
+    }
+
+    for (b = 0; b < ARR_CNT(batch_lens); b++) {
+      cnt = read_elems(file, type, lazy, batch_lens[b], strs, rec_cnts,
+                       &rec_cnt);
+      if (cnt != ref_cnt || rec_cnt != ARR_CNT(expected_rec_cnts) ||
+          memcmp(rec_cnts, ref_rec_cnts, sizeof(expected_rec_cnts)) != 0) {
+        fprintf(stderr, " ! Batches of %d: expected %d elems, got %d\n",
+                batch_lens[b], ref_cnt, cnt);
+        return -1;
+      }
+      for (i = 0; i < cnt; i++) {
+        if (strcmp(strs[i], ref_strs[i]) != 0) {
+          fprintf(stderr,
+                  " ! Batches of %d: expected elem '%s', got '%s'\n",
+                  batch_lens[b], ref_strs[i], strs[i]);
+          return -1;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+int test_mrt_batches()
+{
+  CHECK("write MRT file", write_mrt_file() == 0);
+  CHECK("MRT elem batches", check_batches(MRT_FILE, "mrt") == 0);
+  remove(MRT_FILE);
+  return 0;
+}
+
+int test_bmp_batches()
+{
+  CHECK("write BMP file", write_bmp_file() == 0);
+  CHECK("BMP elem batches", check_batches(BMP_FILE, "bmp") == 0);
+  remove(BMP_FILE);
+  return 0;
+}
+
+int main()
+{
+#ifdef WITH_DATA_INTERFACE_SINGLEFILE
+  CHECK_SECTION("MRT elem batches", test_mrt_batches() == 0);
+  CHECK_SECTION("BMP elem batches", test_bmp_batches() == 0);
+#else
+  SKIPPED_SECTION("MRT elem batches");
+  SKIPPED_SECTION("BMP elem batches");
+#endif
+
+  return 0;
+}
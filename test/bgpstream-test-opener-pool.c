@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2015 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+#include "bgpstream_opener_pool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TASK_CNT 6
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+/* set once the blocking (or slow) task is running, and to let the blocking
+ * task finish */
+static int blocker_running = 0;
+static int blocker_release = 0;
+
+/* ids of the tasks, in the order they were run */
+static int order[TASK_CNT];
+static int order_cnt = 0;
+
+static void blocker(void *user)
+{
+  pthread_mutex_lock(&mutex);
+  blocker_running = 1;
+  pthread_cond_broadcast(&cond);
+  while (blocker_release == 0) {
+    pthread_cond_wait(&cond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+static void record_order(void *user)
+{
+  pthread_mutex_lock(&mutex);
+  order[order_cnt++] = *(int *)user;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&mutex);
+}
+
+static void slow_task(void *user)
+{
+  pthread_mutex_lock(&mutex);
+  blocker_running = 1;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&mutex);
+  usleep(100000);
+  *(int *)user = 1;
+}
+
+static void wait_for_blocker()
+{
+  pthread_mutex_lock(&mutex);
+  while (blocker_running == 0) {
+    pthread_cond_wait(&cond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+static void release_blocker()
+{
+  pthread_mutex_lock(&mutex);
+  blocker_release = 1;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&mutex);
+}
+
+/* tasks queued behind a busy worker run by priority, then in submission
+ * order, and cancelled tasks never run */
+static int test_opener_pool_order()
+{
+  bgpstream_opener_pool_t *pool;
+  bgpstream_opener_task_t *block_task;
+  bgpstream_opener_task_t *tasks[TASK_CNT];
+  bgpstream_opener_stats_t stats;
+  /* ids are the positions the tasks should run in, task 5 is cancelled */
+  int ids[TASK_CNT] = {3, 0, 4, 1, 2, 5};
+  uint32_t prios[TASK_CNT] = {30, 10, 40, 10, 20, 0};
+  int expected[] = {0, 1, 2, 3, 4};
+  int i;
+
+  CHECK("opener pool create", (pool = bgpstream_opener_pool_create(1)) != NULL);
+
+  /* keep the only worker busy, so that everything else is queued */
+  CHECK("submit blocking task",
+        (block_task = bgpstream_opener_pool_submit_work(pool, 0, blocker,
+                                                        NULL)) != NULL);
+  wait_for_blocker();
+
+  for (i = 0; i < TASK_CNT; i++) {
+    CHECK("submit open task",
+          (tasks[i] = bgpstream_opener_pool_submit(pool, prios[i],
+                                                   record_order, &ids[i])) !=
+            NULL);
+  }
+  bgpstream_opener_pool_get_stats(pool, &stats);
+  CHECK("queued opens", stats.queued_cnt == TASK_CNT && stats.active_cnt == 0);
+
+  /* cancel the highest-priority task before it starts */
+  bgpstream_opener_pool_cancel(pool, tasks[TASK_CNT - 1]);
+  tasks[TASK_CNT - 1] = NULL;
+  bgpstream_opener_pool_get_stats(pool, &stats);
+  CHECK("cancel before start", stats.queued_cnt == TASK_CNT - 1);
+
+  release_blocker();
+  bgpstream_opener_pool_cancel(pool, block_task);
+
+  /* wait for the tasks to run (cancelling them now would stop them) */
+  pthread_mutex_lock(&mutex);
+  while (order_cnt < TASK_CNT - 1) {
+    pthread_cond_wait(&cond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+  for (i = 0; i < TASK_CNT - 1; i++) {
+    bgpstream_opener_pool_cancel(pool, tasks[i]);
+  }
+
+  CHECK("tasks run in priority order",
+        order_cnt == TASK_CNT - 1 &&
+          memcmp(order, expected, sizeof(expected)) == 0);
+
+  /* the blocking task is not an open, and the cancelled one never ran */
+  bgpstream_opener_pool_get_stats(pool, &stats);
+  CHECK("open stats",
+        stats.open_cnt == TASK_CNT - 1 && stats.queued_cnt == 0 &&
+          stats.active_cnt == 0 && stats.active_max == 1 &&
+          stats.queue_wait_max <= stats.queue_wait_total &&
+          stats.open_time_max <= stats.open_time_total);
+
+  bgpstream_opener_pool_destroy(pool);
+  return 0;
+}
+
+/* cancelling a running task blocks until it has completed */
+static int test_opener_pool_cancel_running()
+{
+  bgpstream_opener_pool_t *pool;
+  bgpstream_opener_task_t *task;
+  bgpstream_opener_stats_t stats;
+  int done = 0;
+
+  blocker_running = 0;
+
+  CHECK("opener pool create", (pool = bgpstream_opener_pool_create(2)) != NULL);
+  CHECK("submit slow task",
+        (task = bgpstream_opener_pool_submit(pool, 0, slow_task, &done)) !=
+          NULL);
+  wait_for_blocker();
+
+  bgpstream_opener_pool_get_stats(pool, &stats);
+  CHECK("active open", stats.active_cnt == 1 && stats.queued_cnt == 0);
+
+  bgpstream_opener_pool_cancel(pool, task);
+  CHECK("cancel waits for running task", done == 1);
+
+  bgpstream_opener_pool_get_stats(pool, &stats);
+  CHECK("open stats", stats.open_cnt == 1 && stats.active_cnt == 0 &&
+                        stats.open_time_max >= 50);
+
+  bgpstream_opener_pool_destroy(pool);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("opener pool order", test_opener_pool_order() == 0);
+  CHECK_SECTION("opener pool cancel running",
+                test_opener_pool_cancel_running() == 0);
+  return 0;
+}
@@ -0,0 +1,644 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+#include "bgpstream_test_mrt.h"
+
+#include "utils.h"
+
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Tests that the elem filters give the same results when they are evaluated
+ * while decoding TABLE_DUMP_V2 RIB entries. A small RIB dump is written to
+ * disk and then read back through the singlefile data interface with
+ * different filters. */
+
+#define RIB_FILE "td2-filters.mrt"
+#define RIB_TIME 1427846400
+
+#define TD2_PEER_INDEX_TABLE 1
+#define TD2_RIB_IPV4_UNICAST 2
+#define TD2_RIB_IPV6_UNICAST 4
+
+/* the peers in the peer index table */
+#define PEER_CNT 3
+static const uint32_t peer_asns[PEER_CNT] = {65001, 65002, 65003};
+
+/* a RIB entry for the given peer, with ORIGIN, AS_PATH (peer ASN, 65100) and,
+ * for IPv4, NEXT_HOP attributes */
+static void put_rib_entry(struct buf *b, uint16_t peer_idx, int ipv6)
+{
+  put16(b, peer_idx);
+  put32(b, RIB_TIME);
+  put16(b, 4 + 13 + (ipv6 ? 0 : 7)); // attribute length
+
+  // ORIGIN: IGP
+  put8(b, 0x40);
+  put8(b, 1);
+  put8(b, 1);
+  put8(b, 0);
+
+  // AS_PATH: one AS_SEQUENCE segment of two 4-byte ASNs
+  put8(b, 0x40);
+  put8(b, 2);
+  put8(b, 10);
+  put8(b, 2);
+  put8(b, 2);
+  put32(b, peer_asns[peer_idx]);
+  put32(b, 65100);
+
+  if (!ipv6) {
+    // NEXT_HOP: 192.0.2.<peer>
+    put8(b, 0x40);
+    put8(b, 3);
+    put8(b, 4);
+    put32(b, 0xc0000200 | (peer_idx + 1));
+  }
+}
+
+/* the peer ASNs in the table are offset by asn_offset */
+static void put_peer_index_table(struct buf *out, uint32_t asn_offset)
+{
+  struct buf b = {{0}, 0};
+  static const uint8_t ipv6_peer[16] = {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0,
+                                        0,    0,    0,    0,    0, 0, 0, 3};
+  int i;
+
+  put32(&b, 0x0a000001); // collector BGP ID
+  put16(&b, 0);          // view name length
+  put16(&b, PEER_CNT);
+  for (i = 0; i < PEER_CNT; i++) {
+    put8(&b, (i == 2) ? 0x03 : 0x02); // 4-byte ASN, and IPv6 for the last
+    put32(&b, 0x0a000101 + i);        // peer BGP ID
+    if (i == 2) {
+      put_bytes(&b, ipv6_peer, sizeof(ipv6_peer));
+    } else {
+      put32(&b, 0xc0000201 + i);
+    }
+    put32(&b, peer_asns[i] + asn_offset);
+  }
+
+  put_mrt_header(out, RIB_TIME, MRT_TYPE_TABLE_DUMP_V2, TD2_PEER_INDEX_TABLE,
+                 b.len);
+  put_buf(out, &b);
+}
+
+static void put_rib(struct buf *out, uint32_t seq, int ipv6,
+                    const uint8_t *prefix, uint8_t prefix_len,
+                    const uint16_t *peers, int peer_cnt)
+{
+  struct buf b = {{0}, 0};
+  int i;
+
+  put32(&b, seq);
+  put8(&b, prefix_len);
+  put_bytes(&b, prefix, (prefix_len + 7) / 8);
+  put16(&b, peer_cnt);
+  for (i = 0; i < peer_cnt; i++) {
+    put_rib_entry(&b, peers[i], ipv6);
+  }
+
+  put_mrt_header(out, RIB_TIME, MRT_TYPE_TABLE_DUMP_V2,
+                 ipv6 ? TD2_RIB_IPV6_UNICAST : TD2_RIB_IPV4_UNICAST, b.len);
+  put_buf(out, &b);
+}
+
+/* 10.0.0.0/8 from all peers, 10.1.0.0/16 from 65002, 192.168.0.0/24 from
+ * 65001 and 65003, and 2001:db8::/32 from 65001 and 65002 (8 elems) */
+static int write_rib_file()
+{
+  static struct buf b;
+  static const uint8_t pfx1[] = {10};
+  static const uint8_t pfx2[] = {10, 1};
+  static const uint8_t pfx3[] = {192, 168, 0};
+  static const uint8_t pfx4[] = {0x20, 0x01, 0x0d, 0xb8};
+  static const uint16_t peers1[] = {0, 1, 2};
+  static const uint16_t peers2[] = {1};
+  static const uint16_t peers3[] = {0, 2};
+  static const uint16_t peers4[] = {0, 1};
+
+  b.len = 0;
+  put_peer_index_table(&b, 0);
+  put_rib(&b, 0, 0, pfx1, 8, peers1, ARR_CNT(peers1));
+  put_rib(&b, 1, 0, pfx2, 16, peers2, ARR_CNT(peers2));
+  put_rib(&b, 2, 0, pfx3, 24, peers3, ARR_CNT(peers3));
+  put_rib(&b, 3, 1, pfx4, 32, peers4, ARR_CNT(peers4));
+
+  return write_file(RIB_FILE, &b);
+}
+
+/* 10.0.0.0/8 from all peers, twice, with a new peer index table in between
+ * that gives the peers the ASNs 65011 to 65013 (6 elems) */
+static int write_two_table_file()
+{
+  static struct buf b;
+  static const uint8_t pfx[] = {10};
+  static const uint16_t peers[] = {0, 1, 2};
+
+  b.len = 0;
+  put_peer_index_table(&b, 0);
+  put_rib(&b, 0, 0, pfx, 8, peers, ARR_CNT(peers));
+  put_peer_index_table(&b, 10);
+  put_rib(&b, 1, 0, pfx, 8, peers, ARR_CNT(peers));
+
+  return write_file(RIB_FILE, &b);
+}
+
+/* count the elems in the RIB file that pass the given filters (or all elems
+   if filter_type is 0). returns -1 on error */
+static int count_elems(int lazy, bgpstream_filter_type_t filter_type,
+                       const char *value,
+                       bgpstream_filter_type_t filter_type2,
+                       const char *value2)
+{
+  bgpstream_t *bs;
+  bgpstream_record_t *rec;
+  bgpstream_elem_t *elem;
+  bgpstream_data_interface_id_t di_id;
+  bgpstream_data_interface_option_t *option;
+  int ret;
+  int cnt = 0;
+
+  if ((bs = bgpstream_create()) == NULL) {
+    return -1;
+  }
+  if ((di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile")) ==
+        0 ||
+      (option = bgpstream_get_data_interface_option_by_name(
+         bs, di_id, "rib-file")) == NULL) {
+    goto err;
+  }
+  bgpstream_set_data_interface(bs, di_id);
+  bgpstream_set_data_interface_option(bs, option, RIB_FILE);
+  if (lazy != 0) {
+    bgpstream_set_lazy_elem_attrs(bs);
+  }
+
+  if (filter_type != 0) {
+    bgpstream_add_filter(bs, filter_type, value);
+  }
+  if (filter_type2 != 0) {
+    bgpstream_add_filter(bs, filter_type2, value2);
+  }
+
+  if (bgpstream_start(bs) != 0) {
+    goto err;
+  }
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    while ((ret = bgpstream_record_get_next_elem(rec, &elem)) > 0) {
+      cnt++;
+    }
+    if (ret < 0) {
+      goto err;
+    }
+  }
+  if (ret < 0) {
+    goto err;
+  }
+
+  bgpstream_destroy(bs);
+  return cnt;
+
+err:
+  bgpstream_destroy(bs);
+  return -1;
+}
+
+#define COUNT(type, value) count_elems(0, type, value, 0, NULL)
+
+int test_td2_filters()
+{
+  CHECK("write RIB file", write_rib_file() == 0);
+
+  CHECK("no filters", COUNT(0, NULL) == 8);
+
+  CHECK("peer ASN filter",
+        COUNT(BGPSTREAM_FILTER_TYPE_ELEM_PEER_ASN, "65002") == 3);
+  CHECK("peer ASN filter (no match)",
+        COUNT(BGPSTREAM_FILTER_TYPE_ELEM_PEER_ASN, "65999") == 0);
+
+  CHECK("IP version filter (IPv4)",
+        COUNT(BGPSTREAM_FILTER_TYPE_ELEM_IP_VERSION, "4") == 6);
+  CHECK("IP version filter (IPv6)",
+        COUNT(BGPSTREAM_FILTER_TYPE_ELEM_IP_VERSION, "6") == 2);
+
+  CHECK("prefix filter (exact)",
+        COUNT(BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_EXACT, "10.0.0.0/8") == 3);
+  CHECK("prefix filter (more specifics)",
+        COUNT(BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_MORE, "10.0.0.0/8") == 4);
+  CHECK("prefix filter (less specifics)",
+        COUNT(BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_LESS, "10.1.2.0/24") == 4);
+  CHECK("prefix filter (IPv6)",
+        COUNT(BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_ANY, "2001:db8::/48") == 2);
+
+  CHECK("elem type filter (ribs)",
+        COUNT(BGPSTREAM_FILTER_TYPE_ELEM_TYPE, "ribs") == 8);
+  CHECK("elem type filter (announcements)",
+        COUNT(BGPSTREAM_FILTER_TYPE_ELEM_TYPE, "announcements") == 0);
+
+  CHECK("peer ASN and prefix filters",
+        count_elems(0, BGPSTREAM_FILTER_TYPE_ELEM_PEER_ASN, "65001",
+                    BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_MORE, "10.0.0.0/8") == 1);
+  CHECK("peer ASN and IP version filters",
+        count_elems(0, BGPSTREAM_FILTER_TYPE_ELEM_PEER_ASN, "65003",
+                    BGPSTREAM_FILTER_TYPE_ELEM_IP_VERSION, "6") == 0);
+
+  remove(RIB_FILE);
+  return 0;
+}
+
+#define ELEM_STR_LEN 1024
+#define MAX_ELEMS 16
+
+/* write every elem in the RIB file as a string, reading them in batches of
+   batch_size if it is non-zero. returns the number of elems, or -1 on error */
+static int read_elem_strs(int lazy, int batch_size, char strs[][ELEM_STR_LEN])
+{
+  bgpstream_t *bs;
+  bgpstream_record_t *rec;
+  bgpstream_elem_t *elem;
+  bgpstream_elem_t *batch[MAX_ELEMS];
+  int i;
+  bgpstream_data_interface_id_t di_id;
+  bgpstream_data_interface_option_t *option;
+  int ret;
+  int cnt = 0;
+
+  if ((bs = bgpstream_create()) == NULL) {
+    return -1;
+  }
+  di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile");
+  option =
+    bgpstream_get_data_interface_option_by_name(bs, di_id, "rib-file");
+  if (di_id == 0 || option == NULL) {
+    goto err;
+  }
+  bgpstream_set_data_interface(bs, di_id);
+  bgpstream_set_data_interface_option(bs, option, RIB_FILE);
+  if (lazy != 0) {
+    bgpstream_set_lazy_elem_attrs(bs);
+  }
+
+  if (bgpstream_start(bs) != 0) {
+    goto err;
+  }
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    if (batch_size != 0) {
+      while ((ret = bgpstream_record_get_elems(rec, batch, batch_size)) > 0) {
+        // every elem in the batch must still be intact
+        for (i = 0; i < ret; i++) {
+          if (cnt == MAX_ELEMS ||
+              (i > 0 && batch[i] == batch[i - 1]) ||
+              bgpstream_elem_snprintf(strs[cnt], ELEM_STR_LEN, batch[i]) ==
+                NULL) {
+            goto err;
+          }
+          cnt++;
+        }
+      }
+    } else {
+      while ((ret = bgpstream_record_get_next_elem(rec, &elem)) > 0) {
+        if (cnt == MAX_ELEMS ||
+            bgpstream_elem_snprintf(strs[cnt], ELEM_STR_LEN, elem) == NULL) {
+          goto err;
+        }
+        cnt++;
+      }
+    }
+    if (ret < 0) {
+      goto err;
+    }
+  }
+  if (ret < 0) {
+    goto err;
+  }
+
+  bgpstream_destroy(bs);
+  return cnt;
+
+err:
+  bgpstream_destroy(bs);
+  return -1;
+}
+
+int test_td2_lazy_attrs()
+{
+  static char eager[MAX_ELEMS][ELEM_STR_LEN];
+  static char lazy[MAX_ELEMS][ELEM_STR_LEN];
+  int eager_cnt, lazy_cnt;
+  int i;
+
+  CHECK("write RIB file", write_rib_file() == 0);
+
+  eager_cnt = read_elem_strs(0, 0, eager);
+  lazy_cnt = read_elem_strs(1, 0, lazy);
+  CHECK("elem count (eager)", eager_cnt == 8);
+  CHECK("elem count (lazy)", lazy_cnt == eager_cnt);
+
+  for (i = 0; i < eager_cnt; i++) {
+    CHECK("lazy elem equality", strcmp(eager[i], lazy[i]) == 0);
+  }
+  CHECK("AS path decoded", strstr(lazy[0], "|65001 65100|65100|") != NULL);
+
+  // filters need the AS path, so they decode it on demand
+  CHECK("AS path filter (lazy)",
+        count_elems(1, BGPSTREAM_FILTER_TYPE_ELEM_ASPATH, "^65002_",
+                    BGPSTREAM_FILTER_TYPE_ELEM_IP_VERSION, "4") == 2);
+
+  remove(RIB_FILE);
+  return 0;
+}
+
+int test_td2_elem_batches()
+{
+  static char single[MAX_ELEMS][ELEM_STR_LEN];
+  static char batched[MAX_ELEMS][ELEM_STR_LEN];
+  int single_cnt;
+  int batch_size;
+  int lazy;
+  int i;
+
+  CHECK("write RIB file", write_rib_file() == 0);
+
+  single_cnt = read_elem_strs(0, 0, single);
+  CHECK("elem count (single)", single_cnt == 8);
+
+  // the first RIB record has three elems, so a batch of two has to be
+  // continued by a second call
+  for (lazy = 0; lazy <= 1; lazy++) {
+    for (batch_size = 1; batch_size <= 4; batch_size++) {
+      memset(batched, 0, sizeof(batched));
+      CHECK("elem count (batched)",
+            read_elem_strs(lazy, batch_size, batched) == single_cnt);
+      for (i = 0; i < single_cnt; i++) {
+        CHECK("batched elem equality", strcmp(single[i], batched[i]) == 0);
+      }
+    }
+  }
+
+  remove(RIB_FILE);
+  return 0;
+}
+
+static int read_elem_columns(bgpstream_elem_columns_t *all, int size)
+{
+  bgpstream_t *bs;
+  bgpstream_data_interface_id_t di_id;
+  bgpstream_data_interface_option_t *option;
+  bgpstream_elem_columns_t *cols = NULL;
+  bgpstream_record_t *rec;
+  int ret;
+  int i;
+
+  if ((bs = bgpstream_create()) == NULL) {
+    return -1;
+  }
+  di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile");
+  option =
+    bgpstream_get_data_interface_option_by_name(bs, di_id, "rib-file");
+  if (di_id == 0 || option == NULL) {
+    goto err;
+  }
+  bgpstream_set_data_interface(bs, di_id);
+  bgpstream_set_data_interface_option(bs, option, RIB_FILE);
+
+  // a small batch that shares its maps with the large one, and that is
+  // drained into it whenever it fills up
+  if ((cols = bgpstream_elem_columns_create(size, all->peer_sig_map,
+                                            all->path_store)) == NULL ||
+      bgpstream_start(bs) != 0) {
+    goto err;
+  }
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    do {
+      if ((ret = bgpstream_record_get_elem_columns(rec, cols)) < 0 ||
+          all->cnt + cols->cnt > all->size) {
+        goto err;
+      }
+      for (i = 0; i < cols->cnt; i++) {
+        all->type[all->cnt] = cols->type[i];
+        all->time_sec[all->cnt] = cols->time_sec[i];
+        all->ip_version[all->cnt] = cols->ip_version[i];
+        all->pfx_ipv4[all->cnt] = cols->pfx_ipv4[i];
+        all->pfx_ipv6[all->cnt] = cols->pfx_ipv6[i];
+        all->mask_len[all->cnt] = cols->mask_len[i];
+        all->peer_asn[all->cnt] = cols->peer_asn[i];
+        all->peer_id[all->cnt] = cols->peer_id[i];
+        all->origin_asn[all->cnt] = cols->origin_asn[i];
+        all->path_id[all->cnt] = cols->path_id[i];
+        all->cnt++;
+      }
+      bgpstream_elem_columns_clear(cols);
+    } while (ret == 1);
+  }
+  if (ret < 0) {
+    goto err;
+  }
+
+  bgpstream_elem_columns_destroy(cols);
+  bgpstream_destroy(bs);
+  return all->cnt;
+
+err:
+  bgpstream_elem_columns_destroy(cols);
+  bgpstream_destroy(bs);
+  return -1;
+}
+
+int test_td2_elem_columns()
+{
+  bgpstream_peer_sig_map_t *peer_sig_map;
+  bgpstream_as_path_store_t *path_store;
+  bgpstream_elem_columns_t *all;
+  int v4_cnt;
+  int size;
+  int i;
+
+  CHECK("write RIB file", write_rib_file() == 0);
+
+  for (size = 1; size <= 4; size++) {
+    peer_sig_map = bgpstream_peer_sig_map_create();
+    path_store = bgpstream_as_path_store_create();
+    CHECK("elem columns create",
+          peer_sig_map != NULL && path_store != NULL &&
+            (all = bgpstream_elem_columns_create(MAX_ELEMS, peer_sig_map,
+                                                 path_store)) != NULL);
+
+    CHECK("elem count (columns)", read_elem_columns(all, size) == 8);
+
+    v4_cnt = 0;
+    for (i = 0; i < all->cnt; i++) {
+      CHECK("column type", all->type[i] == BGPSTREAM_ELEM_TYPE_RIB);
+      CHECK("column time", all->time_sec[i] == RIB_TIME);
+      CHECK("column origin ASN", all->origin_asn[i] == 65100);
+      CHECK("column peer id", all->peer_id[i] != 0);
+      if (all->ip_version[i] == BGPSTREAM_ADDR_VERSION_IPV4) {
+        v4_cnt++;
+      }
+    }
+    CHECK("column IP versions", v4_cnt == 6);
+
+    // 10.0.0.0/8 from 65001
+    CHECK("column IPv4 prefix", all->pfx_ipv4[0] == htonl(0x0a000000) &&
+                                  all->mask_len[0] == 8 &&
+                                  all->peer_asn[0] == 65001);
+    // 2001:db8::/32
+    CHECK("column IPv6 prefix",
+          all->ip_version[6] == BGPSTREAM_ADDR_VERSION_IPV6 &&
+            all->pfx_ipv6[6].s6_addr[0] == 0x20 &&
+            all->pfx_ipv6[6].s6_addr[1] == 0x01 && all->mask_len[6] == 32);
+
+    // 192.168.0.0/24 from 65001 shares its peer and path with 10.0.0.0/8
+    CHECK("column shared peer id",
+          all->peer_asn[4] == 65001 && all->peer_id[4] == all->peer_id[0]);
+    CHECK("column shared path id",
+          memcmp(&all->path_id[4], &all->path_id[0],
+                 sizeof(bgpstream_as_path_store_path_id_t)) == 0);
+    CHECK("column distinct path id",
+          memcmp(&all->path_id[1], &all->path_id[0],
+                 sizeof(bgpstream_as_path_store_path_id_t)) != 0);
+
+    bgpstream_elem_columns_destroy(all);
+    bgpstream_as_path_store_destroy(path_store);
+    bgpstream_peer_sig_map_destroy(peer_sig_map);
+  }
+
+  remove(RIB_FILE);
+  return 0;
+}
+
+/* read the peer ASN of every elem in the RIB file, decoding up to
+   decode_ahead records in the background. returns the number of elems, or -1
+   on error */
+static int read_peer_asns(int decode_ahead, uint32_t *asns, int max)
+{
+  bgpstream_t *bs;
+  bgpstream_record_t *rec;
+  bgpstream_elem_t *elem;
+  bgpstream_data_interface_id_t di_id;
+  bgpstream_data_interface_option_t *option;
+  int ret;
+  int cnt = 0;
+
+  if ((bs = bgpstream_create()) == NULL) {
+    return -1;
+  }
+  di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile");
+  option =
+    bgpstream_get_data_interface_option_by_name(bs, di_id, "rib-file");
+  if (di_id == 0 || option == NULL) {
+    goto err;
+  }
+  bgpstream_set_data_interface(bs, di_id);
+  bgpstream_set_data_interface_option(bs, option, RIB_FILE);
+  bgpstream_set_decode_ahead(bs, decode_ahead);
+
+  if (bgpstream_start(bs) != 0) {
+    goto err;
+  }
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    while ((ret = bgpstream_record_get_next_elem(rec, &elem)) > 0) {
+      if (cnt == max) {
+        goto err;
+      }
+      asns[cnt++] = elem->peer_asn;
+    }
+    if (ret < 0) {
+      goto err;
+    }
+  }
+  if (ret < 0) {
+    goto err;
+  }
+
+  bgpstream_destroy(bs);
+  return cnt;
+
+err:
+  bgpstream_destroy(bs);
+  return -1;
+}
+
+int test_td2_peer_index_tables()
+{
+  static const uint32_t expected[] = {65001, 65002, 65003,
+                                      65011, 65012, 65013};
+  uint32_t asns[MAX_ELEMS];
+  int decode_ahead;
+  int i;
+
+  CHECK("write RIB file", write_two_table_file() == 0);
+
+  // with decode-ahead, the second table is read before the elems of the first
+  // RIB record are extracted
+  for (decode_ahead = 0; decode_ahead <= 4; decode_ahead += 4) {
+    CHECK("elem count",
+          read_peer_asns(decode_ahead, asns, MAX_ELEMS) ==
+            ARR_CNT(expected));
+    for (i = 0; i < ARR_CNT(expected); i++) {
+      CHECK("peer ASN from the current table", asns[i] == expected[i]);
+    }
+  }
+
+  remove(RIB_FILE);
+  return 0;
+}
+
+int main()
+{
+#ifdef WITH_DATA_INTERFACE_SINGLEFILE
+  CHECK_SECTION("TABLE_DUMP_V2 elem filters", test_td2_filters() == 0);
+  CHECK_SECTION("TABLE_DUMP_V2 lazy path attributes",
+                test_td2_lazy_attrs() == 0);
+  CHECK_SECTION("TABLE_DUMP_V2 elem batches", test_td2_elem_batches() == 0);
+  CHECK_SECTION("TABLE_DUMP_V2 elem columns", test_td2_elem_columns() == 0);
+  CHECK_SECTION("TABLE_DUMP_V2 peer index tables",
+                test_td2_peer_index_tables() == 0);
+#else
+  SKIPPED_SECTION("TABLE_DUMP_V2 elem filters");
+  SKIPPED_SECTION("TABLE_DUMP_V2 lazy path attributes");
+  SKIPPED_SECTION("TABLE_DUMP_V2 elem batches");
+  SKIPPED_SECTION("TABLE_DUMP_V2 elem columns");
+  SKIPPED_SECTION("TABLE_DUMP_V2 peer index tables");
+#endif
+
+  return 0;
+}
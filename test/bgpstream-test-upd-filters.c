@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2016 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+#include "bgpstream_test_mrt.h"
+
+#include "utils.h"
+
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Tests that the elem filters that the formats check for each NLRI of an
+ * UPDATE (elem type, IP version and prefix) select the right announcements
+ * and withdrawals, and that the path attributes are still extracted when the
+ * first announcements of the UPDATE are filtered out, or were appended to
+ * elem columns. A single BGP4MP UPDATE is written to disk and then read back
+ * through the singlefile data interface with different filters. */
+
+#define UPD_FILE "upd-filters.mrt"
+#define UPD_TIME 1427846400
+
+#define ELEM_STR_LEN 256
+#define MAX_ELEMS 16
+
+/* the UPDATE of put_test_update, as a BGP4MP message */
+static int write_upd_file()
+{
+  static struct buf out;
+  struct buf msg = {{0}, 0};
+
+  // BGP4MP header: peer and local ASNs, interface, AFI, peer and local IPs
+  put32(&msg, 65001);
+  put32(&msg, 65000);
+  put16(&msg, 0);
+  put16(&msg, 1);
+  put32(&msg, 0xc0000201);
+  put32(&msg, 0xc00002fe);
+  put_test_update(&msg);
+
+  out.len = 0;
+  put_mrt_header(&out, UPD_TIME, MRT_TYPE_BGP4MP, BGP4MP_MESSAGE_AS4,
+                 msg.len);
+  put_buf(&out, &msg);
+
+  return write_file(UPD_FILE, &out);
+}
+
+/* describe an elem as "A|prefix|next-hop|AS path|communities" for an
+ * announcement or "W|prefix" for a withdrawal */
+static int elem_str(char *buf, size_t len, bgpstream_elem_t *elem)
+{
+  char pfx[INET6_ADDRSTRLEN + 4];
+  char nh[INET6_ADDRSTRLEN];
+  char path[64];
+  char comms[64];
+
+  if (bgpstream_pfx_snprintf(pfx, sizeof(pfx),
+                             (bgpstream_pfx_t *)&elem->prefix) == NULL) {
+    return -1;
+  }
+  if (elem->type == BGPSTREAM_ELEM_TYPE_WITHDRAWAL) {
+    snprintf(buf, len, "W|%s", pfx);
+    return 0;
+  }
+  if (elem->type != BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT ||
+      bgpstream_addr_ntop(nh, sizeof(nh), &elem->nexthop) == NULL ||
+      bgpstream_as_path_snprintf(path, sizeof(path),
+                                 bgpstream_elem_get_as_path(elem)) < 0 ||
+      bgpstream_community_set_snprintf(
+        comms, sizeof(comms), bgpstream_elem_get_communities(elem)) < 0) {
+    return -1;
+  }
+  snprintf(buf, len, "A|%s|%s|%s|%s", pfx, nh, path, comms);
+  return 0;
+}
+
+/* describe every elem in the UPDATE file that passes the given filters (or
+   every elem if filter_type is 0). returns the number of elems, or -1 on
+   error */
+static int read_elem_strs(int lazy, bgpstream_filter_type_t filter_type,
+                          const char *value,
+                          bgpstream_filter_type_t filter_type2,
+                          const char *value2, char strs[][ELEM_STR_LEN])
+{
+  bgpstream_t *bs;
+  bgpstream_record_t *rec;
+  bgpstream_elem_t *elem;
+  bgpstream_data_interface_id_t di_id;
+  bgpstream_data_interface_option_t *option;
+  int ret;
+  int cnt = 0;
+
+  if ((bs = bgpstream_create()) == NULL) {
+    return -1;
+  }
+  di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile");
+  option =
+    bgpstream_get_data_interface_option_by_name(bs, di_id, "upd-file");
+  if (di_id == 0 || option == NULL) {
+    goto err;
+  }
+  bgpstream_set_data_interface(bs, di_id);
+  bgpstream_set_data_interface_option(bs, option, UPD_FILE);
+  if (lazy != 0) {
+    bgpstream_set_lazy_elem_attrs(bs);
+  }
+
+  if (filter_type != 0) {
+    bgpstream_add_filter(bs, filter_type, value);
+  }
+  if (filter_type2 != 0) {
+    bgpstream_add_filter(bs, filter_type2, value2);
+  }
+
+  if (bgpstream_start(bs) != 0) {
+    goto err;
+  }
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    while ((ret = bgpstream_record_get_next_elem(rec, &elem)) > 0) {
+      if (cnt == MAX_ELEMS || elem_str(strs[cnt], ELEM_STR_LEN, elem) != 0) {
+        goto err;
+      }
+      cnt++;
+    }
+    if (ret < 0) {
+      goto err;
+    }
+  }
+  if (ret < 0) {
+    goto err;
+  }
+
+  bgpstream_destroy(bs);
+  return cnt;
+
+err:
+  bgpstream_destroy(bs);
+  return -1;
+}
+
+/* check that the elems that pass the filters are exactly the expected ones,
+   in order, both with and without lazy path attributes */
+static int check_elems(bgpstream_filter_type_t filter_type, const char *value,
+                       bgpstream_filter_type_t filter_type2,
+                       const char *value2, const char **expected,
+                       int expected_cnt)
+{
+  static char strs[MAX_ELEMS][ELEM_STR_LEN];
+  int lazy;
+  int cnt;
+  int i;
+
+  for (lazy = 0; lazy <= 1; lazy++) {
+    cnt = read_elem_strs(lazy, filter_type, value, filter_type2, value2, strs);
+    if (cnt != expected_cnt) {
+      fprintf(stderr, " ! Expected %d elems, got %d\n", expected_cnt, cnt);
+      return -1;
+    }
+    for (i = 0; i < cnt; i++) {
+      if (strcmp(strs[i], expected[i]) != 0) {
+        fprintf(stderr, " ! Expected elem '%s', got '%s'\n", expected[i],
+                strs[i]);
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+#define ANN(pfx, nh) "A|" pfx "|" nh "|65001 65100|65001:100"
+#define ANN4(pfx) ANN(pfx, "192.0.2.1")
+#define ANN6(pfx) ANN(pfx, "2001:db8::1")
+#define WDR(pfx) "W|" pfx
+
+#define CHECK_ELEMS(name, type, value, type2, value2, ...)                     \
+  do {                                                                         \
+    static const char *expected[] = {__VA_ARGS__};                             \
+    CHECK(name, check_elems(type, value, type2, value2, expected,              \
+                            ARR_CNT(expected)) == 0);                          \
+  } while (0)
+
+int test_upd_filters()
+{
+  CHECK("write UPDATE file", write_upd_file() == 0);
+
+  CHECK_ELEMS("no filters", 0, NULL, 0, NULL, WDR("10.2.0.0/16"),
+              WDR("172.16.0.0/12"), WDR("2001:db8:1::/48"),
+              ANN4("192.168.0.0/24"), ANN4("10.0.0.0/8"), ANN4("10.1.0.0/16"),
+              ANN6("2001:db8::/32"), ANN6("2001:db8:2::/48"));
+
+  // the first announcement of the UPDATE is filtered out, so the path
+  // attributes must be extracted for the second one
+  CHECK_ELEMS("prefix filter (more specifics)",
+              BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_MORE, "10.0.0.0/8", 0, NULL,
+              WDR("10.2.0.0/16"), ANN4("10.0.0.0/8"), ANN4("10.1.0.0/16"));
+  CHECK_ELEMS("prefix filter (exact)",
+              BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_EXACT, "10.1.0.0/16", 0, NULL,
+              ANN4("10.1.0.0/16"));
+  CHECK_ELEMS("prefix filter (less specifics)",
+              BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_LESS, "10.2.3.0/24", 0, NULL,
+              WDR("10.2.0.0/16"), ANN4("10.0.0.0/8"));
+  CHECK("prefix filter (no match)",
+        check_elems(BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_ANY, "203.0.113.0/24", 0,
+                    NULL, NULL, 0) == 0);
+
+  // all IPv4 announcements are filtered out, so the path attributes must be
+  // extracted for the first IPv6 one
+  CHECK_ELEMS("prefix filter (IPv6)", BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_ANY,
+              "2001:db8::/32", 0, NULL, WDR("2001:db8:1::/48"),
+              ANN6("2001:db8::/32"), ANN6("2001:db8:2::/48"));
+  CHECK_ELEMS("IP version filter (IPv6)",
+              BGPSTREAM_FILTER_TYPE_ELEM_IP_VERSION, "6", 0, NULL,
+              WDR("2001:db8:1::/48"), ANN6("2001:db8::/32"),
+              ANN6("2001:db8:2::/48"));
+
+  CHECK_ELEMS("prefix and elem type filters (withdrawals)",
+              BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_MORE, "10.0.0.0/8",
+              BGPSTREAM_FILTER_TYPE_ELEM_TYPE, "withdrawals",
+              WDR("10.2.0.0/16"));
+  CHECK_ELEMS("prefix and elem type filters (announcements)",
+              BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_ANY, "2001:db8:2::/48",
+              BGPSTREAM_FILTER_TYPE_ELEM_TYPE, "announcements",
+              ANN6("2001:db8:2::/48"));
+
+  remove(UPD_FILE);
+  return 0;
+}
+
+/* fill a 4-row columnar batch from the UPDATE (which stops at the first
+   announcement), and then read the remaining elems one at a time. returns the
+   number of elems read one at a time, or -1 on error */
+static int read_columns_then_elems(bgpstream_elem_columns_t *cols)
+{
+  bgpstream_t *bs;
+  bgpstream_record_t *rec;
+  bgpstream_elem_t *elem;
+  bgpstream_data_interface_id_t di_id;
+  bgpstream_data_interface_option_t *option;
+  char path[64];
+  int cnt = 0;
+  int ret;
+
+  if ((bs = bgpstream_create()) == NULL) {
+    return -1;
+  }
+  di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile");
+  option =
+    bgpstream_get_data_interface_option_by_name(bs, di_id, "upd-file");
+  if (di_id == 0 || option == NULL) {
+    goto err;
+  }
+  bgpstream_set_data_interface(bs, di_id);
+  bgpstream_set_data_interface_option(bs, option, UPD_FILE);
+
+  if (bgpstream_start(bs) != 0 || bgpstream_get_next_record(bs, &rec) <= 0 ||
+      rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD ||
+      bgpstream_record_get_elem_columns(rec, cols) != 1) {
+    goto err;
+  }
+
+  // without lazy attributes, the AS path and communities of the elems can be
+  // read directly, even though the columns were filled lazily
+  while ((ret = bgpstream_record_get_next_elem(rec, &elem)) > 0) {
+    if (elem->type != BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT ||
+        bgpstream_as_path_snprintf(path, sizeof(path), elem->as_path) < 0 ||
+        strcmp(path, "65001 65100") != 0 ||
+        bgpstream_community_set_size(elem->communities) != 1) {
+      goto err;
+    }
+    cnt++;
+  }
+  if (ret < 0) {
+    goto err;
+  }
+
+  bgpstream_destroy(bs);
+  return cnt;
+
+err:
+  bgpstream_destroy(bs);
+  return -1;
+}
+
+int test_upd_elem_columns()
+{
+  bgpstream_elem_columns_t *cols;
+  int cnt;
+
+  CHECK("write UPDATE file", write_upd_file() == 0);
+  CHECK("elem columns create",
+        (cols = bgpstream_elem_columns_create(4, NULL, NULL)) != NULL);
+
+  cnt = read_columns_then_elems(cols);
+  CHECK("elem count (columns, then elems)", cols->cnt == 4 && cnt == 4);
+  CHECK("withdrawal columns",
+        cols->type[0] == BGPSTREAM_ELEM_TYPE_WITHDRAWAL &&
+          cols->mask_len[0] == 16 && cols->origin_asn[0] == 0);
+  CHECK("announcement columns",
+        cols->type[3] == BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT &&
+          cols->ip_version[3] == 4 && cols->mask_len[3] == 24 &&
+          cols->origin_asn[3] == 65100);
+
+  bgpstream_elem_columns_destroy(cols);
+  remove(UPD_FILE);
+  return 0;
+}
+
+int main()
+{
+#ifdef WITH_DATA_INTERFACE_SINGLEFILE
+  CHECK_SECTION("UPDATE elem filters", test_upd_filters() == 0);
+  CHECK_SECTION("UPDATE elem columns", test_upd_elem_columns() == 0);
+#else
+  SKIPPED_SECTION("UPDATE elem filters");
+  SKIPPED_SECTION("UPDATE elem columns");
+#endif
+
+  return 0;
+}
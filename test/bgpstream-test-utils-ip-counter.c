@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2015 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int add_pfx(bgpstream_ip_counter_t *ipc, const char *str, int append)
+{
+  bgpstream_pfx_storage_t pfx;
+  if (bgpstream_str2pfx(str, &pfx) == NULL) {
+    return -1;
+  }
+  if (append) {
+    return bgpstream_ip_counter_append(ipc, (bgpstream_pfx_t *)&pfx);
+  }
+  return bgpstream_ip_counter_add(ipc, (bgpstream_pfx_t *)&pfx);
+}
+
+static uint64_t overlap(bgpstream_ip_counter_t *ipc, const char *str,
+                        uint8_t *more_specific)
+{
+  bgpstream_pfx_storage_t pfx;
+  bgpstream_str2pfx(str, &pfx);
+  return bgpstream_ip_counter_is_overlapping(ipc, (bgpstream_pfx_t *)&pfx,
+                                             more_specific);
+}
+
+static const char *v4_pfxs[] = {
+  "10.0.0.0/24", "10.0.1.0/24", "10.0.0.128/25", "192.168.0.0/16",
+  "192.168.10.0/24", "10.0.0.0/23", "172.16.0.0/30", NULL,
+};
+
+static int test_ip_counter_ipv4(int append)
+{
+  bgpstream_ip_counter_t *ipc;
+  uint8_t ms;
+  int i;
+
+  CHECK("IPv4 ip counter create",
+        (ipc = bgpstream_ip_counter_create()) != NULL);
+
+  for (i = 0; v4_pfxs[i] != NULL; i++) {
+    CHECK("IPv4 ip counter add", add_pfx(ipc, v4_pfxs[i], append) == 0);
+  }
+  if (append) {
+    bgpstream_ip_counter_normalize(ipc);
+  }
+
+  /* 10.0.0.0/23 + 192.168.0.0/16 + 172.16.0.0/30 */
+  CHECK("IPv4 ip count",
+        bgpstream_ip_counter_get_ipcount(ipc, BGPSTREAM_ADDR_VERSION_IPV4) ==
+          512 + 65536 + 4);
+  CHECK("IPv4 ip count (no IPv6)",
+        bgpstream_ip_counter_get_ipcount(ipc, BGPSTREAM_ADDR_VERSION_IPV6) ==
+          0);
+
+  CHECK("IPv4 overlap (more specific)",
+        overlap(ipc, "10.0.1.64/26", &ms) == 64 && ms == 1);
+  CHECK("IPv4 overlap (less specific)",
+        overlap(ipc, "10.0.0.0/8", &ms) == 512 && ms == 0);
+  CHECK("IPv4 overlap (spanning)",
+        overlap(ipc, "172.16.0.0/24", &ms) == 4 && ms == 0);
+  CHECK("IPv4 overlap (none)",
+        overlap(ipc, "8.8.8.0/24", &ms) == 0 && ms == 0);
+  CHECK("IPv4 overlap (everything)",
+        overlap(ipc, "0.0.0.0/0", &ms) == 512 + 65536 + 4);
+
+  bgpstream_ip_counter_clear(ipc);
+  CHECK("IPv4 ip counter clear",
+        bgpstream_ip_counter_get_ipcount(ipc, BGPSTREAM_ADDR_VERSION_IPV4) ==
+          0);
+
+  bgpstream_ip_counter_destroy(ipc);
+  return 0;
+}
+
+static int test_ip_counter_ipv6()
+{
+  bgpstream_ip_counter_t *ipc;
+  uint8_t ms;
+
+  CHECK("IPv6 ip counter create",
+        (ipc = bgpstream_ip_counter_create()) != NULL);
+
+  CHECK("IPv6 ip counter add",
+        add_pfx(ipc, "2001:db8::/48", 0) == 0 &&
+          add_pfx(ipc, "2001:db8:0:1::/64", 0) == 0 &&
+          add_pfx(ipc, "2001:db8:1::/96", 0) == 0 &&
+          add_pfx(ipc, "2001:db8:1:0:8000::/65", 0) == 0 &&
+          add_pfx(ipc, "2001:db8:2::/63", 1) == 0);
+
+  /* counted in /64s: 65536 + 1 + 2 */
+  CHECK("IPv6 ip count",
+        bgpstream_ip_counter_get_ipcount(ipc, BGPSTREAM_ADDR_VERSION_IPV6) ==
+          65536 + 1 + 2);
+
+  CHECK("IPv6 overlap (more specific)",
+        overlap(ipc, "2001:db8:0:ff00::/56", &ms) == 256 && ms == 1);
+  CHECK("IPv6 overlap (less specific)",
+        overlap(ipc, "2001:db8::/32", &ms) == 65536 + 1 + 2 && ms == 0);
+
+  bgpstream_ip_counter_destroy(ipc);
+  return 0;
+}
+
+/* build the same counter with add and with append + normalize */
+static int test_ip_counter_bulk()
+{
+  bgpstream_ip_counter_t *inc;
+  bgpstream_ip_counter_t *bulk;
+  bgpstream_pfx_storage_t pfx;
+  uint8_t ms_inc, ms_bulk;
+  int failed = 0;
+  int i;
+
+  inc = bgpstream_ip_counter_create();
+  bulk = bgpstream_ip_counter_create();
+  CHECK("IP counter create", inc != NULL && bulk != NULL);
+
+  srand(42);
+  for (i = 0; i < 10000; i++) {
+    pfx.address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+    pfx.address.ipv4.s_addr = (uint32_t)rand() ^ ((uint32_t)rand() << 16);
+    pfx.mask_len = 8 + rand() % 25;
+    if (bgpstream_ip_counter_add(inc, (bgpstream_pfx_t *)&pfx) != 0 ||
+        bgpstream_ip_counter_append(bulk, (bgpstream_pfx_t *)&pfx) != 0) {
+      failed = 1;
+    }
+
+    /* IPv6 prefixes within 2001:db8::/32, so that they overlap */
+    pfx.address.version = BGPSTREAM_ADDR_VERSION_IPV6;
+    memset(&pfx.address.ipv6, 0, sizeof(pfx.address.ipv6));
+    pfx.address.ipv6.s6_addr[0] = 0x20;
+    pfx.address.ipv6.s6_addr[1] = 0x01;
+    pfx.address.ipv6.s6_addr[2] = 0x0d;
+    pfx.address.ipv6.s6_addr[3] = 0xb8;
+    pfx.address.ipv6.s6_addr[4] = rand();
+    pfx.address.ipv6.s6_addr[5] = rand();
+    pfx.address.ipv6.s6_addr[6] = rand();
+    pfx.mask_len = 32 + rand() % 33;
+    if (bgpstream_ip_counter_add(inc, (bgpstream_pfx_t *)&pfx) != 0 ||
+        bgpstream_ip_counter_append(bulk, (bgpstream_pfx_t *)&pfx) != 0) {
+      failed = 1;
+    }
+
+    /* an occasional query merges the prefixes added to inc so far, while
+     * those appended to bulk are only merged at the end */
+    if (i % 1000 == 999) {
+      bgpstream_ip_counter_get_ipcount(inc, BGPSTREAM_ADDR_VERSION_IPV4);
+      bgpstream_ip_counter_get_ipcount(inc, BGPSTREAM_ADDR_VERSION_IPV6);
+    }
+  }
+  CHECK("IP counter add and append", failed == 0);
+
+  CHECK("IP counter bulk ip count",
+        bgpstream_ip_counter_get_ipcount(inc, BGPSTREAM_ADDR_VERSION_IPV4) ==
+          bgpstream_ip_counter_get_ipcount(bulk, BGPSTREAM_ADDR_VERSION_IPV4));
+  CHECK("IP counter bulk ip count (IPv6)",
+        bgpstream_ip_counter_get_ipcount(inc, BGPSTREAM_ADDR_VERSION_IPV6) ==
+          bgpstream_ip_counter_get_ipcount(bulk, BGPSTREAM_ADDR_VERSION_IPV6));
+
+  for (i = 0; i < 1000; i++) {
+    pfx.address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+    pfx.address.ipv4.s_addr = (uint32_t)rand() ^ ((uint32_t)rand() << 16);
+    pfx.mask_len = rand() % 33;
+    if (bgpstream_ip_counter_is_overlapping(inc, (bgpstream_pfx_t *)&pfx,
+                                            &ms_inc) !=
+          bgpstream_ip_counter_is_overlapping(bulk, (bgpstream_pfx_t *)&pfx,
+                                              &ms_bulk) ||
+        ms_inc != ms_bulk) {
+      failed = 1;
+    }
+  }
+  CHECK("IP counter bulk overlap", failed == 0);
+
+  bgpstream_ip_counter_destroy(inc);
+  bgpstream_ip_counter_destroy(bulk);
+  return 0;
+}
+
+static int test_ip_counter_slash24()
+{
+  bgpstream_ip_counter_t *ipc;
+  uint8_t ms;
+
+  CHECK("IPv4 /24 ip counter create",
+        (ipc = bgpstream_ip_counter_create_slash24()) != NULL);
+
+  CHECK("IPv4 /24 ip counter add",
+        add_pfx(ipc, "10.0.0.0/23", 0) == 0 &&
+          add_pfx(ipc, "192.168.0.0/16", 1) == 0 &&
+          add_pfx(ipc, "172.16.0.0/30", 0) == 0 &&
+          add_pfx(ipc, "172.16.0.128/25", 0) == 0);
+
+  /* the /30 and the /25 mark the same /24 */
+  CHECK("IPv4 /24 ip count",
+        bgpstream_ip_counter_get_ipcount(ipc, BGPSTREAM_ADDR_VERSION_IPV4) ==
+          (2 + 256 + 1) * 256);
+
+  CHECK("IPv4 /24 overlap (more specific)",
+        overlap(ipc, "172.16.0.64/26", &ms) == 64 && ms == 1);
+  CHECK("IPv4 /24 overlap (less specific)",
+        overlap(ipc, "10.0.0.0/8", &ms) == 512 && ms == 0);
+  CHECK("IPv4 /24 overlap (none)",
+        overlap(ipc, "8.8.8.0/24", &ms) == 0 && ms == 0);
+  CHECK("IPv4 /24 overlap (everything)",
+        overlap(ipc, "0.0.0.0/0", &ms) == (2 + 256 + 1) * 256);
+
+  bgpstream_ip_counter_clear(ipc);
+  CHECK("IPv4 /24 ip counter clear",
+        bgpstream_ip_counter_get_ipcount(ipc, BGPSTREAM_ADDR_VERSION_IPV4) ==
+            0 &&
+          overlap(ipc, "0.0.0.0/0", &ms) == 0);
+
+  bgpstream_ip_counter_destroy(ipc);
+  return 0;
+}
+
+static bgpstream_ip_counter_t *create_counter(int slash24)
+{
+  return slash24 ? bgpstream_ip_counter_create_slash24()
+                 : bgpstream_ip_counter_create();
+}
+
+/* check the set operations on both kinds of counters against
+ * |A u B| + |A n B| = |A| + |B| and |A \ B| = |A| - |A n B| */
+static int test_ip_counter_set_ops(int slash24)
+{
+  bgpstream_ip_counter_t *a = create_counter(slash24);
+  bgpstream_ip_counter_t *b = create_counter(slash24);
+  bgpstream_ip_counter_t *u = create_counter(slash24);
+  bgpstream_ip_counter_t *n = create_counter(slash24);
+  bgpstream_ip_counter_t *d = create_counter(slash24);
+  bgpstream_ip_counter_t *other = create_counter(!slash24);
+  bgpstream_pfx_storage_t pfx;
+  bgpstream_addr_version_t versions[] = {BGPSTREAM_ADDR_VERSION_IPV4,
+                                         BGPSTREAM_ADDR_VERSION_IPV6};
+  bgpstream_addr_version_t v;
+  uint64_t ca, cb, cu, cn, cd;
+  int i;
+
+  CHECK("IP counter create",
+        a != NULL && b != NULL && u != NULL && n != NULL && d != NULL &&
+          other != NULL);
+
+  srand(24);
+  for (i = 0; i < 2000; i++) {
+    if (i % 2 == 0) {
+      pfx.address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+      pfx.address.ipv4.s_addr = (uint32_t)rand() ^ ((uint32_t)rand() << 16);
+      pfx.mask_len = 8 + rand() % 17;
+    } else {
+      memset(&pfx.address.ipv6, 0, sizeof(pfx.address.ipv6));
+      pfx.address.version = BGPSTREAM_ADDR_VERSION_IPV6;
+      pfx.address.ipv6.s6_addr[0] = 0x20;
+      pfx.address.ipv6.s6_addr[1] = 0x01;
+      pfx.address.ipv6.s6_addr[4] = rand();
+      pfx.address.ipv6.s6_addr[5] = rand();
+      pfx.mask_len = 24 + rand() % 41;
+    }
+    bgpstream_ip_counter_add((i % 3) ? a : b, (bgpstream_pfx_t *)&pfx);
+  }
+
+  CHECK("IP counter union",
+        bgpstream_ip_counter_union(u, a) == 0 &&
+          bgpstream_ip_counter_union(u, b) == 0);
+  CHECK("IP counter intersect",
+        bgpstream_ip_counter_union(n, a) == 0 &&
+          bgpstream_ip_counter_intersect(n, b) == 0);
+  CHECK("IP counter subtract",
+        bgpstream_ip_counter_union(d, a) == 0 &&
+          bgpstream_ip_counter_subtract(d, b) == 0);
+  CHECK("IP counter set op (mismatched modes)",
+        bgpstream_ip_counter_union(other, a) != 0);
+
+  for (i = 0; i < 2; i++) {
+    v = versions[i];
+    ca = bgpstream_ip_counter_get_ipcount(a, v);
+    cb = bgpstream_ip_counter_get_ipcount(b, v);
+    cu = bgpstream_ip_counter_get_ipcount(u, v);
+    cn = bgpstream_ip_counter_get_ipcount(n, v);
+    cd = bgpstream_ip_counter_get_ipcount(d, v);
+    CHECK("IP counter set op counts",
+          cn > 0 && cu + cn == ca + cb && cd == ca - cn);
+  }
+
+  /* the intersection with the difference is empty */
+  CHECK("IP counter intersect (disjoint)",
+        bgpstream_ip_counter_intersect(d, b) == 0 &&
+          bgpstream_ip_counter_get_ipcount(d, BGPSTREAM_ADDR_VERSION_IPV4) ==
+            0 &&
+          bgpstream_ip_counter_get_ipcount(d, BGPSTREAM_ADDR_VERSION_IPV6) ==
+            0);
+
+  /* disjoint IPv4 prefixes must not affect the intersection of the IPv6
+   * prefixes */
+  bgpstream_ip_counter_clear(a);
+  bgpstream_ip_counter_clear(b);
+  CHECK("IP counter intersect (disjoint IPv4)",
+        add_pfx(a, "10.0.0.0/16", 0) == 0 &&
+          add_pfx(a, "2001:db8::/32", 0) == 0 &&
+          add_pfx(b, "192.168.0.0/16", 0) == 0 &&
+          add_pfx(b, "2001:db8:1::/48", 0) == 0 &&
+          bgpstream_ip_counter_intersect(a, b) == 0 &&
+          bgpstream_ip_counter_get_ipcount(a, BGPSTREAM_ADDR_VERSION_IPV4) ==
+            0 &&
+          bgpstream_ip_counter_get_ipcount(a, BGPSTREAM_ADDR_VERSION_IPV6) ==
+            (1 << 16));
+
+  /* as must an empty IPv4 side */
+  bgpstream_ip_counter_clear(a);
+  bgpstream_ip_counter_clear(b);
+  CHECK("IP counter intersect (no IPv4)",
+        add_pfx(a, "10.0.0.0/16", 0) == 0 &&
+          add_pfx(a, "2001:db8::/32", 0) == 0 &&
+          add_pfx(b, "2001:db8::/40", 0) == 0 &&
+          bgpstream_ip_counter_intersect(a, b) == 0 &&
+          bgpstream_ip_counter_get_ipcount(a, BGPSTREAM_ADDR_VERSION_IPV4) ==
+            0 &&
+          bgpstream_ip_counter_get_ipcount(a, BGPSTREAM_ADDR_VERSION_IPV6) ==
+            (1 << 24));
+
+  bgpstream_ip_counter_destroy(a);
+  bgpstream_ip_counter_destroy(b);
+  bgpstream_ip_counter_destroy(u);
+  bgpstream_ip_counter_destroy(n);
+  bgpstream_ip_counter_destroy(d);
+  bgpstream_ip_counter_destroy(other);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("IPv4 ip counter", test_ip_counter_ipv4(0) == 0);
+  CHECK_SECTION("IPv4 ip counter (append)", test_ip_counter_ipv4(1) == 0);
+  CHECK_SECTION("IPv6 ip counter", test_ip_counter_ipv6() == 0);
+  CHECK_SECTION("IP counter bulk", test_ip_counter_bulk() == 0);
+  CHECK_SECTION("IPv4 /24 ip counter", test_ip_counter_slash24() == 0);
+  CHECK_SECTION("IP counter set operations", test_ip_counter_set_ops(0) == 0);
+  CHECK_SECTION("IPv4 /24 ip counter set operations",
+                test_ip_counter_set_ops(1) == 0);
+
+  return 0;
+}
@@ -176,8 +176,288 @@ int test_patricia()
   return 0;
 }
 
+#define LOOKUP_TEST_PFX_CNT 50
+#define LOOKUP_TEST_QUERY_CNT 20000
+
+/* build a random IPv4 prefix inside 10.0.0.0/8 */
+static void random_pfx(bgpstream_pfx_storage_t *pfx, int min_len)
+{
+  int mask_len = min_len + (rand() % (33 - min_len));
+  uint32_t addr = (10u << 24) | (rand() & 0xffffff);
+  char buf[INET_ADDRSTRLEN + 3];
+
+  addr &= ~(uint32_t)0 << (32 - mask_len);
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u/%d", addr >> 24, (addr >> 16) & 0xff,
+           (addr >> 8) & 0xff, addr & 0xff, mask_len);
+  bgpstream_str2pfx(buf, pfx);
+}
+
+int test_patricia_lookup()
+{
+  bgpstream_patricia_tree_t *pt;
+  bgpstream_pfx_storage_t pfxs[LOOKUP_TEST_PFX_CNT];
+  bgpstream_pfx_storage_t q;
+  bgpstream_pfx_t *p;
+  bgpstream_pfx_t *best;
+  bgpstream_patricia_node_t *node;
+  uint64_t v4_cnt;
+  uint8_t mask;
+  int matched;
+  int i, j;
+  int cnt = 0;
+  int ok = 1;
+
+  srand(1);
+
+  CHECK("Create Patricia Tree",
+        (pt = bgpstream_patricia_tree_create(NULL)) != NULL);
+
+  /* the tree keeps the first allowed_matches of a prefix inserted twice, so
+   * only keep unique prefixes in the reference list */
+  for (i = 0; i < LOOKUP_TEST_PFX_CNT; i++) {
+    /* mostly specific prefixes, with mostly restricted matches, so that the
+     * outcome often depends on a single prefix */
+    random_pfx(&pfxs[cnt], 14);
+    pfxs[cnt].allowed_matches = (rand() % 8) == 0
+                                  ? BGPSTREAM_PREFIX_MATCH_ANY
+                                  : BGPSTREAM_PREFIX_MATCH_EXACT + (rand() % 3);
+    if (bgpstream_patricia_tree_search_exact(
+          pt, (bgpstream_pfx_t *)&pfxs[cnt]) == NULL) {
+      if (bgpstream_patricia_tree_insert(
+            pt, (bgpstream_pfx_t *)&pfxs[cnt]) == NULL) {
+        ok = 0;
+      }
+      cnt++;
+    }
+  }
+  CHECK("Insert into Patricia Tree v4", ok);
+  v4_cnt = bgpstream_patricia_prefix_count(pt, BGPSTREAM_ADDR_VERSION_IPV4);
+
+  for (i = 0; i < LOOKUP_TEST_QUERY_CNT && ok; i++) {
+    random_pfx(&q, 8);
+
+    /* brute force over the reference list */
+    mask = 0;
+    matched = 0;
+    best = NULL;
+    for (j = 0; j < cnt; j++) {
+      p = (bgpstream_pfx_t *)&pfxs[j];
+      if (bgpstream_pfx_contains(p, (bgpstream_pfx_t *)&q)) {
+        if (best == NULL || p->mask_len > best->mask_len) {
+          best = p;
+        }
+        if (p->mask_len == q.mask_len) {
+          mask |= BGPSTREAM_PATRICIA_EXACT_MATCH;
+          matched = 1;
+        } else {
+          mask |= BGPSTREAM_PATRICIA_LESS_SPECIFICS;
+          if (p->allowed_matches == BGPSTREAM_PREFIX_MATCH_ANY ||
+              p->allowed_matches == BGPSTREAM_PREFIX_MATCH_MORE) {
+            matched = 1;
+          }
+        }
+      } else if (bgpstream_pfx_contains((bgpstream_pfx_t *)&q, p)) {
+        mask |= BGPSTREAM_PATRICIA_MORE_SPECIFICS;
+        if (p->allowed_matches == BGPSTREAM_PREFIX_MATCH_ANY ||
+            p->allowed_matches == BGPSTREAM_PREFIX_MATCH_LESS) {
+          matched = 1;
+        }
+      }
+    }
+
+    node = bgpstream_patricia_tree_search_best(pt, (bgpstream_pfx_t *)&q);
+    if (bgpstream_patricia_tree_lookup_overlap_info(
+          pt, (bgpstream_pfx_t *)&q) != mask ||
+        bgpstream_patricia_tree_get_pfx_overlap_info(
+          pt, (bgpstream_pfx_t *)&q) != mask ||
+        bgpstream_patricia_tree_lookup_match(pt, (bgpstream_pfx_t *)&q) !=
+          matched ||
+        (node == NULL) != (best == NULL) ||
+        (node != NULL &&
+         bgpstream_pfx_equal(bgpstream_patricia_tree_get_pfx(node), best) ==
+           0)) {
+      bgpstream_pfx_snprintf(buffer, BUFFER_LEN, (bgpstream_pfx_t *)&q);
+      fprintf(stderr, "   lookup of %s differs from brute force\n", buffer);
+      ok = 0;
+    }
+  }
+
+  CHECK("Patricia Tree v4 read-only lookups", ok);
+  CHECK("Patricia Tree v4 unmodified by lookups",
+        bgpstream_patricia_prefix_count(pt, BGPSTREAM_ADDR_VERSION_IPV4) ==
+          v4_cnt);
+
+  bgpstream_patricia_tree_destroy(pt);
+
+  return 0;
+}
+
+#define SUBNETS_TEST_PFX_CNT 400
+#define SUBNETS_TEST_OP_CNT 4000
+
+/* zero the bits of a prefix beyond the given mask length, and set it as the
+ * mask length */
+static void mask_pfx(bgpstream_pfx_storage_t *pfx, int mask_len)
+{
+  uint8_t *addr = (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4)
+                    ? (uint8_t *)&pfx->address.ipv4.s_addr
+                    : pfx->address.ipv6.s6_addr;
+  int len = (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) ? 4 : 16;
+  int i;
+
+  for (i = 0; i < len; i++) {
+    if (mask_len <= i * 8) {
+      addr[i] = 0;
+    } else if (mask_len < (i + 1) * 8) {
+      addr[i] &= 0xff << ((i + 1) * 8 - mask_len);
+    }
+  }
+  pfx->mask_len = mask_len;
+}
+
+/* build a random prefix inside 10.0.0.0/8 or 2001:db8::/32, with few enough
+ * distinct address bits that prefixes often overlap */
+static void random_subnets_pfx(bgpstream_pfx_storage_t *pfx)
+{
+  static const uint8_t ipv6_base[] = {0x20, 0x01, 0x0d, 0xb8};
+  int i;
+
+  memset(pfx, 0, sizeof(*pfx));
+  if (rand() % 2) {
+    pfx->address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+    pfx->address.ipv4.s_addr = htonl((10u << 24) | ((rand() % 4) << 22) |
+                                     ((rand() % 4) << 12) | (rand() % 4));
+    mask_pfx(pfx, 8 + rand() % 25);
+  } else {
+    pfx->address.version = BGPSTREAM_ADDR_VERSION_IPV6;
+    memcpy(pfx->address.ipv6.s6_addr, ipv6_base, sizeof(ipv6_base));
+    for (i = 4; i < 16; i++) {
+      pfx->address.ipv6.s6_addr[i] = (rand() % 3 == 0) ? rand() % 4 : 0;
+    }
+    mask_pfx(pfx, 32 + rand() % 97);
+  }
+}
+
+static int cmp_pfx(const void *a, const void *b)
+{
+  const bgpstream_pfx_storage_t *pa = a;
+  const bgpstream_pfx_storage_t *pb = b;
+  int rc;
+
+  if (pa->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
+    rc = memcmp(&pa->address.ipv4.s_addr, &pb->address.ipv4.s_addr, 4);
+  } else {
+    rc = memcmp(pa->address.ipv6.s6_addr, pb->address.ipv6.s6_addr, 16);
+  }
+  return (rc != 0) ? rc : pa->mask_len - pb->mask_len;
+}
+
+/* number of /subnet_size subnets covered by the given prefixes of version v:
+ * the prefixes are truncated to /subnet_size, sorted so that a prefix comes
+ * right before the ones it covers, and the subnets of the prefixes that are
+ * not covered are summed */
+static uint64_t count_subnets(bgpstream_pfx_storage_t *pfxs, int *present,
+                              int pfxs_cnt, bgpstream_addr_version_t v,
+                              int subnet_size)
+{
+  bgpstream_pfx_storage_t sorted[SUBNETS_TEST_PFX_CNT];
+  bgpstream_pfx_storage_t *last = NULL;
+  uint64_t cnt = 0;
+  int sorted_cnt = 0;
+  int i;
+
+  for (i = 0; i < pfxs_cnt; i++) {
+    if (present[i] && pfxs[i].address.version == v) {
+      sorted[sorted_cnt] = pfxs[i];
+      if (sorted[sorted_cnt].mask_len > subnet_size) {
+        mask_pfx(&sorted[sorted_cnt], subnet_size);
+      }
+      sorted_cnt++;
+    }
+  }
+  qsort(sorted, sorted_cnt, sizeof(bgpstream_pfx_storage_t), cmp_pfx);
+
+  for (i = 0; i < sorted_cnt; i++) {
+    if (last != NULL && bgpstream_pfx_contains((bgpstream_pfx_t *)last,
+                                               (bgpstream_pfx_t *)&sorted[i])) {
+      continue;
+    }
+    last = &sorted[i];
+    cnt += (uint64_t)1 << (subnet_size - last->mask_len);
+  }
+  return cnt;
+}
+
+int test_patricia_subnets()
+{
+  bgpstream_patricia_tree_t *pt;
+  bgpstream_pfx_storage_t pfxs[SUBNETS_TEST_PFX_CNT];
+  int present[SUBNETS_TEST_PFX_CNT];
+  int ok = 1;
+  int i, j;
+
+  srand(2);
+
+  CHECK("Create Patricia Tree",
+        (pt = bgpstream_patricia_tree_create(NULL)) != NULL);
+
+  /* only keep unique prefixes, so that each one is either in the tree or
+   * not */
+  for (i = 0; i < SUBNETS_TEST_PFX_CNT; i++) {
+    do {
+      random_subnets_pfx(&pfxs[i]);
+      for (j = 0; j < i; j++) {
+        if (bgpstream_pfx_equal((bgpstream_pfx_t *)&pfxs[i],
+                                (bgpstream_pfx_t *)&pfxs[j])) {
+          break;
+        }
+      }
+    } while (j < i);
+    present[i] = 0;
+  }
+
+  /* the counts are kept up to date as prefixes are added and removed (some
+   * of them twice, and some of them before they were ever added) */
+  for (i = 0; i < SUBNETS_TEST_OP_CNT && ok; i++) {
+    j = rand() % SUBNETS_TEST_PFX_CNT;
+    if (i < SUBNETS_TEST_PFX_CNT / 2 || rand() % 2) {
+      if (bgpstream_patricia_tree_insert(pt, (bgpstream_pfx_t *)&pfxs[j]) ==
+          NULL) {
+        ok = 0;
+      }
+    } else {
+      bgpstream_patricia_tree_remove(pt, (bgpstream_pfx_t *)&pfxs[j]);
+    }
+    present[j] = bgpstream_patricia_tree_search_exact(
+                   pt, (bgpstream_pfx_t *)&pfxs[j]) != NULL;
+
+    if (bgpstream_patricia_tree_count_24subnets(pt) !=
+          count_subnets(pfxs, present, SUBNETS_TEST_PFX_CNT,
+                        BGPSTREAM_ADDR_VERSION_IPV4, 24) ||
+        bgpstream_patricia_tree_count_64subnets(pt) !=
+          count_subnets(pfxs, present, SUBNETS_TEST_PFX_CNT,
+                        BGPSTREAM_ADDR_VERSION_IPV6, 64)) {
+      bgpstream_pfx_snprintf(buffer, BUFFER_LEN, (bgpstream_pfx_t *)&pfxs[j]);
+      fprintf(stderr, "   subnet counts wrong after updating %s\n", buffer);
+      ok = 0;
+    }
+  }
+  CHECK("Patricia Tree subnet counts after updates", ok);
+
+  bgpstream_patricia_tree_clear(pt);
+  CHECK("Patricia Tree subnet counts after clear",
+        bgpstream_patricia_tree_count_24subnets(pt) == 0 &&
+          bgpstream_patricia_tree_count_64subnets(pt) == 0);
+
+  bgpstream_patricia_tree_destroy(pt);
+
+  return 0;
+}
+
 int main()
 {
   CHECK_SECTION("Patricia Tree", test_patricia() == 0);
+  CHECK_SECTION("Patricia Tree lookups", test_patricia_lookup() == 0);
+  CHECK_SECTION("Patricia Tree subnet counts", test_patricia_subnets() == 0);
   return 0;
 }
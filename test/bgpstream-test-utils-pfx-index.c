@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2015 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LESS BGPSTREAM_PATRICIA_LESS_SPECIFICS
+#define EXACT BGPSTREAM_PATRICIA_EXACT_MATCH
+#define MORE BGPSTREAM_PATRICIA_MORE_SPECIFICS
+
+static const char *list_pfxs[] = {
+  "10.0.0.0/8",     "10.1.0.0/16",    "10.1.2.0/24",     "10.1.2.128/25",
+  "192.168.0.0/16", "10.1.0.0/16",    "172.16.0.0/12",   "2001:db8::/32",
+  "2001:db8::/48",  "2001:db8::1/128", "0.0.0.0/0",      NULL,
+};
+
+static int id_of(bgpstream_pfx_index_t *idx, const char *str, int best)
+{
+  bgpstream_pfx_storage_t pfx;
+  bgpstream_str2pfx(str, &pfx);
+  if (best) {
+    return bgpstream_pfx_index_lookup_best(idx, (bgpstream_pfx_t *)&pfx);
+  }
+  return bgpstream_pfx_index_lookup_exact(idx, (bgpstream_pfx_t *)&pfx);
+}
+
+static uint8_t overlap(bgpstream_pfx_index_t *idx, const char *str)
+{
+  bgpstream_pfx_storage_t pfx;
+  bgpstream_str2pfx(str, &pfx);
+  return bgpstream_pfx_index_lookup_overlap_info(idx, (bgpstream_pfx_t *)&pfx);
+}
+
+static int test_pfx_index_list()
+{
+  bgpstream_pfx_storage_t pfxs[32];
+  bgpstream_pfx_index_t *idx;
+  int cnt;
+
+  for (cnt = 0; list_pfxs[cnt] != NULL; cnt++) {
+    bgpstream_str2pfx(list_pfxs[cnt], &pfxs[cnt]);
+    pfxs[cnt].allowed_matches = BGPSTREAM_PREFIX_MATCH_ANY;
+  }
+
+  CHECK("Prefix index create", (idx = bgpstream_pfx_index_create(
+                                  pfxs, cnt)) != NULL);
+  CHECK("Prefix index size", bgpstream_pfx_index_size(idx) == cnt);
+
+  /* exact */
+  CHECK("Prefix index exact", id_of(idx, "10.1.2.0/24", 0) == 2);
+  CHECK("Prefix index exact (duplicate)", id_of(idx, "10.1.0.0/16", 0) == 1);
+  CHECK("Prefix index exact (host bits)", id_of(idx, "10.1.2.1/24", 0) == 2);
+  CHECK("Prefix index exact (default route)", id_of(idx, "0.0.0.0/0", 0) == 10);
+  CHECK("Prefix index exact (missing)", id_of(idx, "10.1.3.0/24", 0) == -1);
+  CHECK("Prefix index exact (IPv6)", id_of(idx, "2001:db8::1/128", 0) == 9);
+  CHECK("Prefix index exact (IPv6 missing)",
+        id_of(idx, "2001:db8::/64", 0) == -1);
+
+  /* longest match */
+  CHECK("Prefix index best", id_of(idx, "10.1.2.200/32", 1) == 3);
+  CHECK("Prefix index best (shorter)", id_of(idx, "10.1.2.0/26", 1) == 2);
+  CHECK("Prefix index best (default route)", id_of(idx, "11.0.0.0/8", 1) == 10);
+  CHECK("Prefix index best (IPv6)", id_of(idx, "2001:db8::2/128", 1) == 8);
+  CHECK("Prefix index best (IPv6 none)", id_of(idx, "2001:db9::/32", 1) == -1);
+  CHECK("Prefix index get pfx",
+        bgpstream_pfx_index_get_pfx(idx, 3)->mask_len == 25);
+  CHECK("Prefix index get user", bgpstream_pfx_index_get_user(idx, 3) == NULL);
+
+  /* covered-by and covers */
+  CHECK("Prefix index overlap exact",
+        overlap(idx, "10.1.0.0/16") == (LESS | EXACT | MORE));
+  CHECK("Prefix index overlap covered", overlap(idx, "10.2.0.0/16") == LESS);
+  CHECK("Prefix index overlap covers",
+        overlap(idx, "2001:db8::/16") == MORE);
+  CHECK("Prefix index overlap covered and covers",
+        overlap(idx, "10.1.2.0/23") == (LESS | MORE));
+  CHECK("Prefix index overlap none", overlap(idx, "2001:db9::/32") == 0);
+
+  bgpstream_pfx_index_destroy(idx);
+
+  CHECK("Empty prefix index create",
+        (idx = bgpstream_pfx_index_create(NULL, 0)) != NULL);
+  CHECK("Empty prefix index best", id_of(idx, "10.0.0.0/8", 1) == -1);
+  CHECK("Empty prefix index overlap", overlap(idx, "0.0.0.0/0") == 0);
+  bgpstream_pfx_index_destroy(idx);
+
+  return 0;
+}
+
+/* random prefix, with few enough distinct address bits that prefixes often
+ * overlap */
+static void rand_pfx(bgpstream_pfx_storage_t *pfx)
+{
+  int i;
+
+  memset(pfx, 0, sizeof(*pfx));
+  if (rand() % 4 == 0) {
+    pfx->address.version = BGPSTREAM_ADDR_VERSION_IPV6;
+    for (i = 0; i < 16; i++) {
+      pfx->address.ipv6.s6_addr[i] = (rand() % 4 == 0) ? rand() % 4 : 0;
+    }
+    pfx->mask_len = rand() % 129;
+  } else {
+    pfx->address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+    pfx->address.ipv4.s_addr = htonl(((uint32_t)(rand() % 8) << 29) |
+                                     ((uint32_t)(rand() % 8) << 16) |
+                                     (rand() % 4));
+    pfx->mask_len = rand() % 33;
+  }
+  pfx->allowed_matches = rand() % 4;
+}
+
+static int same_pfx(bgpstream_pfx_index_t *idx, int id,
+                    bgpstream_patricia_node_t *node)
+{
+  if (id < 0 || node == NULL) {
+    return id < 0 && node == NULL;
+  }
+  return bgpstream_pfx_equal(
+           (bgpstream_pfx_t *)bgpstream_pfx_index_get_pfx(idx, id),
+           bgpstream_patricia_tree_get_pfx(node)) &&
+         bgpstream_pfx_index_get_user(idx, id) ==
+           bgpstream_patricia_tree_get_user(node);
+}
+
+/* compare the index with the patricia tree it is built from, using either
+ * the given allowed_matches for all the prefixes, or random ones (if -1) */
+static int test_pfx_index_patricia(int allowed_matches)
+{
+  bgpstream_patricia_tree_t *pt;
+  bgpstream_patricia_node_t *node;
+  bgpstream_pfx_index_t *idx;
+  bgpstream_pfx_storage_t pfx;
+  int failed = 0;
+  int i;
+
+  CHECK("Patricia tree create",
+        (pt = bgpstream_patricia_tree_create(NULL)) != NULL);
+
+  srand(42);
+  for (i = 0; i < 2000; i++) {
+    rand_pfx(&pfx);
+    if (allowed_matches >= 0) {
+      pfx.allowed_matches = allowed_matches;
+    }
+    if ((node = bgpstream_patricia_tree_insert(
+           pt, (bgpstream_pfx_t *)&pfx)) == NULL) {
+      failed = 1;
+      break;
+    }
+    bgpstream_patricia_tree_set_user(pt, node, (void *)(intptr_t)(i + 1));
+  }
+  CHECK("Patricia tree insert", failed == 0);
+
+  CHECK("Prefix index create from patricia",
+        (idx = bgpstream_pfx_index_create_from_patricia(pt)) != NULL);
+
+  for (i = 0; i < 20000; i++) {
+    rand_pfx(&pfx);
+    if (!same_pfx(idx,
+                  bgpstream_pfx_index_lookup_exact(idx,
+                                                   (bgpstream_pfx_t *)&pfx),
+                  bgpstream_patricia_tree_search_exact(
+                    pt, (bgpstream_pfx_t *)&pfx)) ||
+        !same_pfx(idx,
+                  bgpstream_pfx_index_lookup_best(idx,
+                                                  (bgpstream_pfx_t *)&pfx),
+                  bgpstream_patricia_tree_search_best(
+                    pt, (bgpstream_pfx_t *)&pfx)) ||
+        bgpstream_pfx_index_lookup_overlap_info(idx,
+                                                (bgpstream_pfx_t *)&pfx) !=
+          bgpstream_patricia_tree_lookup_overlap_info(
+            pt, (bgpstream_pfx_t *)&pfx) ||
+        bgpstream_pfx_index_lookup_match(idx, (bgpstream_pfx_t *)&pfx) !=
+          bgpstream_patricia_tree_lookup_match(pt, (bgpstream_pfx_t *)&pfx)) {
+      failed = 1;
+    }
+  }
+  CHECK("Prefix index lookups match patricia lookups", failed == 0);
+
+  bgpstream_pfx_index_destroy(idx);
+  bgpstream_patricia_tree_destroy(pt);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("Prefix index from list", test_pfx_index_list() == 0);
+  CHECK_SECTION("Prefix index from patricia",
+                test_pfx_index_patricia(-1) == 0);
+  CHECK_SECTION("Prefix index from patricia (exact matches)",
+                test_pfx_index_patricia(BGPSTREAM_PREFIX_MATCH_EXACT) == 0);
+  CHECK_SECTION("Prefix index from patricia (more specific matches)",
+                test_pfx_index_patricia(BGPSTREAM_PREFIX_MATCH_MORE) == 0);
+  CHECK_SECTION("Prefix index from patricia (less specific matches)",
+                test_pfx_index_patricia(BGPSTREAM_PREFIX_MATCH_LESS) == 0);
+
+  return 0;
+}
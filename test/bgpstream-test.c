@@ -36,6 +36,14 @@
 #define csvfile_RECORDS 559424
 #define sqlite_RECORDS 538308
 #define broker_RECORDS 2153
+// unordered mode returns the same records, just not in time order
+#define csvfile_unordered_RECORDS csvfile_RECORDS
+// as does reading with a parse-buffer budget
+#define csvfile_budget_RECORDS csvfile_RECORDS
+// or with an opener thread pool
+#define csvfile_opener_RECORDS csvfile_RECORDS
+// number of resources in the csvfile stream
+#define csvfile_RESOURCES 2
 
 bgpstream_t *bs;
 bgpstream_record_t *rec;
@@ -77,6 +85,16 @@ bgpstream_data_interface_option_t *option;
     bgpstream_set_data_interface(bs, di_id);                                   \
   } while (0)
 
+#define SETUP_CSVFILE                                                          \
+  do {                                                                         \
+    CHECK_SET_INTERFACE(csvfile);                                              \
+    CHECK("get option (csv-file)",                                             \
+          (option = bgpstream_get_data_interface_option_by_name(               \
+             bs, di_id, "csv-file")) != NULL);                                 \
+    bgpstream_set_data_interface_option(bs, option, "csv_test.csv");           \
+    bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_COLLECTOR, "rrc06");        \
+  } while (0)
+
 int test_bgpstream()
 {
   CHECK("BGPStream create", (bs = bgpstream_create()) != NULL);
@@ -111,25 +129,220 @@ int test_singlefile()
   return 0;
 }
 
-int test_csvfile()
+/* number of valid records in the given updates file, or -1 if an error
+ * occurred */
+static int count_singlefile(const char *upd_file, int decompress_threads)
 {
+  int counter = 0;
+  int ret;
+
   SETUP;
 
-  CHECK_SET_INTERFACE(csvfile);
+  CHECK_SET_INTERFACE(singlefile);
 
-  CHECK("get option (csv-file)",
+  CHECK("get option (upd-file)",
         (option = bgpstream_get_data_interface_option_by_name(
-           bs, di_id, "csv-file")) != NULL);
-  bgpstream_set_data_interface_option(bs, option, "csv_test.csv");
+           bs, di_id, "upd-file")) != NULL);
+  CHECK("set option (upd-file)",
+        bgpstream_set_data_interface_option(bs, option, upd_file) == 0);
+
+  if (decompress_threads > 0) {
+    bgpstream_set_decompress_threads(bs, decompress_threads);
+  }
+
+  CHECK("stream start (singlefile_decompress)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status == BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      counter++;
+    }
+  }
+  CHECK("final return code (singlefile_decompress)", ret == 0);
+
+  TEARDOWN;
+  return counter;
+}
+
+int test_singlefile_decompress()
+{
+  /* each file is read serially, then the same data (recompressed as multiple
+   * bzip2 blocks and streams, or as BGZF members) is read with a
+   * decompression pool */
+  const char *files[][2] = {
+    {"routeviews.route-views.jinx.updates.1427846400.bz2",
+     "routeviews.route-views.jinx.updates.1427846400.bz2"},
+    {"routeviews.route-views.jinx.updates.1427846400.bz2",
+     "routeviews.route-views.jinx.updates.1427846400.multi.bz2"},
+    {"ris.rrc06.updates.1427846400.gz",
+     "ris.rrc06.updates.1427846400.bgzf.gz"},
+  };
+  int serial;
+  size_t i;
+
+  for (i = 0; i < ARR_CNT(files); i++) {
+    CHECK("read records (serial)",
+          (serial = count_singlefile(files[i][0], 0)) > 0);
+    CHECK("read records (decompress threads)",
+          count_singlefile(files[i][1], 2) == serial);
+  }
+  return 0;
+}
+
+int test_csvfile()
+{
+  uint32_t last_time = 0;
+  int ordered = 1;
+  int counter = 0;
+  int ret;
+
+  SETUP;
+
+  SETUP_CSVFILE;
+
+  CHECK("stream start (csvfile)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    counter++;
+    /* the RIB and updates dumps are merged into a single time-ordered
+     * stream */
+    if (rec->time_sec < last_time) {
+      ordered = 0;
+    }
+    last_time = rec->time_sec;
+  }
+  CHECK("final return code (csvfile)", ret == 0);
+  CHECK("read records (csvfile)", counter == csvfile_RECORDS);
+  CHECK("records in time order (csvfile)", ordered == 1);
+
+  TEARDOWN;
+  return 0;
+}
+
+#define UNORDERED_MAX_RESOURCES 16
+
+int test_csvfile_unordered()
+{
+  struct {
+    char collector[BGPSTREAM_UTILS_STR_NAME_LEN];
+    bgpstream_record_type_t type;
+    uint32_t dump_time;
+    uint32_t last_time;
+  } res[UNORDERED_MAX_RESOURCES];
+  int res_cnt = 0;
+  int ordered = 1;
+  int counter = 0;
+  int ret;
+  int i;
 
-  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_COLLECTOR, "rrc06");
+  SETUP;
+
+  SETUP_CSVFILE;
+
+  bgpstream_set_unordered(bs);
+
+  CHECK("stream start (csvfile_unordered)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    counter++;
+    /* find the resource (collector, dump type and dump time) the record
+     * came from */
+    for (i = 0; i < res_cnt; i++) {
+      if (res[i].type == rec->type &&
+          res[i].dump_time == rec->dump_time_sec &&
+          strcmp(res[i].collector, rec->collector_name) == 0) {
+        break;
+      }
+    }
+    if (i == res_cnt) {
+      CHECK("unordered resource count", res_cnt < UNORDERED_MAX_RESOURCES);
+      strcpy(res[i].collector, rec->collector_name);
+      res[i].type = rec->type;
+      res[i].dump_time = rec->dump_time_sec;
+      res[i].last_time = 0;
+      res_cnt++;
+    }
+    if (rec->time_sec < res[i].last_time) {
+      ordered = 0;
+    }
+    res[i].last_time = rec->time_sec;
+  }
+  CHECK("final return code (csvfile_unordered)", ret == 0);
+  CHECK("read records (csvfile_unordered)",
+        counter == csvfile_unordered_RECORDS);
+  CHECK("records of each resource in time order (csvfile_unordered)",
+        res_cnt > 1 && ordered == 1);
+
+  TEARDOWN;
+  return 0;
+}
+
+static int run_csvfile_budget(size_t budget)
+{
+  SETUP;
+
+  SETUP_CSVFILE;
 
-  RUN(csvfile);
+  bgpstream_set_buffer_budget(bs, budget);
+
+  RUN(csvfile_budget);
 
   TEARDOWN;
   return 0;
 }
 
+int test_csvfile_budget()
+{
+  /* with a 1 byte budget, every resource reads using small buffers, which
+   * grow whenever a record does not fit. With a 1 MB budget, one resource
+   * gets a full-size buffer and the other is over budget. */
+  if (run_csvfile_budget(1) != 0 || run_csvfile_budget(1024 * 1024) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+static int run_csvfile_opener(int threads, int decode_ahead)
+{
+  bgpstream_opener_stats_t stats;
+
+  SETUP;
+
+  SETUP_CSVFILE;
+
+  bgpstream_set_opener_threads(bs, threads);
+  if (decode_ahead != 0) {
+    bgpstream_set_decode_ahead(bs, decode_ahead);
+  }
+
+  RUN(csvfile_opener);
+
+  /* decoding is not counted as opening */
+  bgpstream_get_opener_stats(bs, &stats);
+  CHECK("opener stats (csvfile_opener)",
+        stats.open_cnt == csvfile_RESOURCES && stats.queued_cnt == 0 &&
+          stats.active_cnt == 0 && stats.active_max >= 1 &&
+          stats.active_max <= threads &&
+          stats.queue_wait_max <= stats.queue_wait_total &&
+          stats.open_time_max <= stats.open_time_total);
+
+  TEARDOWN;
+  return 0;
+}
+
+int test_csvfile_opener()
+{
+  /* a single thread opens the resources one at a time, and also has to
+   * decode them when decoding ahead */
+  if (run_csvfile_opener(1, 0) != 0 || run_csvfile_opener(1, 8) != 0 ||
+      run_csvfile_opener(4, 0) != 0 || run_csvfile_opener(4, 8) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
 int test_sqlite()
 {
   SETUP;
@@ -181,14 +394,26 @@ int main()
 
 #ifdef WITH_DATA_INTERFACE_SINGLEFILE
   CHECK_SECTION("singlefile data interface", test_singlefile() == 0);
+  CHECK_SECTION("singlefile data interface (decompress threads)",
+                test_singlefile_decompress() == 0);
 #else
   SKIPPED_SECTION("singlefile data interface");
+  SKIPPED_SECTION("singlefile data interface (decompress threads)");
 #endif
 
 #ifdef WITH_DATA_INTERFACE_CSVFILE
   CHECK_SECTION("csvfile data interface", test_csvfile() == 0);
+  CHECK_SECTION("csvfile data interface (unordered)",
+                test_csvfile_unordered() == 0);
+  CHECK_SECTION("csvfile data interface (buffer budget)",
+                test_csvfile_budget() == 0);
+  CHECK_SECTION("csvfile data interface (opener threads)",
+                test_csvfile_opener() == 0);
 #else
   SKIPPED_SECTION("csvfile data interface");
+  SKIPPED_SECTION("csvfile data interface (unordered)");
+  SKIPPED_SECTION("csvfile data interface (buffer budget)");
+  SKIPPED_SECTION("csvfile data interface (opener threads)");
 #endif
 
 #ifdef WITH_DATA_INTERFACE_SQLITE
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2015 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_TEST_MRT_H
+#define __BGPSTREAM_TEST_MRT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Helpers for tests that write small MRT (or BMP) dumps to disk and read them
+ * back through the singlefile data interface. */
+
+#define MRT_TYPE_TABLE_DUMP_V2 13
+#define MRT_TYPE_BGP4MP 16
+
+#define BGP4MP_MESSAGE_AS4 4
+#define BGP4MP_STATE_CHANGE_AS4 5
+
+#define BGP_TYPE_UPDATE 2
+
+#define BUF_LEN 4096
+
+struct buf {
+  uint8_t data[BUF_LEN];
+  size_t len;
+};
+
+static inline void put8(struct buf *b, uint8_t v)
+{
+  b->data[b->len++] = v;
+}
+
+static inline void put16(struct buf *b, uint16_t v)
+{
+  put8(b, v >> 8);
+  put8(b, v & 0xff);
+}
+
+static inline void put32(struct buf *b, uint32_t v)
+{
+  put16(b, v >> 16);
+  put16(b, v & 0xffff);
+}
+
+static inline void put_bytes(struct buf *b, const uint8_t *bytes, size_t len)
+{
+  memcpy(b->data + b->len, bytes, len);
+  b->len += len;
+}
+
+/* append the contents of another buffer */
+static inline void put_buf(struct buf *b, struct buf *src)
+{
+  put_bytes(b, src->data, src->len);
+}
+
+static inline void put_mrt_header(struct buf *b, uint32_t time,
+                                  uint16_t type, uint16_t subtype,
+                                  uint32_t len)
+{
+  put32(b, time);
+  put16(b, type);
+  put16(b, subtype);
+  put32(b, len);
+}
+
+static inline void put_prefix(struct buf *b, uint8_t len, const uint8_t *addr)
+{
+  put8(b, len);
+  put_bytes(b, addr, (len + 7) / 8);
+}
+
+/* the header of a BGP message of the given (total) length */
+static inline void put_bgp_header(struct buf *b, uint16_t len, uint8_t type)
+{
+  int i;
+
+  // marker
+  for (i = 0; i < 16; i++) {
+    put8(b, 0xff);
+  }
+  put16(b, len);
+  put8(b, type);
+}
+
+/* withdraws 10.2.0.0/16, 172.16.0.0/12 and 2001:db8:1::/48, and announces
+ * 192.168.0.0/24, 10.0.0.0/8, 10.1.0.0/16 (via 192.0.2.1), 2001:db8::/32 and
+ * 2001:db8:2::/48 (via 2001:db8::1), with the AS path 65001 65100 (as 4-byte
+ * ASNs) and the community 65001:100 */
+static inline void put_test_update(struct buf *msg)
+{
+  struct buf withdrawn = {{0}, 0};
+  struct buf attrs = {{0}, 0};
+  struct buf nlri = {{0}, 0};
+  struct buf mp = {{0}, 0};
+  static const uint8_t w1[] = {10, 2};
+  static const uint8_t w2[] = {172, 16};
+  static const uint8_t w3[] = {0x20, 0x01, 0x0d, 0xb8, 0x00, 0x01};
+  static const uint8_t a1[] = {192, 168, 0};
+  static const uint8_t a2[] = {10};
+  static const uint8_t a3[] = {10, 1};
+  static const uint8_t a4[] = {0x20, 0x01, 0x0d, 0xb8};
+  static const uint8_t a5[] = {0x20, 0x01, 0x0d, 0xb8, 0x00, 0x02};
+  static const uint8_t nh6[16] = {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0,
+                                  0,    0,    0,    0,    0, 0, 0, 1};
+
+  put_prefix(&withdrawn, 16, w1);
+  put_prefix(&withdrawn, 12, w2);
+
+  // ORIGIN: IGP
+  put8(&attrs, 0x40);
+  put8(&attrs, 1);
+  put8(&attrs, 1);
+  put8(&attrs, 0);
+
+  // AS_PATH: one AS_SEQUENCE segment of two 4-byte ASNs
+  put8(&attrs, 0x40);
+  put8(&attrs, 2);
+  put8(&attrs, 10);
+  put8(&attrs, 2);
+  put8(&attrs, 2);
+  put32(&attrs, 65001);
+  put32(&attrs, 65100);
+
+  // NEXT_HOP: 192.0.2.1
+  put8(&attrs, 0x40);
+  put8(&attrs, 3);
+  put8(&attrs, 4);
+  put32(&attrs, 0xc0000201);
+
+  // COMMUNITIES: 65001:100
+  put8(&attrs, 0xc0);
+  put8(&attrs, 8);
+  put8(&attrs, 4);
+  put16(&attrs, 65001);
+  put16(&attrs, 100);
+
+  // MP_REACH_NLRI: IPv6 unicast
+  put16(&mp, 2);
+  put8(&mp, 1);
+  put8(&mp, sizeof(nh6));
+  put_bytes(&mp, nh6, sizeof(nh6));
+  put8(&mp, 0);
+  put_prefix(&mp, 32, a4);
+  put_prefix(&mp, 48, a5);
+  put8(&attrs, 0x80);
+  put8(&attrs, 14);
+  put8(&attrs, mp.len);
+  put_buf(&attrs, &mp);
+
+  // MP_UNREACH_NLRI: IPv6 unicast
+  mp.len = 0;
+  put16(&mp, 2);
+  put8(&mp, 1);
+  put_prefix(&mp, 48, w3);
+  put8(&attrs, 0x80);
+  put8(&attrs, 15);
+  put8(&attrs, mp.len);
+  put_buf(&attrs, &mp);
+
+  put_prefix(&nlri, 24, a1);
+  put_prefix(&nlri, 8, a2);
+  put_prefix(&nlri, 16, a3);
+
+  put_bgp_header(msg, 19 + 2 + withdrawn.len + 2 + attrs.len + nlri.len,
+                 BGP_TYPE_UPDATE);
+  put16(msg, withdrawn.len);
+  put_buf(msg, &withdrawn);
+  put16(msg, attrs.len);
+  put_buf(msg, &attrs);
+  put_buf(msg, &nlri);
+}
+
+/* an UPDATE that announces and withdraws nothing (an End-of-RIB marker) */
+static inline void put_end_of_rib(struct buf *msg)
+{
+  put_bgp_header(msg, 19 + 2 + 2, BGP_TYPE_UPDATE);
+  put16(msg, 0);
+  put16(msg, 0);
+}
+
+/* write the buffer to the given file. returns 0 on success, -1 on error */
+static inline int write_file(const char *path, struct buf *b)
+{
+  FILE *f;
+
+  if ((f = fopen(path, "w")) == NULL) {
+    return -1;
+  }
+  if (fwrite(b->data, 1, b->len, f) != b->len) {
+    fclose(f);
+    return -1;
+  }
+  return fclose(f);
+}
+
+#endif /* __BGPSTREAM_TEST_MRT_H */